@@ -0,0 +1,109 @@
+/**
+ * @file AdaptiveGrid.h
+ * @brief Coarse-to-fine selection of the pixels of a map at which a
+ * test statistic is evaluated.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#ifndef Likelihood_AdaptiveGrid_h
+#define Likelihood_AdaptiveGrid_h
+
+#include <vector>
+
+namespace Likelihood {
+
+/**
+ * @class AdaptiveGrid
+ *
+ * @brief Selects the pixels of an nx by ny map (stored row by row,
+ * x varying fastest) at which a quantity such as TS is evaluated.
+ * The first pass covers a coarse grid of pixels spaced by coarseStep.
+ * Each cell of the grid is then split in half along each axis if the
+ * largest value at its corners exceeds valueThreshold, or if the
+ * change in value across it, per pixel, exceeds gradThreshold, and
+ * the new corners are evaluated in the next pass.  This continues
+ * until the cells are one pixel across.  The pixels that were skipped
+ * are filled by bilinear interpolation from the corners of the cells
+ * that contain them.
+ *
+ * Usage:
+ *
+ *    AdaptiveGrid grid(nx, ny, coarseStep, valueThreshold, gradThreshold);
+ *    std::vector<long> pixels;
+ *    while (grid.nextPixels(pixels)) {
+ *       // evaluate the pixels and pass the results to grid.setValue()
+ *    }
+ *    grid.interpolate(values);
+ */
+
+class AdaptiveGrid {
+
+public:
+
+   AdaptiveGrid(long nx, long ny, long coarseStep,
+                double valueThreshold, double gradThreshold);
+
+   /// Fill pixels with the next pixels to be evaluated.
+   /// @return false if there are no more pixels to evaluate.
+   bool nextPixels(std::vector<long> & pixels);
+
+   /// Set the value at a pixel returned by nextPixels.
+   void setValue(long ipix, double value);
+
+   /// True if the pixel has been evaluated rather than interpolated.
+   bool evaluated(long ipix) const {
+      return m_evaluated.at(ipix);
+   }
+
+   /// Number of pixels evaluated so far.
+   long nEvaluated() const;
+
+   /// Fill the entries of values (of size nx*ny) for the pixels that
+   /// were not evaluated, by bilinear interpolation from the corners
+   /// of the final cells.  Entries for evaluated pixels are left as
+   /// they are, so this may be applied to any quantity that is known
+   /// at the evaluated pixels, not just the one that drove the
+   /// refinement.
+   void interpolate(std::vector<double> & values) const;
+
+private:
+
+   struct Cell {
+      Cell(long x0_, long y0_, long x1_, long y1_)
+         : x0(x0_), y0(y0_), x1(x1_), y1(y1_) {}
+      long x0;
+      long y0;
+      long x1;
+      long y1;
+   };
+
+   long m_nx;
+   long m_ny;
+   long m_coarseStep;
+   double m_valueThreshold;
+   double m_gradThreshold;
+
+   std::vector<double> m_values;
+   std::vector<bool> m_evaluated;
+
+   /// Cells whose corners are being evaluated in the current pass.
+   std::vector<Cell> m_active;
+
+   /// Cells that will not be split further.
+   std::vector<Cell> m_final;
+
+   bool m_started;
+
+   void addPixel(long ix, long iy, std::vector<long> & pixels);
+
+   bool splitCell(const Cell & cell) const;
+
+   static void gridPoints(long n, long step, std::vector<long> & points);
+
+};
+
+} // namespace Likelihood
+
+#endif // Likelihood_AdaptiveGrid_h
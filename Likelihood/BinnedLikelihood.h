@@ -176,23 +176,33 @@ namespace Likelihood {
      inline const std::vector<std::string> & fixedSources() const { return m_fixedSources; }
 
      /// Return the predicted counts for all the fixed sources, summed together
-     inline const std::vector<double> & fixedModelSpectrum() const { return m_fixed_counts_spec; }
+     inline const std::vector<double> & fixedModelSpectrum() const { return fixedModelOwner().m_fixed_counts_spec; }
 
      /// Return the weighted predicted counts for all the fixed sources, summed together
-     inline const std::vector<double> & fixedModelSpectrum_wt() const { return m_fixed_counts_spec_wt; }
+     inline const std::vector<double> & fixedModelSpectrum_wt() const { return fixedModelOwner().m_fixed_counts_spec_wt; }
       
      /// Return the predicted counts for all the fixed sources, summed together, energy dispersion applied
-     inline const std::vector<double> & fixedModelSpectrum_edisp() const { return m_fixed_counts_spec_edisp; }
+     inline const std::vector<double> & fixedModelSpectrum_edisp() const { return fixedModelOwner().m_fixed_counts_spec_edisp; }
       
      /// Return the weighted predicted counts for all the fixed sources, summed together, energy dispersion applied
-     inline const std::vector<double> & fixedModelSpectrum_edisp_wt() const { return m_fixed_counts_spec_edisp_wt; }
+     inline const std::vector<double> & fixedModelSpectrum_edisp_wt() const { return fixedModelOwner().m_fixed_counts_spec_edisp_wt; }
         
      /// Return the fixed model counts
-     inline const std::vector<double> & fixedModelCounts() const { return m_fixedModelCounts; }
+     inline const std::vector<double> & fixedModelCounts() const { return fixedModelOwner().m_fixedModelCounts; }
 
      /// Check if updating the fixed model is allowed
      inline bool updateFixedWeights() const { return m_updateFixedWeights; }
 
+     /* Use the summed fixed-source model of owner instead of building one.
+
+	This must be called before any sources are added, and owner must
+	have the same counts map, source maps file and fixed sources, and
+	must outlive this object.  The fixed sources are then added by
+	name only, so their source maps are not loaded here.  Changing the
+	set of fixed sources makes a private copy of the fixed model.
+     */
+     void shareFixedModel(const BinnedLikelihood & owner);
+
      /// Set flag to enable or disable updating the fixed model 
      void setUpdateFixedWeights(bool update) {
        m_updateFixedWeights = update;
@@ -224,6 +234,7 @@ namespace Likelihood {
      void set_edisp_val(int edisp_val) {
        if ( edisp_val == m_config.edisp_val() ) return;
        m_srcMapCache.set_edisp_val(edisp_val);
+       unshareFixedModel();
        m_fixedModelCounts.clear();
        m_fixed_counts_spec.clear();   
        m_fixed_counts_spec_wt.clear();
@@ -725,6 +736,17 @@ namespace Likelihood {
      void addFixedNpreds(const std::string & srcName,
 			 SourceMap * srcMap=0, 
 			 bool subtract=false);
+
+     /// The object holding the fixed model used by this one
+     const BinnedLikelihood & fixedModelOwner() const {
+       return m_fixedModelOwner != 0 ? *m_fixedModelOwner : *this;
+     }
+
+     /// Stop sharing the fixed model, taking a copy of it
+     void unshareFixedModel();
+
+     /// Add a fixed source that is already in the shared fixed model
+     void addSharedFixedSource(const std::string & srcName);
      
 
      /* ---------------- Data Members --------------------- */
@@ -793,6 +815,9 @@ namespace Likelihood {
      /// Flag to allow updating of Fixed model weights
      bool m_updateFixedWeights;
 
+     /// Object whose fixed model is used instead of this one's, if any
+     const BinnedLikelihood * m_fixedModelOwner;
+
    };
 };
 
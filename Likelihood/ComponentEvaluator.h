@@ -0,0 +1,127 @@
+/**
+ * @file ComponentEvaluator.h
+ * @brief Evaluate the LogLike components of a composite statistic,
+ * concurrently if more than one thread is set.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#ifndef Likelihood_ComponentEvaluator_h
+#define Likelihood_ComponentEvaluator_h
+
+#include <vector>
+
+#include "optimizers/Parameter.h"
+
+namespace Likelihood {
+
+   class LogLike;
+   class ThreadPool;
+
+/**
+ * @class ComponentEvaluator
+ *
+ * @brief Computes the values, derivatives wrt the free parameters
+ * and parameter updates of a set of LogLike components, as used by
+ * SummedLikelihood, Composite2 and CompositeLikelihood.
+ *
+ * The results for each component are returned in their own slots,
+ * so that the caller can combine them in a fixed order, and the
+ * results do not depend on the thread count or scheduling.  The
+ * components are dispatched in order of decreasing predicted cost,
+ * so that the most expensive ones are started first.  The components
+ * must not share Source objects.
+ */
+
+class ComponentEvaluator {
+
+public:
+
+   ComponentEvaluator() : m_nthreads(1), m_valueWarm(false),
+                          m_derivsWarm(false) {}
+
+   /// Set the number of threads.  A value <= 0 selects all
+   /// available processors.
+   void setNumThreads(int nthreads);
+
+   size_t numThreads() const {
+      return m_nthreads;
+   }
+
+   /// Must be called when components are added or removed.
+   void reset();
+
+   /// @param priorsFirstOnly If true, the priors are included with
+   ///        the first component only, otherwise with every one.
+   void values(const std::vector<LogLike *> & components,
+               std::vector<double> & values,
+               bool priorsFirstOnly) const;
+
+   void derivs(const std::vector<LogLike *> & components,
+               std::vector< std::vector<double> > & derivs,
+               bool priorsFirstOnly) const;
+
+   /// Set pars in every component and call its syncParams().
+   void syncParams(const std::vector<LogLike *> & components,
+                   const std::vector<optimizers::Parameter> & pars) const;
+
+   /// Predicted cost of evaluating a component: the number of
+   /// filled pixels (binned) or events (unbinned) times the number
+   /// of sources.  For a RemoteLogLike, this is queried from its
+   /// worker.
+   static double cost(const LogLike & component);
+
+private:
+
+   size_t m_nthreads;
+
+   /// True once values() and derivs() have been called serially, so
+   /// that any caches the components build on first use (source
+   /// maps, responses) are filled before they are evaluated from
+   /// worker threads.
+   mutable bool m_valueWarm;
+   mutable bool m_derivsWarm;
+
+   /// Component indices in order of decreasing predicted cost.
+   mutable std::vector<size_t> m_order;
+
+   class ValueTask;
+   class DerivsTask;
+   class SyncTask;
+
+   /// Owning pointer to the thread pool.  Copies start out empty, so
+   /// each copy builds its own threads.
+   class ThreadPoolPtr {
+   public:
+      ThreadPoolPtr() : m_ptr(0) {}
+      ThreadPoolPtr(const ThreadPoolPtr &) : m_ptr(0) {}
+      ThreadPoolPtr & operator=(const ThreadPoolPtr &) {
+         reset(0);
+         return *this;
+      }
+      ~ThreadPoolPtr() {
+         reset(0);
+      }
+      ThreadPool * get() const {
+         return m_ptr;
+      }
+      void reset(ThreadPool * ptr);
+   private:
+      ThreadPool * m_ptr;
+   };
+
+   mutable ThreadPoolPtr m_pool;
+
+   /// Return the thread pool, or zero if the components are to be
+   /// evaluated serially.
+   ThreadPool * threadPool(size_t ncomponents) const;
+
+   const std::vector<size_t> &
+   order(const std::vector<LogLike *> & components) const;
+
+};
+
+} // namespace Likelihood
+
+#endif // Likelihood_ComponentEvaluator_h
@@ -18,6 +18,7 @@
 
 #include "optimizers/Statistic.h"
 
+#include "Likelihood/ComponentEvaluator.h"
 #include "Likelihood/LogLike.h"
 #include "Likelihood/TiedParameter.h"
 
@@ -66,6 +67,19 @@ public:
 
    void syncParams();
 
+   /// Set the number of threads used to evaluate the components
+   /// concurrently in value() and getFreeDerivs().  A value <= 0
+   /// selects all available processors.  The component contributions
+   /// are combined in a fixed order, so results do not depend on the
+   /// thread count or scheduling.
+   void setNumThreads(int nthreads) {
+      m_evaluator.setNumThreads(nthreads);
+   }
+
+   size_t numThreads() const {
+      return m_evaluator.numThreads();
+   }
+
    double NpredValue(const std::string &, bool weighted=false) const {return 0;}
 
    TiedParameter & getTiedParam(const LogLike & like, size_t i);
@@ -95,6 +109,28 @@ private:
 
    std::vector<TiedParameter *> m_tiedPars;
 
+   /// The components, in the order of m_components.
+   std::vector<LogLike *> m_componentList;
+
+   /// Position of each component in m_componentList.
+   std::map<const LogLike *, size_t> m_componentIndex;
+
+   /// For each component in m_componentList, the index in
+   /// m_tiedPars of the TiedParameter that each of its parameters
+   /// belongs to, or -1.  These are rebuilt whenever the components
+   /// or the ties change.
+   std::vector< std::vector<int> > m_tieIndex;
+
+   ComponentEvaluator m_evaluator;
+
+   void buildTieTables();
+
+   int tiedParIndex(size_t icomp, size_t par_index) const;
+
+   /// Number of free, untied parameters in the first ncomps
+   /// components of m_componentList.
+   int nFreeUntied(size_t ncomps) const;
+
 };
 
 } // namespace Likelihood
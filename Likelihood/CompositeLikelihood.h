@@ -19,6 +19,7 @@
 
 #include "optimizers/Statistic.h"
 
+#include "Likelihood/ComponentEvaluator.h"
 #include "Likelihood/LogLike.h"
 
 namespace Likelihood {
@@ -46,6 +47,17 @@ public:
                                  bool getFree) const;
    void syncParams();
 
+   /// Set the number of threads used to evaluate the components
+   /// concurrently in value() and getFreeDerivs().  A value <= 0
+   /// selects all available processors.
+   void setNumThreads(int nthreads) {
+      m_evaluator.setNumThreads(nthreads);
+   }
+
+   size_t numThreads() const {
+      return m_evaluator.numThreads();
+   }
+
    double NpredValue(const std::string &, bool /* weighted */) const {return 0;}
 
 protected:
@@ -73,6 +85,11 @@ private:
    std::string m_normParName;
    std::string m_commonFuncName;
 
+   /// The components, in the order of m_components.
+   std::vector<LogLike *> m_componentList;
+
+   ComponentEvaluator m_evaluator;
+
 };
 
 } // namespace Likelihood
@@ -34,6 +34,19 @@ public:
    convolve2d(const std::vector< std::vector<float> > & signal,
               const std::vector< std::vector<float> > & psf);
 
+   /// Cross-correlation of two nx by ny images stored row by row
+   /// (x varying fastest),
+   ///
+   ///    output(dx, dy) = Sum_{x,y} signal(x, y)*kernel(x - dx, y - dy),
+   ///
+   /// with kernel taken to be zero outside the image, for all shifts
+   /// |dx| < nx, |dy| < ny.  The output is a (2*nx - 1) by (2*ny - 1)
+   /// image with (dx, dy) = (0, 0) at index (ny - 1)*(2*nx - 1) + nx - 1.
+   static void correlate2d(size_t nx, size_t ny,
+                           const std::vector<double> & signal,
+                           const std::vector<double> & kernel,
+                           std::vector<double> & output);
+
 };
 
 } // namespace Likelihood
@@ -0,0 +1,110 @@
+/**
+ * @file DiffRespGrid.h
+ * @brief Grid of diffuse response values for interpolating the
+ * responses of individual events.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#ifndef Likelihood_DiffRespGrid_h
+#define Likelihood_DiffRespGrid_h
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "healpix_base.h"
+
+namespace Likelihood {
+
+   class Event;
+
+/**
+ * @class DiffRespGrid
+ *
+ * @brief Nodes of a HEALPix x log(energy) x cos(inclination) x event
+ * type grid at which the diffuse responses of smooth components are
+ * computed exactly, and from which the responses of individual events
+ * are interpolated.  Only the nodes needed by the events passed to
+ * addEvent(...) are kept, so the grid may be fine without requiring
+ * responses over the whole sky.
+ *
+ * Interpolation is bilinear in the HEALPix pixels (using the four
+ * nearest pixel centers), linear in log(energy), and linear in
+ * cos(inclination).  The dependence of the response on the spacecraft
+ * azimuth is neglected.
+ */
+
+class DiffRespGrid {
+
+public:
+
+   /// @param nside HEALPix resolution of the direction axis
+   /// @param ebinsPerDecade Number of energy nodes per decade
+   /// @param ncostheta Number of cos(inclination) nodes
+   /// @param costhetaMin Smallest cos(inclination) to be covered
+   /// @param costhetaMax Largest cos(inclination) to be covered
+   DiffRespGrid(int nside, int ebinsPerDecade, int ncostheta,
+                double costhetaMin, double costhetaMax);
+
+   /// Add the nodes needed to interpolate the response of event.
+   void addEvent(const Event & event);
+
+   /// Number of nodes added so far.
+   size_t nnodes() const {
+      return m_nodes.size();
+   }
+
+   /// Pseudo-event at node inode, with the apparent direction at the
+   /// center of the HEALPix pixel and spacecraft axes giving the
+   /// inclination of the node.
+   Event nodeEvent(size_t inode, double time,
+                   const std::string & respName) const;
+
+   /// Interpolate the responses of event for each of ncomps
+   /// components from the node values, which are ordered as
+   /// nodeValues[inode*ncomps + k].  All of the nodes needed by the
+   /// event must have been added.
+   void interpolate(const Event & event,
+                    const std::vector<double> & nodeValues,
+                    size_t ncomps, std::vector<double> & values) const;
+
+   /// Cosine of the angle between the apparent direction of the event
+   /// and the spacecraft z-axis.
+   static double costheta(const Event & event);
+
+private:
+
+   struct NodeKey {
+      int type;
+      int ienergy;
+      int icostheta;
+      int ipix;
+      bool operator<(const NodeKey & rhs) const;
+   };
+
+   Healpix_Base m_healpix;
+   int m_ebinsPerDecade;
+   int m_ncostheta;
+   double m_costhetaMin;
+   double m_costhetaStep;
+
+   /// Keys of the nodes, in the order they were added.
+   std::vector<NodeKey> m_nodes;
+
+   /// Node indices by key.
+   std::map<NodeKey, size_t> m_nodeIndices;
+
+   static const size_t s_nstencil = 16;
+
+   void stencil(const Event & event, NodeKey * keys,
+                double * weights) const;
+
+   size_t nodeIndex(const NodeKey & key) const;
+
+};
+
+} // namespace Likelihood
+
+#endif // Likelihood_DiffRespGrid_h
@@ -21,6 +21,7 @@ namespace Likelihood {
 
    class DiffuseSource;
    class EquinoxRotation;
+   class EventColumns;
    class ResponseFunctions;
    class Source;
 
@@ -42,6 +43,12 @@ public:
          double muZenith, bool useEdisp, const std::string & respName,
          int type=2, double efficiency=1);
 
+   /// Copies are detached from the EventColumns of the original and
+   /// keep their own copies of its diffuse responses.
+   Event(const Event & other);
+
+   Event & operator=(const Event & rhs);
+
    ~Event() {}
 
    const astro::SkyDir & getDir() const {return m_appDir;}
@@ -78,6 +85,15 @@ public:
                           const ResponseFunctions & respFuncs,
                           bool useDummyValue=false);
 
+   /// Compute the Gaussian-quadrature diffuse responses of this event
+   /// for each of srcs, without storing them.  Since the Event is not
+   /// modified, different Events may be processed on different
+   /// threads, provided each thread uses its own ResponseFunctions
+   /// and DiffuseSource copies.
+   void diffuseResponsesGQ(const std::vector<DiffuseSource *> & srcs,
+                           const ResponseFunctions & respFuncs,
+                           std::vector<double> & respValues) const;
+
    /// This method takes the spatial distribution of the emission for
    /// the DiffuseSource src and computes the event-specific response.
    /// See section 1 of 
@@ -113,10 +129,7 @@ public:
 //       m_respDiffuseSrcs[diffuseComponent].clear();
 //       m_respDiffuseSrcs[diffuseComponent].push_back(value);
 //    }
-   void setDiffuseResponse(const std::string & componentName, double value) {
-      m_respDiffuseSrcs[componentName].clear();
-      m_respDiffuseSrcs[componentName].push_back(value);
-   }
+   void setDiffuseResponse(const std::string & componentName, double value);
 
    /// Set diffuse response for finite energy resolution.
    void setDiffuseResponse(const std::string& srcName, 
@@ -129,7 +142,9 @@ public:
       return m_trueEnergies;
    }
 
-   /// Direct access to diffuse responses.
+   /// Direct access to diffuse responses.  For an Event attached to
+   /// an EventColumns object, the value is copied from the columns
+   /// into this Event's map, which holds the returned vector.
    const std::vector<double> & diffuseResponse(const std::string& srcName) const;
 
    void computeGaussianParams(const std::string & srcName, double & norm, 
@@ -158,6 +173,22 @@ public:
       return m_efficiency;
    }
 
+   /// Store the diffuse responses of this event in column "index" of
+   /// the EventColumns object owned by an EventContainer instead of
+   /// in this object.  Any responses already held by this object are
+   /// moved to the columns, which must outlive this Event.
+   void attach(EventColumns * columns, size_t index);
+
+   bool attached() const {
+      return m_columns != 0;
+   }
+
+   /// Index of this event in its EventColumns, if attached or copied
+   /// from an attached Event.
+   size_t index() const {
+      return m_index;
+   }
+
 private:
 
    /// apparent direction, energy, arrival time, and cosine(zenith angle)
@@ -184,20 +215,31 @@ private:
    std::map<std::string, double> m_fluxDensities;
    
    /// Vector of true energies.
-   double m_estep;
    std::vector<double> m_trueEnergies;
 
-   std::vector<double> m_true_energies;
-
    /// Efficiency correction at the time and energy of this event.
    double m_efficiency;
 
    /// Response function data, unique to each event, and comprising an
    /// energy redistribution function for each diffuse source.
    typedef std::vector<double> diffuse_response;
-   std::map<std::string, diffuse_response> m_respDiffuseSrcs;
+   mutable std::map<std::string, diffuse_response> m_respDiffuseSrcs;
    mutable std::map<std::string, std::string> m_diffSrcNames;
 
+   /// Column storage for the diffuse responses, if attached.
+   EventColumns * m_columns;
+   size_t m_index;
+
+   bool haveDiffuseResponse(const std::string & diffuseComponent) const;
+
+   /// Copy the diffuse responses held in the columns, if attached.
+   void copyColumnResponses(std::map<std::string, diffuse_response> 
+                            & responses) const;
+
+   /// Append a diffuse response value for the named component.
+   void addDiffuseResponse(const std::string & diffuseComponent,
+                           double value);
+
    /// Compute Celestial direction from (phi, mu) in Equinox-centered
    /// coordinates.
    void getCelestialDir(double phi, double mu, EquinoxRotation & eqRot,
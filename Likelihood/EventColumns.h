@@ -0,0 +1,88 @@
+/**
+ * @file EventColumns.h
+ * @brief Column-wise (structure-of-arrays) storage of the diffuse
+ * responses used in unbinned likelihood calculations.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#ifndef Likelihood_EventColumns_h
+#define Likelihood_EventColumns_h
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Likelihood {
+
+/**
+ * @class EventColumns
+ *
+ * @brief A [component][event] matrix of diffuse responses.  The
+ * Events held by an EventContainer refer to this matrix rather than
+ * keeping their own maps of response vectors, so that loops over
+ * large event lists touch contiguous memory.  Copies of those Events
+ * are detached and keep their own maps.  The other event quantities
+ * are still held by the Events themselves.
+ */
+
+class EventColumns {
+
+public:
+
+   EventColumns() : m_nevents(0) {}
+
+   /// Add a row for another event, with no diffuse responses set.
+   /// @return The index of the event.
+   size_t append();
+
+   void clear();
+
+   void reserve(size_t nevents);
+
+   size_t size() const {
+      return m_nevents;
+   }
+
+   /// Names of the diffuse components for which responses are stored.
+   const std::vector<std::string> & diffuseComponents() const {
+      return m_components;
+   }
+
+   /// Index of the named diffuse component, or -1 if there are no
+   /// responses for it.
+   int componentIndex(const std::string & component) const;
+
+   void setDiffuseResponse(size_t ievent, const std::string & component,
+                           double value);
+
+   bool hasDiffuseResponse(size_t ievent, const std::string & component) const;
+
+   /// The diffuse response of the named component for an event.
+   /// Throws an Exception if the response has not been set.
+   double diffuseResponse(size_t ievent, const std::string & component) const;
+
+   /// True if every event has a response for component icomp.
+   bool haveAllDiffuseResponses(size_t icomp) const;
+
+   /// Contiguous diffuse responses of a component, indexed by event.
+   /// Entries for which no response has been set are zero.
+   const std::vector<double> & diffuseResponses(size_t icomp) const {
+      return m_diffuseResps.at(icomp);
+   }
+
+private:
+
+   size_t m_nevents;
+
+   std::vector<std::string> m_components;
+   std::map<std::string, size_t> m_componentIndices;
+   std::vector< std::vector<double> > m_diffuseResps;
+   std::vector< std::vector<bool> > m_haveDiffuseResps;
+
+};
+
+} // namespace Likelihood
+
+#endif // Likelihood_EventColumns_h
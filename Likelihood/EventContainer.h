@@ -10,10 +10,12 @@
 #define Likelihood_EventContainer_h
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "Likelihood/DiffRespNames.h"
 #include "Likelihood/Event.h"
+#include "Likelihood/EventColumns.h"
 
 namespace st_stream {
    class StreamFormatter;
@@ -50,6 +52,15 @@ public:
 
    void getEvents(std::string event_file, bool apply_roi_cut=true,
                   unsigned int event_type_mask=3);
+
+   /// Read the events from several FT1 files.  Each file is read in
+   /// chunks of rows, and the ROI cuts are applied to each chunk
+   /// before any Events are constructed.  If cfitsio is reentrant,
+   /// up to nthreads files are read concurrently.  The events are
+   /// stored in the order of the files.
+   void getEvents(const std::vector<std::string> & event_files,
+                  bool apply_roi_cut=true, unsigned int event_type_mask=3,
+                  size_t nthreads=1);
                   
    void computeEventResponses(Source & src, double sr_radius=30.);
 
@@ -71,8 +82,26 @@ public:
       return m_events;
    }
 
+   /// Column-wise diffuse responses, indexed in the same order as
+   /// events().
+   const EventColumns & columns() const {
+      return *m_columns;
+   }
+
+   /// Indices of the events in order of increasing energy.
+   const std::vector<size_t> & energyOrder() const {
+      return m_energyOrder;
+   }
+
+   /// Positions [first, last) in energyOrder() of the events with
+   /// emin <= energy <= emax.
+   std::pair<size_t, size_t> energyRange(double emin, double emax) const;
+
    void clear() {
       m_events.clear();
+      m_columns->clear();
+      m_energyOrder.clear();
+      m_sortedEnergies.clear();
    }
 
 private:
@@ -85,8 +114,40 @@ private:
 
    std::vector<Event> m_events;
 
+   /// Owned by this object and allocated on the heap, so the Events
+   /// can keep a pointer to it.
+   EventColumns * m_columns;
+
+   /// Energy-sorted permutation of the events and the corresponding
+   /// energies, so that energy-restricted loops can visit only the
+   /// events in range.
+   std::vector<size_t> m_energyOrder;
+   std::vector<double> m_sortedEnergies;
+
    static std::vector<std::string> s_FT1_columns;
 
+   /// Header information and accepted rows of one FT1 file.
+   struct FT1File;
+
+   class ReadTask;
+
+   /// Read the event type mask, event class format, and diffuse
+   /// response column names from the header of an FT1 file.
+   void readFileInfo(FT1File & file, unsigned int event_type_mask) const;
+
+   /// Construct the Events for the accepted rows of an FT1 file.
+   void storeEvents(const FT1File & file);
+
+   /// The Events refer to m_columns, which is owned by this object.
+   EventContainer(const EventContainer &);
+   EventContainer & operator=(const EventContainer &);
+
+   /// Reserve space for nevents Events, re-attaching any that a
+   /// reallocation copies to the columns.
+   void reserve(size_t nevents);
+
+   void sortByEnergy();
+
    void setFT1_columns() const;
 
    void get_diffuse_names(tip::Table * events, 
@@ -1,4 +1,4 @@
-/** 
+/**
  * @file EventSourceCache.h
  * @brief Declaration of EventSourceCache class
  * @author S. Fegan
@@ -9,70 +9,153 @@
 #ifndef Likelihood_EventSourceCache_h
 #define Likelihood_EventSourceCache_h
 
+#include<algorithm>
 #include<vector>
 #include<map>
-
-//#define DEBUG_EVENT_SOURCE_CACHE
+#include<string>
+#include<utility>
 
 namespace Likelihood {
 
+/**
+ * @class EventSourceCache
+ *
+ * @brief Cache of per-event, per-source values.  Each source is
+ * assigned an integer index when it is added, and the values are
+ * stored in a contiguous [source][event] matrix, with a bit per entry
+ * recording whether it has been computed.  Inner loops should look
+ * up the source indices once and then use the index-based accessors,
+ * which avoid any string comparisons.
+ *
+ * The accessors that read the cache may be called concurrently, but
+ * entries must not be set from more than one thread at a time.
+ */
+
 template<typename T>
 class EventSourceCache {
 
 public:
 
+  /// Cached value and flag indicating whether it is valid, in the
+  /// form expected by Source::fluxDensity(...).
+  typedef std::pair<bool, T> Entry;
+
   class EventRef
   {
   public:
     EventRef(): m_eventcache(), m_ievent() { }
-    EventRef(EventSourceCache* eventcache, unsigned ievent): 
+    EventRef(EventSourceCache* eventcache, unsigned ievent):
       m_eventcache(eventcache), m_ievent(ievent) { }
-    inline T& getCachedValue(const std::string& srcname);
+    Entry getCachedValue(unsigned isrc) const {
+      return m_eventcache->getCachedValue(isrc, m_ievent);
+    }
+    void setCachedValue(unsigned isrc, const Entry& entry) {
+      m_eventcache->setCachedValue(isrc, m_ievent, entry);
+    }
+    unsigned eventIndex() const { return m_ievent; }
   private:
     EventSourceCache* m_eventcache;
     unsigned m_ievent;
   };
 
-  EventSourceCache(unsigned nevents = 0): m_nevents(nevents), m_cache() { }
+  EventSourceCache(unsigned nevents = 0):
+    m_nevents(nevents), m_nslots(0), m_srcIndices(), m_freeSlots(),
+    m_values(), m_valid() { }
 
-  ~EventSourceCache()
-  {
-#ifdef DEBUG_EVENT_SOURCE_CACHE
-    std::cout << "Event/Source cache count:" << std::endl;
-    for(std::map<std::string, unsigned>::iterator isrccnt=m_srcEvCount.begin();
-	isrccnt!=m_srcEvCount.end(); isrccnt++)
-      std::cout << isrccnt->first << ' ' << isrccnt->second << std::endl;
-#endif
-  }
-    
+  /// Remove all sources and set the number of events.
   void clearAndResize(unsigned nevents = 0)
   {
     m_nevents = nevents;
-    m_cache.clear();
+    m_nslots = 0;
+    m_srcIndices.clear();
+    m_freeSlots.clear();
+    m_values.clear();
+    m_valid.clear();
+  }
+
+  unsigned nevents() const { return m_nevents; }
+
+  /// Index of the named source, assigning one (and invalidating its
+  /// entries) if the source is not yet in the cache.
+  unsigned addSource(const std::string& srcname)
+  {
+    std::map<std::string, unsigned>::const_iterator it
+      = m_srcIndices.find(srcname);
+    if(it != m_srcIndices.end())return it->second;
+    unsigned isrc;
+    if(!m_freeSlots.empty())
+      {
+	isrc = m_freeSlots.back();
+	m_freeSlots.pop_back();
+      }
+    else
+      {
+	isrc = m_nslots++;
+	m_values.resize(m_values.size() + m_nevents);
+	m_valid.resize(m_valid.size() + m_nevents);
+      }
+    invalidate(isrc);
+    m_srcIndices[srcname] = isrc;
+    return isrc;
+  }
+
+  /// Release the index of the named source.  The index may be
+  /// reassigned by a later call to addSource.
+  void deleteSource(const std::string& srcname)
+  {
+    std::map<std::string, unsigned>::iterator it
+      = m_srcIndices.find(srcname);
+    if(it == m_srcIndices.end())return;
+    invalidate(it->second);
+    m_freeSlots.push_back(it->second);
+    m_srcIndices.erase(it);
   }
 
-  void deleteSource(const std::string& srcname) { m_cache.erase(srcname); }
+  /// Index of the named source or -1 if it is not in the cache.
+  int sourceIndex(const std::string& srcname) const
+  {
+    std::map<std::string, unsigned>::const_iterator it
+      = m_srcIndices.find(srcname);
+    if(it == m_srcIndices.end())return -1;
+    return static_cast<int>(it->second);
+  }
+
+  /// Mark all entries for source isrc as not computed.
+  void invalidate(unsigned isrc)
+  {
+    std::vector<bool>::iterator
+      begin(m_valid.begin() + size_t(isrc)*m_nevents);
+    std::fill(begin, begin + m_nevents, false);
+  }
 
   EventRef getEventRef(unsigned ievent) { return EventRef(this,ievent); }
 
-  T& getCachedValue(unsigned ievent,const std::string& srcname)
+  bool isCached(unsigned isrc, unsigned ievent) const
+  {
+    return m_valid[size_t(isrc)*m_nevents + ievent];
+  }
+
+  Entry getCachedValue(unsigned isrc, unsigned ievent) const
   {
-    EvCache& evcache(m_cache[srcname]);
-    if(evcache.size() != m_nevents)evcache.resize(m_nevents);
-#ifdef DEBUG_EVENT_SOURCE_CACHE
-    m_srcEvCount[srcname]++;
-#endif
-    return evcache.at(ievent);
+    size_t indx(size_t(isrc)*m_nevents + ievent);
+    if(m_valid[indx])return Entry(true, m_values[indx]);
+    return Entry(false, T());
   }
 
-  std::vector<T>& getCachedEventValues(const std::string& srcname)
+  /// Store the entry if it is valid.
+  void setCachedValue(unsigned isrc, unsigned ievent, const Entry& entry)
   {
-    EvCache& evcache(m_cache[srcname]);
-    if(evcache.size() != m_nevents)evcache.resize(m_nevents);
-#ifdef DEBUG_EVENT_SOURCE_CACHE
-    m_srcEvCount[srcname]+=m_nevents;
-#endif
-    return evcache;
+    if(!entry.first)return;
+    size_t indx(size_t(isrc)*m_nevents + ievent);
+    m_values[indx] = entry.second;
+    m_valid[indx] = true;
+  }
+
+  /// Contiguous values for source isrc, indexed by event.  Entries
+  /// for which isCached(...) is false are undefined.
+  const T* sourceValues(unsigned isrc) const
+  {
+    return m_nevents > 0 ? &m_values[size_t(isrc)*m_nevents] : 0;
   }
 
 private:
@@ -80,24 +163,16 @@ private:
   //EventSourceCache(const EventSourceCache&);
   EventSourceCache& operator= (const EventSourceCache&);
 
-  typedef std::vector<T> EvCache;
-  typedef std::map<std::string, EvCache> SrcEvCache;
-
   unsigned m_nevents;
-  SrcEvCache m_cache;
-#ifdef DEBUG_EVENT_SOURCE_CACHE
-  std::map<std::string, unsigned> m_srcEvCount;
-#endif
+  unsigned m_nslots;
+  std::map<std::string, unsigned> m_srcIndices;
+  std::vector<unsigned> m_freeSlots;
+  std::vector<T> m_values;
+  std::vector<bool> m_valid;
 };
 
-template<typename T> inline T& 
-EventSourceCache<T>::EventRef::getCachedValue(const std::string& srcname)
-{
-  return m_eventcache->getCachedValue(m_ievent, srcname);
-}
-
 typedef std::pair<bool, double> CachedResponse;
-typedef EventSourceCache<CachedResponse> ResponseCache;
+typedef EventSourceCache<double> ResponseCache;
 
 
 } // namespace Likelihood
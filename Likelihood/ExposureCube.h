@@ -10,6 +10,7 @@
 #define Likelihood_ExposureCube_h
 
 #include <stdexcept>
+#include <vector>
 
 #include "facilities/Util.h"
 
@@ -33,6 +34,44 @@ class ExposureCube {
 
 public:
 
+   /**
+    * @class LivetimeHandle
+    * @brief Livetime distribution of the HEALPix pixel containing a
+    * given sky direction, unpacked into contiguous arrays that are
+    * aligned with the integration nodes returned by
+    * ExposureCube::costhetaNodes() and ExposureCube::phiNodes().
+    * Clients that evaluate the exposure at the same direction for
+    * many response functors should obtain a handle once and use
+    * ExposureCube::integrate or ExposureCube::exposure.
+    */
+   class LivetimeHandle {
+   public:
+      LivetimeHandle() {}
+      /// Phi-averaged livetimes, one per cos(theta) bin.
+      const std::vector<double> & livetime() const {
+         return m_livetime;
+      }
+      /// Efficiency-weighted, phi-averaged livetimes.  Empty if the
+      /// livetime cube has no WEIGHTED_EXPOSURE extension.
+      const std::vector<double> & weightedLivetime() const {
+         return m_weightedLivetime;
+      }
+      /// Livetimes in the (cos(theta), phi) bins, empty if the
+      /// livetime cube has no phi-dependence.
+      const std::vector<double> & phiLivetime() const {
+         return m_phiLivetime;
+      }
+      const std::vector<double> & weightedPhiLivetime() const {
+         return m_weightedPhiLivetime;
+      }
+   private:
+      friend class ExposureCube;
+      std::vector<double> m_livetime;
+      std::vector<double> m_weightedLivetime;
+      std::vector<double> m_phiLivetime;
+      std::vector<double> m_weightedPhiLivetime;
+   };
+
    ExposureCube() : m_exposure(0), m_weightedExposure(0), 
                     m_efficiencyFactor(0),
                     m_haveFile(false), m_fileName(""),
@@ -62,6 +101,26 @@ public:
       }
    }
 
+   /// Unpack the livetime distribution for the pixel containing dir.
+   void getLivetimeHandle(const astro::SkyDir & dir,
+                          LivetimeHandle & handle) const;
+
+   /// cos(theta) values at which the response is sampled for the
+   /// phi-averaged livetimes.
+   const std::vector<double> & costhetaNodes() const {
+      return m_costhNodes;
+   }
+
+   /// (cos(theta), phi) sample points, with phi in degrees, for
+   /// livetime cubes with phi-dependence.
+   const std::vector<double> & phiCosthetaNodes() const {
+      return m_phiCosthNodes;
+   }
+
+   const std::vector<double> & phiNodes() const {
+      return m_phiNodes;
+   }
+
    double tstart() const {
       return m_tstart;
    }
@@ -109,8 +168,40 @@ public:
       }
       return exposure;
    }
+
+   /// Tabulate a response functor at the integration nodes.  The
+   /// same table can be used with the LivetimeHandle of any sky
+   /// direction, and tables for different event types may be summed.
+   template<class T>
+   void fillResponseTable(const T & aeff, std::vector<double> & table) const {
+      if (m_hasPhiDependence) {
+         table.resize(m_phiNodes.size());
+         for (size_t i(0); i < m_phiNodes.size(); i++) {
+            table[i] = aeff.integral(m_phiCosthNodes[i], m_phiNodes[i]);
+         }
+         return;
+      }
+      table.resize(m_costhNodes.size());
+      for (size_t i(0); i < m_costhNodes.size(); i++) {
+         table[i] = aeff(m_costhNodes[i]);
+      }
+   }
 #endif // SWIG
 
+   /// Integrate a response table, filled by fillResponseTable,
+   /// over the livetime distribution in handle.  This is equivalent
+   /// to value(dir, aeff, weighted_lt).
+   double integrate(const LivetimeHandle & handle,
+                    const std::vector<double> & table,
+                    bool weighted_lt=false) const;
+
+   /// Exposure including the trigger rate- and energy-dependent
+   /// efficiency corrections.  This is equivalent to
+   /// value(dir, aeff, energy).
+   double exposure(const LivetimeHandle & handle,
+                   const std::vector<double> & table,
+                   double energy) const;
+
    bool haveFile() const {
       return m_haveFile;
    }
@@ -186,6 +277,13 @@ private:
    double m_tstart;
    double m_tstop;
 
+   /// Integration nodes matching the healpix::CosineBinner sums.
+   std::vector<double> m_costhNodes;
+   std::vector<double> m_phiCosthNodes;
+   std::vector<double> m_phiNodes;
+
+   void computeNodes();
+
    bool phiDependence(const std::string & filename) const;
 
 };
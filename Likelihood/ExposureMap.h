@@ -114,13 +114,15 @@ public:
     * @param nlongmax
     * @param nlatmin
     * @param nlatmax
+    * @param nthreads Number of threads over which the map rows are
+    * distributed.  A value <= 0 uses all available processors.
     */
    void computeMap(std::string filename, 
                    const Observation & observation,
                    double sr_radius=30, int nlong=60, int nlat=60,
                    int nenergies=10, bool compute_submap=false,
                    int nlongmin=0, int nlongmax=0, int nlatmin=0, 
-                   int nlatmax=0);
+                   int nlatmax=0, int nthreads=1);
 
    static void readEnergyExtension(const std::string & filename,
                                    std::vector<double> & energies);
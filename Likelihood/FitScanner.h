@@ -95,6 +95,8 @@ namespace Likelihood {
   struct Snapshot_Status;
   class Snapshot;
   class FitScanModelWrapper;
+  class ThreadPool;
+  class ScanCheckpoint;
 
   /* A utility class to cache the image the predicted counts map for the
      test source.  
@@ -114,18 +116,31 @@ namespace Likelihood {
     TestSourceModelCache(const BinnedLikelihood& logLike,
 			 const Source& source);
 
-    /* D'tor, does nothing */
-    ~TestSourceModelCache(){};
+    /* D'tor, deletes the per-thread copies of the projection */
+    ~TestSourceModelCache();
     
     /* Translate the cached map to a new location 
 
        newRef      : The new direction of the center of the model image
        out_model   : Filled with the values of the new model image
+       thread_id   : The ThreadPool thread making the call
 
        returns 0 for success, error code for failure
      */
     int translateMap(const astro::SkyDir& newRef,
-		     std::vector<float>& out_model) const;
+		     std::vector<float>& out_model,
+		     size_t thread_id = 0) const;
+
+    /* The whole-pixel shift that translateMap applies for a new location
+
+       newRef      : The new direction of the center of the model image
+       delta_x     : Filled with the number of pixels offset in X
+       delta_y     : Filled with the number of pixels offset in Y
+
+       returns 0 for success, error code for failure
+     */
+    int pixelShift(const astro::SkyDir& newRef,
+		   int& delta_x, int& delta_y) const;
 
     /* Write the current cached map to a FITS image
        
@@ -141,6 +156,22 @@ namespace Likelihood {
 
     inline const std::vector<float>& currentModel() const { return m_currentModel; }
 
+    inline size_t nx() const { return m_nx; }
+    inline size_t ny() const { return m_ny; }
+    inline size_t ne() const { return m_ne; }
+
+    /* Switch off (or on) keeping a copy of the last translated image.
+       The copy is only needed by writeTestSourceToFitsImage, and must
+       be switched off when several threads translate the image at once.
+    */
+    inline void setLatchCurrent(bool val) { m_latchCurrent = val; }
+
+    /* Make a copy of the projection for each ThreadPool thread other than
+       the calling one, since projecting a direction is not thread-safe.
+       Calling this with nthreads <= 1 deletes the copies.
+    */
+    void setNumThreads(size_t nthreads);
+
   protected:
 
     /* Translate the map using WCS projection by dx and dy pixels 
@@ -180,6 +211,16 @@ namespace Likelihood {
     /* The current image */
     mutable std::vector<float> m_currentModel;
 
+    /* Copy each translated image to m_currentModel */
+    bool m_latchCurrent;
+
+    /* Copies of m_proj for threads 1 to n-1 */
+    std::vector<astro::ProjBase*> m_threadProjs;
+
+    /* Not copyable, because of m_threadProjs */
+    TestSourceModelCache(const TestSourceModelCache&);
+    TestSourceModelCache& operator=(const TestSourceModelCache&);
+
   };
 
   
@@ -201,6 +242,12 @@ namespace Likelihood {
 
     void writeTestImages(const std::string& filename, size_t ix, size_t iy);
 
+    /* Switch off (or on) keeping the last translated image in each cache */
+    void setLatchCurrent(bool val);
+
+    /* Set the number of threads that will translate the images in each cache */
+    void setNumThreads(size_t nthreads);
+
   private:
 
     std::vector<TestSourceModelCache*> m_vector;
@@ -449,7 +496,8 @@ namespace Likelihood {
     /* shift the test source */
     virtual int shiftTestSource(const TestSourceModelCacheVector& modelCaches,
 				const astro::SkyDir& newDir,
-				std::vector<float>& targetModel) const = 0;
+				std::vector<float>& targetModel,
+				size_t thread_id = 0) const = 0;
 
     /* set the energy bins to use in the analysis */
     virtual void set_klims(size_t kmin, size_t kmax) = 0;
@@ -597,7 +645,8 @@ namespace Likelihood {
     /* shift the test source */
     virtual int shiftTestSource(const TestSourceModelCacheVector& modelCaches,
 				const astro::SkyDir& newDir,
-				std::vector<float>& targetModel) const;
+				std::vector<float>& targetModel,
+				size_t thread_id = 0) const;
 
     /* set the energy bins to use in the analysis */
     virtual void set_klims(size_t kmin, size_t kmax);
@@ -706,7 +755,8 @@ namespace Likelihood {
     /* shift the test source */
     virtual int shiftTestSource(const TestSourceModelCacheVector& modelCaches,
 				const astro::SkyDir& newDir,
-				std::vector<float>& targetModel) const;
+				std::vector<float>& targetModel,
+				size_t thread_id = 0) const;
   
     /* set the energy bins to use in the analysis */
     virtual void set_klims(size_t kmin, size_t kmax);
@@ -809,6 +859,21 @@ namespace Likelihood {
     /* D'tor */
     ~FitScanCache();
 
+    /* Build a worker copy of this cache, for fitting several test source
+       positions at once.
+
+       The worker shares the data, the templates, the weights and the reduced
+       versions of these with this cache, so it must not outlive it, and this cache
+       must not be updated or rebuilt while the worker is in use.
+       The worker copies the current fit state and the priors, so that
+       refactorModel(), shiftTestSource(), fitCurrent(), scanNormalization() and
+       the other functions that act on the current fit may be called on
+       different workers from different threads.   
+       The caller takes ownership of the worker.
+       A worker of a worker shares the data and templates of the original cache.
+    */
+    FitScanCache* makeWorker();
+
     /* Update stuff w.r.t. the wrapped BinnedLikelihood or SummedLikelihood 
 
        This first figures out the action needed, then calls update_with_action()
@@ -876,7 +941,8 @@ namespace Likelihood {
        and in much less expensive, but not quite as accurate 
      */
     int shiftTestSource(const TestSourceModelCacheVector& modelCache,
-			const astro::SkyDir& newDir);
+			const astro::SkyDir& newDir,
+			size_t thread_id = 0);
 
     /* Set the cache to add in the test source with a specify normalization value */
     void addTestSourceToCurrent(double initNorm);
@@ -884,6 +950,14 @@ namespace Likelihood {
     /* Set the cache to remove the test source from the fit */
     void removeTestSourceFromCurrent();
 
+    /* Set the starting values for the next fit, e.g., from the result of a fit 
+       at a neighbouring position.  This must match the number of free parameters */
+    void setInitPars(const CLHEP::HepVector& pars);
+
+    /* Restore the starting values saved before a call to setInitPars, 
+       leaving the results of the last fit in place */
+    void restoreInitPars(const CLHEP::HepVector& pars);
+
     /* Set the prior */
     void buildPriorsFromExternal(const CLHEP::HepVector& centralVals,
 				 const CLHEP::HepSymMatrix& covariance,
@@ -942,7 +1016,11 @@ namespace Likelihood {
        pos_errs   : Positive side errors on the scan
        neg_errs   : Negative side errors on the scan
        norms      : Filled with normalization values used in the scan
-       logLikes   : Filled with the corresponding log likelihood values     
+       logLikes   : Filled with the corresponding log likelihood values
+
+       If no other sources are free, all the scan points are evaluated in one pass
+       over the data with FitUtils::logLikePoissonScan.  Otherwise the other sources
+       are refit at each point, starting from the fit at the previous point.
      */
     int scanNormalization(int nnorm, double normSigma,
 			  double posErr, double negErr,
@@ -994,7 +1072,7 @@ namespace Likelihood {
     // Information about the baseline model
     inline const std::string& testSourceName() const { return m_testSourceName; }
     inline size_t nebins() const { return m_nebins; }
-    inline size_t nBkgModel() const { return m_allModels.size(); }
+    inline size_t nBkgModel() const { return allModels().size(); }
     inline bool useReduced() const { return m_useReduced; }
     inline bool useWeights() const { return m_useWeights; }
     inline double tol() const { return m_tol; }
@@ -1015,30 +1093,31 @@ namespace Likelihood {
     inline const std::vector<float>& currentModel() const { return m_currentBestModel; }
     inline double currentLogLike() const { return m_currentLogLike; }
     inline double currentEDM() const { return m_currentEDM; }    
+    inline int currentNIter() const { return m_currentNIter; }
     inline int firstEnergyBin() const { return m_firstEnergyBin; }
     inline int lastEnergyBin() const { return m_lastEnergyBin; }
 
 
-    // the data
+    // the data (for a worker copy, these come from the master cache)
     inline const std::vector<float>& data() const { return m_data; }
-    inline const std::vector<int>& nonZeroBins() const { return m_nonZeroBins; }
-    inline size_t nFilled() const { return m_nonZeroBins.size(); }
-    inline int global_idx(size_t local) const { return local < m_nonZeroBins.size() ? m_nonZeroBins[local] : -1; }
-    inline const std::vector<int>& energyBinStopIdxs() const { return m_energyBinStopIdxs; }
+    inline const std::vector<int>& nonZeroBins() const { return master().m_nonZeroBins; }
+    inline size_t nFilled() const { return nonZeroBins().size(); }
+    inline int global_idx(size_t local) const { return local < nonZeroBins().size() ? nonZeroBins()[local] : -1; }
+    inline const std::vector<int>& energyBinStopIdxs() const { return master().m_energyBinStopIdxs; }
 
     
     // parts of the models
-    inline const std::vector<float>& refValues() const { return m_refValues; }
-    inline const std::vector<std::string>& templateSourceNames() const { return m_templateSourceNames; }
-    inline const std::vector<std::vector<float> >& allModels() const { return m_allModels; }
-    inline const std::vector<float>& allFixed() const { return m_allFixed; }   
-    inline const std::vector<float>& weights() const { return m_weights; }   
+    inline const std::vector<float>& refValues() const { return master().m_refValues; }
+    inline const std::vector<std::string>& templateSourceNames() const { return master().m_templateSourceNames; }
+    inline const std::vector<std::vector<float> >& allModels() const { return master().m_allModels; }
+    inline const std::vector<float>& allFixed() const { return master().m_allFixed; }   
+    inline const std::vector<float>& weights() const { return master().m_weights; }   
     inline const std::vector<float>& targetModel() const { return m_targetModel; }
 
     // Reduced vectors
-    inline const std::vector<float>& dataRed() const { return m_dataRed; }
-    inline const std::vector<std::vector<float> >& allRedModels() const { return m_allRedModels; }
-    inline const std::vector<float>& allRedFixed() const { return m_allRedFixed; }
+    inline const std::vector<float>& dataRed() const { return master().m_dataRed; }
+    inline const std::vector<std::vector<float> >& allRedModels() const { return master().m_allRedModels; }
+    inline const std::vector<float>& allRedFixed() const { return master().m_allRedFixed; }
 
     // info about the iteration
     inline size_t firstBin() const { return m_firstBin; }
@@ -1046,7 +1125,7 @@ namespace Likelihood {
     
     
     inline const std::vector<float>& targetRedModel() const { return m_targetRedModel; }    
-    inline const std::vector<float>& weightsRed() const { return m_weightsRed; }   
+    inline const std::vector<float>& weightsRed() const { return master().m_weightsRed; }   
 
     inline const std::vector<const std::vector<float>* >& currentModels() const { return m_currentModels; }
     inline const std::vector<float>& currentFixed() const { return m_currentFixed; }
@@ -1063,6 +1142,9 @@ namespace Likelihood {
     // access to the SourceModel
     inline const BinnedLikelihood& sourceModel() const { return m_modelWrapper.getMasterComponent(); }
 
+    // Is this a worker copy of another cache
+    inline bool isWorker() const { return m_master != 0; }
+
     
     void printCurrent() const;
 
@@ -1071,6 +1153,12 @@ namespace Likelihood {
 
   protected:
 
+    /* Build a worker copy of master, see makeWorker() */
+    explicit FitScanCache(FitScanCache& master);
+
+    /* The cache that owns the data and templates */
+    inline const FitScanCache& master() const { return m_master != 0 ? *m_master : *this; }
+
     void reduceModels();
 
     void setEnergyBinStopIdxs();
@@ -1098,6 +1186,9 @@ namespace Likelihood {
     // The wrapper around the model object
     FitScanModelWrapper& m_modelWrapper;
 
+    // The cache that this is a worker copy of, null for the master cache
+    const FitScanCache* m_master;
+
     // A snapshot of the reference model
     Snapshot* m_snapshot;
 
@@ -1202,6 +1293,8 @@ namespace Likelihood {
     double m_currentLogLike;
     // this is the estimated distance to minimum for the current fit
     double m_currentEDM;
+    // this is the number of Newton steps taken in the current fit
+    int m_currentNIter;
 
     // this is the energy bin for the current fit
     // -1 means fit all ranges
@@ -1499,6 +1592,10 @@ namespace Likelihood {
     inline int verbose_scan() const { return m_verbose_scan; }
     inline bool writeTestImages() const { return m_writeTestImages; }
     inline bool useReduced() const { return m_useReduced; }
+    inline int nThreads() const { return m_nThreads; }
+    inline bool fastTSMap() const { return m_fastTSMap; }
+    inline int nRefine() const { return m_nRefine; }
+    inline bool warmStart() const { return m_warmStart; }
 
     inline void set_quiet(bool val) { m_quiet = val; }
     inline void set_verbose_null(int val) { m_verbose_null = val; }
@@ -1507,6 +1604,55 @@ namespace Likelihood {
     inline void set_writeTestImages(bool val) { m_writeTestImages = val; }
     inline void set_useReduced(bool val) { m_useReduced = val; }
 
+    /* Number of threads to use for the pixel loop in run_tscube 
+       ( <= 0 -> all available processors ).  
+       The positions are only fit in parallel when all the fitting is done with 
+       Newton's method (i.e., ST_scan_level < 2), the test source image is 
+       shifted rather than remade, and writeTestImages is off */
+    inline void set_nThreads(int val) { m_nThreads = val; }
+
+    /* Make the TS map in run_tscube from FFT correlations of the residuals with 
+       the test source image, rather than fitting each position (see fastTSMap).
+       This is only used for broadband TS maps of a single WCS counts map, 
+       when the test source image is shifted rather than remade. */
+    inline void set_fastTSMap(bool val) { m_fastTSMap = val; }
+
+    /* Number of positions with the largest approximate TS values that are 
+       refit with Newton's method after making a fast TS map */
+    inline void set_nRefine(int val) { m_nRefine = val; }
+
+    /* Fit the TS map in run_tscube on a grid of positions spaced by coarseStep pixels, 
+       then refine the cells where the TS exceeds refineTs or changes by more than 
+       refineGrad per pixel, down to single pixels (see AdaptiveGrid).  
+       The other positions are interpolated and flagged with fit_status = -1.
+       coarseStep <= 1 fits every position */
+    inline void set_adaptiveGrid(int coarseStep, double refineTs, double refineGrad) {
+      m_coarseStep = coarseStep;
+      m_refineTs = refineTs;
+      m_refineGrad = refineGrad;
+    }
+
+    /* Start the broadband fit at each position in run_tscube from the parameters 
+       of the fit at the previous position, rather than from the null fit. 
+       The positions of a WCS map are visited along a Hilbert curve, so that 
+       consecutive positions are neighbours.  They are fit in fixed chunks of 
+       consecutive positions, each on one thread, and the first fit of a chunk 
+       starts from the null fit, so the results do not depend on the number of 
+       threads.  If a fit started from the previous position fails, it is redone 
+       from the null fit. */
+    inline void set_warmStart(bool val) { m_warmStart = val; }
+
+    /* Checkpoint the output histograms of run_tscube and the finished positions 
+       to filename at most every interval seconds (see ScanCheckpoint).  
+       If resume is true, the positions finished in a checkpoint made by an 
+       interrupted run of the same scan are not fit again.
+       An empty filename switches off the checkpoints */
+    inline void set_checkpoint(const std::string& filename, double interval, bool resume) {
+      m_checkpointFile = filename;
+      m_checkpointInterval = interval;
+      m_resume = resume;
+    }
+
     inline TestSourceModelCacheVector& testSourceCaches() { return m_testSourceCaches; }
 
     /* This adds the test source to the source model */
@@ -1518,6 +1664,10 @@ namespace Likelihood {
     /* Set the direction of the test source, based on the loop parameters */
     int setTestSourceDir(int ix, int iy);
 
+    /* The direction of the test source at a grid position.
+       Unlike setTestSourceDir, this doesn't change the state of the scanner */
+    astro::SkyDir pixelDir(int ix, int iy) const;
+
     /* This does the baseline fit
        i.e., the fit without the test source */
     int baselineFit(double tol = 1e-3, int tolType = 0);
@@ -1531,7 +1681,10 @@ namespace Likelihood {
     int fitTestSourceBroadband(double tol = 1e-3, int tolType = 0);   
 
     /* This does the sed fitting with Newton's method,                                                       
-       for the normalization paramters only */
+       for the normalization paramters only.
+
+       If a pool is given, the energy bins are fit concurrently 
+       with worker copies of the cache (see FitScanCache::makeWorker) */
     int sed_binned_newton(int nnorm, double normSigma,
 			  double constrainScale,
 			  std::vector<double>& norm_mles,
@@ -1541,7 +1694,23 @@ namespace Likelihood {
 			  std::vector<double>& uls,
 			  std::vector<int>& sed_fit_status,
 			  std::vector<std::vector<double> >& norms,
-			  std::vector<std::vector<double> >& logLikes);
+			  std::vector<std::vector<double> >& logLikes,
+			  ThreadPool* pool = 0);
+
+    /* As above, but doing the fits with a specific cache 
+       (e.g., a worker copy of the cache from FitScanCache::makeWorker) */
+    int sed_binned_newton(FitScanCache& cache,
+			  int nnorm, double normSigma,
+			  double constrainScale,
+			  std::vector<double>& norm_mles,
+			  std::vector<double>& pos_errs,
+			  std::vector<double>& neg_errs,
+			  std::vector<double>& logLike_mles,
+			  std::vector<double>& uls,
+			  std::vector<int>& sed_fit_status,
+			  std::vector<std::vector<double> >& norms,
+			  std::vector<std::vector<double> >& logLikes,
+			  ThreadPool* pool = 0) const;
 
     /* Build and cache an image of the test source */
     int buildTestModelCache();
@@ -1589,6 +1758,52 @@ namespace Likelihood {
 
   private:
 
+    class PixelTask;
+
+    /* Fit the test source at many positions with a PixelTask, 
+       using the pool to fit positions concurrently.
+       
+       pixels      : If given, the pixels to fit, otherwise all the pixels
+       checkpoint  : If given, pixels that are already done are skipped, and the 
+                     pixels are marked as done and checkpointed as they are fit
+    */
+    void fitPixels(PixelTask& pixelTask, ThreadPool& pool, bool doTSMap,
+		   const std::vector<long>* pixels = 0,
+		   ScanCheckpoint* checkpoint = 0);
+
+    /* Copy the output histograms to a checkpoint and write it */
+    void saveCheckpoint(ScanCheckpoint& checkpoint) const;
+
+    /* Copy the output histograms back from a checkpoint */
+    void restoreCheckpoint(const ScanCheckpoint& checkpoint);
+
+    /* Approximate broadband TS map with the background fixed at the null fit.
+
+       For a test source with normalization n and counts image n*R shifted to each 
+       position, the change in log-likelihood is expanded in powers of n*R/b, 
+       where b is the null fit model:
+
+          dL(n) = n*g - n^2*M2/2 + n^3*M3/3 - n^4*M4/4
+          
+       with g  = Sum w*(d/b - 1)*R and Mk = Sum w*d*R^k/b^k.
+       The sums for all the shifts of R are cross-correlations, which are done 
+       with FFTs, and n is then found with a few Newton steps at each position
+       (see FitUtils::fitShiftedNorms_fft).  The expansion fails as n*R/b 
+       approaches one, so at positions where it may exceed 0.5 the exact dL 
+       is maximized with direct sums instead.
+
+       parScales   : Normalizations of the background models from the null fit
+       tsVals      : Filled with the TS value at each pixel of the scan
+       normVals    : Filled with the normalization at each pixel of the scan
+       errVals     : Filled with the error on the normalization at each pixel of the scan
+
+       returns 0 for success, error code for failure
+    */
+    int fastTSMap(const std::vector<float>& parScales,
+		  std::vector<double>& tsVals,
+		  std::vector<double>& normVals,
+		  std::vector<double>& errVals) const;
+
     // The log-likelihood object (also the source model)
     FitScanModelWrapper* m_modelWrapper;
 
@@ -1642,6 +1857,26 @@ namespace Likelihood {
     bool m_writeTestImages;
     bool m_useReduced;
 
+    // Number of threads for the pixel loop
+    int m_nThreads;
+
+    // Make the TS map with FFTs, and how many of the positions to refit
+    bool m_fastTSMap;
+    int m_nRefine;
+
+    // Adaptive refinement of the TS map
+    int m_coarseStep;
+    double m_refineTs;
+    double m_refineGrad;
+
+    // Checkpoints of the finished positions
+    std::string m_checkpointFile;
+    double m_checkpointInterval;
+    bool m_resume;
+
+    // Start the fits from the fits at neighbouring positions
+    bool m_warmStart;
+
   };
 
 }
@@ -489,6 +489,83 @@ namespace Likelihood {
 			  std::vector<float>::const_iterator w_start,
 			  std::vector<float>::const_iterator w_stop);
 
+    /* Calculate the Poisson log likelihood at a series of normalizations of a test model,
+       in a single pass over the data
+
+       model_i(norm) = fixed_i + norm * test_i
+       logLikes[j] = Sum  w_i * ( data_i * log(model_i(norms[j])) - model_i(norms[j]) )
+
+       data:          The observed data
+       fixed:         Template with the sum of all the fixed sources
+       test:          Template of the test source
+       norms:         The normalizations of the test source
+       logLikes:      Filled with the log likelihood at each normalization
+       weights:       If provided, the likelihood weights
+       firstBin:      First bin to include
+       lastBin:       One past the last bin to include (0 -> the end)
+
+       This is the same as building the model and calling logLikePoisson() for
+       each normalization, but each bin is only read once, the predicted counts
+       are summed once for both templates, and the logs for all the normalizations
+       are computed in a tight inner loop.
+     */
+    void logLikePoissonScan(const std::vector<float>& data,
+			    const std::vector<float>& fixed,
+			    const std::vector<float>& test,
+			    const std::vector<double>& norms,
+			    std::vector<double>& logLikes,
+			    const std::vector<float>* weights = 0,
+			    size_t firstBin = 0,
+			    size_t lastBin = 0);
+
+
+    /* Fit the normalization n >= 0 of a test source at every shift of its image
+       across a map, with the rest of the model fixed, using FFTs
+
+       model_i(n) = bkg_i + n * ref_i
+       dL(n) = Sum  w_i * ( data_i * log(1 + n*ref_i/bkg_i) - n*ref_i )
+
+       where ref_i is the image shifted by (dx,dy) pixels.  dL is expanded to fourth
+       order in x_i = n*ref_i/bkg_i, and the sums for all the shifts are computed as 
+       cross-correlations.  The expansion is only good for x_i < 1, so maxRatios 
+       gives an upper bound on ref_i/bkg_i over the bins with data for each shift.  
+       Where norms*maxRatios is not small, use fitShiftedNorm_exact instead.
+
+       nx, ny, ne:    Dimensions of the maps, x varies fastest, then y, then energy
+       data:          The observed data
+       bkg:           The predicted counts from the fixed model
+       ref:           The image of the test source, with no shift
+       weights:       If provided, the likelihood weights
+       norms:         Filled with the best-fit normalizations
+       deltaLogLikes: Filled with dL at the best-fit normalizations
+       curvatures:    Filled with d2(dL)/dn2 at the best-fit normalizations
+       maxRatios:     Filled with the bounds on ref_i/bkg_i
+
+       The outputs are indexed by shift as in Convolve::correlate2d.
+     */
+    void fitShiftedNorms_fft(size_t nx, size_t ny, size_t ne,
+			     const std::vector<float>& data,
+			     const std::vector<float>& bkg,
+			     const std::vector<float>& ref,
+			     const std::vector<float>* weights,
+			     std::vector<double>& norms,
+			     std::vector<double>& deltaLogLikes,
+			     std::vector<double>& curvatures,
+			     std::vector<double>& maxRatios);
+
+    /* As fitShiftedNorms_fft, for the single shift (dx,dy), with the exact dL
+
+       norm:          The starting value on input, the best-fit value on output
+     */
+    void fitShiftedNorm_exact(size_t nx, size_t ny, size_t ne, int dx, int dy,
+			      const std::vector<float>& data,
+			      const std::vector<float>& bkg,
+			      const std::vector<float>& ref,
+			      const std::vector<float>* weights,
+			      double& norm,
+			      double& deltaLogLike,
+			      double& curvature);
+
 
     /* Fit the normalization using Newton's method
        
@@ -509,6 +586,7 @@ namespace Likelihood {
        firstBin:      First bin to use
        lastBin:       Last bin to use ( 0 -> end )
        verbose:       0 : none; 1 : start & converged; 2 : params;  3 : matrices
+       nIter:         If provided, filled with the number of Newton steps taken
     */
     int fitNorms_newton(const std::vector<float>& data,
 			const CLHEP::HepVector& initNorms,
@@ -525,7 +603,8 @@ namespace Likelihood {
 			double& logLikeVal,
 			size_t firstBin = 0, 
 			size_t lastBin = 0,
-			int verbose = 0);
+			int verbose = 0,
+			int* nIter = 0);
     
 
     /* Fit the log of the normalization using Newton's method
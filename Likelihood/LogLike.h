@@ -25,6 +25,8 @@ namespace tip {
 
 namespace Likelihood {
 
+   class ThreadPool;
+
 /** 
  * @class LogLike
  *
@@ -82,6 +84,10 @@ public:
 
    void getEvents(std::string event_file);
 
+   /// Read several event files, concurrently if more than one
+   /// thread has been set with setNumThreads(...).
+   void getEvents(const std::vector<std::string> & event_files);
+
    void computeEventResponses(double sr_radius=30.);
 
    virtual void syncParams();
@@ -100,6 +106,43 @@ public:
 
    virtual void unset_ebounds();
 
+   /// Set the number of threads used for the sums over events in
+   /// value() and getFreeDerivs().  A value <= 0 selects all
+   /// available processors.  The partial sums are combined in a
+   /// fixed order, so results do not depend on the thread count
+   /// or scheduling.
+   void setNumThreads(int nthreads);
+
+   size_t numThreads() const {
+      return m_nthreads;
+   }
+
+   /// When only spectral parameters can vary, the response of each
+   /// event to each source is fixed, and value() and getFreeDerivs()
+   /// can be computed from a precomputed [source][event] response
+   /// matrix and the spectra evaluated at the distinct event
+   /// energies.  This applies only to models comprising point and
+   /// diffuse sources.  It is off by default, since the fast path
+   /// does not update Event::modelSum(), which is read by
+   /// EventContainer::nobs() and the per-source counts; call
+   /// updateEventModelSums() before using those if it is enabled.
+   void setUseSpectralFastPath(bool useFastPath) {
+      m_useSpectralFastPath = useFastPath;
+   }
+
+   /// Recompute Event::modelSum() for all of the events.  Evaluations
+   /// using the spectral fast path do not update these sums.
+   void updateEventModelSums();
+
+   /// Adding, deleting, or evaluating free sources normally updates
+   /// Event::modelSum() for each event.  With these updates switched
+   /// off, the Events in the Observation are only read, so several
+   /// LogLike objects sharing an EventContainer may be used on
+   /// different threads.  The source responses are still cached.
+   void setUpdateEventModelSums(bool update) {
+      m_updateEventModelSums = update;
+   }
+
 protected:
 
    virtual LogLike * clone() const {
@@ -129,16 +172,157 @@ private:
    // Cache for instrument response to each event times source
    mutable ResponseCache m_respCache;
 
-   double logSourceModel(const Event & event,
-                         ResponseCache::EventRef* srcRespCache=0) const;
+   mutable std::vector<double> m_bestFitParsSoFar;
+
+   void update_npreds();
+
+   /// Indices of the events with energies in [m_emin, m_emax], in
+   /// ascending order, when m_use_ebounds is set.
+   std::vector<size_t> m_eboundEvents;
+
+   void selectEboundEvents();
+
+   /// The events to include in the sums, or zero for all of them.
+   const std::vector<size_t> * eventSubset() const {
+      return m_use_ebounds ? &m_eboundEvents : 0;
+   }
+
+   /**
+    * @struct SavedExposure
+    * @brief A source's exposure over the full energy range, saved by
+    * set_ebounds so that unset_ebounds can restore it, together with
+    * the exposures already computed by set_ebounds at each energy, so
+    * that these are not recomputed for later energy ranges.
+    */
+   struct SavedExposure {
+      std::vector<double> energies;
+      std::vector<double> exposure;
+      std::map<double, double> computed;
+      std::vector<double> bandEnergies;
+      std::vector<double> bandExposure;
+      /// True if the source still has the exposure set for the
+      /// current energy range.
+      bool isCurrent(const Source & src) const;
+   };
+
+   std::map<std::string, SavedExposure> m_savedExposures;
+
+   /**
+    * @struct SourceList
+    * @brief The Sources in m_sources order, with the per-Source data
+    * used in the loops over events looked up in advance.
+    */
+   struct SourceList {
+      std::vector<Source *> sources;
+      /// Whether each Source is free, and so needs its contribution
+      /// to Event::modelSum() updated.
+      std::vector<bool> updateModelSum;
+      /// Index of each Source in m_respCache.
+      std::vector<unsigned> cacheIndices;
+      /// Names of the free spectral parameters of each Source.
+      std::vector< std::vector<std::string> > freeParamNames;
+   };
+
+   void getSourceList(SourceList & srcList) const;
+
+   double logSourceModel(const Event & event, const SourceList & srcList,
+                         ResponseCache::EventRef* srcRespCache) const;
 
    void getLogSourceModelDerivs(const Event & event,
+                                const SourceList & srcList,
                                 std::vector<double> & derivs,
-                                ResponseCache::EventRef* srcRespCache=0) const;
-
-   mutable std::vector<double> m_bestFitParsSoFar;
+                                ResponseCache::EventRef* srcRespCache) const;
+
+   /**
+    * @struct SpectralResponses
+    * @brief Event responses used by the spectral-only fast path.
+    */
+   struct SpectralResponses {
+      SpectralResponses() : valid(false), usable(false) {}
+      /// Whether the remaining members are up-to-date for sources.
+      bool valid;
+      /// Whether the fast path can be used for these sources.
+      bool usable;
+      /// Sources for which the responses were computed.
+      std::vector<Source *> sources;
+      /// Response times efficiency, indexed as [source][event].
+      std::vector<double> resps;
+      /// Distinct event energies, in ascending order.
+      std::vector<double> energies;
+      /// Index into energies for each event.
+      std::vector<size_t> energyIndices;
+   };
+
+   bool m_useSpectralFastPath;
+
+   mutable SpectralResponses m_specResps;
+
+   /// Return true if the spectral fast path can be used for this set
+   /// of sources, computing the responses if necessary.
+   bool spectralFastPath(const SourceList & srcList) const;
+
+   bool computeSpectralResponses(const SourceList & srcList) const;
+
+   /// Evaluate the spectra, and optionally their derivatives wrt
+   /// the free parameters, at the distinct event energies.  The
+   /// values are indexed as [source][energy] and the derivatives as
+   /// [free parameter][energy].
+   void evaluateSpectra(const SourceList & srcList,
+                        std::vector<double> & values,
+                        std::vector<double> * derivs=0) const;
+
+   size_t m_nthreads;
+
+   /// True once every event/source response has been cached by a
+   /// serial pass, so that IRFs need not be called from worker
+   /// threads.
+   mutable bool m_respCacheFilled;
+
+   /// True once the responses of the events in m_eboundEvents have
+   /// been cached by a serial pass.
+   mutable bool m_eboundCacheFilled;
+
+   /// True if the responses of all of the events in the sums are
+   /// cached.
+   bool respCacheFilled() const {
+      return m_respCacheFilled || (m_use_ebounds && m_eboundCacheFilled);
+   }
 
-   void update_npreds();
+   bool m_updateEventModelSums;
+
+   class EventWorkers;
+   class ValueTask;
+   class DerivsTask;
+
+   /// Owning pointer to the per-thread state.  Copies start out
+   /// empty, so each clone builds its own threads.
+   class EventWorkersPtr {
+   public:
+      EventWorkersPtr() : m_ptr(0) {}
+      EventWorkersPtr(const EventWorkersPtr &) : m_ptr(0) {}
+      EventWorkersPtr & operator=(const EventWorkersPtr &) {
+         reset(0);
+         return *this;
+      }
+      ~EventWorkersPtr() {
+         reset(0);
+      }
+      EventWorkers * get() const {
+         return m_ptr;
+      }
+      void reset(EventWorkers * ptr);
+   private:
+      EventWorkers * m_ptr;
+   };
+
+   mutable EventWorkersPtr m_workers;
+
+   /// Return the per-thread state if the event sums can be run in
+   /// parallel, or zero otherwise.
+   EventWorkers * eventWorkers() const;
+
+   /// Return the thread pool, or zero if running serially.
+   ThreadPool * threadPool() const;
 
 };
 
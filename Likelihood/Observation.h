@@ -62,6 +62,12 @@ public:
       return *m_respFuncs;
    }
 
+   /// Replace the response functions, e.g., with a per-thread clone.
+   /// The Observation does not take ownership.
+   void setRespFuncs(ResponseFunctions * respFuncs) {
+      m_respFuncs = respFuncs;
+   }
+
    const ScData & scData() const {
       return *m_scData;
    }
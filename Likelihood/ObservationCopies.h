@@ -0,0 +1,58 @@
+/**
+ * @file ObservationCopies.h
+ * @brief Per-thread views of an Observation with private copies of
+ * the response functions.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#ifndef Likelihood_ObservationCopies_h
+#define Likelihood_ObservationCopies_h
+
+#include <vector>
+
+namespace Likelihood {
+
+   class Observation;
+   class ResponseFunctions;
+
+/**
+ * @class ObservationCopies
+ *
+ * @brief Holds one Observation per worker thread.  Entry 0 is the
+ * original Observation; the others share its read-only members
+ * (RoiCuts, ScData, ExposureCube, ExposureMap, EventContainer,
+ * exposure maps) but own cloned ResponseFunctions so that IRF
+ * evaluations on different threads do not interfere.
+ */
+
+class ObservationCopies {
+
+public:
+
+   ObservationCopies(const Observation & observation, size_t ncopies);
+
+   ~ObservationCopies();
+
+   size_t size() const {
+      return m_observations.size();
+   }
+
+   const Observation & operator[](size_t thread_id) const {
+      return *m_observations.at(thread_id);
+   }
+
+private:
+
+   std::vector<const Observation *> m_observations;
+   std::vector<ResponseFunctions *> m_respFuncs;
+
+   ObservationCopies(const ObservationCopies &);
+   ObservationCopies & operator=(const ObservationCopies &);
+
+};
+
+} // namespace Likelihood
+
+#endif // Likelihood_ObservationCopies_h
@@ -22,6 +22,8 @@
 
 namespace Likelihood {
 
+   class ThreadPool;
+
    /**
     * @class OneSourceFunc
     * @brief Extended likelihood function for one source.
@@ -36,7 +38,7 @@ namespace Likelihood {
 
     OneSourceFunc(Source * src,  // The Source of interest
 		  const std::vector<Event>& events, 
-		  std::vector<double> * weights = NULL);
+		  const double * weights = 0);  // One weight per event
 
     virtual std::vector<double>::const_iterator 
       setFreeParamValues_(std::vector<double>::const_iterator it);
@@ -50,6 +52,17 @@ namespace Likelihood {
     void setEpsW(double);
     void setEpsF(double);
 
+     /// Evaluate the sums over events on the threads of pool.  Thread
+     /// t uses srcCopies[t], a copy of the Source of interest with its
+     /// own Observation (srcCopies[0] is the Source itself).  The
+     /// parameter values are copied to the copies before each sum.
+     void setThreads(ThreadPool * pool,
+                     const std::vector<Source *> & srcCopies);
+
+     /// Copy the parameter values of the Functions of src to the
+     /// corresponding Functions of dest.
+     static void copyParams(const Source & src, Source & dest);
+
      virtual double value() const {
         optimizers::Arg dummy;
         return value(dummy);
@@ -78,9 +91,21 @@ namespace Likelihood {
     
     Source * m_src;
      const std::vector<Event>& m_events;
-    std::vector<double> * m_weights;
+    const double * m_weights;
     double m_epsw;
     double m_epsf;
+
+     ThreadPool * m_pool;
+     std::vector<Source *> m_srcCopies;
+
+     class EventSumTask;
+
+     /// Weighted sum over events of log(fluxDensity) or, if paramName
+     /// is non-zero, of fluxDensityDeriv/fluxDensity.
+     double eventSum(const std::string * paramName) const;
+
+     double eventTerm(const Source & src, size_t ievent,
+                      const std::string * paramName) const;
     
   };  // class OneSourceFunc
 } // namespace Likelihood
@@ -22,6 +22,10 @@ namespace Likelihood {
  * findMin(...) method and so should not be used as an argument to an
  * optimizer::Optimizer constructor.
  *
+ * The number of threads set by LogLike::setNumThreads(...) is used
+ * for the E step, which fills a [source][event] weight matrix, and
+ * for the sums over events in each per-source M step.
+ *
  * @author P. L. Nolan
  *
  * $Header: /nfs/slac/g/glast/ground/cvs/Likelihood/Likelihood/OptEM.h,v 1.5 2005/02/27 06:42:24 jchiang Exp $
@@ -47,12 +47,13 @@ namespace Likelihood {
    public:
 
      /// Compute the integrated exposure using the provided 
-     /// vector of energy values
+     /// vector of energy values.  If quiet is set, no progress
+     /// output is written, e.g., when called from several threads.
      static void computeExposure(const astro::SkyDir & dir,
 				 const std::vector<double> & energies,
 				 const Observation & observation, 
 				 std::vector<double> & exposure,
-				 bool verbose);
+				 bool verbose, bool quiet=false);
 
      /// Use a hypercube computed using map_tools.
      static void computeExposureWithHyperCube(const astro::SkyDir & dir, 
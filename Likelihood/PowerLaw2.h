@@ -66,16 +66,11 @@ private:
 	 m_cX      = x + 1.0; // force recalculation of m_cPowX below
        } 
 
-     if(s_cX != x)
-       {
-	 s_cX      = x;
-	 s_cLogX   = std::log(x);
-       }
-
      if(m_cX != x)
        {
 	 m_cX      = x;
-	 m_cPowX   = std::exp(s_cLogX*gamma);
+	 m_cLogX   = std::log(x);
+	 m_cPowX   = std::exp(m_cLogX*gamma);
        }
    }
 
@@ -89,9 +84,8 @@ private:
    mutable double m_cPowXHi;
    mutable double m_cGXFact;
    mutable double m_cX;
+   mutable double m_cLogX;
    mutable double m_cPowX;
-   static  double s_cX;
-   static  double s_cLogX;
   };
 
 } // namespace Likelihood
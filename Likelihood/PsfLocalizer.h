@@ -0,0 +1,157 @@
+/**
+ * @file PsfLocalizer.h
+ * @brief Fast localization of a point source in unbinned data using
+ * a cached psf template.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#ifndef Likelihood_PsfLocalizer_h
+#define Likelihood_PsfLocalizer_h
+
+#include <string>
+#include <vector>
+
+#include "CLHEP/Vector/ThreeVector.h"
+
+namespace Likelihood {
+
+   class Event;
+   class MeanPsf;
+   class SourceModel;
+   class ThreadPool;
+
+/**
+ * @class PsfLocalizer
+ *
+ * @brief Fits for the position of a point source with the rest of
+ * the model held fixed.  The flux density of the source for each
+ * event is modeled as the source spectrum times the exposure at the
+ * event energy, times the mean psf at the starting position
+ * (tabulated once) evaluated at the separation of the event from the
+ * trial position.  Moving the source therefore only changes the
+ * separations, and no responses or exposures are recomputed.  The
+ * template is normalized to the flux densities from the full
+ * instrument response at the starting position.  At each position,
+ * the log-likelihood is maximized with respect to the normalization
+ * of the source.
+ *
+ * The position is found by evaluating the log-likelihood on a 3x3
+ * stencil about the current position, concurrently, and taking a
+ * Newton step using the gradient and curvature of the quadratic
+ * through the stencil points.  The stencil is shrunk as the steps
+ * become smaller than it.  The final curvature gives the error
+ * radius.
+ */
+
+class PsfLocalizer {
+
+public:
+
+   /// @param events The events
+   /// @param psf Mean psf at the starting position; its energies
+   ///        must cover those of the events
+   /// @param srcDir Starting position of the source
+   /// @param srcWeights Source spectrum times exposure at the energy
+   ///        of each event, up to an overall factor
+   /// @param srcDensity Flux density of the source for each event,
+   ///        at srcDir, used to normalize the template
+   /// @param bgDensity Summed flux density of all of the other
+   ///        sources for each event
+   /// @param npred Predicted number of counts from the source
+   PsfLocalizer(const std::vector<Event> & events, const MeanPsf & psf,
+                const CLHEP::Hep3Vector & srcDir,
+                const std::vector<double> & srcWeights,
+                const std::vector<double> & srcDensity,
+                const std::vector<double> & bgDensity,
+                double npred);
+
+   /// Fill the flux density inputs of the constructor from a model.
+   /// The source parameters are taken from the model's own copy of
+   /// the source, so that they are those of the most recent fit.
+   /// @param srcName Name of the source to be localized
+   static void modelDensities(const std::vector<Event> & events,
+                              const MeanPsf & psf,
+                              const SourceModel & model,
+                              const std::string & srcName,
+                              std::vector<double> & srcWeights,
+                              std::vector<double> & srcDensity,
+                              std::vector<double> & bgDensity);
+
+   /// Log-likelihood with the source at dir, relative to that at
+   /// the starting position with the source normalization fixed.
+   /// @param norm Filled with the best-fit normalization of the
+   ///        source, relative to its starting value
+   double logLike(const CLHEP::Hep3Vector & dir, double & norm) const;
+
+   /// Find the position that maximizes logLike.
+   /// @param dir On input, the starting position; on output, the
+   ///        best-fit position
+   /// @param step Initial spacing of the stencil (degrees)
+   /// @param tol Positional tolerance (degrees)
+   /// @param pool Used to evaluate the stencil points concurrently
+   /// @param maxIter Maximum number of steps
+   /// @return 0 if the fit converged
+   int localize(CLHEP::Hep3Vector & dir, double step, double tol,
+                ThreadPool & pool, int maxIter=50);
+
+   /// Radius of the 68% confidence region about the best-fit
+   /// position (degrees), or a negative value if the curvature at
+   /// the best-fit position does not give one.
+   double errorRadius() const {
+      return m_errorRadius;
+   }
+
+   /// All of the positions that were evaluated, with their
+   /// log-likelihood values.
+   const std::vector<CLHEP::Hep3Vector> & testDirs() const {
+      return m_testDirs;
+   }
+
+   const std::vector<double> & testValues() const {
+      return m_testValues;
+   }
+
+   /// Number of events with a non-zero source density.
+   size_t nevents() const {
+      return m_dirs.size();
+   }
+
+private:
+
+   std::vector<CLHEP::Hep3Vector> m_dirs;
+   std::vector<double> m_bg;
+
+   /// Factors converting the tabulated psf to the source flux
+   /// density for each event.
+   std::vector<double> m_scale;
+
+   /// Index and weight of the tabulated energy below each event.
+   std::vector<size_t> m_energyIndex;
+   std::vector<double> m_energyWeight;
+
+   /// Log of the psf, tabulated on a logarithmic grid of
+   /// separations for each energy of the mean psf.
+   std::vector< std::vector<double> > m_logPsfTable;
+   double m_logThetaMin;
+   double m_logThetaStep;
+
+   double m_npred;
+   double m_logLike0;
+
+   double m_errorRadius;
+
+   std::vector<CLHEP::Hep3Vector> m_testDirs;
+   std::vector<double> m_testValues;
+
+   double psf(size_t ievt, double theta) const;
+
+   static double separation(const CLHEP::Hep3Vector & dir1,
+                            const CLHEP::Hep3Vector & dir2);
+
+};
+
+} // namespace Likelihood
+
+#endif // Likelihood_PsfLocalizer_h
@@ -0,0 +1,123 @@
+/**
+ * @file RemoteLogLike.h
+ * @brief LogLike component whose data live in a separate worker
+ * process.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#ifndef Likelihood_RemoteLogLike_h
+#define Likelihood_RemoteLogLike_h
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include "Likelihood/LogLike.h"
+
+namespace Likelihood {
+
+/**
+ * @class RemoteLogLike
+ *
+ * @brief Stands in for a LogLike object that lives in a worker
+ * process, so that joint fits with SummedLikelihood, Composite2 or
+ * CompositeLikelihood can use more memory than a single process
+ * would allow.
+ *
+ * The source model of the RemoteLogLike, which must match that of
+ * the worker, is used only for the parameter bookkeeping.  For each
+ * evaluation, the current parameter values and free flags are sent
+ * to the worker, which returns the log-likelihood or its
+ * derivatives.  Priors are evaluated locally.  The evaluations of
+ * several RemoteLogLike components proceed concurrently when the
+ * composite statistic is set to use more than one thread.
+ *
+ * Messages are written in the native byte order, so the coordinator
+ * and the workers must run on the same architecture.
+ */
+
+class RemoteLogLike : public LogLike {
+
+public:
+
+   /**
+    * @class Factory
+    * @brief Builds the LogLike object, including its data, in the
+    * worker process.
+    */
+   class Factory {
+   public:
+      virtual ~Factory() {}
+      virtual LogLike * create() = 0;
+   };
+
+   /// Fork a worker process on this host.  The factory is called in
+   /// the worker, so the data are read only there.  Workers should
+   /// be started before any threads are, since only the calling
+   /// thread is copied to the worker.
+   RemoteLogLike(const Observation & observation, Factory & factory);
+
+   /// Use a worker that is already serving requests, e.g., via
+   /// serve(...) on another node at the other end of a socket.  The
+   /// file descriptors, which may be the same, are closed by the
+   /// destructor.
+   RemoteLogLike(const Observation & observation, int fd_in, int fd_out);
+
+   virtual ~RemoteLogLike();
+
+   using LogLike::value;
+   using LogLike::getFreeDerivs;
+
+   virtual double value(const optimizers::Arg & dummy,
+                        bool include_priors) const;
+
+   virtual void getFreeDerivs(const optimizers::Arg & dummy,
+                              std::vector<double> & derivs,
+                              bool include_priors) const;
+
+   virtual double NpredValue(const std::string & srcName,
+                             bool weighted=false) const;
+
+   /// Predicted cost of an evaluation in the worker, as given by
+   /// ComponentEvaluator::cost for its LogLike object.
+   double cost() const;
+
+   /// Process id of the worker, or zero if it was not started by
+   /// this object.
+   pid_t pid() const {
+      return m_pid;
+   }
+
+   /// Worker loop: evaluate like for the requests read from fd_in,
+   /// writing the results to fd_out, until the coordinator sends
+   /// quit or closes the connection.
+   static void serve(LogLike & like, int fd_in, int fd_out);
+
+protected:
+
+   /// A copy would share the connection to the worker.
+   virtual LogLike * clone() const;
+
+private:
+
+   int m_fdIn;
+   int m_fdOut;
+   pid_t m_pid;
+
+   class Message;
+
+   void putParams(Message & request) const;
+
+   void call(const Message & request, Message & reply) const;
+
+   RemoteLogLike(const RemoteLogLike &);
+   RemoteLogLike & operator=(const RemoteLogLike &);
+
+};
+
+} // namespace Likelihood
+
+#endif // Likelihood_RemoteLogLike_h
@@ -37,6 +37,12 @@ public:
 
    ~ResponseFunctions();
 
+   /// Return a copy that owns clones of the irfInterface::Irfs
+   /// objects.  The IRF implementations cache intermediate results
+   /// and toggle internal state (e.g., phi-dependence), so each
+   /// thread evaluating responses concurrently needs its own copy.
+   ResponseFunctions * clone() const;
+
    /// Return the total instrument response 
    /// (= effective area*PSF*energy dispersion).
    /// @param energy True photon energy (MeV).
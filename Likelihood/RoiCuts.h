@@ -112,6 +112,11 @@ public:
    /// Apply these cuts to an Event
    bool accept(const Event &) const;
 
+   /// Apply these cuts to the FT1 quantities of an event, so that
+   /// events can be selected before an Event is constructed.
+   bool accept(double ra, double dec, double energy, double time,
+               double muZenith) const;
+
    /// Write DSS keywords to a FITS header
    void writeDssKeywords(tip::Header & header) const;
 
@@ -171,6 +176,9 @@ private:
    /// Add a time range cut.
    void addTimeInterval(double tmin, double tmax);
 
+   /// Apply the GTI and time range cuts.
+   bool acceptTime(double time) const;
+
    /// Create the m_energies vector.
    void makeEnergyVector(int nee=100);
 
@@ -0,0 +1,111 @@
+/**
+ * @file ScanCheckpoint.h
+ * @brief Periodic checkpoints of the finished positions of a map scan
+ * so that an interrupted run can be resumed.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#ifndef Likelihood_ScanCheckpoint_h
+#define Likelihood_ScanCheckpoint_h
+
+#include <ctime>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Likelihood {
+
+/**
+ * @class ScanCheckpoint
+ *
+ * @brief Keeps track of which pixels of a scan have been finished,
+ * and writes them to a sidecar file together with named arrays of
+ * results (e.g., the contents of the output histograms) and a vector
+ * of parameters (e.g., the baseline fit).  The file is written to a
+ * temporary file that is then renamed, so an interruption while
+ * writing leaves the previous checkpoint intact.
+ *
+ * A checkpoint is only resumed if it was made with the same
+ * signature, a string describing the scan (e.g., the dimensions and
+ * options of the map), so results from a different run are not
+ * picked up by mistake.
+ */
+
+class ScanCheckpoint {
+
+public:
+
+   /// @param filename Name of the checkpoint file
+   /// @param signature Description of the scan
+   /// @param npix Number of pixels in the scan
+   /// @param interval Minimum time in seconds between checkpoints
+   ScanCheckpoint(const std::string & filename,
+                  const std::string & signature,
+                  size_t npix, double interval);
+
+   /// Read the checkpoint file.
+   /// @return false if the file does not exist or if it was made
+   ///         for a different scan, in which case nothing is changed.
+   bool read();
+
+   /// Write the checkpoint file.
+   void write();
+
+   /// True if at least interval seconds have passed since the last
+   /// write (or since construction).
+   bool due() const;
+
+   /// Remove the checkpoint file, e.g., once the final output has
+   /// been written.
+   void remove() const;
+
+   void setDone(size_t ipix) {
+      m_done.at(ipix) = 1;
+   }
+
+   bool done(size_t ipix) const {
+      return m_done.at(ipix) != 0;
+   }
+
+   size_t nDone() const;
+
+   size_t npix() const {
+      return m_done.size();
+   }
+
+   const std::string & filename() const {
+      return m_filename;
+   }
+
+   void setArray(const std::string & name, const std::vector<float> & values);
+
+   /// @return false if there is no array with this name.
+   bool getArray(const std::string & name, std::vector<float> & values) const;
+
+   void setParams(const std::vector<double> & params) {
+      m_params = params;
+   }
+
+   const std::vector<double> & params() const {
+      return m_params;
+   }
+
+private:
+
+   std::string m_filename;
+   std::string m_signature;
+   double m_interval;
+   std::time_t m_lastWrite;
+
+   std::vector<char> m_done;
+   std::map<std::string, std::vector<float> > m_arrays;
+   std::vector<double> m_params;
+
+};
+
+} // namespace Likelihood
+
+#endif // Likelihood_ScanCheckpoint_h
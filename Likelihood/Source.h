@@ -113,6 +113,17 @@ namespace Likelihood {
 
      /// @return Cached vector of exposures as a function of energy
      inline const std::vector<double> & exposure() const { return m_exposure; }
+
+     /// @return Energies at which the exposures are evaluated
+     inline const std::vector<double> & exposureEnergies() const { return m_energies; }
+
+     /// Set the exposures used by Npred(), e.g., with values saved
+     /// from or interpolated from an earlier computeExposure(...) call.
+     void setExposure(const std::vector<double> & energies,
+                      const std::vector<double> & exposure) {
+       m_energies = energies;
+       m_exposure = exposure;
+     }
  
 
      /* ----------------- Simple setter functions ------------------------- */
@@ -19,6 +19,7 @@
 
 #include "optimizers/Statistic.h"
 
+#include "Likelihood/ComponentEvaluator.h"
 #include "Likelihood/LogLike.h"
 #include "Likelihood/TiedParameter.h"
 
@@ -58,6 +59,20 @@ public:
 
    void syncParams();
 
+   /// Set the number of threads used to evaluate the components
+   /// concurrently in value(), getFreeDerivs() and syncParams().  A
+   /// value <= 0 selects all available processors.  The component
+   /// contributions are summed in the order the components were
+   /// added, so results do not depend on the thread count or
+   /// scheduling.  The components must not share Source objects.
+   void setNumThreads(int nthreads) {
+      m_evaluator.setNumThreads(nthreads);
+   }
+
+   size_t numThreads() const {
+      return m_evaluator.numThreads();
+   }
+
    double NpredValue(const std::string & srcname, bool weighted = false) const;
 
    /// Member functions to support tying of parameters.
@@ -104,6 +119,8 @@ private:
 
    LogLike * m_masterComponent;
 
+   ComponentEvaluator m_evaluator;
+
 };
 
 } // namespace Likelihood
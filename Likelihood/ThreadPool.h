@@ -0,0 +1,156 @@
+/**
+ * @file ThreadPool.h
+ * @brief A small, persistent pool of POSIX threads for distributing
+ * independent work items.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#ifndef Likelihood_ThreadPool_h
+#define Likelihood_ThreadPool_h
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+namespace Likelihood {
+
+/**
+ * @class ThreadPool
+ *
+ * @brief Persistent set of worker threads that execute a Task over a
+ * range of work items.  Items are handed out in chunks from a shared
+ * counter, so workers that finish early pick up the remaining items
+ * and uneven per-item costs are balanced automatically.
+ *
+ * The calling thread participates as worker 0, so a pool with
+ * nthreads() == 1 runs everything serially without spawning any
+ * threads.  Exceptions thrown by a Task are caught in the workers and
+ * re-thrown as std::runtime_error from run().
+ */
+
+class ThreadPool {
+
+public:
+
+   /**
+    * @class Task
+    * @brief Interface for the work executed by the pool.
+    */
+   class Task {
+   public:
+      virtual ~Task() {}
+      /// Process work item "item".  The thread_id lies in
+      /// [0, nthreads()) and may be used to index per-thread scratch
+      /// space.
+      virtual void run(size_t item, size_t thread_id) = 0;
+   };
+
+   /**
+    * @class Mutex
+    * @brief Thin wrapper around pthread_mutex_t for use by Tasks
+    * that need to serialize access to shared data.
+    */
+   class Mutex {
+   public:
+      Mutex() { pthread_mutex_init(&m_mutex, 0); }
+      ~Mutex() { pthread_mutex_destroy(&m_mutex); }
+      void lock() { pthread_mutex_lock(&m_mutex); }
+      void unlock() { pthread_mutex_unlock(&m_mutex); }
+      pthread_mutex_t * handle() { return &m_mutex; }
+   private:
+      pthread_mutex_t m_mutex;
+      Mutex(const Mutex &);
+      Mutex & operator=(const Mutex &);
+   };
+
+   /**
+    * @class Lock
+    * @brief Scoped lock for a Mutex.
+    */
+   class Lock {
+   public:
+      Lock(Mutex & mutex) : m_mutex(mutex) { m_mutex.lock(); }
+      ~Lock() { m_mutex.unlock(); }
+   private:
+      Mutex & m_mutex;
+      Lock(const Lock &);
+      Lock & operator=(const Lock &);
+   };
+
+   /// @param nthreads Total number of threads, including the caller.
+   ///        A value of zero means defaultThreads().
+   explicit ThreadPool(size_t nthreads=0);
+
+   ~ThreadPool();
+
+   size_t nthreads() const {
+      return m_nthreads;
+   }
+
+   /// Execute task.run(item, thread_id) for every item in
+   /// [0, nitems).  Items are dispatched in blocks of "chunk".
+   /// Returns when all items are done.  A pool runs one job at a
+   /// time: calling run() from within a Task running on the same
+   /// pool, or from another thread while it is busy, throws
+   /// std::runtime_error.  Use a separate pool for nested work.
+   void run(Task & task, size_t nitems, size_t chunk=1);
+
+   /// Number of threads to use when none is specified.  This is
+   /// given by the LIKELIHOOD_NTHREADS environment variable if set,
+   /// and is 1 otherwise.
+   static size_t defaultThreads();
+
+   /// Number of online processors, or 1 if this cannot be determined.
+   static size_t hardwareThreads();
+
+   /// Resolve a user-supplied thread count: values <= 0 select
+   /// hardwareThreads().
+   static size_t resolveThreads(int nthreads);
+
+private:
+
+   size_t m_nthreads;
+
+   std::vector<pthread_t> m_threads;
+
+   Mutex m_mutex;
+   pthread_cond_t m_start;
+   pthread_cond_t m_done;
+
+   bool m_shutdown;
+   bool m_busy;
+   unsigned long m_generation;
+
+   // Current job.
+   Task * m_task;
+   size_t m_nitems;
+   size_t m_chunk;
+   size_t m_next;
+   size_t m_pending;
+   std::string m_error;
+
+   struct WorkerArgs {
+      ThreadPool * pool;
+      size_t thread_id;
+   };
+   std::vector<WorkerArgs> m_args;
+
+   void processItems(size_t thread_id);
+
+   void workerLoop(size_t thread_id);
+
+   static void * startWorker(void * args);
+
+   void runSerial(Task & task, size_t nitems);
+
+   ThreadPool(const ThreadPool &);
+   ThreadPool & operator=(const ThreadPool &);
+
+};
+
+} // namespace Likelihood
+
+#endif // Likelihood_ThreadPool_h
@@ -19,6 +19,7 @@ def generate(env, **kw):
     env.Tool('addLibrary', library=env['cfitsioLibs'])
     env.Tool('addLibrary', library=env['fftwLibs'])
     env.Tool('addLibrary', library=env['gsllibs'])
+    env.Tool('addLibrary', library=['pthread'])
     
 def exists(env):
     return 1
@@ -0,0 +1,154 @@
+/**
+ * @file AdaptiveGrid.cxx
+ * @brief Coarse-to-fine selection of the pixels of a map at which a
+ * test statistic is evaluated.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "Likelihood/AdaptiveGrid.h"
+
+namespace Likelihood {
+
+AdaptiveGrid::AdaptiveGrid(long nx, long ny, long coarseStep,
+                           double valueThreshold, double gradThreshold)
+   : m_nx(nx), m_ny(ny), m_coarseStep(std::max(coarseStep, 1L)),
+     m_valueThreshold(valueThreshold), m_gradThreshold(gradThreshold),
+     m_values(nx*ny, 0), m_evaluated(nx*ny, false), m_started(false) {
+   if (nx < 1 || ny < 1) {
+      throw std::runtime_error("AdaptiveGrid: the map must have at least "
+                               "one pixel along each axis.");
+   }
+}
+
+bool AdaptiveGrid::nextPixels(std::vector<long> & pixels) {
+   pixels.clear();
+   if (!m_started) {
+      m_started = true;
+      std::vector<long> xpts;
+      std::vector<long> ypts;
+      gridPoints(m_nx, m_coarseStep, xpts);
+      gridPoints(m_ny, m_coarseStep, ypts);
+      for (size_t j(0); j < ypts.size(); j++) {
+         for (size_t i(0); i < xpts.size(); i++) {
+            addPixel(xpts[i], ypts[j], pixels);
+         }
+      }
+      for (size_t j(0); j + 1 < std::max(ypts.size(), size_t(2)); j++) {
+         long y0(ypts[j]);
+         long y1(ypts.size() > 1 ? ypts[j + 1] : y0);
+         for (size_t i(0); i + 1 < std::max(xpts.size(), size_t(2)); i++) {
+            long x0(xpts[i]);
+            long x1(xpts.size() > 1 ? xpts[i + 1] : x0);
+            m_active.push_back(Cell(x0, y0, x1, y1));
+         }
+      }
+      return !pixels.empty();
+   }
+
+// Split the cells evaluated in the last pass, or set them aside for
+// interpolation.
+   std::vector<Cell> cells;
+   cells.swap(m_active);
+   for (size_t k(0); k < cells.size(); k++) {
+      const Cell & cell(cells[k]);
+      if (!splitCell(cell)) {
+         m_final.push_back(cell);
+         continue;
+      }
+      long xm((cell.x0 + cell.x1)/2);
+      long ym((cell.y0 + cell.y1)/2);
+      long xs[] = {cell.x0, xm, cell.x1};
+      long ys[] = {cell.y0, ym, cell.y1};
+      for (size_t j(0); j < 3; j++) {
+         for (size_t i(0); i < 3; i++) {
+            addPixel(xs[i], ys[j], pixels);
+         }
+      }
+// Only split along an axis if the cell is more than one pixel across.
+      size_t nxsplit(cell.x1 - cell.x0 > 1 ? 2 : 1);
+      size_t nysplit(cell.y1 - cell.y0 > 1 ? 2 : 1);
+      for (size_t j(0); j < nysplit; j++) {
+         long y0(nysplit == 2 ? ys[j] : cell.y0);
+         long y1(nysplit == 2 ? ys[j + 1] : cell.y1);
+         for (size_t i(0); i < nxsplit; i++) {
+            long x0(nxsplit == 2 ? xs[i] : cell.x0);
+            long x1(nxsplit == 2 ? xs[i + 1] : cell.x1);
+            m_active.push_back(Cell(x0, y0, x1, y1));
+         }
+      }
+   }
+   return !pixels.empty() || !m_active.empty();
+}
+
+void AdaptiveGrid::setValue(long ipix, double value) {
+   m_values.at(ipix) = value;
+}
+
+long AdaptiveGrid::nEvaluated() const {
+   return std::count(m_evaluated.begin(), m_evaluated.end(), true);
+}
+
+void AdaptiveGrid::interpolate(std::vector<double> & values) const {
+   if (values.size() != m_values.size()) {
+      throw std::runtime_error("AdaptiveGrid::interpolate: "
+                               "wrong number of values.");
+   }
+   for (size_t k(0); k < m_final.size(); k++) {
+      const Cell & cell(m_final[k]);
+      double v00(values[cell.y0*m_nx + cell.x0]);
+      double v10(values[cell.y0*m_nx + cell.x1]);
+      double v01(values[cell.y1*m_nx + cell.x0]);
+      double v11(values[cell.y1*m_nx + cell.x1]);
+      for (long iy(cell.y0); iy <= cell.y1; iy++) {
+         double ty(cell.y1 > cell.y0 ?
+                   double(iy - cell.y0)/(cell.y1 - cell.y0) : 0);
+         for (long ix(cell.x0); ix <= cell.x1; ix++) {
+            long ipix(iy*m_nx + ix);
+            if (m_evaluated[ipix]) {
+               continue;
+            }
+            double tx(cell.x1 > cell.x0 ?
+                      double(ix - cell.x0)/(cell.x1 - cell.x0) : 0);
+            values[ipix] = (1. - ty)*((1. - tx)*v00 + tx*v10)
+               + ty*((1. - tx)*v01 + tx*v11);
+         }
+      }
+   }
+}
+
+void AdaptiveGrid::addPixel(long ix, long iy, std::vector<long> & pixels) {
+   long ipix(iy*m_nx + ix);
+   if (!m_evaluated[ipix]) {
+      m_evaluated[ipix] = true;
+      pixels.push_back(ipix);
+   }
+}
+
+bool AdaptiveGrid::splitCell(const Cell & cell) const {
+   long size(std::max(cell.x1 - cell.x0, cell.y1 - cell.y0));
+   if (size < 2) {
+      return false;
+   }
+   double corners[] = {m_values[cell.y0*m_nx + cell.x0],
+                       m_values[cell.y0*m_nx + cell.x1],
+                       m_values[cell.y1*m_nx + cell.x0],
+                       m_values[cell.y1*m_nx + cell.x1]};
+   double vmin(*std::min_element(corners, corners + 4));
+   double vmax(*std::max_element(corners, corners + 4));
+   return vmax > m_valueThreshold || (vmax - vmin)/size > m_gradThreshold;
+}
+
+void AdaptiveGrid::gridPoints(long n, long step, std::vector<long> & points) {
+   points.clear();
+   for (long i(0); i < n - 1; i += step) {
+      points.push_back(i);
+   }
+   points.push_back(n - 1);
+}
+
+} // namespace Likelihood
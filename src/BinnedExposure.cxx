@@ -254,19 +254,32 @@ void BinnedExposure::computeMap() {
    st_stream::StreamFormatter formatter("BinnedExposure", "computeMap", 2);
    formatter.warn() << "Computing binned exposure map";
 
-   // Storing Aeff objects for use within loops over sky pixels.
-   std::map<std::pair<unsigned int, int>, Aeff *> aeffs;
+   // Tabulate the effective area, summed over event types, at the
+   // livetime cube integration nodes for each energy, so that the
+   // pixel loop reduces to inner products with the livetime
+   // distributions.
+   const ExposureCube & expCube(m_observation->expCube());
+   std::vector< std::vector<double> > tables(m_energies.size());
+   std::vector<double> table;
    for (unsigned int k(0); k < m_energies.size(); k++) {
       std::map<unsigned int, irfInterface::Irfs *>::const_iterator 
          resp = m_observation->respFuncs().begin();
       for (; resp != m_observation->respFuncs().end(); ++resp) {
          int evtType = resp->second->irfID();
-         aeffs[std::make_pair(k, evtType)] =  
-            new Aeff(m_energies[k], evtType, *m_observation, m_costhmin,
-                     m_costhmax);
+         Aeff aeff(m_energies[k], evtType, *m_observation, m_costhmin,
+                   m_costhmax);
+         expCube.fillResponseTable(aeff, table);
+         if (tables[k].empty()) {
+            tables[k] = table;
+         } else {
+            for (size_t i(0); i < table.size(); i++) {
+               tables[k][i] += table[i];
+            }
+         }
       }
    }
 
+   ExposureCube::LivetimeHandle livetime;
    long npix(m_naxes[0]*m_naxes[1]);
    for (int j = 0; j < m_naxes.at(1); j++) {
       for (int i = 0; i < m_naxes.at(0); i++, iter++) {
@@ -286,33 +299,17 @@ void BinnedExposure::computeMap() {
             // so that client code cannot catch it directly. Amazing.
             continue;
          }
-                                           
+         expCube.getLivetimeHandle(dir, livetime);
          for (unsigned int k = 0; k < m_energies.size(); k++) {
             unsigned int indx = (k*m_naxes.at(1) + j)*m_naxes.at(0) + i;
-            std::map<unsigned int, irfInterface::Irfs *>::const_iterator 
-               resp = m_observation->respFuncs().begin();
-            for (; resp != m_observation->respFuncs().end(); ++resp) {
-               int evtType = resp->second->irfID();
-               // Aeff aeff(m_energies[k], evtType, *m_observation, m_costhmin,
-               //           m_costhmax);
-               Aeff & aeff = *aeffs[std::make_pair(k, evtType)];
+            if (!tables[k].empty()) {
                m_exposureMap.at(indx)
-                  +=m_observation->expCube().value(dir, aeff, m_energies.at(k));
+                  += expCube.exposure(livetime, tables[k], m_energies.at(k));
             }
          }
       }
    }
 
-   // Release memory of Aeff map.
-   for (unsigned int k(0); k < m_energies.size(); k++) {
-      std::map<unsigned int, irfInterface::Irfs *>::const_iterator 
-         resp = m_observation->respFuncs().begin();
-      for (; resp != m_observation->respFuncs().end(); ++resp) {
-         int evtType = resp->second->irfID();
-         delete aeffs[std::make_pair(k, evtType)];
-      }
-   }
-
    formatter.warn() << "!" << std::endl;
 }
 
@@ -216,47 +216,45 @@ void BinnedHealpixExposure::computeHealpixMap() {
   m_exposureMap.resize(m_energies.size());
   st_stream::StreamFormatter formatter("BinnedHealpixExposure", "computeHealpixMap", 2);
   formatter.warn() << "Computing Healpix binned exposure map";
-  // Storing Aeff objects for use within loops over sky pixels.
-  std::map<std::pair<unsigned int, int>, Aeff *> aeffs;
+  // Tabulate the effective area, summed over event types, at the
+  // livetime cube integration nodes for each energy.
+  const ExposureCube & expCube(m_observation->expCube());
+  std::vector< std::vector<double> > tables(m_energies.size());
+  std::vector<double> table;
   for (unsigned int k(0); k < m_energies.size(); k++) {
     m_exposureMap[k].SetNside(m_healpixProj->healpix().Nside(),m_healpixProj->healpix().Scheme());
     std::map<unsigned int, irfInterface::Irfs *>::const_iterator 
       resp = m_observation->respFuncs().begin();
     for (; resp != m_observation->respFuncs().end(); ++resp) {
       int evtType = resp->second->irfID();
-      aeffs[std::make_pair(k, evtType)] =  
-	new Aeff(m_energies[k], evtType, *m_observation, m_costhmin,
-		 m_costhmax);
+      Aeff aeff(m_energies[k], evtType, *m_observation, m_costhmin,
+                m_costhmax);
+      expCube.fillResponseTable(aeff, table);
+      if (tables[k].empty()) {
+        tables[k] = table;
+      } else {
+        for (size_t i(0); i < table.size(); i++) {
+          tables[k][i] += table[i];
+        }
+      }
     }
   }
+  ExposureCube::LivetimeHandle livetime;
   int npix = m_healpixProj->healpix().Npix();
   for (int i = 0; i < npix; i++ ) {
     if (npix > 20 && (i % (npix/20)) == 0) {
       formatter.warn() << ".";
     }
     astro::SkyDir dir(i,0.,*m_healpixProj);
+    expCube.getLivetimeHandle(dir, livetime);
     for (unsigned int k = 0; k < m_energies.size(); k++) {
       m_exposureMap[k][i] = 0.;      
-      std::map<unsigned int, irfInterface::Irfs *>::const_iterator 
-	resp = m_observation->respFuncs().begin();
-      
-      for (; resp != m_observation->respFuncs().end(); ++resp) {
-	int evtType = resp->second->irfID();
-	Aeff & aeff = *aeffs[std::make_pair(k, evtType)];
-	double val = m_observation->expCube().value(dir, aeff, m_energies.at(k));
-	m_exposureMap[k][i] += val;
+      if (!tables[k].empty()) {
+        m_exposureMap[k][i] += expCube.exposure(livetime, tables[k],
+                                                m_energies.at(k));
       }
     }
   }
-  // Release memory of Aeff map.
-  for (unsigned int k(0); k < m_energies.size(); k++) {
-    std::map<unsigned int, irfInterface::Irfs *>::const_iterator 
-      resp = m_observation->respFuncs().begin();
-    for (; resp != m_observation->respFuncs().end(); ++resp) {
-      int evtType = resp->second->irfID();
-      delete aeffs[std::make_pair(k, evtType)];
-    }
-  }  
   formatter.warn() << "!" << std::endl;
 }
 
@@ -64,7 +64,8 @@ BinnedLikelihood::BinnedLikelihood(CountsMapBase & dataMap,
 		  observation, m_dataCache.countsMap().energies())),
     m_srcMapCache(m_dataCache,observation,srcMapsFile,m_config,m_drm),
     m_modelIsCurrent(false),
-    m_updateFixedWeights(true){
+    m_updateFixedWeights(true),
+    m_fixedModelOwner(0){
 
   std::cerr << "This version of the constructor of BinnedLikelihood is deprecated." << std::endl
 	    << "It will be removed in an upcoming release." << std::endl
@@ -104,7 +105,8 @@ BinnedLikelihood::BinnedLikelihood(CountsMapBase & dataMap,
 		  observation, m_dataCache.countsMap().energies())),
     m_srcMapCache(m_dataCache,observation,srcMapsFile,m_config,m_drm),
     m_modelIsCurrent(false),
-    m_updateFixedWeights(true){    
+    m_updateFixedWeights(true),
+    m_fixedModelOwner(0){    
 
   std::cerr << "This version of the constructor of BinnedLikelihood is deprecated." << std::endl
 	    << "It will be removed in an upcoming release." << std::endl
@@ -133,7 +135,8 @@ BinnedLikelihood::BinnedLikelihood(CountsMapBase & dataMap,
 		  observation, m_dataCache.countsMap().energies(), config.drm_bins())),
     m_srcMapCache(m_dataCache,observation,srcMapsFile,m_config,m_drm),
     m_modelIsCurrent(false),
-    m_updateFixedWeights(true){    
+    m_updateFixedWeights(true),
+    m_fixedModelOwner(0){    
   m_fixedModelCounts.resize(m_dataCache.nFilled(), 0);
   m_fixed_counts_spec.resize(m_dataCache.num_ebins(), 0); 
   m_fixed_counts_spec_wt.resize(m_dataCache.num_ebins(), 0); 
@@ -333,7 +336,11 @@ void BinnedLikelihood::getFreeDerivs(const optimizers::Arg & dummy,
     m_bestValueSoFar = -1e38;
     SourceModel::addSource(src, fromClone);
     if ( m_config.use_single_fixed_map() && src->fixedSpectrum()) {
-      addFixedSource(src->getName());      
+      if ( m_fixedModelOwner != 0 ) {
+	addSharedFixedSource(src->getName());
+      } else {
+	addFixedSource(src->getName());
+      }
     } else {
       if ( loadMap ) {
 	if ( srcMap == 0 ) {
@@ -350,7 +357,11 @@ void BinnedLikelihood::getFreeDerivs(const optimizers::Arg & dummy,
     m_bestValueSoFar = -1e38;
     SourceModel::addSource(src, fromClone);
     if ( m_config.use_single_fixed_map() && src->fixedSpectrum()) {
-      addFixedSource(src->getName());
+      if ( m_fixedModelOwner != 0 ) {
+	addSharedFixedSource(src->getName());
+      } else {
+	addFixedSource(src->getName());
+      }
     } else {
       m_srcMapCache.loadSourceMap(*src,false,config);
     }
@@ -367,6 +378,7 @@ void BinnedLikelihood::getFreeDerivs(const optimizers::Arg & dummy,
       std::find(m_fixedSources.begin(), m_fixedSources.end(), srcName);
     bool subtract(true);
     if (source(srcName).fixedSpectrum() && srcIt != m_fixedSources.end()) {
+      unshareFixedModel();
       SourceMap * srcMap(getSourceMap(srcName, false));
       addSourceCounts(m_fixedModelCounts, srcName, srcMap, subtract);
       addFixedNpreds(srcName, srcMap, subtract);
@@ -553,26 +565,28 @@ void BinnedLikelihood::getFreeDerivs(const optimizers::Arg & dummy,
     std::vector<double> modelCounts;
     modelCounts.resize(m_dataCache.nFilled(), 0.);
     
-    if (fixedModelUpdated() && m_updateFixedWeights) {
+    // A shared fixed model is kept up to date by its owner.
+    if (m_fixedModelOwner == 0 && m_updateFixedWeights && fixedModelUpdated()) {
       const_cast<BinnedLikelihood *>(this)->buildFixedModelWts();
     }
 
     // We don't apply the weights to the model we will be filling
     // But we do apply the energy dispersion
     // This was already handled in buildFixedModelWts
-    std::copy(m_fixedModelCounts.begin(), m_fixedModelCounts.end(), modelCounts.begin());
+    const std::vector<double>& fixedCounts = fixedModelCounts();
+    std::copy(fixedCounts.begin(), fixedCounts.end(), modelCounts.begin());
 
     std::vector<std::string> srcNames;
     getSrcNames(srcNames);
     
     // Get the version of the fixed model counts to use
     // Always pick one of the two that uses energy dispersion
-    const std::vector<double>& fixedModelCounts = weighted ? m_fixed_counts_spec_edisp_wt : m_fixed_counts_spec_edisp;
+    const std::vector<double>& fixedSpectrum = weighted ? fixedModelSpectrum_edisp_wt() : fixedModelSpectrum_edisp();
 
     double npred(0.);
     double npred_check(0.);
     for ( size_t kx(m_kmin); kx < m_kmax; kx++ ) {
-      npred += fixedModelCounts[kx];
+      npred += fixedSpectrum[kx];
     }
 
     for (size_t i(0); i < srcNames.size(); i++) {     
@@ -581,10 +595,16 @@ void BinnedLikelihood::getFreeDerivs(const optimizers::Arg & dummy,
       // but because it is possible to free and modify the source parameters directly, 
       // that doesn't always work. 
       // So we have to call NpredValue on all the sources 
+      // (except when the fixed model is shared, since then the fixed
+      // sources have no source maps here).
+      bool is_fixed = std::count(m_fixedSources.begin(), m_fixedSources.end(),
+				 srcNames[i]) != 0;
+      if ( is_fixed && m_fixedModelOwner != 0 ) {
+	continue;
+      }
       double npred_src = NpredValue(srcNames[i], weighted);
       npred_check += npred_src;
-      if (std::count(m_fixedSources.begin(), m_fixedSources.end(),
-		     srcNames[i]) == 0) {
+      if ( !is_fixed ) {
 	addSourceCounts(modelCounts, srcNames[i]);
 	npred += npred_src;
       } 
@@ -704,6 +724,7 @@ void BinnedLikelihood::getFreeDerivs(const optimizers::Arg & dummy,
 
 
   void BinnedLikelihood::buildFixedModelWts(bool process_all) {
+    m_fixedModelOwner = 0;
     m_fixedSources.clear();
 
     m_fixedModelCounts.clear();
@@ -775,7 +796,8 @@ void BinnedLikelihood::getFreeDerivs(const optimizers::Arg & dummy,
 	      << "source " << srcName << " already in fixed model.";
       throw std::runtime_error(message.str());
     }
-  
+
+    unshareFixedModel();
     m_fixedSources.push_back(srcName);
     const Source& src = *(srcIt->second);
 
@@ -806,6 +828,8 @@ void BinnedLikelihood::getFreeDerivs(const optimizers::Arg & dummy,
       throw std::runtime_error(message.str());
     }
   
+    unshareFixedModel();
+
     // Generate the SourceMap and include it in the stored maps.
     SourceMap * srcMap = getSourceMap(srcName, false);
     //bool has_wts = srcMap->weights() != 0;
@@ -825,6 +849,47 @@ void BinnedLikelihood::getFreeDerivs(const optimizers::Arg & dummy,
 
 
 
+  void BinnedLikelihood::shareFixedModel(const BinnedLikelihood & owner) {
+    if ( !m_sources.empty() ) {
+      throw std::runtime_error("BinnedLikelihood::shareFixedModel: "
+			       "must be called before any sources are added.");
+    }
+    if ( owner.m_fixedModelOwner != 0 ) {
+      shareFixedModel(*owner.m_fixedModelOwner);
+      return;
+    }
+    if ( owner.dataCache().nFilled() != m_dataCache.nFilled() ||
+	 owner.dataCache().num_ebins() != m_dataCache.num_ebins() ) {
+      throw std::runtime_error("BinnedLikelihood::shareFixedModel: "
+			       "counts maps do not match.");
+    }
+    m_fixedModelOwner = &owner;
+  }
+
+  void BinnedLikelihood::unshareFixedModel() {
+    if ( m_fixedModelOwner == 0 ) {
+      return;
+    }
+    m_fixedModelCounts = m_fixedModelOwner->m_fixedModelCounts;
+    m_fixed_counts_spec = m_fixedModelOwner->m_fixed_counts_spec;
+    m_fixed_counts_spec_wt = m_fixedModelOwner->m_fixed_counts_spec_wt;
+    m_fixed_counts_spec_edisp = m_fixedModelOwner->m_fixed_counts_spec_edisp;
+    m_fixed_counts_spec_edisp_wt = m_fixedModelOwner->m_fixed_counts_spec_edisp_wt;
+    m_fixedModelOwner = 0;
+  }
+
+  void BinnedLikelihood::addSharedFixedSource(const std::string & srcName) {
+    const std::vector<std::string> & ownerSources = m_fixedModelOwner->fixedSources();
+    if (std::count(ownerSources.begin(), ownerSources.end(), srcName) == 0) {
+      std::ostringstream message;
+      message << "BinnedLikelihood::addSharedFixedSource: "
+	      << "source " << srcName << " is not in the shared fixed model.";
+      throw std::runtime_error(message.str());
+    }
+    m_fixedSources.push_back(srcName);
+  }
+
+
   std::vector<double> 
   BinnedLikelihood::countsSpectrum(const std::string & srcName,
 				   bool use_klims) const {
@@ -0,0 +1,202 @@
+/**
+ * @file ComponentEvaluator.cxx
+ * @brief Evaluate the LogLike components of a composite statistic,
+ * concurrently if more than one thread is set.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#include <algorithm>
+#include <utility>
+
+#include "Likelihood/BinnedLikelihood.h"
+#include "Likelihood/ComponentEvaluator.h"
+#include "Likelihood/EventContainer.h"
+#include "Likelihood/LogLike.h"
+#include "Likelihood/Observation.h"
+#include "Likelihood/RemoteLogLike.h"
+#include "Likelihood/ThreadPool.h"
+
+namespace {
+   void runTask(Likelihood::ThreadPool::Task & task, size_t nitems,
+                Likelihood::ThreadPool * pool) {
+      if (pool) {
+         pool->run(task, nitems);
+      } else {
+         for (size_t i(0); i < nitems; i++) {
+            task.run(i, 0);
+         }
+      }
+   }
+}
+
+namespace Likelihood {
+
+/**
+ * @class ComponentEvaluator::ValueTask
+ * @brief Evaluates each component.  Item i of the task is component
+ * order[i].
+ */
+class ComponentEvaluator::ValueTask : public ThreadPool::Task {
+public:
+   ValueTask(const std::vector<LogLike *> & components,
+             const std::vector<size_t> & order, bool priorsFirstOnly,
+             std::vector<double> & values)
+      : m_components(components), m_order(order),
+        m_priorsFirstOnly(priorsFirstOnly), m_values(values) {}
+
+   virtual void run(size_t item, size_t) {
+      size_t i(m_order[item]);
+      optimizers::Arg dummy;
+      m_values[i] = m_components[i]->value(dummy,
+                                           !m_priorsFirstOnly || i == 0);
+   }
+
+private:
+   const std::vector<LogLike *> & m_components;
+   const std::vector<size_t> & m_order;
+   bool m_priorsFirstOnly;
+   std::vector<double> & m_values;
+};
+
+/**
+ * @class ComponentEvaluator::DerivsTask
+ * @brief Evaluates the free derivatives of each component.
+ */
+class ComponentEvaluator::DerivsTask : public ThreadPool::Task {
+public:
+   DerivsTask(const std::vector<LogLike *> & components,
+              const std::vector<size_t> & order, bool priorsFirstOnly,
+              std::vector< std::vector<double> > & derivs)
+      : m_components(components), m_order(order),
+        m_priorsFirstOnly(priorsFirstOnly), m_derivs(derivs) {}
+
+   virtual void run(size_t item, size_t) {
+      size_t i(m_order[item]);
+      optimizers::Arg dummy;
+      m_components[i]->getFreeDerivs(dummy, m_derivs[i],
+                                     !m_priorsFirstOnly || i == 0);
+   }
+
+private:
+   const std::vector<LogLike *> & m_components;
+   const std::vector<size_t> & m_order;
+   bool m_priorsFirstOnly;
+   std::vector< std::vector<double> > & m_derivs;
+};
+
+/**
+ * @class ComponentEvaluator::SyncTask
+ * @brief Copies a set of parameters to each component.
+ */
+class ComponentEvaluator::SyncTask : public ThreadPool::Task {
+public:
+   SyncTask(const std::vector<LogLike *> & components,
+            const std::vector<size_t> & order,
+            const std::vector<optimizers::Parameter> & pars)
+      : m_components(components), m_order(order), m_pars(pars) {}
+
+   virtual void run(size_t item, size_t) {
+      LogLike * component(m_components[m_order[item]]);
+      component->setParams(m_pars);
+      component->syncParams();
+   }
+
+private:
+   const std::vector<LogLike *> & m_components;
+   const std::vector<size_t> & m_order;
+   const std::vector<optimizers::Parameter> & m_pars;
+};
+
+void ComponentEvaluator::ThreadPoolPtr::reset(ThreadPool * ptr) {
+   delete m_ptr;
+   m_ptr = ptr;
+}
+
+void ComponentEvaluator::setNumThreads(int nthreads) {
+   m_nthreads = ThreadPool::resolveThreads(nthreads);
+   m_pool.reset(0);
+}
+
+void ComponentEvaluator::reset() {
+   m_order.clear();
+   m_pool.reset(0);
+   m_valueWarm = false;
+   m_derivsWarm = false;
+}
+
+ThreadPool * ComponentEvaluator::threadPool(size_t ncomponents) const {
+   if (m_nthreads < 2 || ncomponents < 2) {
+      return 0;
+   }
+   if (m_pool.get() == 0) {
+      m_pool.reset(new ThreadPool(std::min(m_nthreads, ncomponents)));
+   }
+   return m_pool.get();
+}
+
+double ComponentEvaluator::cost(const LogLike & component) {
+// The data of a remote component live in its worker.
+   const RemoteLogLike * remote
+      = dynamic_cast<const RemoteLogLike *>(&component);
+   if (remote) {
+      return remote->cost();
+   }
+   double nitems;
+   const BinnedLikelihood * binned
+      = dynamic_cast<const BinnedLikelihood *>(&component);
+   if (binned) {
+      nitems = binned->dataCache().nFilled();
+   } else {
+      nitems = component.observation().eventCont().events().size();
+   }
+   return (nitems + 1)*(component.getNumSrcs() + 1);
+}
+
+const std::vector<size_t> & ComponentEvaluator::
+order(const std::vector<LogLike *> & components) const {
+   if (m_order.size() != components.size()) {
+      std::vector< std::pair<double, size_t> > costs;
+      for (size_t i(0); i < components.size(); i++) {
+         costs.push_back(std::make_pair(-cost(*components[i]), i));
+      }
+      std::sort(costs.begin(), costs.end());
+      m_order.clear();
+      for (size_t i(0); i < costs.size(); i++) {
+         m_order.push_back(costs[i].second);
+      }
+   }
+   return m_order;
+}
+
+void ComponentEvaluator::values(const std::vector<LogLike *> & components,
+                                std::vector<double> & values,
+                                bool priorsFirstOnly) const {
+   values.assign(components.size(), 0);
+   ValueTask task(components, order(components), priorsFirstOnly, values);
+   runTask(task, components.size(),
+           m_valueWarm ? threadPool(components.size()) : 0);
+   m_valueWarm = true;
+}
+
+void ComponentEvaluator::
+derivs(const std::vector<LogLike *> & components,
+       std::vector< std::vector<double> > & derivs,
+       bool priorsFirstOnly) const {
+   derivs.resize(components.size());
+   DerivsTask task(components, order(components), priorsFirstOnly, derivs);
+   runTask(task, components.size(),
+           m_derivsWarm ? threadPool(components.size()) : 0);
+   m_derivsWarm = true;
+}
+
+void ComponentEvaluator::
+syncParams(const std::vector<LogLike *> & components,
+           const std::vector<optimizers::Parameter> & pars) const {
+   SyncTask task(components, order(components), pars);
+   runTask(task, components.size(),
+           m_valueWarm ? threadPool(components.size()) : 0);
+}
+
+} // namespace Likelihood
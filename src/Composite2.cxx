@@ -30,9 +30,19 @@ Composite2::~Composite2() throw() {
 void Composite2::addComponent(LogLike & like) {
    std::vector<size_t> tiedPars;
    m_components[&like] = tiedPars;
+   buildTieTables();
+   m_evaluator.reset();
 }
 
 void Composite2::tieParameters(const TiedParameter::ParVector_t & pars) {
+   for (TiedParameter::ParVectorConstIterator_t it(pars.begin());
+        it != pars.end(); ++it) {
+      const std::vector<size_t> & tiedPars(m_components[it->first]);
+      if (std::count(tiedPars.begin(), tiedPars.end(), it->second) != 0) {
+         throw std::runtime_error("A parameter can belong to one "
+                                  "group of tied parameters at most.");
+      }
+   }
    TiedParameter * tiedPar = new TiedParameter();
    for (TiedParameter::ParVectorConstIterator_t it(pars.begin());
         it != pars.end(); ++it) {
@@ -40,13 +50,44 @@ void Composite2::tieParameters(const TiedParameter::ParVector_t & pars) {
       m_components[it->first].push_back(it->second);
    }
    m_tiedPars.push_back(tiedPar);
+   buildTieTables();
+   m_evaluator.reset();
 }
 
-double Composite2::value() const {
-   double my_value(0);
+void Composite2::buildTieTables() {
+   m_componentList.clear();
+   m_componentIndex.clear();
+   m_tieIndex.clear();
    for (ComponentConstIterator_t it(m_components.begin());
         it != m_components.end(); ++it) {
-      my_value += it->first->value();
+      m_componentIndex[it->first] = m_componentList.size();
+      m_componentList.push_back(it->first);
+      m_tieIndex.push_back(std::vector<int>());
+   }
+   for (size_t k(0); k < m_tiedPars.size(); k++) {
+      const TiedParameter::ParVector_t & pars(m_tiedPars[k]->pars());
+      for (size_t j(0); j < pars.size(); j++) {
+         std::vector<int> & 
+            tieIndex(m_tieIndex[m_componentIndex[pars[j].first]]);
+         if (tieIndex.size() <= pars[j].second) {
+            tieIndex.resize(pars[j].second + 1, -1);
+         }
+         tieIndex[pars[j].second] = k;
+      }
+   }
+}
+
+int Composite2::tiedParIndex(size_t icomp, size_t par_index) const {
+   const std::vector<int> & tieIndex(m_tieIndex[icomp]);
+   return par_index < tieIndex.size() ? tieIndex[par_index] : -1;
+}
+
+double Composite2::value() const {
+   std::vector<double> values;
+   m_evaluator.values(m_componentList, values, false);
+   double my_value(0);
+   for (size_t i(0); i < values.size(); i++) {
+      my_value += values[i];
    }
    return my_value;
 }
@@ -58,13 +99,11 @@ getFreeParams(std::vector<optimizers::Parameter> & params) const {
       throw std::runtime_error("getFreeParams: empty composite list");
    }
 // Loop over LogLike components and gather up free, untied parameters
-   for (ComponentConstIterator_t it(m_components.begin());
-        it != m_components.end(); ++it) {
-      const std::vector<size_t> & tiedPars(it->second);
-      const std::vector<optimizers::Parameter> & pars(it->first->parameters());
+   for (size_t icomp(0); icomp < m_componentList.size(); icomp++) {
+      const std::vector<optimizers::Parameter> & 
+         pars(m_componentList[icomp]->parameters());
       for (size_t i(0); i < pars.size(); i++) {
-         if (pars.at(i).isFree() 
-             && std::count(tiedPars.begin(), tiedPars.end(), i) == 0) {
+         if (pars.at(i).isFree() && tiedParIndex(icomp, i) < 0) {
             params.push_back(pars.at(i));
          }
       }
@@ -101,13 +140,11 @@ setFreeParamValues(const std::vector<double> & values) {
    }
    size_t j(0);
 // Loop over LogLike components and set free, untied parameters
-   for (ComponentConstIterator_t it(m_components.begin());
-        it != m_components.end(); ++it) {
-      const std::vector<size_t> & tiedPars(it->second);
-      std::vector<optimizers::Parameter> & pars(it->first->parameters());
+   for (size_t icomp(0); icomp < m_componentList.size(); icomp++) {
+      std::vector<optimizers::Parameter> & 
+         pars(m_componentList[icomp]->parameters());
       for (size_t i(0); i < pars.size(); i++) {
-         if (pars.at(i).isFree() 
-             && std::count(tiedPars.begin(), tiedPars.end(), i) == 0) {
+         if (pars.at(i).isFree() && tiedParIndex(icomp, i) < 0) {
             pars.at(i).setValue(values.at(j++));
          }
       }
@@ -127,13 +164,11 @@ void Composite2::setErrors(const std::vector<double> & errors) {
    }
    size_t j(0);
 // Loop over LogLike components and set free, untied parameters
-   for (ComponentConstIterator_t it(m_components.begin());
-        it != m_components.end(); ++it) {
-      const std::vector<size_t> & tiedPars(it->second);
-      std::vector<optimizers::Parameter> & pars(it->first->parameters());
+   for (size_t icomp(0); icomp < m_componentList.size(); icomp++) {
+      std::vector<optimizers::Parameter> & 
+         pars(m_componentList[icomp]->parameters());
       for (size_t i(0); i < pars.size(); i++) {
-         if (pars.at(i).isFree() 
-             && std::count(tiedPars.begin(), tiedPars.end(), i) == 0) {
+         if (pars.at(i).isFree() && tiedParIndex(icomp, i) < 0) {
             pars.at(i).setError(errors.at(j++));
          }
       }
@@ -149,22 +184,21 @@ void Composite2::setErrors(const std::vector<double> & errors) {
 
 void Composite2::syncParams() {
    m_parameter.clear();
-   for (ComponentIterator_t it(m_components.begin()); 
-        it != m_components.end(); ++it) {
-      const std::vector<size_t> & tiedPars(it->second);
+   for (size_t icomp(0); icomp < m_componentList.size(); icomp++) {
+      LogLike * component(m_componentList[icomp]);
       std::vector<optimizers::Parameter> freePars;
-      const std::vector<optimizers::Parameter> & pars(it->first->parameters());
+      const std::vector<optimizers::Parameter> & pars(component->parameters());
       for (size_t i(0); i < pars.size(); i++) {
          if (pars.at(i).isFree()) {
             freePars.push_back(pars.at(i));
          }
 	 //Fill the optimizers::Function m_parameter vector component 
 	 //by component, leaving the tied parameters for the end 
-         if (std::count(tiedPars.begin(), tiedPars.end(), i) == 0) {
+         if (tiedParIndex(icomp, i) < 0) {
             m_parameter.push_back(pars.at(i));
          }
       }
-      it->first->setFreeParams(freePars);
+      component->setFreeParams(freePars);
    }
 
    // Now fill m_parameter with the tied parameters.
@@ -174,19 +208,7 @@ void Composite2::syncParams() {
 }
 
 unsigned int Composite2::getNumFreeParams() const {
-   unsigned int npars(0);
-// Loop over LogLike components and count free, untied parameters
-   for (ComponentConstIterator_t it(m_components.begin());
-        it != m_components.end(); ++it) {
-      const std::vector<size_t> & tiedPars(it->second);
-      const std::vector<optimizers::Parameter> & pars(it->first->parameters());
-      for (size_t i(0); i < pars.size(); i++) {
-         if (pars.at(i).isFree() 
-             && std::count(tiedPars.begin(), tiedPars.end(), i) == 0) {
-            npars++;
-         }
-      }
-   }
+   unsigned int npars(nFreeUntied(m_componentList.size()));
 // Add the free TiedParameters.
    for (size_t i(0); i < m_tiedPars.size(); i++) {
       if (m_tiedPars.at(i)->isFree()) {
@@ -199,34 +221,29 @@ unsigned int Composite2::getNumFreeParams() const {
 void Composite2::getFreeDerivs(std::vector<double> & derivs) const {
    derivs.clear();
    std::vector<double> tp_derivs(m_tiedPars.size(), 0);
-   for (ComponentConstIterator_t it(m_components.begin());
-        it != m_components.end(); ++it) {
-      const std::vector<size_t> & tiedPars(it->second);
-      const std::vector<optimizers::Parameter> & pars(it->first->parameters());
-      std::vector<double> freeDerivs;
-      it->first->getFreeDerivs(freeDerivs);
+// Evaluate the components, concurrently after the first call, then
+// gather their contributions in order.
+   std::vector< std::vector<double> > componentDerivs;
+   m_evaluator.derivs(m_componentList, componentDerivs, false);
+   for (size_t icomp(0); icomp < m_componentList.size(); icomp++) {
+      const std::vector<optimizers::Parameter> & 
+         pars(m_componentList[icomp]->parameters());
+      const std::vector<double> & freeDerivs(componentDerivs[icomp]);
       size_t j(0);
       for (size_t i(0); i < pars.size(); i++) {
          if (pars.at(i).isFree()) {
-            if (std::count(tiedPars.begin(), tiedPars.end(), i) == 0) {
+            int k(tiedParIndex(icomp, i));
+            if (k < 0) {
                // normal free parameter
                derivs.push_back(freeDerivs.at(j));
             } else {
                // tied parameter: sum up contribution from individual params
-               std::pair<LogLike *, size_t> item = std::make_pair(it->first, i);
-               std::vector<TiedParameter *>::const_iterator tp 
-                  = m_tiedPars.begin();
-               for (size_t k(0) ; tp != m_tiedPars.end(); ++tp, k++) {
-                  if (std::count((*tp)->pars().begin(), 
-                                 (*tp)->pars().end(), item) != 0) {
-                     tp_derivs.at(k) += freeDerivs.at(j);
-                  }
-               }
+               tp_derivs.at(k) += freeDerivs.at(j);
             }
             j++;
          }
       } // pars.at(i)
-   } // m_components
+   } // m_componentList
    /// Append the derivative sums for the tied parameters.
    for (size_t k(0); k < tp_derivs.size(); k++) {
       if (m_tiedPars.at(k)->isFree()) {
@@ -236,54 +253,53 @@ void Composite2::getFreeDerivs(std::vector<double> & derivs) const {
 }
 
 int Composite2::findIndex(const LogLike & like, size_t par_index) const {
-   int j(0);
-/// Loop over components and free, untied parameters, advancing index
-/// until the desired par_index is found.
-   for (ComponentConstIterator_t it(m_components.begin());
-        it != m_components.end(); ++it) {
-      const std::vector<size_t> & tiedPars(it->second);
-      const std::vector<optimizers::Parameter> & 
-         pars(it->first->parameters());
-      if (&like == it->first) {
-         /// LogLike object matches, so loop over parameters and if
-         /// index matches, return the incremented index value, j.
-         for (size_t i(0); i < pars.size(); i++) {
-            if (std::count(tiedPars.begin(), tiedPars.end(), i) != 0
-                || !pars.at(i).isFree()) {
-               continue;
-            }
-            if (par_index == i) {
-               return j;
-            }
-            j++;
-         }
-      } else {
-         /// LogLike object does not match, so just loop over free,
-         /// untied parameters and increment the j index.
-         for (size_t i(0); i < pars.size(); i++) {
-            if (std::count(tiedPars.begin(), tiedPars.end(), i) != 0
-                || !pars.at(i).isFree()) {
-               continue;
-            }
-            j++;
-         }
+   std::map<const LogLike *, size_t>::const_iterator 
+      comp(m_componentIndex.find(&like));
+   if (comp == m_componentIndex.end()) {
+      return -1;
+   }
+   size_t icomp(comp->second);
+/// Tied parameters follow all of the free, untied ones, in the order
+/// of m_tiedPars.
+   int k(tiedParIndex(icomp, par_index));
+   if (k >= 0) {
+      return nFreeUntied(m_componentList.size()) + k;
+   }
+   const std::vector<optimizers::Parameter> & pars(like.parameters());
+   if (par_index >= pars.size() || !pars.at(par_index).isFree()) {
+      return -1;
+   }
+/// The free flags can change at any time, so these are counted here.
+   int j(nFreeUntied(icomp));
+   for (size_t i(0); i < par_index; i++) {
+      if (pars.at(i).isFree() && tiedParIndex(icomp, i) < 0) {
+         j++;
       }
    }
-/// Loop over tied parameters.
-   for (size_t i(0); i < m_tiedPars.size(); i++) {
-      if (m_tiedPars.at(i)->containsIndex(like, par_index)) {
-         return j;
+   return j;
+}
+
+int Composite2::nFreeUntied(size_t ncomps) const {
+   int npars(0);
+   for (size_t icomp(0); icomp < ncomps; icomp++) {
+      const std::vector<optimizers::Parameter> & 
+         pars(m_componentList[icomp]->parameters());
+      for (size_t i(0); i < pars.size(); i++) {
+         if (pars.at(i).isFree() && tiedParIndex(icomp, i) < 0) {
+            npars++;
+         }
       }
-      j++;
    }
-   return -1;
+   return npars;
 }
 
 TiedParameter & Composite2::getTiedParam(const LogLike & like, size_t i) {
-   std::vector<TiedParameter *>::const_iterator tp(m_tiedPars.begin());
-   for (; tp != m_tiedPars.end(); ++tp) {
-      if ((*tp)->has_member(like, i)) {
-         return *(*tp);
+   std::map<const LogLike *, size_t>::const_iterator 
+      icomp(m_componentIndex.find(&like));
+   if (icomp != m_componentIndex.end()) {
+      int k(tiedParIndex(icomp->second, i));
+      if (k >= 0) {
+         return *m_tiedPars.at(k);
       }
    }
    throw std::runtime_error("Parameter not found.");
@@ -291,14 +307,7 @@ TiedParameter & Composite2::getTiedParam(const LogLike & like, size_t i) {
 
 void Composite2::
 setTiedParamValue(const LogLike & like, size_t i, double value) {
-   std::vector<TiedParameter *>::const_iterator tp(m_tiedPars.begin());
-   for (; tp != m_tiedPars.end(); ++tp) {
-      if ((*tp)->has_member(like, i)) {
-         (*tp)->setValue(value);
-         return;
-      }
-   }
-   throw std::runtime_error("Parameter not found.");
+   getTiedParam(like, i).setValue(value);
 }
   
 } // namespace Likleihood
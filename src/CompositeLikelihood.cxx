@@ -36,13 +36,20 @@ void CompositeLikelihood::addComponent(const std::string & srcName,
       }
    }
    m_components[&component] = srcName;
+   m_componentList.clear();
+   for (ComponentConstIterator_t it(m_components.begin());
+        it != m_components.end(); ++it) {
+      m_componentList.push_back(it->first);
+   }
+   m_evaluator.reset();
 }
 
 double CompositeLikelihood::value() const {
+   std::vector<double> values;
+   m_evaluator.values(m_componentList, values, false);
    double my_value(0);
-   ComponentConstIterator_t it(m_components.begin());
-   for ( ; it != m_components.end(); ++it) {
-      my_value += it->first->value();
+   for (size_t i(0); i < values.size(); i++) {
+      my_value += values[i];
    }
    return my_value;
 }
@@ -265,7 +272,13 @@ void CompositeLikelihood::getFreeDerivs(std::vector<double> & derivs) const {
       }
    }
 
-   for ( ; it != m_components.end(); ++it) {
+// Evaluate the components, concurrently after the first call.  Their
+// derivatives are gathered in the order of m_components, which is
+// that of m_componentList.
+   std::vector< std::vector<double> > componentDerivs;
+   m_evaluator.derivs(m_componentList, componentDerivs, false);
+
+   for (size_t icomp(0); it != m_components.end(); ++it, icomp++) {
       std::map<std::string, Source *>::const_iterator src 
          = it->first->sources().begin();
       for ( ; src != it->first->sources().end(); ++src) {
@@ -281,8 +294,7 @@ void CompositeLikelihood::getFreeDerivs(std::vector<double> & derivs) const {
             }
          }
       }
-      std::vector<double> my_derivs;
-      it->first->getFreeDerivs(my_derivs);
+      const std::vector<double> & my_derivs(componentDerivs.at(icomp));
       for (size_t i(0); i < my_derivs.size(); i++) {
          freeDerivs.push_back(my_derivs.at(i));
       }
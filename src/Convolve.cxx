@@ -267,5 +267,67 @@ Convolve::convolve2d(const std::vector< std::vector<float> > & signal,
    return my_result;
 }
 
+void Convolve::correlate2d(size_t nx, size_t ny,
+                           const std::vector<double> & signal,
+                           const std::vector<double> & kernel,
+                           std::vector<double> & output) {
+   if (signal.size() != nx*ny || kernel.size() != nx*ny) {
+      throw std::runtime_error("Convolve::correlate2d: signal and kernel "
+                               "sizes must be nx*ny.");
+   }
+// Zero-pad to twice the image size so that the shifts do not wrap.
+   size_t mx(2*nx);
+   size_t my(2*ny);
+   size_t npts(mx*my);
+   size_t ncomplex(my*(mx/2 + 1));
+
+   double * in = (double *) fftw_malloc(sizeof(double)*npts);
+   fftw_complex * sft = 
+      (fftw_complex *) fftw_malloc(sizeof(fftw_complex)*ncomplex);
+   fftw_complex * kft = 
+      (fftw_complex *) fftw_malloc(sizeof(fftw_complex)*ncomplex);
+   fftw_plan fplan = fftw_plan_dft_r2c_2d(my, mx, in, sft, FFTW_ESTIMATE);
+   fftw_plan bplan = fftw_plan_dft_c2r_2d(my, mx, sft, in, FFTW_ESTIMATE);
+
+   const std::vector<double> * images[] = {&signal, &kernel};
+   fftw_complex * transforms[] = {sft, kft};
+   for (size_t k = 0; k < 2; k++) {
+      for (size_t i = 0; i < npts; i++) {
+         in[i] = 0;
+      }
+      for (size_t j = 0; j < ny; j++) {
+         for (size_t i = 0; i < nx; i++) {
+            in[j*mx + i] = (*images[k])[j*nx + i];
+         }
+      }
+      fftw_execute_dft_r2c(fplan, in, transforms[k]);
+   }
+
+// Correlation theorem: multiply by the complex conjugate of the
+// kernel transform.
+   for (size_t i = 0; i < ncomplex; i++) {
+      double re = sft[i][0]*kft[i][0] + sft[i][1]*kft[i][1];
+      double im = sft[i][1]*kft[i][0] - sft[i][0]*kft[i][1];
+      sft[i][0] = re;
+      sft[i][1] = im;
+   }
+   fftw_execute(bplan);
+
+   size_t nxout(2*nx - 1);
+   output.resize(nxout*(2*ny - 1));
+   for (size_t jout = 0; jout < 2*ny - 1; jout++) {
+      size_t j = (jout + my - (ny - 1)) % my;
+      for (size_t iout = 0; iout < nxout; iout++) {
+         size_t i = (iout + mx - (nx - 1)) % mx;
+         output[jout*nxout + iout] = in[j*mx + i]/npts;
+      }
+   }
+
+   fftw_destroy_plan(fplan);
+   fftw_destroy_plan(bplan);
+   fftw_free(in);
+   fftw_free(sft);
+   fftw_free(kft);
+}
 
 } // namespace Likelihood
@@ -0,0 +1,149 @@
+/**
+ * @file DiffRespGrid.cxx
+ * @brief Grid of diffuse response values for interpolating the
+ * responses of individual events.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#include <cmath>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "arr.h"
+#include "pointing.h"
+
+#include "astro/SkyDir.h"
+
+#include "Likelihood/DiffRespGrid.h"
+#include "Likelihood/Event.h"
+
+namespace Likelihood {
+
+bool DiffRespGrid::NodeKey::operator<(const NodeKey & rhs) const {
+   if (type != rhs.type) {
+      return type < rhs.type;
+   }
+   if (ienergy != rhs.ienergy) {
+      return ienergy < rhs.ienergy;
+   }
+   if (icostheta != rhs.icostheta) {
+      return icostheta < rhs.icostheta;
+   }
+   return ipix < rhs.ipix;
+}
+
+DiffRespGrid::DiffRespGrid(int nside, int ebinsPerDecade, int ncostheta,
+                           double costhetaMin, double costhetaMax)
+   : m_healpix(nside, RING, SET_NSIDE), m_ebinsPerDecade(ebinsPerDecade),
+     m_ncostheta(ncostheta), m_costhetaMin(costhetaMin), m_costhetaStep(0) {
+   if (ebinsPerDecade < 1 || ncostheta < 2) {
+      throw std::runtime_error("DiffRespGrid: at least one energy per "
+                               "decade and two cos(inclination) values "
+                               "are required.");
+   }
+   if (costhetaMax <= costhetaMin) {
+      costhetaMax = costhetaMin + 1e-3;
+   }
+   m_costhetaStep = (costhetaMax - costhetaMin)/(ncostheta - 1);
+}
+
+double DiffRespGrid::costheta(const Event & event) {
+   return event.getDir().dir().dot(event.zAxis().dir());
+}
+
+void DiffRespGrid::addEvent(const Event & event) {
+   NodeKey keys[s_nstencil];
+   double weights[s_nstencil];
+   stencil(event, keys, weights);
+   for (size_t i(0); i < s_nstencil; i++) {
+      if (m_nodeIndices.find(keys[i]) == m_nodeIndices.end()) {
+         m_nodeIndices[keys[i]] = m_nodes.size();
+         m_nodes.push_back(keys[i]);
+      }
+   }
+}
+
+Event DiffRespGrid::nodeEvent(size_t inode, double time,
+                              const std::string & respName) const {
+   const NodeKey & key(m_nodes.at(inode));
+   pointing ptg(m_healpix.pix2ang(key.ipix));
+   double ra(ptg.phi*180./M_PI);
+   double dec(90. - ptg.theta*180./M_PI);
+   double energy(std::pow(10., static_cast<double>(key.ienergy)
+                          /m_ebinsPerDecade));
+   double mu(std::min(1., m_costhetaMin + key.icostheta*m_costhetaStep));
+   double sintheta(std::sqrt(std::max(0., 1. - mu*mu)));
+
+// Spacecraft z-axis at the node inclination from the apparent
+// direction, and an x-axis perpendicular to both.
+   CLHEP::Hep3Vector dir(astro::SkyDir(ra, dec).dir());
+   CLHEP::Hep3Vector perp(dir.orthogonal().unit());
+   astro::SkyDir zAxis(mu*dir + sintheta*perp);
+   astro::SkyDir xAxis(dir.cross(perp).unit());
+
+   bool useEdisp(false);
+   return Event(ra, dec, energy, time, zAxis, xAxis, 0, useEdisp,
+                respName, key.type);
+}
+
+void DiffRespGrid::interpolate(const Event & event,
+                               const std::vector<double> & nodeValues,
+                               size_t ncomps,
+                               std::vector<double> & values) const {
+   NodeKey keys[s_nstencil];
+   double weights[s_nstencil];
+   stencil(event, keys, weights);
+   values.assign(ncomps, 0);
+   for (size_t i(0); i < s_nstencil; i++) {
+      size_t inode(nodeIndex(keys[i]));
+      for (size_t k(0); k < ncomps; k++) {
+         values[k] += weights[i]*nodeValues[inode*ncomps + k];
+      }
+   }
+}
+
+void DiffRespGrid::stencil(const Event & event, NodeKey * keys,
+                           double * weights) const {
+   fix_arr<int, 4> pix;
+   fix_arr<double, 4> pixWts;
+   const astro::SkyDir & dir(event.getDir());
+   pointing ptg((90. - dir.dec())*M_PI/180., dir.ra()*M_PI/180.);
+   m_healpix.get_interpol(ptg, pix, pixWts);
+
+   double xx(std::log10(event.getEnergy())*m_ebinsPerDecade);
+   int ienergy(static_cast<int>(std::floor(xx)));
+   double eWts[2] = {ienergy + 1 - xx, xx - ienergy};
+
+   double yy((costheta(event) - m_costhetaMin)/m_costhetaStep);
+   int icostheta(static_cast<int>(std::floor(yy)));
+   icostheta = std::max(0, std::min(m_ncostheta - 2, icostheta));
+   yy = std::max(0., std::min(static_cast<double>(m_ncostheta - 1), yy));
+   double ctWts[2] = {icostheta + 1 - yy, yy - icostheta};
+
+   size_t indx(0);
+   for (int ie(0); ie < 2; ie++) {
+      for (int ict(0); ict < 2; ict++) {
+         for (size_t ip(0); ip < 4; ip++, indx++) {
+            keys[indx].type = event.getType();
+            keys[indx].ienergy = ienergy + ie;
+            keys[indx].icostheta = icostheta + ict;
+            keys[indx].ipix = pix[ip];
+            weights[indx] = eWts[ie]*ctWts[ict]*pixWts[ip];
+         }
+      }
+   }
+}
+
+size_t DiffRespGrid::nodeIndex(const NodeKey & key) const {
+   std::map<NodeKey, size_t>::const_iterator it(m_nodeIndices.find(key));
+   if (it == m_nodeIndices.end()) {
+      throw std::runtime_error("DiffRespGrid::interpolate: "
+                               "event was not added to the grid.");
+   }
+   return it->second;
+}
+
+} // namespace Likelihood
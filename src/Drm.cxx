@@ -171,20 +171,15 @@ void Drm::compute_transpose() {
 void Drm::compute_livetime() {
   // This it can be done once for the entire matrix
   const ExposureCube & expcube = m_observation->expCube();
-  const healpix::CosineBinner& cos_binner = expcube.get_cosine_binner(m_dir);
-  size_t nmu = cos_binner.size();
-  
-  m_costheta_vals.resize(nmu, 0);
+  ExposureCube::LivetimeHandle handle;
+  expcube.getLivetimeHandle(m_dir, handle);
+  m_costheta_vals = expcube.costhetaNodes();
+  m_livetime = handle.livetime();
+  size_t nmu = m_livetime.size();
+
   m_theta_vals.resize(nmu, 0);
-  m_livetime.resize(nmu, 0);
-
-  size_t j(0);
-  for ( std::vector<float>::const_iterator itrcos = cos_binner.begin(); 
-	itrcos != cos_binner.end_costh(); itrcos++, j++) {
-    double cos_theta = cos_binner.costheta(itrcos);
-    m_costheta_vals[j] = cos_theta;
-    m_theta_vals[j] = std::acos(cos_theta)*180./M_PI;
-    m_livetime[j] = *itrcos;
+  for ( size_t j(0); j < nmu; j++ ) {
+    m_theta_vals[j] = std::acos(m_costheta_vals[j])*180./M_PI;
   }
 
 }
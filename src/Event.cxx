@@ -22,6 +22,7 @@
 #include "Likelihood/DiffRespIntegrand2.h"
 #include "Likelihood/DiffuseSource.h"
 #include "Likelihood/Event.h"
+#include "Likelihood/EventColumns.h"
 #include "Likelihood/EquinoxRotation.h"
 #include "Likelihood/Exception.h"
 #include "Likelihood/MapBase.h"
@@ -31,6 +32,7 @@
 #include "Likelihood/SpatialFunction.h"
 #include "Likelihood/SkyDirArg.h"
 #include "Likelihood/Source.h"
+#include "Likelihood/ThreadPool.h"
 #include "Likelihood/TrapQuad.h"
 
 #include "LogNormalMuDist.h"
@@ -53,6 +55,9 @@ namespace {
          return acos(mu);
       }
    }
+/// Guards the lazy initialization of the source region arrays shared
+/// by all Events.
+   Likelihood::ThreadPool::Mutex s_srDataMutex;
 }
 
 namespace Likelihood {
@@ -65,9 +70,9 @@ bool Event::s_haveSourceRegionData(false);
 Event::Event() : m_appDir(0, 0), m_energy(0), m_arrTime(0), m_muZenith(0),
                  m_type(0), m_classLevel(0), m_scDir(0, 0), m_scXDir(0, 0),
                  m_useEdisp(false),
-                 m_respName(""), m_modelSum(0), m_fluxDensities(), m_estep(0),
-                 m_trueEnergies(), m_true_energies(), 
-                 m_efficiency(1), m_respDiffuseSrcs(), m_diffSrcNames() {}
+                 m_respName(""), m_modelSum(0), m_fluxDensities(),
+                 m_trueEnergies(), m_efficiency(1), m_respDiffuseSrcs(),
+                 m_diffSrcNames(), m_columns(0), m_index(0) {}
 
 Event::Event(double ra, double dec, double energy, double time, 
              const astro::SkyDir & scZAxis, const astro::SkyDir & scXAxis, 
@@ -77,8 +82,8 @@ Event::Event(double ra, double dec, double energy, double time,
      m_muZenith(muZenith), m_type(type), m_classLevel(0), 
      m_scDir(scZAxis), m_scXDir(scXAxis),
      m_useEdisp(useEdisp), m_respName(respName), m_modelSum(0),
-     m_fluxDensities(), m_estep(0), m_trueEnergies(), m_true_energies(),
-     m_efficiency(efficiency), m_respDiffuseSrcs(), m_diffSrcNames() {
+     m_fluxDensities(), m_trueEnergies(), m_efficiency(efficiency),
+     m_respDiffuseSrcs(), m_diffSrcNames(), m_columns(0), m_index(0) {
    if (m_useEdisp) {
       throw std::runtime_error("Attempt to use energy dispersion "
                                "handling in unbinned analysis.");
@@ -101,6 +106,77 @@ Event::Event(double ra, double dec, double energy, double time,
    }
 }
 
+Event::Event(const Event & other) 
+   : m_appDir(other.m_appDir), m_energy(other.m_energy),
+     m_arrTime(other.m_arrTime), m_muZenith(other.m_muZenith),
+     m_type(other.m_type), m_classLevel(other.m_classLevel),
+     m_scDir(other.m_scDir), m_scXDir(other.m_scXDir),
+     m_useEdisp(other.m_useEdisp), m_respName(other.m_respName),
+     m_modelSum(other.m_modelSum), m_fluxDensities(other.m_fluxDensities),
+     m_trueEnergies(other.m_trueEnergies), m_efficiency(other.m_efficiency),
+     m_respDiffuseSrcs(other.m_respDiffuseSrcs),
+     m_diffSrcNames(other.m_diffSrcNames), m_columns(0),
+     m_index(other.m_index) {
+   other.copyColumnResponses(m_respDiffuseSrcs);
+}
+
+Event & Event::operator=(const Event & rhs) {
+   if (this != &rhs) {
+      m_appDir = rhs.m_appDir;
+      m_energy = rhs.m_energy;
+      m_arrTime = rhs.m_arrTime;
+      m_muZenith = rhs.m_muZenith;
+      m_type = rhs.m_type;
+      m_classLevel = rhs.m_classLevel;
+      m_scDir = rhs.m_scDir;
+      m_scXDir = rhs.m_scXDir;
+      m_useEdisp = rhs.m_useEdisp;
+      m_respName = rhs.m_respName;
+      m_modelSum = rhs.m_modelSum;
+      m_fluxDensities = rhs.m_fluxDensities;
+      m_trueEnergies = rhs.m_trueEnergies;
+      m_efficiency = rhs.m_efficiency;
+      m_respDiffuseSrcs = rhs.m_respDiffuseSrcs;
+      m_diffSrcNames = rhs.m_diffSrcNames;
+      m_columns = 0;
+      m_index = rhs.m_index;
+      rhs.copyColumnResponses(m_respDiffuseSrcs);
+   }
+   return *this;
+}
+
+void Event::attach(EventColumns * columns, size_t index) {
+   m_columns = columns;
+   m_index = index;
+   if (m_columns == 0) {
+      return;
+   }
+   std::map<std::string, diffuse_response>::const_iterator 
+      it(m_respDiffuseSrcs.begin());
+   for ( ; it != m_respDiffuseSrcs.end(); ++it) {
+      if (!it->second.empty()) {
+         m_columns->setDiffuseResponse(m_index, it->first, it->second[0]);
+      }
+   }
+   m_respDiffuseSrcs.clear();
+}
+
+void Event::copyColumnResponses(std::map<std::string, diffuse_response> 
+                                & responses) const {
+   if (m_columns == 0) {
+      return;
+   }
+   const std::vector<std::string> & 
+      components(m_columns->diffuseComponents());
+   for (size_t i(0); i < components.size(); i++) {
+      if (m_columns->hasDiffuseResponse(m_index, components[i])) {
+         responses[components[i]] = 
+            diffuse_response(1, m_columns->diffuseResponse(m_index,
+                                                           components[i]));
+      }
+   }
+}
+
 double Event::diffuseResponse(double trueEnergy, 
                               const std::string& srcName) const {
    const std::string & diffuseComponent(diffuseSrcName(srcName));
@@ -113,6 +189,9 @@ double Event::diffuseResponse(double trueEnergy,
       //    return 0;
       // }
    }
+   if (m_columns) {
+      return m_columns->diffuseResponse(m_index, diffuseComponent);
+   }
    std::map<std::string, diffuse_response>::const_iterator it;
    if ((it = m_respDiffuseSrcs.find(diffuseComponent))
        != m_respDiffuseSrcs.end()) {
@@ -141,6 +220,12 @@ double Event::diffuseResponse(double trueEnergy,
 const std::vector<double> & 
 Event::diffuseResponse(const std::string& srcName) const {
    const std::string & diffuseComponent(diffuseSrcName(srcName));
+   if (m_columns) {
+      double value(m_columns->diffuseResponse(m_index, diffuseComponent));
+      diffuse_response & resp(m_respDiffuseSrcs[diffuseComponent]);
+      resp.assign(1, value);
+      return resp;
+   }
    std::map<std::string, diffuse_response>::const_iterator it;
    if ((it = m_respDiffuseSrcs.find(diffuseComponent))
        == m_respDiffuseSrcs.end()) {
@@ -161,10 +246,23 @@ void Event::computeResponseGQ(std::vector<DiffuseSource *> & srcList,
    if (srcs.size() == 0) {
       return;
    }
+   std::vector<double> respValues(srcs.size(), 0);
+   if (!useDummyValue) {
+      diffuseResponsesGQ(srcs, respFuncs, respValues);
+   }
+   for (size_t i(0); i < srcs.size(); i++) {
+      addDiffuseResponse(diffuseSrcName(srcs.at(i)->getName()),
+                         respValues.at(i));
+   }
+}
+
+void Event::diffuseResponsesGQ(const std::vector<DiffuseSource *> & srcs,
+                               const ResponseFunctions & respFuncs,
+                               std::vector<double> & respValues) const {
+   respValues.resize(srcs.size());
    double minusone(-1);
    double one(1);
    double mumin(minusone);
-   double mumid(0.0);
    double mumax(one);
    double theta(getDir().difference(zAxis())*180./M_PI);
 
@@ -183,48 +281,43 @@ void Event::computeResponseGQ(std::vector<DiffuseSource *> & srcList,
 
    EquinoxRotation eqRot(getDir().ra(), getDir().dec());
    for (size_t i(0); i < srcs.size(); i++) {     
-      const std::string& name(diffuseSrcName(srcs.at(i)->getName()));
       bool haveSpatialFunction = dynamic_cast<const SpatialFunction *>(srcs.at(i)->spatialDist()) != 0;
-      if (useDummyValue) {
-         m_respDiffuseSrcs[name].push_back(0);
-      } else {
-         double respValue(0);
-         mumin = minusone;
-         mumax = one;
-         double phimin(0);
-         double phimax(2.*M_PI);
-         try {
-            srcs.at(i)->mapBaseObject()->getDiffRespLimits(getDir(), 
-                                                           mumin, mumax,
-                                                           phimin, phimax);
-         } catch (MapBaseException &) {
-            // do nothing
-         }
+      double respValue(0);
+      mumin = minusone;
+      mumax = one;
+      double phimin(0);
+      double phimax(2.*M_PI);
+      try {
+         srcs.at(i)->mapBaseObject()->getDiffRespLimits(getDir(), 
+                                                        mumin, mumax,
+                                                        phimin, phimax);
+      } catch (MapBaseException &) {
+         // do nothing
+      }
 
-	 mumin = std::max(mumin,mu_psfmax);
-
-	 if (haveSpatialFunction) {
-	    const SpatialFunction* fn = dynamic_cast<const SpatialFunction *>(srcs.at(i)->spatialDist());
-	    respValue = fn->diffuseResponse(*this,respFuncs);	
-	 } else if (srcs.at(i)->mapBasedIntegral() || 
-		    (::getenv("MAP_BASED_DIFFRSP") && (mumin != minusone || mumax != one))) {
-	    respValue = srcs.at(i)->diffuseResponse(*this);
-	 } else if (mumin > mu_psf2s) {
-	    respValue = 
-	      DiffRespIntegrand2::
-	      do2DIntegration(*this, respFuncs, *srcs.at(i), eqRot,
-			      mumin, mumax, phimin, phimax, 0.001, 0.01);
-	 } else {
-	    respValue = 
-	      DiffRespIntegrand2::
-	      do2DIntegration(*this, respFuncs, *srcs.at(i), eqRot,
-			      mu_psf2s, mumax, phimin, phimax, 0.001, 0.01) +
-	      DiffRespIntegrand2::
-	      do2DIntegration(*this, respFuncs, *srcs.at(i), eqRot,
-			      mumin, mu_psf2s, phimin, phimax, 0.001, 0.01);
-	 }
-         m_respDiffuseSrcs[name].push_back(respValue);
+      mumin = std::max(mumin,mu_psfmax);
+
+      if (haveSpatialFunction) {
+         const SpatialFunction* fn = dynamic_cast<const SpatialFunction *>(srcs.at(i)->spatialDist());
+         respValue = fn->diffuseResponse(*this,respFuncs);	
+      } else if (srcs.at(i)->mapBasedIntegral() || 
+                 (::getenv("MAP_BASED_DIFFRSP") && (mumin != minusone || mumax != one))) {
+         respValue = srcs.at(i)->diffuseResponse(*this);
+      } else if (mumin > mu_psf2s) {
+         respValue = 
+            DiffRespIntegrand2::
+            do2DIntegration(*this, respFuncs, *srcs.at(i), eqRot,
+                            mumin, mumax, phimin, phimax, 0.001, 0.01);
+      } else {
+         respValue = 
+            DiffRespIntegrand2::
+            do2DIntegration(*this, respFuncs, *srcs.at(i), eqRot,
+                            mu_psf2s, mumax, phimin, phimax, 0.001, 0.01) +
+            DiffRespIntegrand2::
+            do2DIntegration(*this, respFuncs, *srcs.at(i), eqRot,
+                            mumin, mu_psf2s, phimin, phimax, 0.001, 0.01);
       }
+      respValues[i] = respValue;
    }
 }
 
@@ -239,8 +332,11 @@ void Event::computeResponse(std::vector<DiffuseSource *> &srcList,
    double ra0(m_appDir.ra());
    double dec0(m_appDir.dec());
    EquinoxRotation eqRot(ra0, dec0);
-   if (!s_haveSourceRegionData) {
-      prepareSrData(sr_radius, sr_radius2);
+   {
+      Likelihood::ThreadPool::Lock lock(s_srDataMutex);
+      if (!s_haveSourceRegionData) {
+         prepareSrData(sr_radius, sr_radius2);
+      }
    }
 
    const std::vector<double> & muArray =
@@ -307,7 +403,7 @@ void Event::computeResponse(std::vector<DiffuseSource *> &srcList,
             throw std::runtime_error("Negative diffuse response value computed"
                                      " in Likelihood::Event::computeResponse");
          }
-         m_respDiffuseSrcs[name].push_back(muQuad.integral());
+         addDiffuseResponse(name, respValue);
       }
    } // loop over trueEnergy
 // // Compute the Gaussian params to check validity of response.
@@ -344,6 +440,19 @@ void Event::computeGaussianParams(const std::string & name,
 
 void Event::writeDiffuseResponses(const std::string & filename) {
    std::ofstream outfile(filename.c_str());
+   if (m_columns) {
+      const std::vector<std::string> & 
+         components(m_columns->diffuseComponents());
+      for (size_t i(0); i < components.size(); i++) {
+         if (m_columns->hasDiffuseResponse(m_index, components[i])) {
+            outfile << m_trueEnergies[0] << "  "
+                    << m_columns->diffuseResponse(m_index, components[i])
+                    << std::endl;
+         }
+      }
+      outfile.close();
+      return;
+   }
    std::map<std::string, diffuse_response>::iterator it
       = m_respDiffuseSrcs.begin();
    for ( ; it != m_respDiffuseSrcs.end(); ++it) {
@@ -440,7 +549,7 @@ void Event::getNewDiffuseSrcs(const std::vector<DiffuseSource *> & srcList,
    for (std::vector<DiffuseSource *>::const_iterator it = srcList.begin();
         it != srcList.end(); ++it) {
       const std::string & name(diffuseSrcName((*it)->getName()));
-      if (!m_respDiffuseSrcs.count(name)) {
+      if (!haveDiffuseResponse(name)) {
          srcs.push_back(*it);
       }
    }
@@ -486,6 +595,33 @@ void Event::resetModelSum() {
    m_fluxDensities.clear();
 }
 
+void Event::setDiffuseResponse(const std::string & componentName,
+                               double value) {
+   if (m_columns) {
+      m_columns->setDiffuseResponse(m_index, componentName, value);
+      return;
+   }
+   m_respDiffuseSrcs[componentName].clear();
+   m_respDiffuseSrcs[componentName].push_back(value);
+}
+
+bool Event::haveDiffuseResponse(const std::string & diffuseComponent) const {
+   if (m_columns) {
+      return m_columns->hasDiffuseResponse(m_index, diffuseComponent);
+   }
+   return m_respDiffuseSrcs.count(diffuseComponent) > 0;
+}
+
+void Event::addDiffuseResponse(const std::string & diffuseComponent,
+                               double value) {
+   if (m_columns) {
+// Only a single true energy is supported for column storage.
+      m_columns->setDiffuseResponse(m_index, diffuseComponent, value);
+      return;
+   }
+   m_respDiffuseSrcs[diffuseComponent].push_back(value);
+}
+
 void Event::setDiffuseResponse(const std::string& srcName,
                                const std::vector<double> & gaussianParams) {
    const std::string & diffuseComponent(diffuseSrcName(srcName));
@@ -0,0 +1,85 @@
+/**
+ * @file EventColumns.cxx
+ * @brief Column-wise storage of event data.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#include <algorithm>
+
+#include "Likelihood/EventColumns.h"
+#include "Likelihood/Exception.h"
+
+namespace Likelihood {
+
+size_t EventColumns::append() {
+   for (size_t i(0); i < m_diffuseResps.size(); i++) {
+      m_diffuseResps[i].push_back(0);
+      m_haveDiffuseResps[i].push_back(false);
+   }
+   return m_nevents++;
+}
+
+void EventColumns::clear() {
+   m_nevents = 0;
+   m_components.clear();
+   m_componentIndices.clear();
+   m_diffuseResps.clear();
+   m_haveDiffuseResps.clear();
+}
+
+void EventColumns::reserve(size_t nevents) {
+   for (size_t i(0); i < m_diffuseResps.size(); i++) {
+      m_diffuseResps[i].reserve(nevents);
+      m_haveDiffuseResps[i].reserve(nevents);
+   }
+}
+
+int EventColumns::componentIndex(const std::string & component) const {
+   std::map<std::string, size_t>::const_iterator it
+      = m_componentIndices.find(component);
+   if (it == m_componentIndices.end()) {
+      return -1;
+   }
+   return static_cast<int>(it->second);
+}
+
+void EventColumns::setDiffuseResponse(size_t ievent,
+                                      const std::string & component,
+                                      double value) {
+   int icomp(componentIndex(component));
+   if (icomp < 0) {
+      icomp = m_components.size();
+      m_components.push_back(component);
+      m_componentIndices[component] = icomp;
+      m_diffuseResps.push_back(std::vector<double>(size(), 0));
+      m_haveDiffuseResps.push_back(std::vector<bool>(size(), false));
+   }
+   m_diffuseResps[icomp].at(ievent) = value;
+   m_haveDiffuseResps[icomp].at(ievent) = true;
+}
+
+bool EventColumns::hasDiffuseResponse(size_t ievent,
+                                      const std::string & component) const {
+   int icomp(componentIndex(component));
+   return icomp >= 0 && m_haveDiffuseResps[icomp].at(ievent);
+}
+
+double EventColumns::diffuseResponse(size_t ievent,
+                                     const std::string & component) const {
+   int icomp(componentIndex(component));
+   if (icomp < 0 || !m_haveDiffuseResps[icomp].at(ievent)) {
+      throw Exception("EventColumns::diffuseResponse: \nDiffuse component "
+                      + component
+                      + " does not have an associated diffuse response.\n");
+   }
+   return m_diffuseResps[icomp][ievent];
+}
+
+bool EventColumns::haveAllDiffuseResponses(size_t icomp) const {
+   const std::vector<bool> & have(m_haveDiffuseResps.at(icomp));
+   return std::find(have.begin(), have.end(), false) == have.end();
+}
+
+} // namespace Likelihood
@@ -9,6 +9,10 @@
 #include <cmath>
 
 #include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "fitsio.h"
 
 #include "facilities/Util.h"
 
@@ -28,15 +32,238 @@
 #include "Likelihood/ResponseFunctions.h"
 #include "Likelihood/RoiCuts.h"
 #include "Likelihood/ScData.h"
+#include "Likelihood/ThreadPool.h"
+
+namespace {
+// Number of rows of an event table read at a time.
+   const LONGLONG s_chunkSize(65536);
+
+   void fitsReportError(int status, const std::string & routine) {
+      if (status == 0) {
+         return;
+      }
+      fits_report_error(stderr, status);
+      throw std::runtime_error(routine + ": cfitsio error.");
+   }
+
+/// Column number of colname, or zero if the column is absent and not
+/// required.
+   int columnNumber(fitsfile * fptr, const std::string & colname,
+                    bool required=true) {
+      int status(0);
+      int colnum(0);
+      fits_get_colnum(fptr, CASEINSEN, const_cast<char *>(colname.c_str()),
+                      &colnum, &status);
+      if (status == COL_NOT_FOUND && !required) {
+         fits_clear_errmsg();
+         return 0;
+      }
+      fitsReportError(status, "EventContainer::getEvents: column " + colname);
+      return colnum;
+   }
+
+   template <typename T>
+   void readColumn(fitsfile * fptr, int datatype, int colnum,
+                   LONGLONG first, LONGLONG nrows, std::vector<T> & values) {
+      values.resize(nrows);
+      int status(0);
+      fits_read_col(fptr, datatype, colnum, first + 1, 1, nrows, 0,
+                    &values[0], 0, &status);
+      fitsReportError(status, "EventContainer::getEvents");
+   }
+
+/// Read a bit-array column as unsigned integers, with the first bit
+/// as the most significant, or an integer column as it is.
+   void readFlags(fitsfile * fptr, int colnum, LONGLONG first,
+                  LONGLONG nrows, std::vector<unsigned long> & values) {
+      int status(0);
+      int typecode(0);
+      long repeat(0);
+      long width(0);
+      fits_get_coltype(fptr, colnum, &typecode, &repeat, &width, &status);
+      fitsReportError(status, "EventContainer::getEvents");
+      if (typecode != TBIT) {
+         readColumn(fptr, TULONG, colnum, first, nrows, values);
+         return;
+      }
+      std::vector<unsigned int> bits(nrows);
+      int nbits(std::min(repeat, 32L));
+      fits_read_col_bit_uint(fptr, colnum, first + 1, nrows, 1, nbits,
+                             &bits[0], &status);
+      fitsReportError(status, "EventContainer::getEvents");
+      values.assign(bits.begin(), bits.end());
+   }
+
+   class EnergyOrder {
+   public:
+      EnergyOrder(const std::vector<double> & energies) 
+         : m_energies(energies) {}
+      bool operator()(size_t i, size_t j) const {
+         return m_energies[i] < m_energies[j];
+      }
+   private:
+      const std::vector<double> & m_energies;
+   };
+}
 
 namespace Likelihood {
 
 std::vector<std::string> EventContainer::s_FT1_columns;
 
+struct EventContainer::FT1File {
+   std::string name;
+   unsigned int event_type_mask;
+   bool evclass_bitarray;
+
+   /// Names under which the diffuse responses are stored, and the
+   /// corresponding FT1 columns.
+   std::vector<std::string> diffuseNames;
+   std::vector<std::string> diffuseColumns;
+
+   /// Quantities for the accepted rows.
+   unsigned long nTotal;
+   bool haveEventType;
+   std::vector<double> ra;
+   std::vector<double> dec;
+   std::vector<double> energy;
+   std::vector<double> time;
+   std::vector<double> muZenith;
+   std::vector<int> conversionType;
+   std::vector<unsigned long> eventClass;
+   std::vector<unsigned long> eventType;
+   /// Diffuse responses, [row][component]
+   std::vector<double> diffuseResponses;
+
+   FT1File() : event_type_mask(3), evclass_bitarray(true), nTotal(0),
+               haveEventType(false) {}
+
+   /// Read the event table a chunk at a time, keeping the rows that
+   /// pass roiCuts (or all of them if roiCuts is zero).
+   void read(const RoiCuts * roiCuts);
+
+   void clear() {
+      std::vector<double>().swap(ra);
+      std::vector<double>().swap(dec);
+      std::vector<double>().swap(energy);
+      std::vector<double>().swap(time);
+      std::vector<double>().swap(muZenith);
+      std::vector<int>().swap(conversionType);
+      std::vector<unsigned long>().swap(eventClass);
+      std::vector<unsigned long>().swap(eventType);
+      std::vector<double>().swap(diffuseResponses);
+   }
+};
+
+void EventContainer::FT1File::read(const RoiCuts * roiCuts) {
+   const std::string routine("EventContainer::getEvents");
+   int status(0);
+   fitsfile * fptr(0);
+   std::string extfilename(name + "[EVENTS]");
+   fits_open_file(&fptr, extfilename.c_str(), READONLY, &status);
+   fitsReportError(status, routine);
+   LONGLONG nrows(0);
+   fits_get_num_rowsll(fptr, &nrows, &status);
+   fitsReportError(status, routine);
+   nTotal = nrows;
+
+   int raCol(columnNumber(fptr, "RA"));
+   int decCol(columnNumber(fptr, "DEC"));
+   int energyCol(columnNumber(fptr, "ENERGY"));
+   int timeCol(columnNumber(fptr, "TIME"));
+   int zenithCol(columnNumber(fptr, "ZENITH_ANGLE"));
+   int convTypeCol(columnNumber(fptr, "CONVERSION_TYPE"));
+   int evclassCol(columnNumber(fptr, "EVENT_CLASS"));
+   bool required;
+   int evtypeCol(columnNumber(fptr, "EVENT_TYPE", required=false));
+   haveEventType = (evtypeCol != 0);
+   std::vector<int> diffuseCols;
+   for (size_t k(0); k < diffuseColumns.size(); k++) {
+      diffuseCols.push_back(columnNumber(fptr, diffuseColumns[k]));
+   }
+   size_t ndiffuse(diffuseCols.size());
+
+   std::vector<double> my_ra, my_dec, my_energy, my_time, zenAngle;
+   std::vector<int> my_convType;
+   std::vector<unsigned long> my_evclass, my_evtype;
+   std::vector< std::vector<double> > my_diffRsps(ndiffuse);
+   std::vector<size_t> rows;
+   for (LONGLONG first(0); first < nrows; first += s_chunkSize) {
+      LONGLONG nchunk(std::min(nrows - first, s_chunkSize));
+      readColumn(fptr, TDOUBLE, raCol, first, nchunk, my_ra);
+      readColumn(fptr, TDOUBLE, decCol, first, nchunk, my_dec);
+      readColumn(fptr, TDOUBLE, energyCol, first, nchunk, my_energy);
+      readColumn(fptr, TDOUBLE, timeCol, first, nchunk, my_time);
+      readColumn(fptr, TDOUBLE, zenithCol, first, nchunk, zenAngle);
+      rows.clear();
+      for (LONGLONG r(0); r < nchunk; r++) {
+         zenAngle[r] = std::cos(zenAngle[r]*M_PI/180.);
+         if (!roiCuts || roiCuts->accept(my_ra[r], my_dec[r], my_energy[r],
+                                         my_time[r], zenAngle[r])) {
+            rows.push_back(r);
+         }
+      }
+      if (rows.empty()) {
+         continue;
+      }
+// The remaining columns are only needed for chunks with accepted rows.
+      readColumn(fptr, TINT, convTypeCol, first, nchunk, my_convType);
+      if (evclass_bitarray) {
+         readFlags(fptr, evclassCol, first, nchunk, my_evclass);
+      } else {
+         readColumn(fptr, TULONG, evclassCol, first, nchunk, my_evclass);
+      }
+      if (haveEventType) {
+         readFlags(fptr, evtypeCol, first, nchunk, my_evtype);
+      }
+      for (size_t k(0); k < ndiffuse; k++) {
+         readColumn(fptr, TDOUBLE, diffuseCols[k], first, nchunk,
+                    my_diffRsps[k]);
+      }
+      for (size_t i(0); i < rows.size(); i++) {
+         size_t r(rows[i]);
+         ra.push_back(my_ra[r]);
+         dec.push_back(my_dec[r]);
+         energy.push_back(my_energy[r]);
+         time.push_back(my_time[r]);
+         muZenith.push_back(zenAngle[r]);
+         conversionType.push_back(my_convType[r]);
+         eventClass.push_back(my_evclass[r]);
+         if (haveEventType) {
+            eventType.push_back(my_evtype[r]);
+         }
+         for (size_t k(0); k < ndiffuse; k++) {
+            diffuseResponses.push_back(my_diffRsps[k][r]);
+         }
+      }
+   }
+   fits_close_file(fptr, &status);
+   fitsReportError(status, routine);
+}
+
+/**
+ * @class EventContainer::ReadTask
+ * @brief Reads the accepted rows of one FT1 file.  Only the FT1File
+ * of the work item is modified.
+ */
+class EventContainer::ReadTask : public ThreadPool::Task {
+public:
+   ReadTask(std::vector<FT1File> & files, const RoiCuts * roiCuts)
+      : m_files(files), m_roiCuts(roiCuts) {}
+
+   virtual void run(size_t item, size_t) {
+      m_files[item].read(m_roiCuts);
+   }
+
+private:
+   std::vector<FT1File> & m_files;
+   const RoiCuts * m_roiCuts;
+};
+
 EventContainer::EventContainer(const ResponseFunctions & respFuncs, 
                                const RoiCuts & roiCuts, const ScData & scData) 
    : m_respFuncs(respFuncs), m_roiCuts(roiCuts), m_scData(scData),
-     m_formatter(new st_stream::StreamFormatter("EventContainer", "", 2)) {
+     m_formatter(new st_stream::StreamFormatter("EventContainer", "", 2)),
+     m_columns(new EventColumns()) {
    if (s_FT1_columns.size() == 0) {
       setFT1_columns();
    }
@@ -44,22 +271,58 @@ EventContainer::EventContainer(const ResponseFunctions & respFuncs,
 
 EventContainer::~EventContainer() {
    delete m_formatter;
+   delete m_columns;
 }
 
 void EventContainer::getEvents(std::string event_file, 
                                bool apply_roi_cut,
                                unsigned int event_type_mask) {
+   getEvents(std::vector<std::string>(1, event_file), apply_roi_cut,
+             event_type_mask);
+}
+
+void EventContainer::getEvents(const std::vector<std::string> & event_files,
+                               bool apply_roi_cut,
+                               unsigned int event_type_mask,
+                               size_t nthreads) {
+   std::vector<FT1File> files(event_files.size());
+   for (size_t i(0); i < files.size(); i++) {
+      files[i].name = event_files[i];
+      facilities::Util::expandEnvVar(&files[i].name);
+      readFileInfo(files[i], event_type_mask);
+   }
 
-   facilities::Util::expandEnvVar(&event_file);
+   ReadTask task(files, apply_roi_cut ? &m_roiCuts : 0);
+   nthreads = std::min(nthreads, files.size());
+   if (nthreads > 1 && fits_is_reentrant()) {
+      ThreadPool pool(nthreads);
+      pool.run(task, files.size());
+   } else {
+      for (size_t i(0); i < files.size(); i++) {
+         task.run(i, 0);
+      }
+   }
 
-   unsigned int nTotal(0);
-   unsigned int nReject(0);
+   size_t nAccepted(m_events.size());
+   for (size_t i(0); i < files.size(); i++) {
+      nAccepted += files[i].energy.size();
+   }
+   reserve(nAccepted);
 
-   facilities::Util::expandEnvVar(&event_file);
+   for (size_t i(0); i < files.size(); i++) {
+      storeEvents(files[i]);
+      files[i].clear();
+   }
+
+   sortByEnergy();
+}
+
+void EventContainer::readFileInfo(FT1File & file,
+                                  unsigned int event_type_mask) const {
    tip::Table * events = 
-      tip::IFileSvc::instance().editTable(event_file, "events");
+      tip::IFileSvc::instance().editTable(file.name, "events");
 
-   dataSubselector::Cuts cuts(event_file, "EVENTS");
+   dataSubselector::Cuts cuts(file.name, "EVENTS");
    std::vector<dataSubselector::BitMaskCut *> bit_mask_cuts(cuts.bitMaskCuts());
    for (size_t i(0); i < bit_mask_cuts.size(); i++) {
       if (bit_mask_cuts[i]->colname() == "EVENT_TYPE") {
@@ -67,6 +330,7 @@ void EventContainer::getEvents(std::string event_file,
       }
       delete bit_mask_cuts[i];
    }
+   file.event_type_mask = event_type_mask;
 
    tip::Header & header(events->getHeader());
    std::string pass_ver;
@@ -76,61 +340,65 @@ void EventContainer::getEvents(std::string event_file,
       // keyword missing so use default value
       pass_ver = "NONE";
    }
-   bool evclass_bitarray(true);
+   file.evclass_bitarray = true;
    if (pass_ver == "NONE" || pass_ver.substr(0, 2) == "P7") {
-      evclass_bitarray = false;
+      file.evclass_bitarray = false;
    }
 
-   double ra;
-   double dec;
-   double energy;
-   double time;
-   double zenAngle;
-   unsigned long eventClass;
-   int conversionType;
-   unsigned long eventType;
-
-   double respValue;
-
-   tip::Table::Iterator it = events->begin();
-   tip::Table::Record & event = *it;
-
-   std::vector<std::string> diffuseNames;
    DiffRespNames diffRespNames;
    bool haveOldDiffRespCols(false);
    try {
       int ndifrsp;
       header["NDIFRSP"].get(ndifrsp);
       get_diffuse_names(events, diffRespNames);
-      diffuseNames = diffRespNames.colnames();
+      file.diffuseNames = diffRespNames.colnames();
    } catch(tip::TipException) {
 // Use old diffuse response column names.
-      get_diffuse_names(events, diffuseNames);
+      get_diffuse_names(events, file.diffuseNames);
       haveOldDiffRespCols = true;
    }
-
-   for ( ; it != events->end(); ++it, nTotal++) {
-      event["ra"].get(ra);
-      event["dec"].get(dec);
-      event["energy"].get(energy);
-      event["time"].get(time);
-      event["zenith_angle"].get(zenAngle);
-      event["conversion_type"].get(conversionType);
-      if (evclass_bitarray) {
-         tip::BitStruct event_class;
-         event["event_class"].get(event_class);
-         eventClass = event_class;
+   file.diffuseColumns.clear();
+   for (size_t k(0); k < file.diffuseNames.size(); k++) {
+      if (haveOldDiffRespCols) {
+         file.diffuseColumns.push_back(file.diffuseNames[k]);
       } else {
-         event["event_class"].get(eventClass);
+         file.diffuseColumns.push_back(diffRespNames.key(file.diffuseNames[k]));
       }
-      try {
-         tip::BitStruct event_type;
-         event["event_type"].get(event_type);
-         eventType = event_type;
-         eventType = static_cast<int>(std::log(eventType & event_type_mask)
+   }
+
+   delete events;
+}
+
+void EventContainer::reserve(size_t nevents) {
+   size_t nOld(m_events.size());
+   const Event * oldEvents(nOld > 0 ? &m_events[0] : 0);
+   m_events.reserve(nevents);
+// The copies made by a reallocation are detached from the columns.
+   if (nOld > 0 && &m_events[0] != oldEvents) {
+      for (size_t i(0); i < nOld; i++) {
+         m_events[i].attach(m_columns, m_events[i].index());
+      }
+   }
+}
+
+void EventContainer::storeEvents(const FT1File & file) {
+   size_t nAccepted(file.energy.size());
+   size_t ndiffuse(file.diffuseNames.size());
+   if (nAccepted > 0 && ndiffuse > 0 && m_respFuncs.useEdisp()) {
+      throw std::runtime_error("Attempt to use energy dispersion "
+                               "handling in unbinned analysis.");
+   }
+   reserve(m_events.size() + nAccepted);
+   m_columns->reserve(m_columns->size() + nAccepted);
+
+   for (size_t j(0); j < nAccepted; j++) {
+      double energy(file.energy[j]);
+      double time(file.time[j]);
+      int eventType(file.conversionType[j]);
+      if (file.haveEventType) {
+         eventType = static_cast<int>(std::log(file.eventType[j] 
+                                               & file.event_type_mask)
                                       /std::log(2));
-      } catch(tip::TipException &) {
-         eventType = conversionType;
       }
       const irfInterface::IEfficiencyFactor * eff_factor =
          m_respFuncs.respPtr(eventType)->efficiencyFactor();
@@ -144,53 +412,54 @@ void EventContainer::getEvents(std::string event_file,
                                      "efficiency < 0");
          }
       }
-      Event thisEvent(ra, dec, energy, time, m_scData.zAxis(time),
-                      m_scData.xAxis(time), cos(zenAngle*M_PI/180.), 
-                      m_respFuncs.useEdisp(), m_respFuncs.respName(),
-                      eventType, efficiency);
-      thisEvent.set_classLevel(eventClass);
-      if (!apply_roi_cut || m_roiCuts.accept(thisEvent)) {
-         m_events.push_back(thisEvent);
-         for (std::vector<std::string>::iterator name = diffuseNames.begin();
-              name != diffuseNames.end(); ++name) {
-            std::string srcName = sourceName(*name);
-            std::vector<double> gaussianParams;
-            if (m_respFuncs.useEdisp()) {
-               throw std::runtime_error("Attempt to use energy dispersion "
-                                        "handling in unbinned analysis.");
-               // try {
-               //    event[*name].get(gaussianParams);
-               //    m_events.back().setDiffuseResponse(srcName, gaussianParams);
-               // } catch (tip::TipException & eObj) {
-               //    std::string message(eObj.what());
-               //    if (message.find("FitsColumn::getVector") ==
-               //        std::string::npos) {
-               //       throw;
-               //    }
-               // }
-            } else {
-               std::string colname;
-               if (haveOldDiffRespCols) {
-                  colname = *name;
-               } else {
-                  colname = diffRespNames.key(*name);
-               }
-               event[colname].get(respValue);
-               m_events.back().setDiffuseResponse(*name, respValue);
-            }
-         }
-      } else {
-         nReject++;
+      Event thisEvent(file.ra[j], file.dec[j], energy, time,
+                      m_scData.zAxis(time), m_scData.xAxis(time),
+                      file.muZenith[j], m_respFuncs.useEdisp(),
+                      m_respFuncs.respName(), eventType, efficiency);
+      thisEvent.set_classLevel(file.eventClass[j]);
+      m_events.push_back(thisEvent);
+      m_events.back().attach(m_columns, m_columns->append());
+      for (size_t k(0); k < ndiffuse; k++) {
+         m_events.back().setDiffuseResponse(file.diffuseNames[k],
+                                            file.diffuseResponses[j*ndiffuse
+                                                                  + k]);
       }
    }
 
    m_formatter->info(3) << "EventContainer::getEvents:\nOut of " 
-                        << nTotal << " events in file "
-                        << event_file << ",\n "
-                        << nTotal - nReject << " were accepted, and "
-                        << nReject << " were rejected.\n" << std::endl;
+                        << file.nTotal << " events in file "
+                        << file.name << ",\n "
+                        << nAccepted << " were accepted, and "
+                        << file.nTotal - nAccepted << " were rejected.\n" 
+                        << std::endl;
+}
 
-   delete events;
+void EventContainer::sortByEnergy() {
+   std::vector<double> energies(m_events.size());
+   for (size_t j(0); j < m_events.size(); j++) {
+      energies[j] = m_events[j].getEnergy();
+   }
+   m_energyOrder.resize(energies.size());
+   for (size_t j(0); j < energies.size(); j++) {
+      m_energyOrder[j] = j;
+   }
+   std::stable_sort(m_energyOrder.begin(), m_energyOrder.end(),
+                    EnergyOrder(energies));
+   m_sortedEnergies.resize(energies.size());
+   for (size_t j(0); j < energies.size(); j++) {
+      m_sortedEnergies[j] = energies[m_energyOrder[j]];
+   }
+}
+
+std::pair<size_t, size_t> 
+EventContainer::energyRange(double emin, double emax) const {
+   size_t first(std::lower_bound(m_sortedEnergies.begin(),
+                                 m_sortedEnergies.end(), emin)
+                - m_sortedEnergies.begin());
+   size_t last(std::upper_bound(m_sortedEnergies.begin(),
+                                m_sortedEnergies.end(), emax)
+               - m_sortedEnergies.begin());
+   return std::make_pair(first, std::max(first, last));
 }
 
 void EventContainer::computeEventResponses(Source & src, double sr_radius) {
@@ -24,7 +24,10 @@ ExposureCube::ExposureCube(const ExposureCube & other)
      m_fileName(other.m_fileName), 
      m_hasPhiDependence(other.m_hasPhiDependence),
      m_tstart(other.m_tstart),
-     m_tstop(other.m_tstop) {
+     m_tstop(other.m_tstop),
+     m_costhNodes(other.m_costhNodes),
+     m_phiCosthNodes(other.m_phiCosthNodes),
+     m_phiNodes(other.m_phiNodes) {
    if (other.m_weightedExposure) {
       m_weightedExposure = new map_tools::Exposure(*(other.m_weightedExposure));
    }
@@ -51,6 +54,101 @@ void ExposureCube::readExposureCube(std::string filename) {
    header["TSTART"].get(m_tstart);
    header["TSTOP"].get(m_tstop);
    delete exposure;
+   computeNodes();
+}
+
+void ExposureCube::computeNodes() {
+// The bin centers are the same for every pixel, so take them from the
+// first one.  These mirror the sums in healpix::CosineBinner:
+// operator() runs over the cos(theta) bins and integral() over the
+// (cos(theta), phi) bins that follow them.
+   const healpix::CosineBinner & binner(*(m_exposure->data().begin()));
+   m_costhNodes.clear();
+   m_phiCosthNodes.clear();
+   m_phiNodes.clear();
+   healpix::CosineBinner::const_iterator it(binner.begin());
+   for ( ; it != binner.end_costh(); ++it) {
+      m_costhNodes.push_back(binner.costheta(it));
+   }
+   if (m_hasPhiDependence) {
+      for ( ; it != binner.end(); ++it) {
+         m_phiCosthNodes.push_back(binner.costheta(it));
+// CosineBinner returns phi in radians; the Aeff functors expect degrees
+// (cf. AeffWrapper).
+         m_phiNodes.push_back(binner.phi(it)*180./M_PI);
+      }
+   }
+}
+
+void ExposureCube::getLivetimeHandle(const astro::SkyDir & dir,
+                                     LivetimeHandle & handle) const {
+   size_t nbins(m_costhNodes.size());
+   const healpix::CosineBinner & binner(m_exposure->data()[dir]);
+   handle.m_livetime.assign(binner.begin(), binner.begin() + nbins);
+   if (m_hasPhiDependence) {
+      handle.m_phiLivetime.assign(binner.begin() + nbins, binner.end());
+   } else {
+      handle.m_phiLivetime.clear();
+   }
+   if (m_weightedExposure) {
+      const healpix::CosineBinner & 
+         weighted_binner(m_weightedExposure->data()[dir]);
+      handle.m_weightedLivetime.assign(weighted_binner.begin(),
+                                       weighted_binner.begin() + nbins);
+      if (m_hasPhiDependence) {
+         handle.m_weightedPhiLivetime.assign(weighted_binner.begin() + nbins,
+                                             weighted_binner.end());
+      } else {
+         handle.m_weightedPhiLivetime.clear();
+      }
+   } else {
+      handle.m_weightedLivetime.clear();
+      handle.m_weightedPhiLivetime.clear();
+   }
+}
+
+double ExposureCube::integrate(const LivetimeHandle & handle,
+                               const std::vector<double> & table,
+                               bool weighted_lt) const {
+   const std::vector<double> * livetime;
+   if (m_hasPhiDependence) {
+      livetime = &handle.m_phiLivetime;
+      if (weighted_lt && m_weightedExposure) {
+         livetime = &handle.m_weightedPhiLivetime;
+      }
+   } else {
+      livetime = &handle.m_livetime;
+      if (weighted_lt && m_weightedExposure) {
+         livetime = &handle.m_weightedLivetime;
+      }
+   }
+   if (table.size() != livetime->size()) {
+      throw std::runtime_error("ExposureCube::integrate: response table "
+                               "does not match the livetime binning.");
+   }
+   double sum(0);
+   for (size_t i(0); i < table.size(); i++) {
+      sum += (*livetime)[i]*table[i];
+   }
+   return sum;
+}
+
+double ExposureCube::exposure(const LivetimeHandle & handle,
+                              const std::vector<double> & table,
+                              double energy) const {
+   double factor1(1), factor2(0);
+   if (m_efficiencyFactor) {
+      double met((m_tstart + m_tstop)/2.);
+      m_efficiencyFactor->getLivetimeFactors(energy, factor1, factor2, met);
+   }
+   double exposure(factor1*integrate(handle, table));
+   if (factor2 != 0) {
+      exposure += factor2*integrate(handle, table, true);
+   }
+   if (exposure < 0) {
+      throw std::runtime_error("ExposureCube::exposure: exposure < 0");
+   }
+   return exposure;
 }
 
 double ExposureCube::livetime(const astro::SkyDir & dir,
@@ -8,6 +8,7 @@
  */
 
 #include <cstdio>
+#include <ctime>
 
 #include <algorithm>
 #include <iostream>
@@ -30,11 +31,100 @@
 
 #include "Likelihood/ExposureMap.h"
 #include "Likelihood/Observation.h"
+#include "Likelihood/ObservationCopies.h"
 #include "Likelihood/PointSource.h"
 #include "Likelihood/SkyDirArg.h"
 #include "Likelihood/ProjMap.h"
+#include "Likelihood/ThreadPool.h"
 #include "Likelihood/WcsMapLibrary.h"
 
+namespace {
+   using namespace Likelihood;
+
+/**
+ * @class ExposureRowTask
+ * @brief Computes the exposure for one row of the map.  Each thread
+ * evaluates its PointSource::Aeff functors against its own copy of
+ * the response functions, so rows may be processed concurrently; only
+ * the progress counter is shared.  The pixel directions are computed
+ * beforehand, since the wcslib projection is not safe to share across
+ * threads.
+ */
+   class ExposureRowTask : public ThreadPool::Task {
+   public:
+      ExposureRowTask(const ObservationCopies & observations,
+                      const std::vector<astro::SkyDir> & dirs,
+                      const std::vector<double> & energies,
+                      int nlon, int nlat, int imin, int imax, int jmin,
+                      std::vector<float> & expMap,
+                      st_stream::StreamFormatter & formatter,
+                      size_t nrows) 
+         : m_observations(observations), m_dirs(dirs), m_energies(energies),
+           m_nlon(nlon), m_nlat(nlat), m_imin(imin), m_imax(imax),
+           m_jmin(jmin), m_expMap(expMap), m_formatter(formatter),
+           m_nrows(nrows), m_ndone(0), m_step(std::max(nrows/20, size_t(1))),
+           m_tstart(std::time(0)) {}
+
+      virtual void run(size_t item, size_t thread_id) {
+         const Observation & observation(m_observations[thread_id]);
+         int j(m_jmin + static_cast<int>(item));
+         std::vector<double> exposure;
+         exposure.reserve(m_energies.size());
+         bool verbose(false);
+         for (int i = m_imin; i < m_imax; i++) {
+            const astro::SkyDir & dir(m_dirs.at(item*(m_imax - m_imin)
+                                                + i - m_imin));
+            if (observation.expCube().haveFile()) {
+               PointSource::computeExposureWithHyperCube(dir, m_energies,
+                                                         observation,
+                                                         exposure, verbose);
+            } else {
+               bool quiet(true);
+               PointSource::computeExposure(dir, m_energies, observation,
+                                            exposure, verbose, quiet);
+            }
+            for (size_t k = 0; k < m_energies.size(); k++) {
+               int indx = (k*m_nlat + j)*m_nlon + i;
+               m_expMap.at(indx) = exposure[k];
+            }
+         }
+         reportProgress();
+      }
+
+   private:
+      const ObservationCopies & m_observations;
+      const std::vector<astro::SkyDir> & m_dirs;
+      const std::vector<double> & m_energies;
+      int m_nlon;
+      int m_nlat;
+      int m_imin;
+      int m_imax;
+      int m_jmin;
+      std::vector<float> & m_expMap;
+      st_stream::StreamFormatter & m_formatter;
+      size_t m_nrows;
+      size_t m_ndone;
+      size_t m_step;
+      std::time_t m_tstart;
+      ThreadPool::Mutex m_mutex;
+
+      void reportProgress() {
+         ThreadPool::Lock lock(m_mutex);
+         m_ndone++;
+         if (m_ndone % m_step != 0 || m_ndone == m_nrows) {
+            return;
+         }
+         double elapsed(std::difftime(std::time(0), m_tstart));
+         double remaining(elapsed*(m_nrows - m_ndone)/m_ndone);
+         m_formatter.info(3) << m_ndone << " of " << m_nrows 
+                             << " rows done, approx. " 
+                             << static_cast<long>(remaining) 
+                             << " s remaining" << std::endl;
+         m_formatter.warn() << ".";
+      }
+   };
+} // anonymous namespace
+
 namespace Likelihood {
 
 ExposureMap::~ExposureMap() {
@@ -118,7 +208,8 @@ void ExposureMap::computeMap(std::string filename,
                              double sr_radius, int nlon, int nlat,
                              int nenergies, bool compute_submap,
                              int nlongmin, int nlongmax, 
-                             int nlatmin, int nlatmax) {
+                             int nlatmin, int nlatmax,
+                             int nthreads) {
 
    facilities::Util::expandEnvVar(&filename);
 
@@ -144,9 +235,6 @@ void ExposureMap::computeMap(std::string filename,
 
    astro::SkyProj proj("STG", crpix, crval, cdelt, 0, false);
 
-   std::vector<double> exposure;
-   exposure.reserve(nenergies);
-
    std::vector<float> expMap;
    expMap.resize(nenergies*nlat*nlon);
 
@@ -160,8 +248,6 @@ void ExposureMap::computeMap(std::string filename,
       formatter.info() << " (no expCube file given) " << std::endl;
    }
 
-   int ncount = 0;
-
    int imin(0);
    int imax(nlon);
    int jmin(0);
@@ -173,37 +259,27 @@ void ExposureMap::computeMap(std::string filename,
       jmax = std::min(nlat, nlatmax);
    }
 
+   size_t nrows(std::max(jmax - jmin, 0));
+   std::vector<astro::SkyDir> dirs;
+   dirs.reserve(nrows*std::max(imax - imin, 0));
    for (int j = jmin; j < jmax; j++) {
       for (int i = imin; i < imax; i++) {
-         int step(((imax-imin)*(jmax-jmin))/20);
-         if (step == 0) {
-            step = 2;
-         }
-         if ((ncount % step) == 0) {
-            formatter.warn() << ".";
-         }
-
 // NB: wcslib (via astro::SkyProj) starts indexing pixels at 1, not 0, 
 // so apply correction here to avoid off-by-one error.
          std::pair<double, double> coords = proj.pix2sph(i+1, j+1);
-         astro::SkyDir dir(coords.first, coords.second);
-
-         bool verbose(false);
-         if (observation.expCube().haveFile()) {
-            PointSource::computeExposureWithHyperCube(dir, energies, 
-                                                      observation, 
-                                                      exposure, verbose);
-         } else {
-            PointSource::computeExposure(dir, energies, observation,
-                                         exposure, verbose);
-         }
-         for (int k = 0; k < nenergies; k++) {
-            int indx = (k*nlat + j)*nlon + i;
-            expMap.at(indx) = exposure[k];
-         }
-         ncount++;
+         dirs.push_back(astro::SkyDir(coords.first, coords.second));
       }
    }
+
+   ThreadPool pool(ThreadPool::resolveThreads(nthreads));
+   if (pool.nthreads() > 1) {
+      formatter.info(3) << "Using " << pool.nthreads() << " threads"
+                        << std::endl;
+   }
+   ObservationCopies observations(observation, pool.nthreads());
+   ExposureRowTask task(observations, dirs, energies, nlon, nlat,
+                        imin, imax, jmin, expMap, formatter, nrows);
+   pool.run(task, nrows);
    formatter.warn() << "!" << std::endl;
 
    writeFitsFile(filename, naxes, crpix, crval, cdelt, energies, expMap);
@@ -8,10 +8,13 @@
 #include "Likelihood/FitScanner.h"
 
 #include <cstdio>
+#include <cstdlib>
 #include <stdexcept>
 #include <cmath>
 #include <vector>
 #include <memory>
+#include <sstream>
+#include <algorithm>
 
 #include "tip/IFileSvc.h"
 #include "tip/Image.h"
@@ -32,26 +35,190 @@
 #include "evtbin/HealpixBinner.h"
 #include "evtbin/OrderedBinner.h"
 
+#include "Likelihood/AdaptiveGrid.h"
 #include "Likelihood/AppHelpers.h"
 #include "Likelihood/HistND.h"
 #include "Likelihood/Source.h"
 #include "Likelihood/ScanUtils.h"
+#include "Likelihood/ScanCheckpoint.h"
 #include "Likelihood/BinnedLikelihood.h"
 #include "Likelihood/SummedLikelihood.h"
 #include "Likelihood/FitUtils.h"
 #include "Likelihood/SourceMap.h"
 #include "Likelihood/Snapshot.h"
+#include "Likelihood/ThreadPool.h"
 
 #include "CLHEP/Matrix/Vector.h"
 #include "CLHEP/Matrix/SymMatrix.h"
 
+namespace {
+
+  Likelihood::FitScanMVPrior* clonePrior(const Likelihood::FitScanMVPrior* prior) {
+    return prior != 0 ? new Likelihood::FitScanMVPrior(*prior) : 0;
+  }
+
+  /* Fill the pixels of each map in a histogram that were skipped by an adaptive grid.
+     The pixel index varies fastest in all the histograms */
+  void interpolateHist(const Likelihood::AdaptiveGrid& grid, Likelihood::HistND* hist, size_t npix) {
+    if ( hist == 0 ) return;
+    std::vector<float> data = hist->data();
+    std::vector<double> plane(npix);
+    for ( size_t offset(0); offset + npix <= data.size(); offset += npix ) {
+      std::copy(data.begin()+offset,data.begin()+offset+npix,plane.begin());
+      grid.interpolate(plane);
+      std::copy(plane.begin(),plane.end(),data.begin()+offset);
+    }
+    hist->setData(data);
+  }
+
+  /* Set the pixels of each map in a histogram that were skipped by an adaptive grid */
+  void flagInterpolated(const Likelihood::AdaptiveGrid& grid, Likelihood::HistND* hist, size_t npix, float flag) {
+    if ( hist == 0 ) return;
+    std::vector<float> data = hist->data();
+    for ( size_t i(0); i < data.size(); i++ ) {
+      if ( ! grid.evaluated(i % npix) ) data[i] = flag;
+    }
+    hist->setData(data);
+  }
+
+  /* Position of pixel (x,y) along a Hilbert curve that fills an n x n grid, 
+     where n is a power of 2 */
+  long hilbertIndex(long n, long x, long y) {
+    long d(0);
+    for ( long s(n/2); s > 0; s /= 2 ) {
+      long rx = ( x & s ) > 0 ? 1 : 0;
+      long ry = ( y & s ) > 0 ? 1 : 0;
+      d += s * s * ( ( 3 * rx ) ^ ry );
+      // Rotate the quadrant so that the curve is continuous
+      if ( ry == 0 ) {
+	if ( rx == 1 ) {
+	  x = n - 1 - x;
+	  y = n - 1 - y;
+	}
+	std::swap(x,y);
+      }
+    }
+    return d;
+  }
+
+  /* Number of consecutive positions that are fit in order on one thread with 
+     warm starts, each starting from the fit before it.  The first position of 
+     each chunk starts from the null fit. */
+  const size_t warmStartChunk(16);
+
+  /* Sort pixels of an nx x ny map (x varies fastest) along a Hilbert curve, 
+     so that consecutive pixels are adjacent */
+  void hilbertSort(long nx, long ny, std::vector<long>& pixels) {
+    long n(1);
+    while ( n < nx || n < ny ) n *= 2;
+    std::vector<std::pair<long,long> > keys;
+    keys.reserve(pixels.size());
+    for ( size_t i(0); i < pixels.size(); i++ ) {
+      keys.push_back(std::make_pair(hilbertIndex(n,pixels[i] % nx,pixels[i] / nx),pixels[i]));
+    }
+    std::sort(keys.begin(),keys.end());
+    for ( size_t i(0); i < keys.size(); i++ ) {
+      pixels[i] = keys[i].second;
+    }
+  }
+
+  /* Round a pixel offset to the nearest whole number of pixels */
+  int roundShift(double d) {
+    // I can't find a built-in rounding function, so do this instead (it is really ugly)
+    return d >= 0 ? ( std::fmod(d,1.0) > 0.5 ? std::ceil(d) : std::floor(d) ) :
+      ( std::fmod(d,1.0) < -0.5 ? std::floor(d) : std::ceil(d) );
+  }
+
+  /* Fits the test source normalization in single energy bins and scans the 
+     likelihood about the best fit, for the SED.
+
+     Each bin only touches its own slice of the templates and of the outputs, 
+     and the fits are done with the cache for the calling thread, so bins may 
+     be fit concurrently with worker copies of the FitScanCache.
+  */
+  class SEDBinTask : public Likelihood::ThreadPool::Task {
+
+  public:
+
+    SEDBinTask(const std::vector<Likelihood::FitScanCache*>& caches,
+	       bool usePrior, int verbose, int nnorm, double errorLevel,
+	       std::vector<double>& norm_mles,
+	       std::vector<double>& pos_errs,
+	       std::vector<double>& neg_errs,
+	       std::vector<double>& logLike_mles,
+	       std::vector<double>& uls,
+	       std::vector<int>& sed_fit_status,
+	       std::vector<std::vector<double> >& norms,
+	       std::vector<std::vector<double> >& logLikes)
+      :m_caches(caches),m_usePrior(usePrior),m_verbose(verbose),
+       m_nnorm(nnorm),m_errorLevel(errorLevel),
+       m_norm_mles(norm_mles),m_pos_errs(pos_errs),m_neg_errs(neg_errs),
+       m_logLike_mles(logLike_mles),m_uls(uls),m_sed_fit_status(sed_fit_status),
+       m_norms(norms),m_logLikes(logLikes){;}
+
+    virtual void run(size_t i, size_t thread_id) {
+      static const bool redoFailedVerbose(false);
+      Likelihood::FitScanCache& cache = *(m_caches[thread_id]);
+      Likelihood::FitScanCache::Prior_Version priorType = 
+	m_usePrior ? Likelihood::FitScanCache::Local_Prior : Likelihood::FitScanCache::No_Prior;
+      cache.setEnergyBin(i);
+      int status = cache.fitCurrent(priorType,m_verbose);
+      m_sed_fit_status[i] = status;
+      if ( status ) {
+	// if the fit failed, fill the output vectors, and move on.
+	// for debugging, redo failed fits with verbose on
+	if ( redoFailedVerbose ) {
+	  cache.fitCurrent(priorType,4);
+	}
+	m_logLike_mles[i] = 0.;
+	m_norm_mles[i] = -1.;
+	m_pos_errs[i] = -1;
+	m_neg_errs[i] = -1;
+	m_uls[i] = -1;
+	m_norms[i].assign(m_nnorm,0.);
+	m_logLikes[i].assign(m_nnorm,0.);
+	return;
+      }
+      // latch the information for the output vectors
+      m_logLike_mles[i] = cache.currentLogLike();
+      m_norm_mles[i] = cache.currentPars()[cache.testSourceIndex()];
+      cache.signalUncertainty_quad(0.5,m_pos_errs[i],m_neg_errs[i]);
+      double negLim(0.);
+      double posLim(0.);
+      // estimate the upper limit
+      cache.signalUncertainty_quad(1.36,m_uls[i],negLim);
+      // now estimate the scan range
+      cache.signalUncertainty_quad(m_errorLevel,posLim,negLim); 
+      cache.scanNormalization(m_nnorm,1.0,posLim,negLim,m_norms[i],m_logLikes[i]);
+    }
+
+  private:
+
+    const std::vector<Likelihood::FitScanCache*>& m_caches;
+    bool m_usePrior;
+    int m_verbose;
+    int m_nnorm;
+    double m_errorLevel;
+    std::vector<double>& m_norm_mles;
+    std::vector<double>& m_pos_errs;
+    std::vector<double>& m_neg_errs;
+    std::vector<double>& m_logLike_mles;
+    std::vector<double>& m_uls;
+    std::vector<int>& m_sed_fit_status;
+    std::vector<std::vector<double> >& m_norms;
+    std::vector<std::vector<double> >& m_logLikes;
+  };
+
+}
+
 namespace Likelihood {
 
   TestSourceModelCache::TestSourceModelCache(const BinnedLikelihood& logLike,
 					     const Source& source)
     :m_refModel(logLike.countsMap().data().size(),0),
      m_proj(logLike.countsMap().projection()),
-     m_refDir(source.getRefDir()) {    
+     m_refDir(source.getRefDir()),
+     m_latchCurrent(true) {    
     // latch the reference direction and the size of the model axes
     m_refPixel = m_refDir.project( m_proj );
     m_nx = logLike.countsMap().imageDimension(0);
@@ -60,9 +227,24 @@ namespace Likelihood {
     // Extract the reference image
     FitUtils::extractModelFromSource(source,logLike,m_refModel,true);
   }
+
+  TestSourceModelCache::~TestSourceModelCache() {
+    setNumThreads(1);
+  }
+
+  void TestSourceModelCache::setNumThreads(size_t nthreads) {
+    for ( size_t i(0); i < m_threadProjs.size(); i++ ) {
+      delete m_threadProjs[i];
+    }
+    m_threadProjs.clear();
+    for ( size_t i(1); i < nthreads; i++ ) {
+      m_threadProjs.push_back(m_proj.clone());
+    }
+  }
     
   int TestSourceModelCache::translateMap(const astro::SkyDir& newRef,
-					 std::vector<float>& out_model) const {
+					 std::vector<float>& out_model,
+					 size_t thread_id) const {
     
     /*
       if ( m_proj.method() == astro::ProjBase::HEALPIX ) {
@@ -72,12 +254,22 @@ namespace Likelihood {
       return translateMap_Healpix(d_theta,d_phi,out_model); 
       }
     */
-    std::pair<double,double> newPix = newRef.project( m_proj );
+    // Thread 0 is the calling thread, which uses the original projection
+    const astro::ProjBase& proj = thread_id == 0 ? m_proj : *(m_threadProjs.at(thread_id-1));
+    std::pair<double,double> newPix = newRef.project( proj );
     double dx = newPix.first - m_refPixel.first;
     double dy = newPix.second - m_refPixel.second;
     return translateMap_Wcs(dx,dy,out_model);
   }
 
+  int TestSourceModelCache::pixelShift(const astro::SkyDir& newRef,
+				       int& delta_x, int& delta_y) const {
+    std::pair<double,double> newPix = newRef.project( m_proj );
+    delta_x = roundShift(newPix.first - m_refPixel.first);
+    delta_y = roundShift(newPix.second - m_refPixel.second);
+    return 0;
+  }
+
   void TestSourceModelCache::writeTestSourceToFitsImage(const std::string& fits_file,
 							const std::string& ext_name) const {
     std::vector<long> naxes;    
@@ -112,12 +304,8 @@ namespace Likelihood {
     FitUtils::setVectorValue(1e-9,out_model.begin(),out_model.end());    
 
     // Convert the deltas to integers
-    // I can't find a built-in rounding function, so do this instead (it is really ugly)
-    int delta_x = dx >= 0 ? ( std::fmod(dx,1.0) > 0.5 ? std::ceil(dx) : std::floor(dx) ) :
-      ( std::fmod(dx,1.0) < -0.5 ? std::floor(dx) : std::ceil(dx) );
-    
-    int delta_y = dy >= 0 ? ( std::fmod(dy,1.0) > 0.5 ? std::ceil(dy) : std::floor(dy) ) :
-      ( std::fmod(dy,1.0) < -0.5 ? std::floor(dy) : std::ceil(dy) );
+    int delta_x = roundShift(dx);
+    int delta_y = roundShift(dy);
 
     if ( false ) {
       std::cout << "Translate WCS: " << delta_x << ' ' << delta_y << std::endl;
@@ -157,8 +345,10 @@ namespace Likelihood {
     }
     
     // copy to the local cache
-    m_currentModel.resize(out_model.size(),0.);
-    std::copy(out_model.begin(),out_model.end(),m_currentModel.begin());
+    if ( m_latchCurrent ) {
+      m_currentModel.resize(out_model.size(),0.);
+      std::copy(out_model.begin(),out_model.end(),m_currentModel.begin());
+    }
     
     // This is just a check to make sure that we have preserved the 
     // normalization
@@ -219,6 +409,22 @@ namespace Likelihood {
       m_vector[iComp]->writeTestSourceToFitsImage(filename,buffer);
     }
   }
+
+  void TestSourceModelCacheVector::setLatchCurrent(bool val) {
+    for ( size_t iComp(0); iComp < m_vector.size(); iComp++ ) {
+      if ( m_vector[iComp] != 0 ) {
+	m_vector[iComp]->setLatchCurrent(val);
+      }
+    }
+  }
+
+  void TestSourceModelCacheVector::setNumThreads(size_t nthreads) {
+    for ( size_t iComp(0); iComp < m_vector.size(); iComp++ ) {
+      if ( m_vector[iComp] != 0 ) {
+	m_vector[iComp]->setNumThreads(nthreads);
+      }
+    }
+  }
  
   void FitScanMVPrior::logLikelihood(const CLHEP::HepVector& params, double& logLike) const {
     CLHEP::HepVector delta = params - m_centralVals;
@@ -568,12 +774,13 @@ namespace Likelihood {
 
   int FitScanModelWrapper_Binned::shiftTestSource(const TestSourceModelCacheVector& modelCaches,
 						  const astro::SkyDir& newDir,
-						  std::vector<float>& targetModel) const {
+						  std::vector<float>& targetModel,
+						  size_t thread_id) const {
     if ( modelCaches.size() != 1 ) {
       throw std::runtime_error("FitScanModelWrapper_Binned should only have a single modelCache");
       return -1;
     }
-    modelCaches[0]->translateMap(newDir,targetModel);
+    modelCaches[0]->translateMap(newDir,targetModel,thread_id);
     return 0;
   }
 
@@ -879,7 +1086,8 @@ namespace Likelihood {
   
   int FitScanModelWrapper_Summed::shiftTestSource(const TestSourceModelCacheVector& modelCaches,
 						  const astro::SkyDir& newDir,
-						  std::vector<float>& targetModel) const {
+						  std::vector<float>& targetModel,
+						  size_t thread_id) const {
     if ( modelCaches.size() != m_summedLike.numComponents() ) {
       throw std::runtime_error("FitScanModelWrapper_Summed number of modelCaches should equal number of Likelihood components");
       return -1;
@@ -891,7 +1099,7 @@ namespace Likelihood {
       size_t compSize = m_sizeByComp[i];
       targetModels[i].resize(compSize);
       std::vector<float>* newVect = &(targetModels[i]);
-      modelCaches[i]->translateMap(newDir,*newVect);
+      modelCaches[i]->translateMap(newDir,*newVect,thread_id);
       targetModelsPtrs.push_back(newVect);
     }
 
@@ -921,6 +1129,7 @@ namespace Likelihood {
 			     double tol, int maxIter, double initLambda,
 			     bool useReduced, bool useWeights, bool useUnitRefVals)
     :m_modelWrapper(modelWrapper),
+     m_master(0),
      m_snapshot(0),
      m_testSourceName(testSourceName),
      m_tol(tol),
@@ -948,6 +1157,7 @@ namespace Likelihood {
      m_currentTestSourceIndex(-1),
      m_currentLogLike(0.),
      m_currentEDM(0.),
+     m_currentNIter(0),
      m_firstEnergyBin(0.),
      m_lastEnergyBin(m_nebins),
      m_firstBin(0),
@@ -959,6 +1169,58 @@ namespace Likelihood {
 
   }
 
+  FitScanCache::FitScanCache(FitScanCache& master)
+    :m_modelWrapper(master.m_modelWrapper),
+     m_master(&master.master()),
+     m_snapshot(0),
+     m_testSourceName(master.m_testSourceName),
+     m_tol(master.m_tol),
+     m_maxIter(master.m_maxIter),
+     m_initLambda(master.m_initLambda),
+     m_nebins(master.m_nebins),
+     m_data(master.m_data),
+     m_targetModel(master.m_targetModel),
+     m_useReduced(master.m_useReduced),
+     m_useWeights(master.m_useWeights),
+     m_useUnitRefVals(master.m_useUnitRefVals),
+     m_targetRedModel(master.m_targetRedModel),
+     m_loglike_ref(master.m_loglike_ref),
+     m_currentModels(master.m_currentModels),
+     m_currentFreeSources(master.m_currentFreeSources),
+     m_currentFixed(master.m_currentFixed),
+     m_currentRefValues(master.m_currentRefValues),
+     m_currentSourceIndices(master.m_currentSourceIndices),
+     m_currentTestSourceIndex(master.m_currentTestSourceIndex),
+     m_initPars(master.m_initPars),
+     m_currentPars(master.m_currentPars),
+     m_currentCov(master.m_currentCov),
+     m_currentGrad(master.m_currentGrad),
+     m_prior_test(clonePrior(master.m_prior_test)),
+     m_prior_bkg(clonePrior(master.m_prior_bkg)),
+     m_global_prior_test(clonePrior(master.m_global_prior_test)),
+     m_global_prior_bkg(clonePrior(master.m_global_prior_bkg)),
+     m_init_prior_test(clonePrior(master.m_init_prior_test)),
+     m_init_prior_bkg(clonePrior(master.m_init_prior_bkg)),
+     m_full_prior_test(clonePrior(master.m_full_prior_test)),
+     m_full_prior_bkg(clonePrior(master.m_full_prior_bkg)),
+     m_currentBestModel(master.m_currentBestModel),
+     m_currentLogLike(master.m_currentLogLike),
+     m_currentEDM(master.m_currentEDM),
+     m_currentNIter(master.m_currentNIter),
+     m_firstEnergyBin(master.m_firstEnergyBin),
+     m_lastEnergyBin(master.m_lastEnergyBin),
+     m_firstBin(master.m_firstBin),
+     m_lastBin(master.m_lastBin){
+    // The current test source model belongs to each cache
+    if ( m_currentTestSourceIndex >= 0 ) {
+      m_currentModels.back() = m_useReduced ? &m_targetRedModel : &m_targetModel;
+    }
+  }
+
+  FitScanCache* FitScanCache::makeWorker() {
+    return new FitScanCache(*this);
+  }
+
  
   FitScanCache::~FitScanCache() {
     cleanup();
@@ -971,6 +1233,9 @@ namespace Likelihood {
 					std::vector<std::string>& /* new_free */, 
 					std::vector<std::string>& /* new_fixed */) {
 
+    if ( m_master != 0 ) {
+      throw std::runtime_error("FitScanCache::update_with_action can not be called for a worker copy.");
+    }
     if ( (action & Rebuild) != 0 ) {
       build_from_model();
       return;
@@ -1077,13 +1342,13 @@ namespace Likelihood {
     //  2) pushes free models onto the m_currentModels vector
     //  3) pushes free paramters to the pars_out vector
     if ( m_useReduced ) {						
-      m_currentFixed.resize(m_dataRed.size());
-      m_currentBestModel.resize(m_dataRed.size());
-      FitUtils::refactorModels(m_allRedModels,m_allRedFixed,pars_scales,freeSources,
+      m_currentFixed.resize(dataRed().size());
+      m_currentBestModel.resize(dataRed().size());
+      FitUtils::refactorModels(allRedModels(),allRedFixed(),pars_scales,freeSources,
 			       test_source_ptr,
 			       m_currentModels,m_currentFixed,pars_out);
     } else {
-      FitUtils::refactorModels(m_allModels,m_allFixed,pars_scales,freeSources,
+      FitUtils::refactorModels(allModels(),allFixed(),pars_scales,freeSources,
 			       test_source_ptr,
 			       m_currentModels,m_currentFixed,pars_out);      
     }
@@ -1104,7 +1369,7 @@ namespace Likelihood {
     for ( size_t i(0); i < freeSources.size(); i++ ) {
       if ( freeSources[i] ) {
 	m_currentSourceIndices.push_back(i);
-	m_currentRefValues.push_back(m_refValues[i]);
+	m_currentRefValues.push_back(refValues()[i]);
       }
     }  
 
@@ -1171,8 +1436,8 @@ namespace Likelihood {
     m_firstEnergyBin = firstEnergyBin;
     m_lastEnergyBin = lastEnergyBin;
     // Loop from m_npix*energyBin to m_npix*(energyBin+1)
-    m_firstBin = firstEnergyBin == 0 ? 0 : m_energyBinStopIdxs[m_firstEnergyBin-1];
-    m_lastBin = m_energyBinStopIdxs[m_lastEnergyBin-1];
+    m_firstBin = firstEnergyBin == 0 ? 0 : energyBinStopIdxs()[m_firstEnergyBin-1];
+    m_lastBin = energyBinStopIdxs()[m_lastEnergyBin-1];
     //if ( m_useReduced ) {
     //  m_firstBin = firstEnergyBin == 0 ? 0 : m_energyBinStopIdxs[m_firstEnergyBin-1];
     //  m_lastBin = m_energyBinStopIdxs[m_lastEnergyBin-1];
@@ -1189,24 +1454,25 @@ namespace Likelihood {
     // setting the last arguement to true sets the parameters scale to 1.0
     m_modelWrapper.extractModelFromSource(aSrc,m_targetModel,true);
     if ( m_useReduced ) {
-      FitUtils::sparsifyModel(m_nonZeroBins,m_targetModel,m_targetRedModel);    
+      FitUtils::sparsifyModel(nonZeroBins(),m_targetModel,m_targetRedModel);    
     }    
     // Add the new version of the source to the model
     addTestSourceToCurrent(0.0);
   } 
   
   int FitScanCache::shiftTestSource(const TestSourceModelCacheVector& modelCaches,
-				    const astro::SkyDir& newDir) {
+				    const astro::SkyDir& newDir,
+				    size_t thread_id) {
     // First remove the current version of the source
     removeTestSourceFromCurrent();
     
-    int status = m_modelWrapper.shiftTestSource(modelCaches,newDir,m_targetModel);
+    int status = m_modelWrapper.shiftTestSource(modelCaches,newDir,m_targetModel,thread_id);
     if ( status != 0 ) {
       // FIXME, do we throw an exception here?
       return status;
     }
     if ( m_useReduced ) {
-      FitUtils::sparsifyModel(m_nonZeroBins,m_targetModel,m_targetRedModel);    
+      FitUtils::sparsifyModel(nonZeroBins(),m_targetModel,m_targetRedModel);    
     }        
     // Add the new version of the source to the model
     addTestSourceToCurrent(0.0);
@@ -1268,6 +1534,23 @@ namespace Likelihood {
   }
   
 
+  void FitScanCache::setInitPars(const CLHEP::HepVector& pars) {
+    if ( size_t(pars.num_row()) != nFreeCurrent() ) {
+      throw std::runtime_error("FitScanCache::setInitPars: wrong number of parameters.");
+    }
+    m_initPars = pars;
+    m_currentPars = pars;
+  }
+
+
+  void FitScanCache::restoreInitPars(const CLHEP::HepVector& pars) {
+    if ( size_t(pars.num_row()) != nFreeCurrent() ) {
+      throw std::runtime_error("FitScanCache::restoreInitPars: wrong number of parameters.");
+    }
+    m_initPars = pars;
+  }
+  
+
   /* Set the prior */
   void FitScanCache::buildPriorsFromExternal(const CLHEP::HepVector& centralVals,
 					     const CLHEP::HepSymMatrix& covariance,
@@ -1336,9 +1619,9 @@ namespace Likelihood {
     // and latches the output into the internal cache
 
     const FitScanMVPrior* prior = getPrior(whichPrior,m_currentTestSourceIndex >= 0);
-    std::vector<float>* wts_ptr = m_useWeights ?  ( m_useReduced ? &m_weightsRed : &m_weights ) : 0;
+    const std::vector<float>* wts_ptr = m_useWeights ?  ( m_useReduced ? &weightsRed() : &weights() ) : 0;
 
-    int status = FitUtils::fitNorms_newton(m_useReduced ? m_dataRed : m_data,
+    int status = FitUtils::fitNorms_newton(m_useReduced ? dataRed() : m_data,
 					   m_initPars,
 					   m_currentModels,
 					   m_currentFixed,
@@ -1354,7 +1637,8 @@ namespace Likelihood {
 					   m_currentLogLike,
 					   m_firstBin,
 					   m_lastBin,
-					   verbose);
+					   verbose,
+					   &m_currentNIter);
     return status;
   }
   
@@ -1366,18 +1650,18 @@ namespace Likelihood {
     FitUtils::sumModel(m_currentPars,m_currentModels,m_currentFixed,m_currentBestModel,
 		       m_firstBin,m_lastBin);
 
-    std::vector<float>::const_iterator data_start = m_useReduced ? m_dataRed.begin() + m_firstBin : m_data.begin() + m_firstBin;
+    std::vector<float>::const_iterator data_start = m_useReduced ? dataRed().begin() + m_firstBin : m_data.begin() + m_firstBin;
     std::vector<float>::const_iterator data_end =  m_useReduced ? 
-      ( m_lastBin == 0 ? m_dataRed.end() : m_dataRed.begin() + m_lastBin ) :
+      ( m_lastBin == 0 ? dataRed().end() : dataRed().begin() + m_lastBin ) :
       ( m_lastBin == 0 ? m_data.end() : m_data.begin() + m_lastBin );
     std::vector<float>::const_iterator model_start = m_currentBestModel.begin() + m_firstBin;
     std::vector<float>::const_iterator model_end = m_lastBin == 0 ? m_currentBestModel.end() : m_currentBestModel.begin() + m_lastBin;
 
     if ( m_useWeights ) {
-      std::vector<float>::const_iterator w_start = m_useReduced ? m_weightsRed.begin() + m_firstBin : m_weights.begin() + m_firstBin;
+      std::vector<float>::const_iterator w_start = m_useReduced ? weightsRed().begin() + m_firstBin : weights().begin() + m_firstBin;
       std::vector<float>::const_iterator w_end =  m_useReduced ? 
-	( m_lastBin == 0 ? m_weightsRed.end() : m_weightsRed.begin() + m_lastBin ) :
-	( m_lastBin == 0 ? m_weights.end() : m_weights.begin() + m_lastBin );
+	( m_lastBin == 0 ? weightsRed().end() : weightsRed().begin() + m_lastBin ) :
+	( m_lastBin == 0 ? weights().end() : weights().begin() + m_lastBin );
       logLike  = FitUtils::logLikePoisson(data_start,data_end,model_start,model_end,w_start,w_end);
     } else {
       logLike = FitUtils::logLikePoisson(data_start,data_end,model_start,model_end);
@@ -1404,8 +1688,8 @@ namespace Likelihood {
 					   size_t lastBin,
 					   int verbose) {
     const FitScanMVPrior* prior = getPrior(whichPrior,m_currentTestSourceIndex >= 0);
-    std::vector<float>* wts_ptr = m_useWeights ?  ( m_useReduced ? &m_weightsRed : &m_weights ) : 0;
-    FitUtils::getGradientAndHessian(m_useReduced ? m_dataRed : m_data,
+    const std::vector<float>* wts_ptr = m_useWeights ?  ( m_useReduced ? &weightsRed() : &weights() ) : 0;
+    FitUtils::getGradientAndHessian(m_useReduced ? dataRed() : m_data,
 				    norms,
 				    m_currentModels,
 				    m_currentFixed,
@@ -1481,61 +1765,48 @@ namespace Likelihood {
       init_pars = m_currentPars.sub(1,models_temp.size());
     }
     
-    // Loop on the normalizations
+    // Set the normalizations
     for ( int is(0); is < nnorm; is++ ) {
       norms[is] = scan_val;
-      float nPred(0.);
-      float nCF(0.);
-      float nTM(0.);
-      // Add the test model to the fixed models (with the correct normalization factor)
-      if ( m_useReduced ) {
-	FitUtils::vectorAdd(m_currentFixed.begin()+m_firstBin,m_currentFixed.begin()+m_lastBin,
-			    m_targetRedModel.begin()+m_firstBin,m_targetRedModel.begin()+m_lastBin,
-			    fixed_temp.begin()+m_firstBin,fixed_temp.begin()+m_lastBin,
-			    1.,scan_val);
-      } else {
-	FitUtils::vectorAdd(m_currentFixed.begin()+m_firstBin,m_currentFixed.begin()+m_lastBin,
-			    m_targetModel.begin()+m_firstBin,m_targetModel.begin()+m_lastBin,
-			    fixed_temp.begin()+m_firstBin,fixed_temp.begin()+m_lastBin,
-			    1.,scan_val);	
-      }
-      std::vector<float>* wts_ptr = m_useWeights ? ( m_useReduced ? &m_weightsRed : &m_weights ) : 0;
-      if ( do_profile ) {
-	// Fit the other sources
-	int status = FitUtils::fitNorms_newton((m_useReduced ? m_dataRed : m_data),
-					       init_pars,models_temp,fixed_temp,
-					       m_prior_bkg,wts_ptr,
-					       m_tol,m_maxIter,m_initLambda,
-					       pars_temp,covs_temp,grad_temp,
-					       model_temp,
-					       edm_temp,logLikes[is],
-					       m_firstBin,m_lastBin);
-	if ( status ) {	    
-	  std::cerr << "Failed profile fit on energy bin " << is << ".  Status: " << status << std::endl;
-	  return status;
-	} 
-      } else {
-	// No need to do the fit, just build the total model and get the log-likelihood
-	FitUtils::sumModel(init_pars,models_temp,fixed_temp,model_temp,m_firstBin,m_lastBin);
-	FitUtils::sumVector(m_currentFixed.begin()+m_firstBin,m_currentFixed.begin()+m_lastBin,nCF);
-	FitUtils::sumVector(m_targetRedModel.begin()+m_firstBin,m_targetRedModel.begin()+m_lastBin,nTM);
-	FitUtils::sumVector(model_temp.begin(),model_temp.end(),nPred);
-
-	std::vector<float>::const_iterator itrDataBeg = m_useReduced ? m_dataRed.begin()+m_firstBin : m_data.begin()+m_firstBin;
-	std::vector<float>::const_iterator itrDataEnd = m_useReduced ? m_dataRed.begin()+m_lastBin : m_data.begin()+m_lastBin;
-	
-	if ( m_useWeights ) {
-	  logLikes[is] = FitUtils::logLikePoisson(itrDataBeg,itrDataEnd,
-						  model_temp.begin()+m_firstBin,model_temp.begin()+m_lastBin,
-						  wts_ptr->begin()+m_firstBin,wts_ptr->begin()+m_lastBin);
-	} else {
-	  logLikes[is] = FitUtils::logLikePoisson(itrDataBeg,itrDataEnd,
-						  model_temp.begin()+m_firstBin,model_temp.begin()+m_lastBin);   
-	}
-      }
-      // step the scan value
       scan_val += lin_step;
     }
+
+    const std::vector<float>& data = m_useReduced ? dataRed() : m_data;
+    const std::vector<float>& target = m_useReduced ? m_targetRedModel : m_targetModel;
+    const std::vector<float>* wts_ptr = m_useWeights ? ( m_useReduced ? &weightsRed() : &weights() ) : 0;
+
+    if ( ! do_profile ) {
+      // No need to do any fits, the model is just fixed + norm * test, 
+      // so we get the log-likelihood at all the normalizations in one pass over the data
+      FitUtils::logLikePoissonScan(data,m_currentFixed,target,norms,logLikes,
+				   wts_ptr,m_firstBin,m_lastBin);
+      return 0;
+    }
+    
+    // Loop on the normalizations
+    for ( int is(0); is < nnorm; is++ ) {
+      // Add the test model to the fixed models (with the correct normalization factor)
+      FitUtils::vectorAdd(m_currentFixed.begin()+m_firstBin,m_currentFixed.begin()+m_lastBin,
+			  target.begin()+m_firstBin,target.begin()+m_lastBin,
+			  fixed_temp.begin()+m_firstBin,fixed_temp.begin()+m_lastBin,
+			  1.,norms[is]);
+      // Fit the other sources
+      int status = FitUtils::fitNorms_newton(data,
+					     init_pars,models_temp,fixed_temp,
+					     m_prior_bkg,wts_ptr,
+					     m_tol,m_maxIter,m_initLambda,
+					     pars_temp,covs_temp,grad_temp,
+					     model_temp,
+					     edm_temp,logLikes[is],
+					     m_firstBin,m_lastBin);
+      if ( status ) {	    
+	std::cerr << "Failed profile fit on energy bin " << is << ".  Status: " << status << std::endl;
+	return status;
+      } 
+      // Neighbouring scan points have nearly the same solution,
+      // so start the next fit from this one
+      init_pars = pars_temp;
+    }
     return 0;
   }  
   
@@ -1578,8 +1849,8 @@ namespace Likelihood {
 
   int FitScanCache::getTemplateIndex(const std::string& srcName) const {
     int retVal(0);
-    for ( std::vector<std::string>::const_iterator itrFind = m_templateSourceNames.begin();
-	  itrFind != m_templateSourceNames.end(); itrFind++, retVal++ ) {
+    for ( std::vector<std::string>::const_iterator itrFind = templateSourceNames().begin();
+	  itrFind != templateSourceNames().end(); itrFind++, retVal++ ) {
       if ( *itrFind == srcName ) return retVal;
     }
     return -1;
@@ -1587,6 +1858,9 @@ namespace Likelihood {
 
 
   int FitScanCache::updateTemplateForSource(const std::string& srcName) {
+    if ( m_master != 0 ) {
+      throw std::runtime_error("FitScanCache::updateTemplateForSource can not be called for a worker copy.");
+    }
     int srcIdx = update_template_for_source(srcName);
     setCache();
     refactor_from_model();
@@ -1877,21 +2151,21 @@ namespace Likelihood {
 
   void FitScanCache::fillModelCounts(const std::string& srcName, 
 				     std::vector<float>& model) const {
-    model.resize(m_energyBinStopIdxs.size());
+    model.resize(energyBinStopIdxs().size());
     int idx = getTemplateIndex(srcName);
-    const std::vector<float>& src_redModel = m_allRedModels[idx];
+    const std::vector<float>& src_redModel = allRedModels()[idx];
     int start(0);
     for ( int i(0); i < model.size(); i++ ) {
       model[i] = 0.;
-      FitUtils::sumVector(src_redModel.begin()+start, src_redModel.begin()+m_energyBinStopIdxs[i], model[i]);
-      start = m_energyBinStopIdxs[i];
+      FitUtils::sumVector(src_redModel.begin()+start, src_redModel.begin()+energyBinStopIdxs()[i], model[i]);
+      start = energyBinStopIdxs()[i];
     }
   }
 
   void FitScanCache::fillRedModel(const std::string& srcName, 
 				  std::vector<float>& model) const {
     int idx = getTemplateIndex(srcName);
-    const std::vector<float>& src_redModel = m_allRedModels[idx];
+    const std::vector<float>& src_redModel = allRedModels()[idx];
     model.resize(src_redModel.size(), 0);
     std::copy(src_redModel.begin(), src_redModel.end(), model.begin());
   }
@@ -1899,7 +2173,7 @@ namespace Likelihood {
   void FitScanCache::fillFullModel(const std::string& srcName, 
 				   std::vector<float>& model) const {
     int idx = getTemplateIndex(srcName);
-    const std::vector<float>& src_model = m_allModels[idx];
+    const std::vector<float>& src_model = allModels()[idx];
     model.resize(src_model.size(), 0);
     std::copy(src_model.begin(), src_model.end(), model.begin());
   }
@@ -1975,7 +2249,16 @@ namespace Likelihood {
      m_verbose_bb(0),
      m_verbose_scan(0),
      m_writeTestImages(false),
-     m_useReduced(true){
+     m_useReduced(true),
+     m_nThreads(1),
+     m_fastTSMap(false),
+     m_nRefine(0),
+     m_coarseStep(1),
+     m_refineTs(4.),
+     m_refineGrad(1.),
+     m_checkpointInterval(0.),
+     m_resume(false),
+     m_warmStart(true){
         
     // Build the energy binned from the energies in the BinnedLikelihood
     m_energy_binner = buildEnergyBinner(m_modelWrapper->energies());  
@@ -2007,7 +2290,16 @@ namespace Likelihood {
      m_verbose_bb(0),
      m_verbose_scan(0),
      m_writeTestImages(false),
-     m_useReduced(true){
+     m_useReduced(true),
+     m_nThreads(1),
+     m_fastTSMap(false),
+     m_nRefine(0),
+     m_coarseStep(1),
+     m_refineTs(4.),
+     m_refineGrad(1.),
+     m_checkpointInterval(0.),
+     m_resume(false),
+     m_warmStart(true){
         
     // Build the energy binned from the energies in the BinnedLikelihood
     m_energy_binner = buildEnergyBinner(m_modelWrapper->energies());  
@@ -2047,7 +2339,16 @@ namespace Likelihood {
      m_verbose_bb(0),
      m_verbose_scan(0),
      m_writeTestImages(false),
-     m_useReduced(true){
+     m_useReduced(true),
+     m_nThreads(1),
+     m_fastTSMap(false),
+     m_nRefine(0),
+     m_coarseStep(1),
+     m_refineTs(4.),
+     m_refineGrad(1.),
+     m_checkpointInterval(0.),
+     m_resume(false),
+     m_warmStart(true){
    
     
     // Build the energy binned from the energies in the BinnedLikelihood
@@ -2086,7 +2387,16 @@ namespace Likelihood {
      m_verbose_bb(0),
      m_verbose_scan(0),
      m_writeTestImages(false),
-     m_useReduced(true){
+     m_useReduced(true),
+     m_nThreads(1),
+     m_fastTSMap(false),
+     m_nRefine(0),
+     m_coarseStep(1),
+     m_refineTs(4.),
+     m_refineGrad(1.),
+     m_checkpointInterval(0.),
+     m_resume(false),
+     m_warmStart(true){
    
     // Build the energy binned from the energies in the BinnedLikelihood
     m_energy_binner = buildEnergyBinner(m_modelWrapper->energies());
@@ -2147,6 +2457,296 @@ namespace Likelihood {
   }
 
   
+  /* Fits the test source at grid positions with Newton's method and 
+     fills the output histograms for those positions.
+
+     Each position only touches its own bins of the output histograms, and 
+     the fits are done with the cache for the calling thread, so positions 
+     may be fit concurrently with worker copies of the FitScanCache.
+  */
+  class FitScanner::PixelTask : public ThreadPool::Task {
+
+  public:
+
+    /* The output histograms, any of which may be null */
+    struct Outputs {
+      Outputs()
+	:ts_map(0),ts_map_ok(0),norm_map(0),posErr_map(0),negErr_map(0),symErr_map(0),
+	 ts_cube(0),ts_cube_ok(0),norm_cube(0),norm_ul_cube(0),
+	 symErr_cube(0),posErr_cube(0),negErr_cube(0),nll_cube(0),
+	 norm_vals(0),delta_ll_vals(0){;}
+      HistND* ts_map;
+      HistND* ts_map_ok;
+      HistND* norm_map;
+      HistND* posErr_map;
+      HistND* negErr_map;
+      HistND* symErr_map;
+      HistND* ts_cube;
+      HistND* ts_cube_ok;
+      HistND* norm_cube;
+      HistND* norm_ul_cube;
+      HistND* symErr_cube;
+      HistND* posErr_cube;
+      HistND* negErr_cube;
+      HistND* nll_cube;
+      HistND* norm_vals;
+      HistND* delta_ll_vals;
+    };
+
+    PixelTask(const FitScanner& scanner, const Outputs& outputs,
+	      const std::vector<bool>& freeSources,
+	      const std::vector<float>& parScales,
+	      double loglike_null, bool doSED, int nNorm, double normSigma, 
+	      double covScale, int npix, size_t nthreads)
+      :m_scanner(scanner),m_out(outputs),
+       m_freeSources(freeSources),m_parScales(parScales),
+       m_loglike_null(loglike_null),m_doSED(doSED),m_nNorm(nNorm),
+       m_normSigma(normSigma),m_covScale(covScale),m_npix(npix),
+       m_caches(0),m_dirs(0),m_pixels(0),m_chunkSize(1),m_ipix_print(std::max(npix / 20,1)),
+       m_nfailed_bb(nthreads,0),m_nfailed_scan(nthreads,0),m_nfailed_scan_bins(nthreads,0),
+       m_nfits(nthreads,0),m_nseeded(nthreads,0),m_niter(nthreads,0),
+       m_sedPool(0){;}
+
+    /* Set a pool used to fit the energy bins of the SED concurrently.
+       This should only be used if the positions are fit one at a time */
+    void setSEDPool(ThreadPool* pool) {
+      m_sedPool = pool;
+    }
+
+    /* Set the caches (one per thread) and the test source directions (one per pixel)
+       used by run().  The pixels are pixels[0..n), or all of the pixels if pixels
+       is not given, and they are split into consecutive chunks of chunkSize.  
+       Item i of the task is chunk i, which is fit in order on a single thread, 
+       each fit starting from the one before it if warm starts are used.  
+       The chunks do not depend on the number of threads, so neither do the results. */
+    void setPixels(const std::vector<FitScanCache*>& caches,
+		   const std::vector<CLHEP::Hep3Vector>& dirs,
+		   const std::vector<long>* pixels = 0,
+		   size_t chunkSize = 1) {
+      m_caches = &caches;
+      m_dirs = &dirs;
+      m_pixels = pixels;
+      m_chunkSize = std::max(chunkSize,size_t(1));
+    }
+
+    /* Number of items, i.e., of chunks of pixels */
+    size_t nChunks() const {
+      size_t npix = m_pixels != 0 ? m_pixels->size() : m_dirs->size();
+      return ( npix + m_chunkSize - 1 ) / m_chunkSize;
+    }
+
+    /* Fit the pixels of chunk item, in order, with the cache for this thread */
+    virtual void run(size_t item, size_t thread_id) {
+      size_t npix = m_pixels != 0 ? m_pixels->size() : m_dirs->size();
+      size_t first = item*m_chunkSize;
+      size_t last = std::min(first+m_chunkSize,npix);
+      FitScanCache& cache = *((*m_caches)[thread_id]);
+      CLHEP::HepVector seedPars;
+      CLHEP::HepVector fitPars;
+      bool haveSeed(false);
+      for ( size_t i(first); i < last; i++ ) {
+	long ipix = m_pixels != 0 ? (*m_pixels)[i] : i;
+	if ( ! m_scanner.quiet() && ipix % m_ipix_print == 0 ) {
+	  ThreadPool::Lock lock(m_mutex);
+	  std::cout << '.' << std::flush;
+	}
+	cache.refactorModel(m_freeSources,m_parScales,false);
+	astro::SkyDir dir((*m_dirs)[ipix]);
+	cache.shiftTestSource(m_scanner.m_testSourceCaches,dir,thread_id);
+	int status = fitPixel(cache,ipix,thread_id,haveSeed ? &seedPars : 0,&fitPars);
+	haveSeed = m_scanner.warmStart() && status == 0;
+	if ( haveSeed ) seedPars = fitPars;
+      }
+    }
+
+    /* Fit a cache with the test source already in place, fill the outputs 
+       for pixel ipix and remove the test source from the cache.
+
+       seedPars : If given, and warm starts are used, the starting values of the 
+                  broadband fit, e.g., the result at the previous position
+       fitPars  : If given, filled with the result of a successful broadband fit
+
+       returns the status of the broadband fit 
+    */
+    int fitPixel(FitScanCache& cache, long ipix, size_t thread_id,
+		 const CLHEP::HepVector* seedPars = 0,
+		 CLHEP::HepVector* fitPars = 0) {
+      static const bool redoFailedVerbose(false);
+      
+      // Set the cache to do a broadband fit
+      cache.setEnergyBin(-1);	
+
+      // Start from the given parameters, if any
+      CLHEP::HepVector defaultPars;
+      bool seeded = m_scanner.warmStart() && seedPars != 0 && 
+	size_t(seedPars->num_row()) == cache.nFreeCurrent();
+      if ( seeded ) {
+	defaultPars = cache.initPars();
+	cache.setInitPars(*seedPars);
+      }
+      int status = cache.fitCurrent(FitScanCache::Global_Prior,m_scanner.verbose_bb());
+      int niter = cache.currentNIter();
+      if ( status != 0 && seeded ) {
+	// Don't let the starting point change the outcome, redo it from the null fit
+	cache.setInitPars(defaultPars);
+	status = cache.fitCurrent(FitScanCache::Global_Prior,m_scanner.verbose_bb());
+	niter += cache.currentNIter();
+      } else if ( seeded ) {
+	// Leave the starting values as they would be without the warm start
+	cache.restoreInitPars(defaultPars);
+      }
+      m_nfits[thread_id]++;
+      m_niter[thread_id] += niter;
+      if ( seeded ) m_nseeded[thread_id]++;
+
+      if ( status != 0 ) {
+	// Refit with verbose
+	if ( redoFailedVerbose ) {
+	  status = cache.fitCurrent(FitScanCache::Global_Prior,4);
+	}
+	if ( m_out.ts_map_ok ) m_out.ts_map_ok->setBinDirect(ipix,status);
+	if ( m_out.ts_cube_ok ) {
+	  int idx_sed_err = ipix;
+	  for ( int iE_err(0); iE_err < m_scanner.nEBins(); iE_err++, idx_sed_err += m_npix ) {
+	    m_out.ts_cube_ok->setBinDirect(idx_sed_err,double(status));
+	  }
+	}
+	m_nfailed_bb[thread_id]++;
+	cache.removeTestSourceFromCurrent();
+	return status;
+      }
+
+      if ( fitPars != 0 ) {
+	*fitPars = cache.currentPars();
+      }
+
+      // get the TS value and copy to the output histogram
+      double tsval_newton = 2*(cache.currentLogLike() - m_loglike_null);
+      double normVal = cache.currentPars()[cache.testSourceIndex()];
+      double posErr(0.);
+      double negErr(0.);
+	
+      cache.signalUncertainty_quad(0.5,posErr,negErr);
+      double symErr = FitUtils::symmetricError(posErr,negErr);
+
+      if ( m_out.ts_map ) m_out.ts_map->setBinDirect(ipix,tsval_newton);
+      if ( m_out.norm_map ) m_out.norm_map->setBinDirect(ipix,normVal);
+      if ( m_out.posErr_map ) m_out.posErr_map->setBinDirect(ipix,posErr);
+      if ( m_out.negErr_map ) m_out.negErr_map->setBinDirect(ipix,negErr);
+      if ( m_out.symErr_map ) m_out.symErr_map->setBinDirect(ipix,symErr);
+
+      // if we are not doing the SED, we can move the next grid location 
+      // after removing the test source
+      if ( ! m_doSED ) {
+	cache.removeTestSourceFromCurrent();
+	return 0;
+      }
+
+      // Space for the output of the SED scan	
+      std::vector<double> norm_mles;
+      std::vector<double> pos_errs;
+      std::vector<double> neg_errs;
+      std::vector<double> logLike_mles; 
+      std::vector<double> uls;
+      std::vector<int> sed_fit_status;
+      std::vector<std::vector<double> > logLikes;
+      std::vector<std::vector<double> > norms;
+
+      int sed_status = m_scanner.sed_binned_newton(cache,m_nNorm,m_normSigma,m_covScale,
+						   norm_mles,pos_errs,neg_errs,
+						   logLike_mles,uls,
+						   sed_fit_status,
+						   norms,logLikes,m_sedPool);
+      if ( sed_status != 0 ) {
+	m_nfailed_scan[thread_id]++;
+	if ( sed_status > 0 ) {
+	  m_nfailed_scan_bins[thread_id] += sed_status;
+	}
+      }
+
+      // This block copies the SED scan data to the output histograms
+
+      // This is the pixel index
+      int idx_sed = ipix;
+      // This is the stride from one normalization set to the next
+      int step_norm = m_npix;
+      // Loop on energy bins
+      for ( int iE(0); iE < m_scanner.nEBins(); iE++, idx_sed += m_npix ) {
+	// Fill the histograms that use pixel and energy bin
+	double ts_val_bin = 2.*(logLike_mles[iE] - logLikes[iE][0]);
+	double sym_err = FitUtils::symmetricError(pos_errs[iE],neg_errs[iE]);
+	if ( m_out.ts_cube ) m_out.ts_cube->setBinDirect(idx_sed,ts_val_bin);
+	if ( m_out.ts_cube_ok ) m_out.ts_cube_ok->setBinDirect(idx_sed,sed_fit_status[iE]);
+	if ( m_out.norm_cube ) m_out.norm_cube->setBinDirect(idx_sed,norm_mles[iE]);
+	if ( m_out.symErr_cube ) m_out.symErr_cube->setBinDirect(idx_sed,sym_err);
+	if ( m_out.posErr_cube ) m_out.posErr_cube->setBinDirect(idx_sed,pos_errs[iE]);
+	if ( m_out.negErr_cube ) m_out.negErr_cube->setBinDirect(idx_sed,neg_errs[iE]);
+	if ( m_out.norm_ul_cube ) m_out.norm_ul_cube->setBinDirect(idx_sed,uls[iE]);
+	if ( m_out.nll_cube ) m_out.nll_cube->setBinDirect(idx_sed,logLike_mles[iE]);
+	// This is the index for the pixel,energy bin
+	int idx_norm = iE*(m_npix*m_nNorm) + ipix;
+	// Loop on normalization scan points
+	for ( int iN(0); iN < m_nNorm; iN++, idx_norm += step_norm ) {
+	  // Fill the histograms that use pixel, energy bin and normalization
+	  double deltaLogLike = logLikes[iE][iN] - logLike_mles[iE] ;
+	  if ( m_out.norm_vals ) m_out.norm_vals->setBinDirect(idx_norm,norms[iE][iN]);
+	  if ( m_out.delta_ll_vals ) m_out.delta_ll_vals->setBinDirect(idx_norm,deltaLogLike);
+	}	  
+      }
+      cache.removeTestSourceFromCurrent();
+      return 0;
+    }
+
+    // Number of failed fits, summed over the threads
+    int nfailed_bb() const { return sum(m_nfailed_bb); }
+    int nfailed_scan() const { return sum(m_nfailed_scan); }
+    int nfailed_scan_bins() const { return sum(m_nfailed_scan_bins); }
+
+    // Number of broadband fits, of those started from a neighbouring position,
+    // and of Newton steps taken, summed over the threads
+    int nfits() const { return sum(m_nfits); }
+    int nseeded() const { return sum(m_nseeded); }
+    int niter() const { return sum(m_niter); }
+
+  private:
+
+    static int sum(const std::vector<int>& counts) {
+      int retVal(0);
+      for ( size_t i(0); i < counts.size(); i++ ) {
+	retVal += counts[i];
+      }
+      return retVal;
+    }
+
+    const FitScanner& m_scanner;
+    Outputs m_out;
+    const std::vector<bool>& m_freeSources;
+    const std::vector<float>& m_parScales;
+    double m_loglike_null;
+    bool m_doSED;
+    int m_nNorm;
+    double m_normSigma;
+    double m_covScale;
+    int m_npix;
+    const std::vector<FitScanCache*>* m_caches;
+    const std::vector<CLHEP::Hep3Vector>* m_dirs;
+    const std::vector<long>* m_pixels;
+    size_t m_chunkSize;
+    int m_ipix_print;
+    ThreadPool::Mutex m_mutex;
+    // Failed fits, by thread
+    std::vector<int> m_nfailed_bb;
+    std::vector<int> m_nfailed_scan;
+    std::vector<int> m_nfailed_scan_bins;
+    // Fits and Newton steps, by thread
+    std::vector<int> m_nfits;
+    std::vector<int> m_nseeded;
+    std::vector<int> m_niter;
+    // Used to fit the SED energy bins concurrently, if the positions are fit one at a time
+    ThreadPool* m_sedPool;
+  };
+
+  
   /* Build a TS cube.
      For each point in a TS Map this also calculate the spectrum as a function of energy
      and can also scan over the normalization
@@ -2177,8 +2777,6 @@ namespace Likelihood {
       std::cout << "st_scan   = " << ST_scan_level << std::endl;
     }
 
-    static const bool redoFailedVerbose(false);
-
     // How much fitting do we do with ScienceTools fitter
     const bool baseline_st( ST_scan_level > 0 );
     const bool broadband_st( ST_scan_level > 1 );
@@ -2359,27 +2957,188 @@ namespace Likelihood {
     
     // Count the number of failed fits
     int nfailed_bb(0);
-    int nfailed_bb_newton(0);
     int nfailed_scan(0);
-    int nfailed_scan_newton(0);
-    int nfailed_scan_newton_bins(0);
 
     // We store the output by pixel, so these are useful
     long ipix(0);
     int npix = doTSMap ? nPixels() : 1;
     int ipix_print = std::max(npix / 20,1);
 
+    // Set up the checkpoints, and pick up the results of an interrupted run.
+    // The null fit is taken from the checkpoint, so that all the positions are 
+    // compared to the same null hypothesis
+    std::auto_ptr<ScanCheckpoint> checkpoint;
+    if ( ! m_checkpointFile.empty() ) {
+      std::ostringstream signature;
+      signature << "run_tscube " << nxbins << ' ' << nybins << ' ' << nEBins() << ' ' << nNorm << ' '
+		<< doTSMap << ' ' << doSED << ' ' << ST_scan_level << ' ' << m_cache->nBkgModel();
+      checkpoint.reset(new ScanCheckpoint(m_checkpointFile,signature.str(),npix,m_checkpointInterval));
+      if ( m_resume ) {
+	if ( checkpoint->read() && checkpoint->params().size() == parScales.size() + 1 ) {
+	  restoreCheckpoint(*checkpoint);
+	  loglike_null = checkpoint->params()[0];
+	  std::copy(checkpoint->params().begin()+1,checkpoint->params().end(),parScales.begin());
+	  if ( ! m_quiet ) {
+	    std::cout << "Resuming from " << m_checkpointFile << " with " << checkpoint->nDone() 
+		      << " of " << npix << " positions done." << std::endl;
+	  }
+	} else {
+	  std::cerr << "Warning: could not resume from " << m_checkpointFile 
+		    << ", starting from the beginning." << std::endl;
+	  checkpoint.reset(new ScanCheckpoint(m_checkpointFile,signature.str(),npix,m_checkpointInterval));
+	}
+      }
+      std::vector<double> baseline(1,loglike_null);
+      baseline.insert(baseline.end(),parScales.begin(),parScales.end());
+      checkpoint->setParams(baseline);
+    }
+
+    // The positions can be fit in parallel if the fitting is all 
+    // done with the cache and the test source image is just shifted
+    const bool parallel = npix > 1 && ! broadband_st && ! sed_st && ! remakeTestSource && ! m_writeTestImages;
+    ThreadPool pool(parallel ? ThreadPool::resolveThreads(m_nThreads) : 1);
+
+    // The TS map can be made with FFTs if we only want the broadband fits 
+    // and the test source image is shifted across a single WCS counts map
+    bool fast = m_fastTSMap && doTSMap && ! doSED && ! broadband_st && ! remakeTestSource &&
+      m_dir2_binner != 0 && ! m_modelWrapper->isSummed();
+    if ( m_fastTSMap && ! fast ) {
+      std::cerr << "Warning: fast TS map is only available for broadband TS maps of a single WCS counts map, " 
+		<< "fitting all positions." << std::endl;
+    }
+
+    // The grid can be refined from coarse to fine if the positions are fit 
+    // with the pixel task on a WCS grid
+    const bool adaptive = m_coarseStep > 1 && parallel && m_dir2_binner != 0 && ! fast;
+    if ( m_coarseStep > 1 && ! adaptive ) {
+      std::cerr << "Warning: adaptive refinement is only available for WCS grids fit with Newton's method, " 
+		<< "fitting all positions." << std::endl;
+    }
+
+    PixelTask::Outputs outputs;
+    outputs.ts_map = ts_map;
+    outputs.ts_map_ok = ts_map_ok;
+    outputs.norm_map = norm_map;
+    outputs.posErr_map = posErr_map;
+    outputs.negErr_map = negErr_map;
+    outputs.symErr_map = symErr_map;
+    outputs.ts_cube = ts_cube;
+    outputs.ts_cube_ok = ts_cube_ok;
+    outputs.norm_cube = norm_cube;
+    outputs.norm_ul_cube = norm_ul_cube;
+    outputs.symErr_cube = symErr_cube;
+    outputs.posErr_cube = posErr_cube;
+    outputs.negErr_cube = negErr_cube;
+    outputs.nll_cube = nll_cube;
+    outputs.norm_vals = norm_vals;
+    outputs.delta_ll_vals = delta_ll_vals;
+    PixelTask pixelTask(*this,outputs,freeSources,parScales,loglike_null,
+			doSED,nNorm,normSigma,covScale,npix,pool.nthreads());
+
     if ( ! m_quiet ) {
+      if ( pool.nthreads() > 1 ) {
+	std::cout << "Fitting positions with " << pool.nthreads() << " threads." << std::endl;
+      }
       if ( doTSMap ) {
 	std::cout << "Performing TS Grid Scan" << std::flush;
       } else {
 	std::cout << "Performing SED Scan" << std::flush;
       }
     }
- 
-    // Note the loop order, outer loop is on Y, this matches HistND structure
-    for ( long iy(0); iy < nybins; iy++ ) {      
-      for ( long ix(0); ix < nxbins; ix++, ipix++ ) {
+
+    if ( fast ) {
+      // Make the map from the FFTs, then refit the positions with the largest TS
+      std::vector<double> tsVals;
+      std::vector<double> normVals;
+      std::vector<double> errVals;
+      status = fastTSMap(parScales,tsVals,normVals,errVals);
+      if ( status != 0 ) {
+	std::cerr << "Warning: fast TS map failed with status code " << status 
+		  << ", fitting all positions." << std::endl;
+	fast = false;
+      } else {
+	for ( long i(0); i < npix; i++ ) {
+	  // Keep the refits from an earlier run
+	  if ( checkpoint.get() && checkpoint->done(i) ) continue;
+	  if ( ts_map ) ts_map->setBinDirect(i,tsVals[i]);
+	  if ( ts_map_ok ) ts_map_ok->setBinDirect(i,0.);
+	  if ( norm_map ) norm_map->setBinDirect(i,normVals[i]);
+	  if ( posErr_map ) posErr_map->setBinDirect(i,errVals[i]);
+	  if ( negErr_map ) negErr_map->setBinDirect(i,errVals[i]);
+	  if ( symErr_map ) symErr_map->setBinDirect(i,errVals[i]);
+	}
+	std::vector<std::pair<double,long> > ranked;
+	ranked.reserve(npix);
+	for ( long i(0); i < npix; i++ ) {
+	  ranked.push_back(std::make_pair(-tsVals[i],i));
+	}
+	size_t nRefine = std::min(size_t(std::max(m_nRefine,0)),ranked.size());
+	std::partial_sort(ranked.begin(),ranked.begin()+nRefine,ranked.end());
+	std::vector<long> pixels;
+	for ( size_t i(0); i < nRefine; i++ ) {
+	  pixels.push_back(ranked[i].second);
+	}
+	if ( ! pixels.empty() ) {
+	  fitPixels(pixelTask,pool,doTSMap,&pixels,checkpoint.get());
+	}
+      }
+    }
+
+    if ( fast ) {
+      // The map has already been filled
+    } else if ( adaptive ) {
+      // Fit a coarse grid, refine it where the TS is large or changes quickly,
+      // and interpolate the rest
+      AdaptiveGrid grid(nxbins,nybins,m_coarseStep,m_refineTs,m_refineGrad);
+      std::vector<long> pixels;
+      while ( grid.nextPixels(pixels) ) {
+	fitPixels(pixelTask,pool,doTSMap,&pixels,checkpoint.get());
+	for ( size_t k(0); k < pixels.size(); k++ ) {
+	  grid.setValue(pixels[k],ts_map ? (*ts_map)[pixels[k]] : 0.);
+	}
+      }
+      if ( ! m_quiet ) {
+	std::cout << "Fit " << grid.nEvaluated() << " of " << npix << " positions" << std::flush;
+      }
+      // Flag the interpolated positions with a fit status of -1
+      HistND* interpolated[] = { ts_map, norm_map, posErr_map, negErr_map, symErr_map, 
+				 ts_cube, norm_cube, norm_ul_cube, symErr_cube, posErr_cube, negErr_cube, 
+				 nll_cube, norm_vals, delta_ll_vals };
+      for ( size_t i(0); i < sizeof(interpolated)/sizeof(HistND*); i++ ) {
+	interpolateHist(grid,interpolated[i],npix);
+      }
+      flagInterpolated(grid,ts_map_ok,npix,-1.);
+      flagInterpolated(grid,ts_cube_ok,npix,-1.);
+    } else if ( pool.nthreads() > 1 ) {
+      fitPixels(pixelTask,pool,doTSMap,0,checkpoint.get());
+    } else {
+      // Note the loop order, outer loop is on Y, this matches HistND structure,
+      // unless we are visiting the positions along a Hilbert curve
+      std::vector<long> order;
+      for ( long i(0); i < npix; i++ ) {
+	order.push_back(i);
+      }
+      // Since the positions are done one at a time, use the threads 
+      // to fit the SED energy bins concurrently instead
+      ThreadPool sedPool(doSED ? ThreadPool::resolveThreads(m_nThreads) : 1);
+      pixelTask.setSEDPool(&sedPool);
+      if ( m_warmStart && m_dir2_binner != 0 && doTSMap ) {
+	hilbertSort(nxbins,nybins,order);
+      }
+      // Warm starts use the same chunks of positions as fitPixels, 
+      // so the results do not depend on the number of threads
+      CLHEP::HepVector seedPars;
+      CLHEP::HepVector fitPars;
+      bool haveSeed(false);
+      size_t nfit(0);
+      for ( size_t iorder(0); iorder < order.size(); iorder++ ) {
+	ipix = order[iorder];
+	long ix = ipix % nxbins;
+	long iy = ipix / nxbins;
+
+	// Skip the positions finished in an earlier run
+	if ( checkpoint.get() && checkpoint->done(ipix) ) continue;
+	if ( nfit++ % warmStartChunk == 0 ) haveSeed = false;
 
 	if ( ! m_quiet ) {
 	  if ( ipix % ipix_print == 0 ) {
@@ -2438,67 +3197,17 @@ namespace Likelihood {
 	  }	 
 	}
 
-	// Set the cache to do a broadband fit
-	m_cache->setEnergyBin(-1);	
-	status = m_cache->fitCurrent(FitScanCache::Global_Prior,verbose_bb());
-
-	if ( status != 0 ) {
-	  // Refit with verbose
-	  if ( redoFailedVerbose ) {
-	    status = m_cache->fitCurrent(FitScanCache::Global_Prior,4);
-	  }
-
-	  ts_map_ok->setBinDirect(ipix,status);
-	  int idx_sed_err = ipix;
-	  for ( int iE_err(0); iE_err < nEBins(); iE_err++, idx_sed_err += npix ) {
-	    ts_cube_ok->setBinDirect(idx_sed_err,double(status));
-	  }
-	  nfailed_bb_newton++;
-	  continue;
-	}
-
-	// get the TS value and copy to the output histogram
-	double tsval_newton = 2*(m_cache->currentLogLike() - loglike_null);
-	double normVal = m_cache->currentPars()[m_cache->testSourceIndex()];
-	double posErr(0.);
-	double negErr(0.);
-	
-	m_cache->signalUncertainty_quad(0.5,posErr,negErr);
-	double symErr = FitUtils::symmetricError(posErr,negErr);
-
-	if ( ts_map ) ts_map->setBinDirect(ipix,tsval_newton);
-	if ( norm_map ) norm_map->setBinDirect(ipix,normVal);
-	if ( posErr_map ) posErr_map->setBinDirect(ipix,posErr);
-	if ( negErr_map ) negErr_map->setBinDirect(ipix,negErr);
-	if ( symErr_map ) symErr_map->setBinDirect(ipix,symErr);
-
-	// if we are not doing the SED, we can move the next grid location 
-	// after removing the test soruce
-	if ( ! doSED ) {
-	  if ( broadband_st || remakeTestSource ) {
-	    removeTestSourceFromModel();
-	  }
-	  m_cache->removeTestSourceFromCurrent();
-	  continue;
-	}
-
-	// Space for the output of the SED scan	
-	std::vector<double> norm_mles;
-	std::vector<double> pos_errs;
-	std::vector<double> neg_errs;
-	std::vector<double> logLike_mles; 
-	std::vector<double> uls;
-	std::vector<int> sed_fit_status;
-	std::vector<std::vector<double> > logLikes;
-	std::vector<std::vector<double> > norms;
-
-	// Space for the output of the SED (with ScienceTools fitting)
-	std::vector<double> norm_mles_st;
-	std::vector<double> logLike_mles_st;
-	std::vector<std::vector<double> > logLikes_st;
-	std::vector<std::vector<double> > norms_st;
-
-	if ( sed_st ) {
+	// Do the fits with Newton's method and fill the outputs
+	status = pixelTask.fitPixel(*m_cache,ipix,0,haveSeed ? &seedPars : 0,&fitPars);
+	haveSeed = m_warmStart && status == 0;
+	if ( haveSeed ) seedPars = fitPars;
+
+	if ( status == 0 && doSED && sed_st ) {
+	  // Do the SED with the ScienceTools fitter
+	  std::vector<double> norm_mles_st;
+	  std::vector<double> logLike_mles_st;
+	  std::vector<std::vector<double> > logLikes_st;
+	  std::vector<std::vector<double> > norms_st;
 	  Likelihood::ScanUtils::sed_binned(*m_modelWrapper,
 					    m_testSourceName,
 					    *m_opt,
@@ -2508,69 +3217,40 @@ namespace Likelihood {
 					    norm_mles_st,
 					    logLike_mles_st,
 					    logLikes_st);
-	}
-
-	status = sed_binned_newton(nNorm,normSigma,covScale,
-				   norm_mles,pos_errs,neg_errs,
-				   logLike_mles,uls,
-				   sed_fit_status,
-				   norms,logLikes);
-	if ( status != 0 ) {
-	  nfailed_scan_newton++;
-	  if ( status > 0 ) {
-	    nfailed_scan_newton_bins += status;
-	  }
-	}
-
-	// This block copies the SED scan data to the output histograms
-
-	// This is the pixel index
-	int idx_sed = ipix;
-	// This is the stride from one normalization set to the next
-	int step_norm = npix;
-	// int step_norm = npix * nEBins();
-	// Loop on energy bins
-	for ( int iE(0); iE < nEBins(); iE++, idx_sed += npix ) {
-	  // Fill the histograms that use pixel and energy bin
-	  double ts_val_bin = 2.*(logLike_mles[iE] - logLikes[iE][0]);
-	  double sym_err = FitUtils::symmetricError(pos_errs[iE],neg_errs[iE]);
-	  if ( ts_cube ) ts_cube->setBinDirect(idx_sed,ts_val_bin);
-	  if ( ts_cube_ok ) ts_cube_ok->setBinDirect(idx_sed,sed_fit_status[iE]);
-	  if ( norm_cube ) norm_cube->setBinDirect(idx_sed,norm_mles[iE]);
-	  if ( symErr_cube ) symErr_cube->setBinDirect(idx_sed,sym_err);
-	  if ( posErr_cube ) posErr_cube->setBinDirect(idx_sed,pos_errs[iE]);
-	  if ( negErr_cube ) negErr_cube->setBinDirect(idx_sed,neg_errs[iE]);
-	  if ( norm_ul_cube ) norm_ul_cube->setBinDirect(idx_sed,uls[iE]);
-	  if ( nll_cube ) nll_cube->setBinDirect(idx_sed,logLike_mles[iE]);
-	  if ( sed_st ) {
+	  int idx_sed = ipix;
+	  for ( int iE(0); iE < nEBins(); iE++, idx_sed += npix ) {
 	    double ts_val_bin_st = 2.*(logLike_mles_st[iE] - logLikes_st[iE][0]);
 	    if ( ts_cube_st ) ts_cube_st->setBinDirect(idx_sed,ts_val_bin_st);
 	    if ( norm_cube_st ) norm_cube_st->setBinDirect(idx_sed,norm_mles_st[iE]);
 	    if ( nll_cube_st ) nll_cube_st->setBinDirect(idx_sed,logLike_mles_st[iE]);
-	  }
-	  // This is the index for the pixel,energy bin
-	  int idx_norm = iE*(npix*nNorm) + ipix;
-	  // int idx_norm = idx_sed;
-	  // Loop on normalization scan points
-  	  for ( int iN(0); iN < nNorm; iN++, idx_norm += step_norm ) {
-	    // Fill the histograms that use pixel, energy bin and normalization
-	    double deltaLogLike = logLikes[iE][iN] - logLike_mles[iE] ;
- 	    if ( norm_vals ) norm_vals->setBinDirect(idx_norm,norms[iE][iN]);
-	    if ( delta_ll_vals ) delta_ll_vals->setBinDirect(idx_norm,deltaLogLike);
-	    if ( normscan_st ) {
+	    int idx_norm = iE*(npix*nNorm) + ipix;
+	    for ( int iN(0); iN < nNorm_st; iN++, idx_norm += npix ) {
 	      double deltaLogLike_st = logLikes_st[iE][iN] - logLike_mles_st[iE];
 	      if ( norm_vals_st ) norm_vals_st->setBinDirect(idx_norm,norms_st[iE][iN]);
 	      if ( delta_ll_vals_st ) delta_ll_vals_st->setBinDirect(idx_norm,deltaLogLike_st);
 	    }
-	  }	  
+	  }
 	}
+
 	if ( broadband_st || remakeTestSource ) {
 	  removeTestSourceFromModel();
 	}
-	m_cache->removeTestSourceFromCurrent();
+
+	if ( checkpoint.get() ) {
+	  checkpoint->setDone(ipix);
+	  if ( checkpoint->due() ) saveCheckpoint(*checkpoint);
+	}
       }
     }
 
+    if ( checkpoint.get() ) {
+      saveCheckpoint(*checkpoint);
+    }
+
+    int nfailed_bb_newton = pixelTask.nfailed_bb();
+    int nfailed_scan_newton = pixelTask.nfailed_scan();
+    int nfailed_scan_newton_bins = pixelTask.nfailed_scan_bins();
+
     if ( ! m_quiet ) {
       std::cout << "!" << std::endl;
       
@@ -2590,8 +3270,179 @@ namespace Likelihood {
       if ( nfailed_scan_newton_bins > 0 ) {
 	std::cout << "There were " << nfailed_scan_newton_bins << " failed bins in the SED scans with the Newton's method fitter." << std::endl;
       }
+
+      // Report the cost of the broadband fits
+      if ( pixelTask.nfits() > 0 ) {
+	std::cout << "Newton's method took " << double(pixelTask.niter()) / double(pixelTask.nfits()) 
+		  << " iterations per broadband fit on average, " << pixelTask.nseeded() << " of " 
+		  << pixelTask.nfits() << " fits were started from the previous position." << std::endl;
+      }
+    }
+
+    return 0;
+  }
+
+
+  void FitScanner::fitPixels(PixelTask& pixelTask, ThreadPool& pool, bool doTSMap,
+			     const std::vector<long>* pixels,
+			     ScanCheckpoint* checkpoint) {
+    // Number of positions per thread between checks for a checkpoint
+    static const size_t checkpointBatch(16);
+
+    long nxbins = doTSMap ? m_dir1_binner->getNumBins() : 1;
+    long nybins = doTSMap ? ( m_dir2_binner ? m_dir2_binner->getNumBins() : 1 ) : 1;
+    // The directions are computed up front, so that the projection 
+    // is only used by this thread
+    std::vector<CLHEP::Hep3Vector> dirs;
+    dirs.reserve(nxbins*nybins);
+    for ( long iy(0); iy < nybins; iy++ ) {      
+      for ( long ix(0); ix < nxbins; ix++ ) {
+	dirs.push_back( doTSMap ? pixelDir(ix,iy)() : m_testSourceDir() );
+      }
+    }
+    // The calling thread uses the master cache, the others use worker copies
+    std::vector<FitScanCache*> caches(pool.nthreads(),m_cache);
+    for ( size_t i(1); i < caches.size(); i++ ) {
+      caches[i] = m_cache->makeWorker();
+    }
+    // Skip the positions finished in an earlier run, and fit the rest in batches
+    // so that the finished positions can be checkpointed
+    std::vector<long> todo;
+    size_t nitems = pixels != 0 ? pixels->size() : dirs.size();
+    for ( size_t i(0); i < nitems; i++ ) {
+      long ipix = pixels != 0 ? (*pixels)[i] : i;
+      if ( checkpoint == 0 || ! checkpoint->done(ipix) ) {
+	todo.push_back(ipix);
+      }
+    }
+    // Visit the positions along a Hilbert curve, so that consecutive 
+    // positions are neighbours and each fit can start from the one before
+    if ( m_warmStart && m_dir2_binner != 0 && doTSMap ) {
+      hilbertSort(nxbins,nybins,todo);
+    }
+    // Each item of the task is a chunk of consecutive positions.  The batches 
+    // are whole numbers of chunks, so the chunks are the same for any number of threads
+    size_t chunkSize = m_warmStart ? warmStartChunk : 1;
+    size_t batchSize = checkpoint != 0 ? 
+      std::max(checkpointBatch*pool.nthreads()/chunkSize,size_t(1))*chunkSize : todo.size();
+    std::vector<long> batch;
+    pixelTask.setPixels(caches,dirs,&batch,chunkSize);
+    m_testSourceCaches.setLatchCurrent(false);
+    m_testSourceCaches.setNumThreads(pool.nthreads());
+    try {
+      for ( size_t start(0); start < todo.size(); start += batchSize ) {
+	size_t stop = std::min(start+batchSize,todo.size());
+	batch.assign(todo.begin()+start,todo.begin()+stop);
+	pool.run(pixelTask,pixelTask.nChunks());
+	if ( checkpoint != 0 ) {
+	  for ( size_t i(0); i < batch.size(); i++ ) {
+	    checkpoint->setDone(batch[i]);
+	  }
+	  if ( checkpoint->due() ) saveCheckpoint(*checkpoint);
+	}
+      }
+    } catch (...) {
+      m_testSourceCaches.setLatchCurrent(true);
+      m_testSourceCaches.setNumThreads(1);
+      for ( size_t i(1); i < caches.size(); i++ ) {
+	delete caches[i];
+      }
+      throw;
+    }
+    m_testSourceCaches.setLatchCurrent(true);
+    m_testSourceCaches.setNumThreads(1);
+    for ( size_t i(1); i < caches.size(); i++ ) {
+      delete caches[i];
+    }
+  }
+
+
+  void FitScanner::saveCheckpoint(ScanCheckpoint& checkpoint) const {
+    for ( std::vector< std::pair< std::string,std::pair<HistND*,std::string> > >::const_iterator itr = m_scanData.begin();
+	  itr != m_scanData.end(); itr++ ) {
+      checkpoint.setArray(itr->first,itr->second.first->data());
+    }
+    checkpoint.write();
+  }
+
+
+  void FitScanner::restoreCheckpoint(const ScanCheckpoint& checkpoint) {
+    std::vector<float> data;
+    for ( std::vector< std::pair< std::string,std::pair<HistND*,std::string> > >::iterator itr = m_scanData.begin();
+	  itr != m_scanData.end(); itr++ ) {
+      HistND* hist = itr->second.first;
+      if ( checkpoint.getArray(itr->first,data) && data.size() == hist->data().size() ) {
+	hist->setData(data);
+      }
     }
+  }
+
 
+  int FitScanner::fastTSMap(const std::vector<float>& parScales,
+			    std::vector<double>& tsVals,
+			    std::vector<double>& normVals,
+			    std::vector<double>& errVals) const {
+
+    // Largest n*R/b for which the expansion of dL is used.  
+    // At 0.5 the error from the missing terms is about 1% of dL.
+    static const double maxExpansionRatio(0.5);
+
+    const TestSourceModelCache* srcCache = m_testSourceCaches.size() == 1 ? m_testSourceCaches.cache(0) : 0;
+    if ( srcCache == 0 ) return -1;
+    const size_t nx = srcCache->nx();
+    const size_t ny = srcCache->ny();
+    const size_t ne = srcCache->ne();
+    const size_t nmap = nx*ny;
+    const std::vector<float>& data = m_cache->data();
+    const std::vector<float>& ref = srcCache->refModel();
+    if ( data.size() != nmap*ne || ref.size() != data.size() || 
+	 m_cache->allFixed().size() != data.size() ) return -2;
+
+    // The null fit model, over the full counts map
+    size_t nBkg = m_cache->nBkgModel();
+    CLHEP::HepVector bkgNorms(nBkg);
+    std::vector<const std::vector<float>* > bkgModels;
+    for ( size_t i(0); i < nBkg; i++ ) {
+      bkgNorms[i] = parScales[i];
+      bkgModels.push_back( &(m_cache->allModels()[i]) );
+    }
+    std::vector<float> bkg(data.size(),0.);
+    FitUtils::sumModel(bkgNorms,bkgModels,m_cache->allFixed(),bkg);
+    const std::vector<float>* wts = m_cache->useWeights() ? &(m_cache->weights()) : 0;
+
+    // The fits for each shift, indexed as in Convolve::correlate2d
+    std::vector<double> norm;
+    std::vector<double> dLogLike;
+    std::vector<double> curv;
+    std::vector<double> maxRatio;
+    FitUtils::fitShiftedNorms_fft(nx,ny,ne,data,bkg,ref,wts,norm,dLogLike,curv,maxRatio);
+
+    // Pick out the shift for each pixel of the scan
+    long nxbins = m_dir1_binner->getNumBins();
+    long nybins = m_dir2_binner->getNumBins();
+    tsVals.assign(nxbins*nybins,0.);
+    normVals.assign(nxbins*nybins,0.);
+    errVals.assign(nxbins*nybins,0.);
+    long ipix(0);
+    for ( long iy(0); iy < nybins; iy++ ) {      
+      for ( long ix(0); ix < nxbins; ix++, ipix++ ) {
+	int dx(0);
+	int dy(0);
+	srcCache->pixelShift(pixelDir(ix,iy),dx,dy);
+	if ( std::abs(dx) >= int(nx) || std::abs(dy) >= int(ny) ) continue;
+	size_t k = size_t(dy+int(ny)-1)*(2*nx-1) + size_t(dx+int(nx)-1);
+	double n = norm[k];
+	double deltaLogLike = dLogLike[k];
+	double d2 = curv[k];
+	// The expansion does not hold where the source is comparable to the background
+	if ( n*maxRatio[k] >= maxExpansionRatio ) {
+	  FitUtils::fitShiftedNorm_exact(nx,ny,ne,dx,dy,data,bkg,ref,wts,n,deltaLogLike,d2);
+	}
+	tsVals[ipix] = 2.*std::max(deltaLogLike,0.);
+	normVals[ipix] = n;
+	errVals[ipix] = d2 < 0 ? 1./std::sqrt(-d2) : 0.;
+      }
+    }
     return 0;
   }
 
@@ -2943,16 +3794,19 @@ namespace Likelihood {
     m_testSourceDir() = astro::SkyDir(xpix,ypix,*m_proj,false)();   
     */
 
-    if ( m_dir2_binner != 0 ) {
-      m_testSourceDir() = astro::SkyDir(ix+1,iy+1,*m_proj,false)();   
-    } else {
-      const evtbin::HealpixBinner* hxp_binner = static_cast<const evtbin::HealpixBinner*>(m_dir1_binner);
-      int pixNum  = hxp_binner->pixelIndices()[ix];
-      m_testSourceDir() = astro::SkyDir(pixNum,0,*m_proj,false)();   
-    }
+    m_testSourceDir() = pixelDir(ix,iy)();
     return 0;
   }
 
+  astro::SkyDir FitScanner::pixelDir(int ix, int iy) const {
+    if ( m_dir2_binner != 0 ) {
+      return astro::SkyDir(ix+1,iy+1,*m_proj,false);
+    } 
+    const evtbin::HealpixBinner* hxp_binner = static_cast<const evtbin::HealpixBinner*>(m_dir1_binner);
+    int pixNum  = hxp_binner->pixelIndices()[ix];
+    return astro::SkyDir(pixNum,0,*m_proj,false);
+  }
+
   /* This does the baseline fit
      i.e., the fit without the test source */
   int FitScanner::baselineFit(double tol, int tolType) {
@@ -3001,92 +3855,101 @@ namespace Likelihood {
 				    std::vector<double>& uls,
 				    std::vector<int>& sed_fit_status,
 				    std::vector<std::vector<double> >& norms,
-				    std::vector<std::vector<double> >& logLikes) {
-
-
-    static const bool redoFailedVerbose(false);
-
-    const double errorLevel = 0.5*normSigma*normSigma;
+				    std::vector<std::vector<double> >& logLikes,
+				    ThreadPool* pool) {
 
     // We can't do the fitting without a FitScanCache
     if ( m_cache == 0 ) {
       std::cerr << "FitScanner::sed_binned_newton no Cache" << std::endl;
       return -1;
     }
+    return sed_binned_newton(*m_cache,nnorm,normSigma,constrainScale,
+			     norm_mles,pos_errs,neg_errs,logLike_mles,uls,
+			     sed_fit_status,norms,logLikes,pool);
+  }
+
+
+  int FitScanner::sed_binned_newton(FitScanCache& cache,
+				    int nnorm, double normSigma, 
+				    double constrainScale,
+				    std::vector<double>& norm_mles,
+				    std::vector<double>& pos_errs,
+				    std::vector<double>& neg_errs,
+				    std::vector<double>& logLike_mles,
+				    std::vector<double>& uls,
+				    std::vector<int>& sed_fit_status,
+				    std::vector<std::vector<double> >& norms,
+				    std::vector<std::vector<double> >& logLikes,
+				    ThreadPool* pool) const {
+
+    const double errorLevel = 0.5*normSigma*normSigma;
 
     // first we fix everything except the signal component to their current values 
     std::vector<float> par_scales;
-    m_cache->getParScales(par_scales);
+    cache.getParScales(par_scales);
     bool usePrior(false);
 
     if ( constrainScale < 0 ) {
-      std::vector<bool> freeSources(m_cache->nBkgModel(),false);
-      m_cache->refactorModel(freeSources,par_scales,true);
+      std::vector<bool> freeSources(cache.nBkgModel(),false);
+      cache.refactorModel(freeSources,par_scales,true);
     } else {
       usePrior = true;
-      std::vector<bool> constrainPars(m_cache->nBkgModel(),true);
-      m_cache->buildPriorsFromCurrent(constrainPars,constrainScale);
+      std::vector<bool> constrainPars(cache.nBkgModel(),true);
+      cache.buildPriorsFromCurrent(constrainPars,constrainScale);
     }
-    
-    // Latch the index of the test source
-    int test_idx = m_cache->testSourceIndex();
 
     // Allocate the output vectors
-    norm_mles.resize(m_cache->nebins());
-    logLike_mles.resize(m_cache->nebins());
-    pos_errs.resize(m_cache->nebins());
-    neg_errs.resize(m_cache->nebins());
-    norms.resize(m_cache->nebins());    
-    logLikes.resize(m_cache->nebins());
-    uls.resize(m_cache->nebins());
-    sed_fit_status.resize(m_cache->nebins());
+    norm_mles.resize(cache.nebins());
+    logLike_mles.resize(cache.nebins());
+    pos_errs.resize(cache.nebins());
+    neg_errs.resize(cache.nebins());
+    norms.resize(cache.nebins());    
+    logLikes.resize(cache.nebins());
+    uls.resize(cache.nebins());
+    sed_fit_status.resize(cache.nebins());
+
+    // The calling thread uses this cache, the others use worker copies.
+    // The workers copy the fit state set up above, and every bin is fit 
+    // from the same starting point, so the results don't depend on the 
+    // number of threads.  The pool can hand a bin to any of its threads, 
+    // so there is one cache per pool thread, even if there are fewer bins
+    size_t nthreads = ( pool != 0 && cache.nebins() > 1 ) ? pool->nthreads() : 1;
+    std::vector<FitScanCache*> caches(std::max(nthreads,size_t(1)),&cache);
+    for ( size_t i(1); i < caches.size(); i++ ) {
+      caches[i] = cache.makeWorker();
+    }
+    SEDBinTask task(caches,usePrior,verbose_scan(),nnorm,errorLevel,
+		    norm_mles,pos_errs,neg_errs,logLike_mles,uls,
+		    sed_fit_status,norms,logLikes);
+    try {
+      if ( caches.size() > 1 ) {
+	pool->run(task,cache.nebins());
+      } else {
+	for ( size_t i(0); i < cache.nebins(); i++ ) {
+	  task.run(i,0);
+	}
+      }
+    } catch (...) {
+      for ( size_t i(1); i < caches.size(); i++ ) {
+	delete caches[i];
+      }
+      cache.setEnergyBin(-1);
+      throw;
+    }
+    for ( size_t i(1); i < caches.size(); i++ ) {
+      delete caches[i];
+    }
 
     // This is to keep track of failed fits.
     // Usually they just have to do with problem
     // with the matrix inversion, so we might not want to crash
     int nfailed(0);
-
-    // Loop on the energy bins
-    for ( size_t i(0); i < m_cache->nebins(); i++ ) {
-      m_cache->setEnergyBin(i);
-      int status = m_cache->fitCurrent(usePrior ? FitScanCache::Local_Prior : FitScanCache::No_Prior,
-				       verbose_scan());
-      sed_fit_status[i] = status;
-      if ( status ) {
-	// if the fit failed, fill the output vectors, and move on.
-	// for debugging, redo failed fits with verbose on
-	if ( redoFailedVerbose ) {
-	  m_cache->fitCurrent(usePrior ? FitScanCache::Local_Prior : FitScanCache::No_Prior, 4);
-	}
-	nfailed++;
-	logLike_mles[i] = 0.;
-	norm_mles[i] = -1.;
-	pos_errs[i] = -1;
-	neg_errs[i] = -1;
-	uls[i] = -1;
-	norms[i].resize(nnorm,0.);
-	logLikes[i].resize(nnorm,0.);
-	continue;
-      }
-      // latch the information for the output vectors
-      logLike_mles[i] = m_cache->currentLogLike();
-      norm_mles[i] = m_cache->currentPars()[test_idx];
-      m_cache->signalUncertainty_quad(0.5,pos_errs[i],neg_errs[i]);
-      double negLim(0.);
-      double posLim(0.);
-      // estimate the upper limit
-      m_cache->signalUncertainty_quad(1.36,uls[i],negLim);
-      // now estimate the scan range
-      m_cache->signalUncertainty_quad(errorLevel,posLim,negLim); 
-      m_cache->scanNormalization(nnorm,1.0,posLim,negLim,norms[i],logLikes[i]);
-      if ( false ) {
-	std::cout << "Done scan " << i << ' ' << norm_mles[i] 
-		  << ' ' << norms[i].back() << ' ' << ( logLikes[i].back() - logLike_mles[i] ) << std::endl;
-      }
+    for ( size_t i(0); i < cache.nebins(); i++ ) {
+      if ( sed_fit_status[i] ) nfailed++;
     }
 
     // Reset the cache to do broadband fitting
-    m_cache->setEnergyBin(-1);
+    cache.setEnergyBin(-1);
     return nfailed;
   } 
 
@@ -11,6 +11,7 @@
 
 #include <cmath>
 
+#include <algorithm>
 #include <stdexcept>
 
 #include "gsl/gsl_matrix.h"
@@ -23,6 +24,7 @@
 #include "Likelihood/SourceModel.h"
 // #include "Likelihood/CountsMapBase.h"
 #include "Likelihood/BinnedLikelihood.h"
+#include "Likelihood/Convolve.h"
 #include "Likelihood/FitScanner.h"
 #include "Likelihood/WeightMap.h"
 
@@ -38,6 +40,9 @@ namespace Likelihood {
 
   namespace FitUtils {
 
+    /// Number of pixels per block in getGradientAndHessian
+    static const size_t s_hessianBlockSize(256);
+
     /// Integrates weights over a pixel to get the counts
     double pixelCounts_linearQuad(double emin, double emax, double y1, double y2) {
       return (y1 + y2)*(emax - emin)/2.;
@@ -615,41 +620,60 @@ namespace Likelihood {
 		       model.begin() + start, model.begin() + stop,
 		       w2.begin(),w2.end());
 
+      // Fold the weights into the per-pixel factors once, rather
+      // than in every inner product.
+      if ( weights != 0 ) {
+	std::vector<float>::const_iterator itr_w = weights->begin() + start;
+	for ( size_t k(0); k < sz; k++, itr_w++ ) {
+	  fdiff[k] *= *itr_w;
+	  w2[k] *= *itr_w;
+	}
+      }
+
+      // g_i = Sum fdiff * templates[i]
+      // h_ij = Sum w2 * templates[i] * templates[j], for j >= i
+      //
+      // All of the sums are done in one pass over the pixels, in
+      // blocks small enough that the template values for a block
+      // stay in cache while every (i,j) pair is formed from them.
+      // The partial sums are accumulated in double precision.
       size_t npar = norms.num_row();
+      std::vector<const float*> tmpls(npar);
       for ( size_t i(0); i < npar; i++ ) {
-	const std::vector<float>& tmpl_i = *(templates[i]);
-	float gval(0.);
-	// this is g_i = Sum fdiff * templates[i]
-	if ( weights != 0 ) {
-	  innerProduct( weights->begin() + start, weights->begin() + stop,
-		        fdiff.begin(), fdiff.end(),
-			tmpl_i.begin() + start, tmpl_i.begin() + stop, 
-			gval );
-	} else {
-	  innerProduct( fdiff.begin(), fdiff.end(),
-			tmpl_i.begin() + start, tmpl_i.begin() + stop, 
-			gval );
-	}
-	gradient[i] = gval;
-	// note that the inner loop starts at i.
-	// we only need elements at or above the diagonal
-	for ( size_t j(i); j < npar; j++ ) {
-	  const std::vector<float>& tmpl_j = *(templates[j]);
-	  float hval(0.);
-	  // this is h_ij = Sum w2 * templates[i] * templates[j] 
-	  if ( weights != 0 ) {
-	    innerProduct( weights->begin() + start, weights->begin() + stop,
-			  w2.begin(), w2.end(),
-			  tmpl_i.begin() + start, tmpl_i.begin() + stop, 
-			  tmpl_j.begin() + start, tmpl_j.begin() + stop, 
-			  hval );
-	  } else {
-	    innerProduct( w2.begin(), w2.end(),
-			  tmpl_i.begin() + start, tmpl_i.begin() + stop, 
-			  tmpl_j.begin() + start, tmpl_j.begin() + stop, 
-			  hval );
+	tmpls[i] = sz > 0 ? &((*templates[i])[start]) : 0;
+      }
+      std::vector<double> gsum(npar, 0.);
+      std::vector<double> hsum(npar*(npar+1)/2, 0.);
+      std::vector<double> w2t(s_hessianBlockSize);
+      for ( size_t k0(0); k0 < sz; k0 += s_hessianBlockSize ) {
+	size_t nk = std::min(s_hessianBlockSize, sz - k0);
+	const float* fd = &fdiff[k0];
+	const float* wt = &w2[k0];
+	size_t ih(0);
+	for ( size_t i(0); i < npar; i++ ) {
+	  const float* ti = tmpls[i] + k0;
+	  double gval(0.);
+	  for ( size_t k(0); k < nk; k++ ) {
+	    gval += double(fd[k])*ti[k];
+	    w2t[k] = double(wt[k])*ti[k];
 	  }
-	  hessian[i][j] = hval;
+	  gsum[i] += gval;
+	  for ( size_t j(i); j < npar; j++, ih++ ) {
+	    const float* tj = tmpls[j] + k0;
+	    double hval(0.);
+	    for ( size_t k(0); k < nk; k++ ) {
+	      hval += w2t[k]*tj[k];
+	    }
+	    hsum[ih] += hval;
+	  }
+	}
+      }
+
+      size_t ih(0);
+      for ( size_t i(0); i < npar; i++ ) {
+	gradient[i] = gsum[i];
+	for ( size_t j(i); j < npar; j++, ih++ ) {
+	  hessian[i][j] = hsum[ih];
 	}
       }
       
@@ -831,11 +855,13 @@ namespace Likelihood {
 			double& logLikeVal,
 			size_t firstBin, 
 			size_t lastBin,
-			int verbose) {
+			int verbose,
+			int* nIter) {
 
 
       // copy over the initial parameters
       norms = initNorms;
+      if ( nIter != 0 ) *nIter = 0;
       
       // local stuff
       size_t npar = initNorms.num_row();
@@ -894,6 +920,7 @@ namespace Likelihood {
 	// do the derivative stuff
 	getGradientAndHessian(data,norms,templates,fixed,prior,weights,model,
 			      gradient,hessian,firstBin,lastBin,verbose);
+	if ( nIter != 0 ) *nIter = iter + 1;
 	if ( verbose > 2 ) {
 	  printMatrix("Hesse: ",hessian);
 	  printVector("Grad: ",gradient);
@@ -1864,6 +1891,225 @@ namespace Likelihood {
       return (logTerm-nPred);
     }
 
+    void logLikePoissonScan(const std::vector<float>& data,
+			    const std::vector<float>& fixed,
+			    const std::vector<float>& test,
+			    const std::vector<double>& norms,
+			    std::vector<double>& logLikes,
+			    const std::vector<float>* weights,
+			    size_t firstBin,
+			    size_t lastBin) {
+      size_t nbin = data.size();
+      if ( fixed.size() != nbin || test.size() != nbin ) {
+	throw std::runtime_error("Size of model does not match size of data in FitUtils::logLikePoissonScan.");
+	return;
+      }
+      if ( weights != 0 && weights->size() != nbin ) {
+	throw std::runtime_error("Size of weights does not match size of data in FitUtils::logLikePoissonScan.");
+	return;
+      }
+      if ( lastBin == 0 ) lastBin = nbin;
+      size_t nnorm = norms.size();
+      logLikes.assign(nnorm,0.);
+      if ( nnorm == 0 ) return;
+
+      // The model is linear in the normalization, so in each bin
+      // it is smallest at one of the ends of the scan
+      double normMin = *std::min_element(norms.begin(),norms.end());
+      double normMax = *std::max_element(norms.begin(),norms.end());
+
+      // As in logLikePoisson, the predicted counts and the log terms are summed
+      // separately.  The predicted counts are also linear in the normalization,
+      // so we only need the sums of the two templates.
+      double nPredFixed(0.);
+      double nPredTest(0.);
+      std::vector<double> logTerms(nnorm,0.);
+      const double* normPtr = &norms[0];
+      double* logPtr = &logTerms[0];
+      for ( size_t i(firstBin); i < lastBin; i++ ) {
+	double w = weights != 0 ? (*weights)[i] : 1.;
+	double f = fixed[i];
+	double t = test[i];
+	double modelMin = std::min(f + normMin*t, f + normMax*t);
+	if ( modelMin < 0. ) {
+	  throw std::runtime_error("Negative model counts in FitUtils::logLikePoissonScan.");
+	  return;
+	}
+	nPredFixed += w*f;
+	nPredTest += w*t;
+	double dw = w*data[i];
+	// logs are expensive, don't do this unless the weighted number of data counts is > 0.
+	if ( dw > 1e-9 ) {
+	  if ( modelMin <= 0. ) {
+	    throw std::runtime_error("Negative or zero model counts for pixel with data counts in FitUtils::logLikePoissonScan.");
+	  }
+	  for ( size_t j(0); j < nnorm; j++ ) {
+	    logPtr[j] += dw * std::log(f + normPtr[j]*t);
+	  }
+	}
+      }
+      for ( size_t j(0); j < nnorm; j++ ) {
+	logLikes[j] = logTerms[j] - ( nPredFixed + norms[j]*nPredTest );
+      }
+    }
+
+    void fitShiftedNorms_fft(size_t nx, size_t ny, size_t ne,
+			     const std::vector<float>& data,
+			     const std::vector<float>& bkg,
+			     const std::vector<float>& ref,
+			     const std::vector<float>* weights,
+			     std::vector<double>& norms,
+			     std::vector<double>& deltaLogLikes,
+			     std::vector<double>& curvatures,
+			     std::vector<double>& maxRatios) {
+      // Number of Newton steps for the normalization at each shift
+      static const int nNewton(5);
+      // Power of the norm used to bound the largest ratio
+      static const double boundPow(8.);
+
+      const size_t nmap = nx*ny;
+      if ( data.size() != nmap*ne || bkg.size() != data.size() || ref.size() != data.size() ) {
+	throw std::runtime_error("Size of model does not match size of data in FitUtils::fitShiftedNorms_fft.");
+      }
+      if ( weights != 0 && weights->size() != data.size() ) {
+	throw std::runtime_error("Size of weights does not match size of data in FitUtils::fitShiftedNorms_fft.");
+      }
+
+      // The sums for each shift
+      const size_t nshift = (2*nx-1)*(2*ny-1);
+      std::vector<double> grad(nshift,0.);
+      std::vector<std::vector<double> > moments(3,std::vector<double>(nshift,0.));
+      maxRatios.assign(nshift,0.);
+
+      std::vector<double> signal(nmap);
+      std::vector<double> kernel(nmap);
+      std::vector<double> corr;
+      for ( size_t ie(0); ie < ne; ie++ ) {
+	size_t offset = ie*nmap;
+	// The weights correlated with the image
+	for ( size_t i(0); i < nmap; i++ ) {
+	  kernel[i] = ref[offset+i];
+	  signal[i] = weights ? (*weights)[offset+i] : 1.;
+	}
+	Convolve::correlate2d(nx,ny,signal,kernel,corr);
+	for ( size_t k(0); k < nshift; k++ ) grad[k] -= corr[k];
+	// Powers of d/b correlated with powers of the image
+	for ( size_t ipow(1); ipow <= 4; ipow++ ) {
+	  for ( size_t i(0); i < nmap; i++ ) {
+	    double b = bkg[offset+i];
+	    double d = data[offset+i];
+	    double w = weights ? (*weights)[offset+i] : 1.;
+	    kernel[i] = std::pow(double(ref[offset+i]),double(ipow));
+	    signal[i] = ( b > 0 && d > 0 ) ? w*d/std::pow(b,double(ipow)) : 0.;
+	  }
+	  Convolve::correlate2d(nx,ny,signal,kernel,corr);
+	  std::vector<double>& sum = ipow == 1 ? grad : moments[ipow-2];
+	  for ( size_t k(0); k < nshift; k++ ) sum[k] += corr[k];
+	}
+	// The 8-norm of ref/bkg over the bins with data bounds its maximum.
+	// Both are scaled to at most one so that the powers cannot overflow.
+	double refMax(0.);
+	double bkgMin(0.);
+	for ( size_t i(0); i < nmap; i++ ) {
+	  double b = bkg[offset+i];
+	  refMax = std::max(refMax,double(ref[offset+i]));
+	  if ( b > 0 && data[offset+i] > 0 && ( bkgMin == 0 || b < bkgMin ) ) bkgMin = b;
+	}
+	if ( refMax <= 0 || bkgMin <= 0 ) continue;
+	for ( size_t i(0); i < nmap; i++ ) {
+	  double b = bkg[offset+i];
+	  kernel[i] = std::pow(std::max(double(ref[offset+i]),0.)/refMax,boundPow);
+	  signal[i] = ( b > 0 && data[offset+i] > 0 ) ? std::pow(bkgMin/b,boundPow) : 0.;
+	}
+	Convolve::correlate2d(nx,ny,signal,kernel,corr);
+	for ( size_t k(0); k < nshift; k++ ) {
+	  double bound = refMax/bkgMin*std::pow(std::max(corr[k],0.),1./boundPow);
+	  maxRatios[k] = std::max(maxRatios[k],bound);
+	}
+      }
+
+      // Maximize dL(n) for each shift, with n >= 0
+      const std::vector<double>& m2 = moments[0];
+      const std::vector<double>& m3 = moments[1];
+      const std::vector<double>& m4 = moments[2];
+      norms.assign(nshift,0.);
+      for ( size_t k(0); k < nshift; k++ ) {
+	norms[k] = m2[k] > 0 ? std::max(grad[k]/m2[k],0.) : 0.;
+      }
+      for ( int iter(0); iter < nNewton; iter++ ) {
+	for ( size_t k(0); k < nshift; k++ ) {
+	  double n = norms[k];
+	  double d1 = grad[k] - n*m2[k] + n*n*m3[k] - n*n*n*m4[k];
+	  double d2 = -m2[k] + 2.*n*m3[k] - 3.*n*n*m4[k];
+	  if ( d2 < 0 ) {
+	    norms[k] = std::max(n - d1/d2,0.);
+	  }
+	}
+      }
+      deltaLogLikes.resize(nshift);
+      curvatures.resize(nshift);
+      for ( size_t k(0); k < nshift; k++ ) {
+	double n = norms[k];
+	deltaLogLikes[k] = n*grad[k] - n*n*m2[k]/2. + n*n*n*m3[k]/3. - n*n*n*n*m4[k]/4.;
+	curvatures[k] = -m2[k] + 2.*n*m3[k] - 3.*n*n*m4[k];
+      }
+    }
+
+    void fitShiftedNorm_exact(size_t nx, size_t ny, size_t ne, int dx, int dy,
+			      const std::vector<float>& data,
+			      const std::vector<float>& bkg,
+			      const std::vector<float>& ref,
+			      const std::vector<float>* weights,
+			      double& norm,
+			      double& deltaLogLike,
+			      double& curvature) {
+      static const int maxIter(50);
+      static const double tol(1e-8);
+      const size_t nmap = nx*ny;
+      if ( data.size() != nmap*ne || bkg.size() != data.size() || ref.size() != data.size() ) {
+	throw std::runtime_error("Size of model does not match size of data in FitUtils::fitShiftedNorm_exact.");
+      }
+      // The bins of the map that the shifted image overlaps
+      int xmin = std::max(dx,0);
+      int xmax = std::min(int(nx),int(nx)+dx);
+      int ymin = std::max(dy,0);
+      int ymax = std::min(int(ny),int(ny)+dy);
+      norm = std::max(norm,0.);
+      bool converged(false);
+      for ( int iter(0); ; iter++ ) {
+	double d1(0.);
+	deltaLogLike = 0.;
+	curvature = 0.;
+	for ( size_t ie(0); ie < ne; ie++ ) {
+	  for ( int y(ymin); y < ymax; y++ ) {
+	    for ( int x(xmin); x < xmax; x++ ) {
+	      double r = ref[ie*nmap + (y-dy)*nx + (x-dx)];
+	      if ( r <= 0 ) continue;
+	      size_t i = ie*nmap + y*nx + x;
+	      double w = weights ? (*weights)[i] : 1.;
+	      double b = bkg[i];
+	      double d = data[i];
+	      deltaLogLike -= w*norm*r;
+	      d1 -= w*r;
+	      if ( b > 0 && d > 0 ) {
+		double m = b + norm*r;
+		deltaLogLike += w*d*std::log(m/b);
+		d1 += w*d*r/m;
+		curvature -= w*d*r*r/(m*m);
+	      }
+	    }
+	  }
+	}
+	if ( converged || iter == maxIter ) break;
+	// The derivative is convex and decreasing in n, so after the first step 
+	// Newton's method approaches the maximum from below.
+	// With no data under the image, dL is linear and decreasing.
+	double newNorm = curvature < 0 ? std::max(norm - d1/curvature,0.) : 0.;
+	converged = std::fabs(newNorm - norm) <= tol*std::max(norm,1.);
+	norm = newNorm;
+      }
+    }
+
     int fitModelNorms_newton(const BinnedLikelihood& logLike,
 			     const std::string& test_name,
 			     double tol, int maxIter, double initLambda,
@@ -16,23 +16,518 @@
 
 #include "st_stream/StreamFormatter.h"
 
+#include "optimizers/dArg.h"
+
 #include "Likelihood/Exception.h"
 #include "Likelihood/DiffuseSource.h"
+#include "Likelihood/EventContainer.h"
 #include "Likelihood/LogLike.h"
 #include "Likelihood/Npred.h"
 #include "Likelihood/SrcArg.h"
+#include "Likelihood/ThreadPool.h"
+
+namespace {
+// Number of events per work item in the threaded event sums.  The
+// partial sums for each block are combined in block order, so the
+// results do not depend on the number of threads.
+   const size_t s_eventBlockSize(2048);
+
+/// The log of the model density for an event, with the handling of
+/// non-positive values used by LogLike.
+   double log_density(double value, size_t nsrcs) {
+      if (value > 0) {
+         return std::log(value);
+      }
+      if (::getenv("LOGLIKE_CATCH_NEG_PROB")) {
+         throw std::runtime_error("negative probability density "
+                                  "for this event.");
+      }
+      if (nsrcs == 1) {
+         // special case of a single source in the model
+         return 0;
+      }
+      return -1e30;
+   }
+
+/**
+ * @class SpectralSumTask
+ * @brief Sum over one block of events of log(sum_s spec_s(E_j)*R_sj)
+ * for the spectral-only fast path and, optionally, of its derivatives
+ * wrt the free parameters.
+ */
+   class SpectralSumTask : public Likelihood::ThreadPool::Task {
+   public:
+      /// @param resps Responses times efficiency, [source][event]
+      /// @param energyIndices Index of each event's energy
+      /// @param specValues Spectral values, [source][energy]
+      /// @param specDerivs Spectral derivatives, [parameter][energy],
+      ///        or zero if derivatives are not needed
+      /// @param paramSources Source index of each free parameter
+      /// @param eventIndices If non-zero, the indices of the events
+      ///        to be included; otherwise all events are summed
+      SpectralSumTask(const std::vector<double> & resps,
+                      const std::vector<size_t> & energyIndices,
+                      const std::vector<double> & specValues,
+                      const std::vector<double> * specDerivs,
+                      const std::vector<size_t> & paramSources,
+                      const std::vector<size_t> * eventIndices)
+         : m_resps(resps), m_energyIndices(energyIndices),
+           m_specValues(specValues), m_specDerivs(specDerivs),
+           m_paramSources(paramSources), m_eventIndices(eventIndices),
+           m_nevents(energyIndices.size()),
+           m_nitems(eventIndices ? eventIndices->size() : m_nevents),
+           m_nsrcs(m_nevents > 0 ? resps.size()/m_nevents : 0),
+           m_nee(m_nsrcs > 0 ? specValues.size()/m_nsrcs : 0),
+           m_sums((m_nitems + s_eventBlockSize - 1)/s_eventBlockSize, 0) {
+         if (m_specDerivs) {
+            m_derivs.resize(m_sums.size(),
+                            std::vector<double>(paramSources.size(), 0));
+         }
+      }
+
+      size_t nblocks() const {
+         return m_sums.size();
+      }
+
+      const std::vector<double> & sums() const {
+         return m_sums;
+      }
+
+      const std::vector<double> & derivs(size_t block) const {
+         return m_derivs.at(block);
+      }
+
+      virtual void run(size_t block, size_t) {
+         size_t jmin(block*s_eventBlockSize);
+         size_t jmax(std::min(m_nitems, jmin + s_eventBlockSize));
+         size_t nj(jmax - jmin);
+         std::vector<size_t> events(nj);
+         for (size_t j(0); j < nj; j++) {
+            events[j] = m_eventIndices ? (*m_eventIndices)[jmin + j] : jmin + j;
+         }
+// Accumulate the model densities source by source so that the
+// responses are read in event order.
+         std::vector<double> density(nj, 0);
+         for (size_t i(0); i < m_nsrcs; i++) {
+            const double * resps(&m_resps[i*m_nevents]);
+            const double * spec(&m_specValues[i*m_nee]);
+            for (size_t j(0); j < nj; j++) {
+               density[j] += spec[m_energyIndices[events[j]]]*resps[events[j]];
+            }
+         }
+         Likelihood::Kahan_Accumulator accumulator;
+         for (size_t j(0); j < nj; j++) {
+            double logDensity(log_density(density[j], m_nsrcs));
+            accumulator.add(logDensity);
+            density[j] = std::exp(logDensity);
+         }
+         m_sums[block] = accumulator.total();
+         if (m_specDerivs == 0) {
+            return;
+         }
+         std::vector<double> & derivs(m_derivs[block]);
+         for (size_t k(0); k < m_paramSources.size(); k++) {
+            size_t isrc(m_paramSources[k]);
+            const double * resps(&m_resps[isrc*m_nevents]);
+            const double * specDeriv(&(*m_specDerivs)[k*m_nee]);
+            double sum(0);
+            for (size_t j(0); j < nj; j++) {
+               sum += specDeriv[m_energyIndices[events[j]]]*resps[events[j]]
+                  /density[j];
+            }
+            derivs[k] = sum;
+         }
+      }
+
+   private:
+      const std::vector<double> & m_resps;
+      const std::vector<size_t> & m_energyIndices;
+      const std::vector<double> & m_specValues;
+      const std::vector<double> * m_specDerivs;
+      const std::vector<size_t> & m_paramSources;
+      const std::vector<size_t> * m_eventIndices;
+      size_t m_nevents;
+      size_t m_nitems;
+      size_t m_nsrcs;
+      size_t m_nee;
+      std::vector<double> m_sums;
+      std::vector< std::vector<double> > m_derivs;
+   };
+}
 
 namespace Likelihood {
 
+/**
+ * @class LogLike::EventWorkers
+ * @brief Thread pool and per-thread copies of the Sources.  The
+ * spectral Functions cache intermediate results, so each thread
+ * evaluates its own clones; thread 0 uses the original Sources.
+ */
+class LogLike::EventWorkers {
+public:
+   EventWorkers(size_t nthreads) : m_pool(nthreads) {
+      m_srcLists.resize(m_pool.nthreads());
+   }
+
+   ~EventWorkers() {
+      deleteClones();
+   }
+
+   ThreadPool & pool() {
+      return m_pool;
+   }
+
+   const SourceList & sourceList(size_t thread_id) const {
+      return m_srcLists[thread_id];
+   }
+
+   /// Ensure the clones match the current source list and copy the
+   /// current spectral parameters to them.
+   void sync(const SourceList & srcList) {
+      const std::vector<Source *> & sources(srcList.sources);
+      if (sources != m_srcLists[0].sources) {
+         deleteClones();
+         for (size_t i(1); i < m_srcLists.size(); i++) {
+            for (size_t j(0); j < sources.size(); j++) {
+               m_srcLists[i].sources.push_back(sources[j]->clone());
+            }
+         }
+      }
+      for (size_t i(0); i < m_srcLists.size(); i++) {
+         m_srcLists[i].updateModelSum = srcList.updateModelSum;
+         m_srcLists[i].cacheIndices = srcList.cacheIndices;
+         m_srcLists[i].freeParamNames = srcList.freeParamNames;
+      }
+      m_srcLists[0].sources = sources;
+      std::vector<optimizers::Parameter> params;
+      for (size_t j(0); j < sources.size(); j++) {
+         sources[j]->spectrum().getParams(params);
+         for (size_t i(1); i < m_srcLists.size(); i++) {
+            optimizers::Function & 
+               spectrum(m_srcLists[i].sources[j]->spectrum());
+            for (size_t k(0); k < params.size(); k++) {
+               spectrum.setParam(params[k]);
+            }
+         }
+      }
+   }
+
+private:
+
+   ThreadPool m_pool;
+
+   std::vector<SourceList> m_srcLists;
+
+   void deleteClones() {
+      for (size_t i(1); i < m_srcLists.size(); i++) {
+         for (size_t j(0); j < m_srcLists[i].sources.size(); j++) {
+            delete m_srcLists[i].sources[j];
+         }
+         m_srcLists[i].sources.clear();
+      }
+      m_srcLists[0].sources.clear();
+   }
+};
+
+void LogLike::EventWorkersPtr::reset(EventWorkers * ptr) {
+   delete m_ptr;
+   m_ptr = ptr;
+}
+
+/**
+ * @class LogLike::ValueTask
+ * @brief Sums log(source model) over one block of events.
+ */
+class LogLike::ValueTask : public ThreadPool::Task {
+public:
+   ValueTask(const LogLike & logLike, EventWorkers & workers)
+      : m_logLike(logLike), m_workers(workers),
+        m_events(logLike.m_observation.eventCont().events()),
+        m_eventIndices(logLike.eventSubset()),
+        m_nitems(m_eventIndices ? m_eventIndices->size() : m_events.size()),
+        m_sums((m_nitems + s_eventBlockSize - 1)/s_eventBlockSize, 0) {}
+
+   size_t nblocks() const {
+      return m_sums.size();
+   }
+
+   const std::vector<double> & sums() const {
+      return m_sums;
+   }
+
+   virtual void run(size_t block, size_t thread_id) {
+      const SourceList & srcList(m_workers.sourceList(thread_id));
+      size_t kmax(std::min(m_nitems, (block + 1)*s_eventBlockSize));
+      Kahan_Accumulator accumulator;
+      for (size_t k(block*s_eventBlockSize); k < kmax; k++) {
+         size_t j(m_eventIndices ? (*m_eventIndices)[k] : k);
+         ResponseCache::EventRef rc_ref = m_logLike.m_respCache.getEventRef(j);
+         accumulator.add(m_logLike.logSourceModel(m_events[j], srcList,
+                                                  &rc_ref));
+      }
+      m_sums[block] = accumulator.total();
+   }
+
+private:
+   const LogLike & m_logLike;
+   EventWorkers & m_workers;
+   const std::vector<Event> & m_events;
+   const std::vector<size_t> * m_eventIndices;
+   size_t m_nitems;
+   std::vector<double> m_sums;
+};
+
+/**
+ * @class LogLike::DerivsTask
+ * @brief Sums the derivatives of log(source model) wrt the free
+ * parameters over one block of events.
+ */
+class LogLike::DerivsTask : public ThreadPool::Task {
+public:
+   DerivsTask(const LogLike & logLike, EventWorkers & workers, size_t nfree)
+      : m_logLike(logLike), m_workers(workers),
+        m_events(logLike.m_observation.eventCont().events()),
+        m_eventIndices(logLike.eventSubset()),
+        m_nitems(m_eventIndices ? m_eventIndices->size() : m_events.size()),
+        m_derivs((m_nitems + s_eventBlockSize - 1)/s_eventBlockSize,
+                 std::vector<double>(nfree, 0)) {}
+
+   size_t nblocks() const {
+      return m_derivs.size();
+   }
+
+   const std::vector<double> & derivs(size_t block) const {
+      return m_derivs[block];
+   }
+
+   virtual void run(size_t block, size_t thread_id) {
+      const SourceList & srcList(m_workers.sourceList(thread_id));
+      size_t kmax(std::min(m_nitems, (block + 1)*s_eventBlockSize));
+      std::vector<double> & blockDerivs(m_derivs[block]);
+      std::vector<double> derivs;
+      for (size_t k(block*s_eventBlockSize); k < kmax; k++) {
+         size_t j(m_eventIndices ? (*m_eventIndices)[k] : k);
+         ResponseCache::EventRef rc_ref = m_logLike.m_respCache.getEventRef(j);
+         m_logLike.getLogSourceModelDerivs(m_events[j], srcList, derivs,
+                                           &rc_ref);
+         for (size_t i(0); i < derivs.size(); i++) {
+            blockDerivs[i] += derivs[i];
+         }
+      }
+   }
+
+private:
+   const LogLike & m_logLike;
+   EventWorkers & m_workers;
+   const std::vector<Event> & m_events;
+   const std::vector<size_t> * m_eventIndices;
+   size_t m_nitems;
+   std::vector< std::vector<double> > m_derivs;
+};
+
 LogLike::LogLike(const Observation & observation) 
   : SourceModel(observation), m_nevals(0), m_bestValueSoFar(-1e38),
     m_Npred(), m_accumulator(), m_npredValues(),    
-    m_respCache(), m_use_ebounds(false), m_emin(0), m_emax(0) {
+    m_respCache(), m_use_ebounds(false), m_emin(0), m_emax(0),
+    m_useSpectralFastPath(false), m_specResps(),
+    m_nthreads(1), m_respCacheFilled(false), m_eboundCacheFilled(false),
+    m_updateEventModelSums(true) {
    const std::vector<Event> & events = m_observation.eventCont().events();
    m_respCache.clearAndResize(events.size());
    deleteAllSources();
 }
 
+void LogLike::setNumThreads(int nthreads) {
+   m_nthreads = ThreadPool::resolveThreads(nthreads);
+   m_workers.reset(0);
+}
+
+void LogLike::getSourceList(SourceList & srcList) const {
+   srcList.sources.clear();
+   srcList.updateModelSum.clear();
+   srcList.cacheIndices.clear();
+   srcList.freeParamNames.clear();
+   std::map<std::string, Source *>::const_iterator 
+      source(m_sources.begin());
+   for ( ; source != m_sources.end(); ++source) {
+      srcList.sources.push_back(source->second);
+      srcList.updateModelSum.push_back(m_updateEventModelSums &&
+                                       std::count(m_freeSrcs.begin(),
+                                                  m_freeSrcs.end(),
+                                                  source->second) > 0);
+      srcList.cacheIndices.push_back(m_respCache.addSource(source->first));
+      srcList.freeParamNames.push_back(std::vector<std::string>());
+      source->second->spectrum()
+         .getFreeParamNames(srcList.freeParamNames.back());
+   }
+}
+
+bool LogLike::spectralFastPath(const SourceList & srcList) const {
+   if (!m_useSpectralFastPath || !respCacheFilled()) {
+      return false;
+   }
+   if (!m_specResps.valid || m_specResps.sources != srcList.sources) {
+      m_specResps.valid = true;
+      m_specResps.sources = srcList.sources;
+      m_specResps.usable = computeSpectralResponses(srcList);
+      if (!m_specResps.usable) {
+         m_specResps.resps.clear();
+      }
+   }
+   return m_specResps.usable;
+}
+
+bool LogLike::computeSpectralResponses(const SourceList & srcList) const {
+   const std::vector<Event> & events = m_observation.eventCont().events();
+   const EventColumns & columns(m_observation.eventCont().columns());
+   size_t nevents(events.size());
+   if (nevents == 0 || columns.size() != nevents) {
+      return false;
+   }
+// Only the events in the sums are filled in; the entries for the
+// others are left at zero.
+   const std::vector<size_t> * eventIndices(eventSubset());
+   size_t nitems(eventIndices ? eventIndices->size() : nevents);
+   const std::vector<Source *> & sources(srcList.sources);
+   std::vector<double> & resps(m_specResps.resps);
+   resps.assign(sources.size()*nevents, 0);
+   for (size_t i(0); i < sources.size(); i++) {
+      double * srcResps(&resps[i*nevents]);
+      if (sources[i]->srcType() == Source::Point) {
+// The point source responses are all in the response cache after
+// a full serial pass.
+         for (size_t k(0); k < nitems; k++) {
+            size_t j(eventIndices ? (*eventIndices)[k] : k);
+            CachedResponse 
+               resp(m_respCache.getCachedValue(srcList.cacheIndices[i], j));
+            if (!resp.first) {
+               return false;
+            }
+            srcResps[j] = resp.second*events[j].efficiency();
+         }
+      } else if (sources[i]->srcType() == Source::Diffuse) {
+         const std::string & 
+            component(events[0].diffuseSrcName(sources[i]->getName()));
+         int icomp(columns.componentIndex(component));
+         if (icomp < 0 || !columns.haveAllDiffuseResponses(icomp)) {
+            return false;
+         }
+         const std::vector<double> & 
+            diffResps(columns.diffuseResponses(icomp));
+         for (size_t k(0); k < nitems; k++) {
+            size_t j(eventIndices ? (*eventIndices)[k] : k);
+            srcResps[j] = diffResps[j]*events[j].efficiency();
+         }
+      } else {
+         return false;
+      }
+   }
+// The spectra need only be evaluated at the distinct event energies.
+   std::vector<double> & energies(m_specResps.energies);
+   energies.clear();
+   energies.reserve(nitems);
+   for (size_t k(0); k < nitems; k++) {
+      energies.push_back(events[eventIndices ? 
+                                (*eventIndices)[k] : k].getEnergy());
+   }
+   std::sort(energies.begin(), energies.end());
+   energies.erase(std::unique(energies.begin(), energies.end()),
+                  energies.end());
+   std::vector<size_t> & energyIndices(m_specResps.energyIndices);
+   energyIndices.assign(nevents, 0);
+   for (size_t k(0); k < nitems; k++) {
+      size_t j(eventIndices ? (*eventIndices)[k] : k);
+      energyIndices[j] = std::lower_bound(energies.begin(), energies.end(),
+                                          events[j].getEnergy())
+         - energies.begin();
+   }
+   return true;
+}
+
+void LogLike::evaluateSpectra(const SourceList & srcList,
+                              std::vector<double> & values,
+                              std::vector<double> * derivs) const {
+   const std::vector<double> & energies(m_specResps.energies);
+   size_t nee(energies.size());
+   const std::vector<Source *> & sources(srcList.sources);
+   values.resize(sources.size()*nee);
+   if (derivs) {
+      derivs->clear();
+      derivs->reserve(getNumFreeParams()*nee);
+   }
+   for (size_t i(0); i < sources.size(); i++) {
+      const optimizers::Function & spectrum(sources[i]->spectrum());
+      for (size_t k(0); k < nee; k++) {
+         optimizers::dArg energy_arg(energies[k]);
+         values[i*nee + k] = spectrum(energy_arg);
+      }
+      if (derivs == 0) {
+         continue;
+      }
+      const std::vector<std::string> & paramNames(srcList.freeParamNames[i]);
+      for (size_t p(0); p < paramNames.size(); p++) {
+// Follow the Source::fluxDensityDeriv implementations in using the
+// ratio to the prefactor for normalization parameters.
+         double prefactor(0);
+         if (paramNames[p] == "Prefactor") {
+            prefactor = spectrum.getParamValue("Prefactor");
+         }
+         for (size_t k(0); k < nee; k++) {
+            if (prefactor != 0) {
+               derivs->push_back(values[i*nee + k]/prefactor);
+            } else {
+               optimizers::dArg energy_arg(energies[k]);
+               derivs->push_back(spectrum.derivByParam(energy_arg,
+                                                       paramNames[p]));
+            }
+         }
+      }
+   }
+}
+
+void LogLike::updateEventModelSums() {
+   const std::vector<Event> & events = m_observation.eventCont().events();
+   SourceList srcList;
+   getSourceList(srcList);
+   for (size_t j(0); j < events.size(); j++) {
+      for (size_t i(0); i < srcList.sources.size(); i++) {
+         unsigned isrc(srcList.cacheIndices[i]);
+         CachedResponse resp(m_respCache.getCachedValue(isrc, j));
+         const_cast<Event &>(events[j]).updateModelSum(*srcList.sources[i],
+                                                       &resp);
+         m_respCache.setCachedValue(isrc, j, resp);
+      }
+   }
+}
+
+ThreadPool * LogLike::threadPool() const {
+   if (m_nthreads < 2) {
+      return 0;
+   }
+   if (m_workers.get() == 0) {
+      m_workers.reset(new EventWorkers(m_nthreads));
+   }
+   return &m_workers.get()->pool();
+}
+
+LogLike::EventWorkers * LogLike::eventWorkers() const {
+   if (m_nthreads < 2 || !respCacheFilled()) {
+      return 0;
+   }
+// Only point and diffuse sources provide clones and use the response
+// cache in a way that keeps IRF evaluations out of the event loop.
+   std::map<std::string, Source *>::const_iterator 
+      source(m_sources.begin());
+   for ( ; source != m_sources.end(); ++source) {
+      if (source->second->srcType() != Source::Point &&
+          source->second->srcType() != Source::Diffuse) {
+         return 0;
+      }
+   }
+   threadPool();
+   return m_workers.get();
+}
+
 double LogLike::value(const optimizers::Arg& dummy, 
 		      bool include_prior) const {
    std::clock_t start = std::clock();
@@ -49,17 +544,56 @@ double LogLike::value(const optimizers::Arg& dummy,
    double my_value(0);
    double logSourceModelSum(0);
    double NpredSum(0);
+   SourceList srcList;
+   getSourceList(srcList);
 // The "data sum"
-   for (size_t j = 0; j < events.size(); j++) {
-      if (m_use_ebounds && 
-          (events[j].getEnergy() < m_emin || events[j].getEnergy() > m_emax)) {
-         continue;
+   EventWorkers * workers(0);
+   if (spectralFastPath(srcList)) {
+      std::vector<double> specValues;
+      evaluateSpectra(srcList, specValues);
+      std::vector<size_t> paramSources;
+      SpectralSumTask task(m_specResps.resps, m_specResps.energyIndices,
+                           specValues, 0, paramSources, eventSubset());
+      ThreadPool * pool(threadPool());
+      if (pool) {
+         pool->run(task, task.nblocks());
+      } else {
+         for (size_t i(0); i < task.nblocks(); i++) {
+            task.run(i, 0);
+         }
+      }
+      for (size_t i(0); i < task.nblocks(); i++) {
+         double addend(task.sums()[i]);
+         my_value += addend;
+         m_accumulator.add(addend);
+         logSourceModelSum += addend;
+      }
+   } else if ((workers = eventWorkers())) {
+      workers->sync(srcList);
+      ValueTask task(*this, *workers);
+      workers->pool().run(task, task.nblocks());
+      for (size_t i(0); i < task.nblocks(); i++) {
+         double addend(task.sums()[i]);
+         my_value += addend;
+         m_accumulator.add(addend);
+         logSourceModelSum += addend;
+      }
+   } else {
+      const std::vector<size_t> * eventIndices(eventSubset());
+      size_t nitems(eventIndices ? eventIndices->size() : events.size());
+      for (size_t k = 0; k < nitems; k++) {
+         size_t j(eventIndices ? (*eventIndices)[k] : k);
+         ResponseCache::EventRef rc_ref = m_respCache.getEventRef(j);
+         double addend(logSourceModel(events.at(j), srcList, &rc_ref));
+         my_value += addend;
+         m_accumulator.add(addend);
+         logSourceModelSum += addend;
+      }
+      if (m_use_ebounds) {
+         m_eboundCacheFilled = true;
+      } else {
+         m_respCacheFilled = true;
       }
-      ResponseCache::EventRef rc_ref = m_respCache.getEventRef(j);
-      double addend(logSourceModel(events.at(j), &rc_ref));
-      my_value += addend;
-      m_accumulator.add(addend);
-      logSourceModelSum += addend;
    }
 //   std::cout << "data sum: " << my_value << std::endl;
 
@@ -110,6 +644,7 @@ double LogLike::value(const optimizers::Arg& dummy,
 }
 
 double LogLike::logSourceModel(const Event & event,
+                               const SourceList & srcList,
 			       ResponseCache::EventRef* srcRespCache) const {
    double my_value(0);
 // This part was commented out in v15r8p2 (Feb 8, 2010), either for
@@ -125,21 +660,27 @@ double LogLike::logSourceModel(const Event & event,
    //    }
    //    my_value = event.modelSum();
    // } else {
-      std::map<std::string, Source *>::const_iterator 
-         source(m_sources.begin());
-      for ( ; source != m_sources.end(); ++source) {
+      const std::vector<Source *> & sources(srcList.sources);
+      for (size_t i(0); i < sources.size(); i++) {
+         const Source * source(sources[i]);
+         CachedResponse resp(false, 0);
          CachedResponse* cResp=0;
          if (srcRespCache) {
-            cResp = &srcRespCache->getCachedValue(source->second->getName());
+            resp = srcRespCache->getCachedValue(srcList.cacheIndices[i]);
+            cResp = &resp;
          }
+         bool wasCached(resp.first);
 // Event::modelSum() will be used for the per event source
 // probabilities so we need to update the Event::m_modelSum value.
-         if (std::count(m_freeSrcs.begin(), m_freeSrcs.end(), source->second)) {
-            const_cast<Event &>(event).updateModelSum(*source->second, cResp);
+         if (srcList.updateModelSum[i]) {
+            const_cast<Event &>(event).updateModelSum(*source, cResp);
          }
-         double fluxDens(source->second->fluxDensity(event, cResp));
+         double fluxDens(source->fluxDensity(event, cResp));
          fluxDens *= event.efficiency();
          my_value += fluxDens;
+         if (srcRespCache && !wasCached) {
+            srcRespCache->setCachedValue(srcList.cacheIndices[i], resp);
+         }
       }
 //       if (my_value > 0 && 
 //           std::fabs((my_value - event.modelSum())/my_value) > 1e-5) {
@@ -148,54 +689,31 @@ double LogLike::logSourceModel(const Event & event,
 //                    << event.modelSum() << std::endl;
 //       }
    // }
-   if (my_value > 0) {
-      return std::log(my_value);
-   }
-   if (::getenv("LOGLIKE_CATCH_NEG_PROB")) {
-      throw std::runtime_error("negative probability density for this event.");
-   }
-   if (m_sources.size() == 1) {
-      // special case of a single source in the model
-      return 0;
-   }
-   return -1e30;
+   return log_density(my_value, sources.size());
 }
 
 void LogLike::getLogSourceModelDerivs(const Event & event,
+                                      const SourceList & srcList,
                                       std::vector<double> & derivs,
 				 ResponseCache::EventRef* srcRespCache) const {
    derivs.clear();
    derivs.reserve(getNumFreeParams());
-   double my_logSourceModel = logSourceModel(event, srcRespCache);
+   double my_logSourceModel = logSourceModel(event, srcList, srcRespCache);
    double srcSum = std::exp(my_logSourceModel);
 
-   std::map<std::string, Source *>::const_iterator source = m_sources.begin();
-   for ( ; source != m_sources.end(); ++source) {
-//       Source::FuncMap srcFuncs = source->second->getSrcFuncs();
-//       Source::FuncMap::const_iterator func_it = srcFuncs.begin();
-//       CachedResponse* cResp=0;
-//       for (; func_it != srcFuncs.end(); func_it++) {
-//          std::vector<std::string> paramNames;
-//          (*func_it).second->getFreeParamNames(paramNames);
-//          // Only set cResp for sources with at least 1 free param
-//          if((cResp==0)&&(!paramNames.empty())&&(srcRespCache))
-//             cResp = &srcRespCache->getCachedValue(source->second->getName());
-//          for (size_t j = 0; j < paramNames.size(); j++) {
-//             double fluxDensDeriv = 
-// 	       source->second->fluxDensityDeriv(event, paramNames[j], cResp);
-//             fluxDensDeriv *= event.efficiency();
-//             derivs.push_back(fluxDensDeriv/srcSum);
-//          }
-//       }
+   const std::vector<Source *> & sources(srcList.sources);
+   for (size_t i(0); i < sources.size(); i++) {
+      const std::vector<std::string> & paramNames(srcList.freeParamNames[i]);
+// The responses have all been cached by logSourceModel above.
+      CachedResponse resp(false, 0);
       CachedResponse * cResp(0);
-      std::vector<std::string> paramNames;
-      source->second->spectrum().getFreeParamNames(paramNames);
-      if ( (cResp == 0) && (!paramNames.empty()) && (srcRespCache) ) {
-         cResp = &srcRespCache->getCachedValue(source->second->getName());
+      if ( (!paramNames.empty()) && (srcRespCache) ) {
+         resp = srcRespCache->getCachedValue(srcList.cacheIndices[i]);
+         cResp = &resp;
       }
       for (size_t j(0); j < paramNames.size(); j++) {
          double fluxDensDeriv = 
-            source->second->fluxDensityDeriv(event, paramNames.at(j), cResp);
+            sources[i]->fluxDensityDeriv(event, paramNames.at(j), cResp);
          fluxDensDeriv *= event.efficiency();
          derivs.push_back(fluxDensDeriv/srcSum);
       }
@@ -210,13 +728,63 @@ void LogLike::getFreeDerivs(const optimizers::Arg & dummy,
 
    const std::vector<Event> & events = m_observation.eventCont().events();
 
+   SourceList srcList;
+   getSourceList(srcList);
+
    std::vector<double> logSrcModelDerivs(getNumFreeParams(), 0);
-   for (size_t j = 0; j < events.size(); j++) {
+   EventWorkers * workers(0);
+   if (spectralFastPath(srcList)) {
+      std::vector<double> specValues;
+      std::vector<double> specDerivs;
+      evaluateSpectra(srcList, specValues, &specDerivs);
+      std::vector<size_t> paramSources;
+      for (size_t i(0); i < srcList.freeParamNames.size(); i++) {
+         paramSources.insert(paramSources.end(),
+                             srcList.freeParamNames[i].size(), i);
+      }
+      SpectralSumTask task(m_specResps.resps, m_specResps.energyIndices,
+                           specValues, &specDerivs, paramSources,
+                           eventSubset());
+      ThreadPool * pool(threadPool());
+      if (pool) {
+         pool->run(task, task.nblocks());
+      } else {
+         for (size_t k(0); k < task.nblocks(); k++) {
+            task.run(k, 0);
+         }
+      }
+      for (size_t k(0); k < task.nblocks(); k++) {
+         const std::vector<double> & derivs(task.derivs(k));
+         for (size_t i = 0; i < derivs.size(); i++) {
+            logSrcModelDerivs[i] += derivs[i];
+         }
+      }
+   } else if ((workers = eventWorkers())) {
+      workers->sync(srcList);
+      DerivsTask task(*this, *workers, logSrcModelDerivs.size());
+      workers->pool().run(task, task.nblocks());
+      for (size_t k(0); k < task.nblocks(); k++) {
+         const std::vector<double> & derivs(task.derivs(k));
+         for (size_t i = 0; i < derivs.size(); i++) {
+            logSrcModelDerivs[i] += derivs[i];
+         }
+      }
+   } else {
+      const std::vector<size_t> * eventIndices(eventSubset());
+      size_t nitems(eventIndices ? eventIndices->size() : events.size());
       std::vector<double> derivs;
-      ResponseCache::EventRef rc_ref = m_respCache.getEventRef(j);
-      getLogSourceModelDerivs(events[j], derivs, &rc_ref);
-      for (size_t i = 0; i < derivs.size(); i++) {
-         logSrcModelDerivs[i] += derivs[i];
+      for (size_t k = 0; k < nitems; k++) {
+         size_t j(eventIndices ? (*eventIndices)[k] : k);
+         ResponseCache::EventRef rc_ref = m_respCache.getEventRef(j);
+         getLogSourceModelDerivs(events[j], srcList, derivs, &rc_ref);
+         for (size_t i = 0; i < derivs.size(); i++) {
+            logSrcModelDerivs[i] += derivs[i];
+         }
+      }
+      if (eventIndices) {
+         m_eboundCacheFilled = true;
+      } else {
+         m_respCacheFilled = true;
       }
    }
 
@@ -291,32 +859,62 @@ void LogLike::addSource(Source * src, bool fromClone, SourceMap* /* srcMap */, b
       useCachedResp = true;
    }
 
+   unsigned isrc(m_respCache.addSource(srcName));
    for (size_t j = 0; j < events.size(); j++) {
+      CachedResponse resp(false, 0);
       CachedResponse* cResp = 0;
-      if(useCachedResp)cResp = &m_respCache.getCachedValue(j,srcName);
-      const_cast<std::vector<Event> &>(events).at(j).updateModelSum(*src, cResp);
+      if(useCachedResp)cResp = &resp;
+      if (m_updateEventModelSums) {
+         const_cast<std::vector<Event> &>(events).at(j).updateModelSum(*src, cResp);
+      } else if (cResp) {
+         src->fluxDensity(events[j], cResp);
+      }
+      m_respCache.setCachedValue(isrc, j, resp);
    }
    SrcArg sArg(src);
    m_npredValues[src->getName()] = m_Npred(sArg);
    m_bestValueSoFar = -1e38;
+   m_respCacheFilled = false;
+   m_eboundCacheFilled = false;
+   m_specResps.valid = false;
+   m_workers.reset(0);
 }
 
 Source * LogLike::deleteSource(const std::string & srcName) {
    const std::vector<Event> & events = m_observation.eventCont().events();
-   for (size_t j = 0; j < events.size(); j++) {
+   for (size_t j = 0; m_updateEventModelSums && j < events.size(); j++) {
       const_cast<std::vector<Event> &>(events).at(j).deleteSource(srcName);
    }
    m_respCache.deleteSource(srcName);
    m_npredValues.erase(srcName);
+   m_savedExposures.erase(srcName);
    m_bestValueSoFar = -1e38;
+   m_respCacheFilled = false;
+   m_eboundCacheFilled = false;
+   m_specResps.valid = false;
+   m_workers.reset(0);
    return SourceModel::deleteSource(srcName);
 }
 
 void LogLike::getEvents(std::string event_file) {
+   getEvents(std::vector<std::string>(1, event_file));
+}
+
+void LogLike::getEvents(const std::vector<std::string> & event_files) {
    EventContainer & eventCont =
       const_cast<EventContainer &>(m_observation.eventCont());
-   eventCont.getEvents(event_file);
+   bool apply_roi_cut;
+   unsigned int event_type_mask;
+   eventCont.getEvents(event_files, apply_roi_cut=true, event_type_mask=3,
+                       m_nthreads);
    m_respCache.clearAndResize(eventCont.events().size());
+   if (m_use_ebounds) {
+      selectEboundEvents();
+   }
+   m_respCacheFilled = false;
+   m_eboundCacheFilled = false;
+   m_specResps.valid = false;
+   m_workers.reset(0);
 }
 
 void LogLike::computeEventResponses(double sr_radius) {
@@ -354,9 +952,16 @@ void LogLike::syncSrcParams(const std::string & srcName) {
       SrcArg sArg(source->second);
       m_npredValues[source->first] = m_Npred(sArg);
       const std::vector<Event> & events(m_observation.eventCont().events());
+      unsigned isrc(m_respCache.addSource(srcName));
       for (size_t j(0); j < events.size(); j++) {
-	 CachedResponse* cResp = &m_respCache.getCachedValue(j,srcName);
-         const_cast<Event &>(events.at(j)).updateModelSum(*source->second,cResp);
+         CachedResponse resp(m_respCache.getCachedValue(isrc, j));
+         if (m_updateEventModelSums) {
+            const_cast<Event &>(events.at(j)).updateModelSum(*source->second,
+                                                             &resp);
+         } else {
+            source->second->fluxDensity(events[j], &resp);
+         }
+         m_respCache.setCachedValue(isrc, j, resp);
       }
    }
 }
@@ -365,6 +970,7 @@ void LogLike::set_ebounds(double emin, double emax) {
    m_emin = emin;
    m_emax = emax;
    m_use_ebounds = true;
+   selectEboundEvents();
    size_t nee(observation().roiCuts().energies().size());
    double estep(std::log(emax/emin)/(nee-1));
    std::vector<double> energies;
@@ -375,16 +981,81 @@ void LogLike::set_ebounds(double emin, double emax) {
 
    std::map<std::string, Source *>::const_iterator it(m_sources.begin());
    for ( ; it != m_sources.end(); ++it) {
-      it->second->computeExposure(energies);
+      Source * src(it->second);
+      SavedExposure & saved(m_savedExposures[it->first]);
+      if (!saved.isCurrent(*src)) {
+// The exposure has been (re)computed since the last call, so it
+// covers the full energy range.
+         saved.energies = src->exposureEnergies();
+         saved.exposure = src->exposure();
+         saved.computed.clear();
+         for (size_t k(0); k < saved.energies.size(); k++) {
+            saved.computed[saved.energies[k]] = saved.exposure[k];
+         }
+      }
+// The exposure at each energy is computed independently of the
+// others, so only the energies not seen before need computing.
+      std::vector<double> newEnergies;
+      for (size_t k(0); k < energies.size(); k++) {
+         if (saved.computed.count(energies[k]) == 0) {
+            newEnergies.push_back(energies[k]);
+         }
+      }
+      if (!newEnergies.empty()) {
+         src->computeExposure(newEnergies);
+         const std::vector<double> & newExposure(src->exposure());
+         for (size_t k(0); k < newEnergies.size(); k++) {
+            saved.computed[newEnergies[k]] = newExposure.at(k);
+         }
+      }
+      std::vector<double> exposure;
+      for (size_t k(0); k < energies.size(); k++) {
+         exposure.push_back(saved.computed[energies[k]]);
+      }
+      src->setExposure(energies, exposure);
+      saved.bandEnergies = energies;
+      saved.bandExposure = exposure;
    }
    update_npreds();
 }
 
 void LogLike::unset_ebounds() {
    m_use_ebounds = false;
+   m_eboundEvents.clear();
+   m_eboundCacheFilled = false;
+   m_specResps.valid = false;
+   std::map<std::string, Source *>::const_iterator it(m_sources.begin());
+   for ( ; it != m_sources.end(); ++it) {
+      std::map<std::string, SavedExposure>::const_iterator 
+         saved(m_savedExposures.find(it->first));
+      if (saved != m_savedExposures.end() && 
+          saved->second.isCurrent(*it->second)) {
+         it->second->setExposure(saved->second.energies,
+                                 saved->second.exposure);
+      }
+   }
+   m_savedExposures.clear();
    update_npreds();
 }
 
+void LogLike::selectEboundEvents() {
+   m_eboundCacheFilled = false;
+   m_specResps.valid = false;
+   const EventContainer & eventCont(m_observation.eventCont());
+   std::pair<size_t, size_t> range(eventCont.energyRange(m_emin, m_emax));
+   const std::vector<size_t> & order(eventCont.energyOrder());
+// Visit the selected events in their original order so that the
+// response cache and the sums are traversed as for the full list.
+   m_eboundEvents.assign(order.begin() + range.first,
+                         order.begin() + range.second);
+   std::sort(m_eboundEvents.begin(), m_eboundEvents.end());
+}
+
+bool LogLike::SavedExposure::isCurrent(const Source & src) const {
+   return (src.exposureEnergies() == bandEnergies &&
+           src.exposure() == bandExposure);
+}
+
 void LogLike::update_npreds() {
    std::map<std::string, Source *>::const_iterator it(m_sources.begin());
    for ( ; it != m_sources.end(); ++it) {
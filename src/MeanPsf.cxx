@@ -21,16 +21,28 @@
 #include "st_facilities/Util.h"
 
 #include "Likelihood/MeanPsf.h"
+#include "Likelihood/ThreadPool.h"
 
 namespace Likelihood {
 
 std::vector<double> MeanPsf::s_separations;
 
+namespace {
+   ThreadPool::Mutex s_separationsMutex;
+}
+
 void MeanPsf::init() {
    computeExposure();
-   if (s_separations.size() == 0) {
-      createLogArray(1e-4, 70., 400, s_separations);
+   {
+      ThreadPool::Lock lock(s_separationsMutex);
+      if (s_separations.size() == 0) {
+         createLogArray(1e-4, 70., 400, s_separations);
+      }
    }
+   const ExposureCube & expCube(m_observation.expCube());
+   ExposureCube::LivetimeHandle livetime;
+   expCube.getLivetimeHandle(m_srcDir, livetime);
+   std::vector<double> table;
    m_psfValues.reserve(m_energies.size()*s_separations.size());
    for (unsigned int k = 0; k < m_energies.size(); k++) {
       for (unsigned int j = 0; j < s_separations.size(); j++) {
@@ -40,8 +52,8 @@ void MeanPsf::init() {
          for (; resp != m_observation.respFuncs().end(); ++resp) {
             int evtType = resp->second->irfID();
             Psf psf(s_separations[j], m_energies[k], evtType, m_observation);
-            value += m_observation.expCube().value(m_srcDir, psf,
-                                                   m_energies[k]);
+            expCube.fillResponseTable(psf, table);
+            value += expCube.exposure(livetime, table, m_energies[k]);
          }
          if (m_exposure[k] > 0) {
             value /= m_exposure[k];
@@ -60,6 +72,10 @@ void MeanPsf::init() {
 }
 
 void MeanPsf::computeExposure() {
+   const ExposureCube & expCube(m_observation.expCube());
+   ExposureCube::LivetimeHandle livetime;
+   expCube.getLivetimeHandle(m_srcDir, livetime);
+   std::vector<double> table;
    m_exposure.reserve(m_energies.size());
    for (size_t k(0); k < m_energies.size(); k++) {
       double value(0);
@@ -68,7 +84,8 @@ void MeanPsf::computeExposure() {
       for (; resp != m_observation.respFuncs().end(); ++resp) {
          int evtType = resp->second->irfID();
          ExposureCube::Aeff aeff(m_energies[k], evtType, m_observation);
-         value += m_observation.expCube().value(m_srcDir, aeff, m_energies[k]);
+         expCube.fillResponseTable(aeff, table);
+         value += expCube.exposure(livetime, table, m_energies[k]);
       }
       m_exposure.push_back(value);
    }
@@ -0,0 +1,36 @@
+/**
+ * @file ObservationCopies.cxx
+ * @brief Per-thread views of an Observation with private copies of
+ * the response functions.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#include "Likelihood/Observation.h"
+#include "Likelihood/ObservationCopies.h"
+
+namespace Likelihood {
+
+ObservationCopies::ObservationCopies(const Observation & observation,
+                                     size_t ncopies) {
+   m_observations.push_back(&observation);
+   for (size_t i(1); i < ncopies; i++) {
+      ResponseFunctions * respFuncs(observation.respFuncs().clone());
+      m_respFuncs.push_back(respFuncs);
+      Observation * my_obs(new Observation(observation));
+      my_obs->setRespFuncs(respFuncs);
+      m_observations.push_back(my_obs);
+   }
+}
+
+ObservationCopies::~ObservationCopies() {
+   for (size_t i(1); i < m_observations.size(); i++) {
+      delete m_observations[i];
+   }
+   for (size_t i(0); i < m_respFuncs.size(); i++) {
+      delete m_respFuncs[i];
+   }
+}
+
+} // namespace Likelihood
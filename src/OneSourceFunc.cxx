@@ -9,22 +9,70 @@
 
 #include "Likelihood/OneSourceFunc.h"
 #include "Likelihood/Source.h"
+#include "Likelihood/ThreadPool.h"
 #include "optimizers/Parameter.h"
+#include <algorithm>
 #include <cmath>
+#include <stdexcept>
+
+namespace {
+// Number of events per work item in the sums over events.  The
+// partial sums are combined in block order, so the results do not
+// depend on the number of threads.
+   const size_t s_eventBlockSize(2048);
+}
 
 namespace Likelihood {
 
+/**
+ * @class OneSourceFunc::EventSumTask
+ * @brief Sums the event terms over one block of events.
+ */
+class OneSourceFunc::EventSumTask : public ThreadPool::Task {
+public:
+   EventSumTask(const OneSourceFunc & func, const std::string * paramName)
+      : m_func(func), m_paramName(paramName),
+        m_sums((func.m_events.size() + s_eventBlockSize - 1)
+               /s_eventBlockSize, 0) {}
+
+   size_t nblocks() const {
+      return m_sums.size();
+   }
+
+   const std::vector<double> & sums() const {
+      return m_sums;
+   }
+
+   virtual void run(size_t block, size_t thread_id) {
+      const Source & src(m_func.m_srcCopies.empty() ? *m_func.m_src
+                         : *m_func.m_srcCopies[thread_id]);
+      size_t jmax(std::min(m_func.m_events.size(),
+                           (block + 1)*s_eventBlockSize));
+      double sum(0);
+      for (size_t j(block*s_eventBlockSize); j < jmax; j++) {
+         sum += m_func.eventTerm(src, j, m_paramName);
+      }
+      m_sums[block] = sum;
+   }
+
+private:
+   const OneSourceFunc & m_func;
+   const std::string * m_paramName;
+   std::vector<double> m_sums;
+};
+
   //! cutoff values for minimum weight and flux
 
   OneSourceFunc::OneSourceFunc(Source * src,
 			       const std::vector<Event>& evt,
-			       std::vector<double> * weights):
+			       const double * weights):
     Statistic("OneSourceFunc", 0),
     m_src(src),
     m_events(evt),
     m_weights(weights),
     m_epsw(1.e-3),
-    m_epsf(1.e-20)
+    m_epsf(1.e-20),
+    m_pool(0)
   {
      setName("OneSourceFunc");
     syncParams();
@@ -38,51 +86,83 @@ namespace Likelihood {
     m_epsf = e;
   }
 
-  double OneSourceFunc::value(const optimizers::Arg& ) const {
+  void OneSourceFunc::setThreads(ThreadPool * pool,
+                                 const std::vector<Source *> & srcCopies) {
+     if (pool && srcCopies.size() < pool->nthreads()) {
+        throw std::runtime_error("OneSourceFunc::setThreads: "
+                                 "one Source copy per thread is required.");
+     }
+     m_pool = pool;
+     m_srcCopies = srcCopies;
+  }
 
-    double val = 0.;
-    //    double wtot = 0.;
-    //    int nused = 0;
-    for (unsigned int i = 0; i < m_events.size(); i++) {
-      double w = (m_weights == NULL) ? 1.0 : (*m_weights)[i];
-      if (w > m_epsw) {
-	double q = m_src->fluxDensity(m_events[i]);
-	if (fabs(q) > m_epsf) {
-	  val += w * log(q);
-	  //	  wtot += w;
-	  //	  nused++;
-	}
-      }
-    }
+  void OneSourceFunc::copyParams(const Source & src, Source & dest) {
+     const Source::FuncMap & srcFuncs(src.getSrcFuncs());
+     Source::FuncMap & destFuncs(dest.getSrcFuncs());
+     Source::FuncMap::const_iterator func_it(srcFuncs.begin());
+     for ( ; func_it != srcFuncs.end(); ++func_it) {
+        Source::FuncMap::iterator dest_it(destFuncs.find(func_it->first));
+        if (dest_it == destFuncs.end()) {
+           continue;
+        }
+        std::vector<optimizers::Parameter> params;
+        func_it->second->getParams(params);
+        for (size_t k(0); k < params.size(); k++) {
+           dest_it->second->setParam(params[k]);
+        }
+     }
+  }
+
+  double OneSourceFunc::value(const optimizers::Arg& ) const {
+    double val = eventSum(0);
     double bar = m_src->Npred();
     double foo = val - bar;
-    //  std::cout << "OSF:v value " << foo << " photons " << nused << " wtot " 
-    //	      << wtot <<  " sum " << val
-    //	      << " integral " << bar << std::endl;
     return foo;
   }
 
   double OneSourceFunc::derivByParamImp(const optimizers::Arg &, 
                                         const std::string & paramName) const {
-
-    double deriv = 0;
-    //    double wtot = 0.;
-    for (unsigned int i = 0; i < m_events.size(); i++) {
-      double w = (m_weights == NULL) ? 1.0 : (*m_weights)[i];
-      if (w > m_epsw) {
-	//	wtot += w;
-	double q = m_src->fluxDensity(m_events[i]);
-	if (fabs(q) > m_epsf) {
-	  double v = m_src->fluxDensityDeriv(m_events[i], paramName);
-	  deriv += w * v / q;
-	}
-      }
-    }
+    double deriv = eventSum(&paramName);
     double bar = m_src->NpredDeriv(paramName);
     double foo = deriv - bar;
     return foo;
   }
 
+  double OneSourceFunc::eventSum(const std::string * paramName) const {
+     EventSumTask task(*this, paramName);
+     if (m_pool) {
+        for (size_t i(1); i < m_pool->nthreads(); i++) {
+           copyParams(*m_src, *m_srcCopies[i]);
+        }
+        m_pool->run(task, task.nblocks());
+     } else {
+        for (size_t i(0); i < task.nblocks(); i++) {
+           task.run(i, 0);
+        }
+     }
+     double sum(0);
+     for (size_t i(0); i < task.nblocks(); i++) {
+        sum += task.sums()[i];
+     }
+     return sum;
+  }
+
+  double OneSourceFunc::eventTerm(const Source & src, size_t ievent,
+                                  const std::string * paramName) const {
+     double w = (m_weights == 0) ? 1.0 : m_weights[ievent];
+     if (w <= m_epsw) {
+        return 0;
+     }
+     double q = src.fluxDensity(m_events[ievent]);
+     if (fabs(q) <= m_epsf) {
+        return 0;
+     }
+     if (paramName) {
+        return w*src.fluxDensityDeriv(m_events[ievent], *paramName)/q;
+     }
+     return w*log(q);
+  }
+
   void OneSourceFunc::syncParams(void) {
     m_parameter.clear();
     Source::FuncMap srcFuncs = m_src->getSrcFuncs();
@@ -7,8 +7,10 @@
  */
 
 #include "st_stream/StreamFormatter.h"
+#include "Likelihood/ObservationCopies.h"
 #include "Likelihood/OptEM.h"
 #include "Likelihood/OneSourceFunc.h"
+#include "Likelihood/ThreadPool.h"
 #include "optimizers/Lbfgs.h"
 #include "optimizers/Drmngb.h"
 #include "optimizers/Minuit.h"
@@ -16,8 +18,107 @@
 #include "optimizers/FunctionTest.h"
 #include "optimizers/ParameterNotFound.h"
 #include "optimizers/OutOfBounds.h"
+#include <algorithm>
 #include <vector>
 
+namespace {
+// Number of events per work item in the E step.
+   const size_t s_eventBlockSize(2048);
+
+/**
+ * @class SourceCopies
+ * @brief Per-thread copies of the Sources, [source][thread].  Thread
+ * 0 uses the original Sources; the copies for the other threads refer
+ * to Observations with their own response functions.
+ */
+   class SourceCopies {
+   public:
+      SourceCopies(const std::vector<Likelihood::Source *> & sources,
+                   const Likelihood::ObservationCopies & observations)
+         : m_copies(sources.size()) {
+         for (size_t i(0); i < sources.size(); i++) {
+            m_copies[i].push_back(sources[i]);
+            for (size_t t(1); t < observations.size(); t++) {
+               Likelihood::Source * src(sources[i]->clone());
+               src->setObservation(&observations[t]);
+               m_copies[i].push_back(src);
+            }
+         }
+      }
+
+      ~SourceCopies() {
+         for (size_t i(0); i < m_copies.size(); i++) {
+            for (size_t t(1); t < m_copies[i].size(); t++) {
+               delete m_copies[i][t];
+            }
+         }
+      }
+
+      const std::vector<Likelihood::Source *> & operator[](size_t i) const {
+         return m_copies[i];
+      }
+
+      /// Copy the current parameter values to the per-thread copies.
+      void sync() {
+         for (size_t i(0); i < m_copies.size(); i++) {
+            for (size_t t(1); t < m_copies[i].size(); t++) {
+               Likelihood::OneSourceFunc::copyParams(*m_copies[i][0],
+                                                     *m_copies[i][t]);
+            }
+         }
+      }
+
+   private:
+      std::vector< std::vector<Likelihood::Source *> > m_copies;
+
+      SourceCopies(const SourceCopies &);
+      SourceCopies & operator=(const SourceCopies &);
+   };
+
+/**
+ * @class EStepTask
+ * @brief Computes the weight factors of each source for one block of
+ * events.
+ */
+   class EStepTask : public Likelihood::ThreadPool::Task {
+   public:
+      /// @param weights [source][event] weight matrix
+      EStepTask(const std::vector<Likelihood::Event> & events,
+                const SourceCopies & sources, size_t nsrcs,
+                std::vector<double> & weights)
+         : m_events(events), m_sources(sources), m_nsrcs(nsrcs),
+           m_weights(weights) {}
+
+      size_t nblocks() const {
+         return (m_events.size() + s_eventBlockSize - 1)/s_eventBlockSize;
+      }
+
+      virtual void run(size_t block, size_t thread_id) {
+         size_t nevents(m_events.size());
+         size_t jmax(std::min(nevents, (block + 1)*s_eventBlockSize));
+         for (size_t j(block*s_eventBlockSize); j < jmax; j++) {
+            double ztot(0);
+            for (size_t i(0); i < m_nsrcs; i++) {
+               double x(m_sources[i][thread_id]->fluxDensity(m_events[j]));
+               m_weights[i*nevents + j] = x;
+               ztot += x;
+            }
+            if (ztot > 0.) {
+               for (size_t i(0); i < m_nsrcs; i++) {
+                  m_weights[i*nevents + j] /= ztot;
+               }
+            }
+         }
+      }
+
+   private:
+      const std::vector<Likelihood::Event> & m_events;
+      const SourceCopies & m_sources;
+      size_t m_nsrcs;
+      std::vector<double> & m_weights;
+   };
+}
+
 namespace Likelihood {
 
   void OptEM::findMin(const int verbose) {
@@ -26,11 +127,21 @@ namespace Likelihood {
     double oldLogL;
     double logL = 0.;
 
-    //! Build array of weight factors
-    std::vector<std::vector<double>* > Warray;
-    for (unsigned int i = 0; i < getNumSrcs(); i++) {
-      Warray.push_back(new std::vector<double>(events.size()));
+    std::vector<Source *> sources;
+    std::map<std::string, Source *>::iterator srcIt = m_sources.begin();
+    for ( ; srcIt != m_sources.end(); ++srcIt) {
+       sources.push_back(srcIt->second);
     }
+    size_t nsrcs(sources.size());
+    size_t nevents(events.size());
+
+    //! Each thread evaluates its own copies of the Sources.
+    ThreadPool pool(numThreads());
+    ObservationCopies observations(m_observation, pool.nthreads());
+    SourceCopies srcCopies(sources, observations);
+
+    //! Weight factors, stored as weights[isrc*nevents + ievent]
+    std::vector<double> weights(nsrcs*nevents);
 
     unsigned int iteration = 0;
     int nPar;
@@ -43,23 +154,19 @@ namespace Likelihood {
       logL = 0.;
 
       //! The E step.  Find weight factors
-      for (unsigned int j = 0; j < events.size(); j++) {
-	double ztot = 0.;
-        std::map<std::string, Source *>::iterator srcIt = m_sources.begin();
-        for (unsigned int i = 0 ; srcIt != m_sources.end(); ++srcIt, i++) {
-	  double x = srcIt->second->fluxDensity(events[j]);
-	  (*Warray[i])[j] = x;
-	  ztot += x;
-	}
-	for (unsigned int i = 0; i < getNumSrcs(); i++) {
-	  if (ztot > 0.) (*Warray[i])[j] /= ztot;
-	}
-      }
+      srcCopies.sync();
+      EStepTask eStep(events, srcCopies, nsrcs, weights);
+      pool.run(eStep, eStep.nblocks());
 
-      //! The M step.  Optimize parameters of each source.
-      std::map<std::string, Source *>::iterator srcIt = m_sources.begin();
-      for (unsigned int i = 0 ; srcIt != m_sources.end(); ++srcIt, ++i) {
-	OneSourceFunc f(srcIt->second, events, Warray[i]); 
+      //! The M step.  Optimize parameters of each source.  The
+      //! optimizers keep internal state between calls, so the sources
+      //! are done in turn and the sums over events are threaded.
+      for (unsigned int i = 0; i < nsrcs; ++i) {
+	OneSourceFunc f(sources[i], events, 
+                        nevents > 0 ? &weights[i*nevents] : 0);
+        if (pool.nthreads() > 1) {
+           f.setThreads(&pool, srcCopies[i]);
+        }
 	f.setEpsF(1.e-20);
 	f.setEpsW(1.e-2);
 	nPar += f.getNumFreeParams();
@@ -89,11 +196,6 @@ namespace Likelihood {
                           << oldLogL  << " params " << nPar << std::endl;
       }
     } while (fabs(logL-oldLogL) > 0.1*chifunc(nPar) || oldLogL == 0.);
-
-    //! Clean up before exit
-    for (unsigned int i=0; i < getNumSrcs(); i++) {
-      delete Warray[i];
-    }
   }
 
   double chifunc(int ndof) {
@@ -29,16 +29,24 @@
 #include "Likelihood/ResponseFunctions.h"
 #include "Likelihood/RoiCuts.h"
 #include "Likelihood/ScData.h"
+#include "Likelihood/ThreadPool.h"
 #include "Likelihood/TrapQuad.h"
 
 namespace Likelihood {
 
 std::vector<double> PointSource::s_trueEnergies(0);
 
+namespace {
+/// Guards the lazy initialization of PointSource::s_trueEnergies so
+/// that PointSources may be created on several threads.
+   ThreadPool::Mutex s_trueEnergiesMutex;
+}
+
 PointSource::PointSource(const Observation * observation) 
    : Source(observation) {
    setDir(0., 0., false);
    m_srcType = Source::Point;
+   ThreadPool::Lock lock(s_trueEnergiesMutex);
    if (s_trueEnergies.empty()) {
       makeEnergyVector();
    }
@@ -49,6 +57,7 @@ PointSource::PointSource(double ra, double dec,
    : Source(&observation) {
    setDir(ra, dec, true, verbose);
    m_srcType = Source::Point;
+   ThreadPool::Lock lock(s_trueEnergiesMutex);
    if (s_trueEnergies.empty()) {
       makeEnergyVector();
    }
@@ -365,18 +374,21 @@ computeExposureWithHyperCube(const astro::SkyDir & srcDir,
 //    formatter.warn() << "Computing exposure at (" 
 //                     << srcDir.ra() << ", " 
 //                     << srcDir.dec() << ")";
+   const ExposureCube & expCube(observation.expCube());
+   ExposureCube::LivetimeHandle livetime;
+   expCube.getLivetimeHandle(srcDir, livetime);
+   std::vector<double> table;
    for (std::vector<double>::const_iterator it = energies.begin();
         it != energies.end(); it++) {
 //       if (verbose) {
 //          formatter.warn() << ".";
 //       }
-      double time((observation.expCube().tstart() 
-                   + observation.expCube().tstop())/2.);
+      double time((expCube.tstart() + expCube.tstop())/2.);
       PointSource::Aeff aeff(*it, srcDir, observation.roiCuts(),
                              observation.respFuncs(), time,
-                             observation.expCube().hasPhiDependence());
-      double exposure_value = observation.expCube().value(srcDir, aeff, *it);
-      exposure.push_back(exposure_value);
+                             expCube.hasPhiDependence());
+      expCube.fillResponseTable(aeff, table);
+      exposure.push_back(expCube.exposure(livetime, table, *it));
    }
 //    formatter.warn() << "!" << std::endl;
 }
@@ -385,7 +397,7 @@ void PointSource::computeExposure(const astro::SkyDir & srcDir,
                                   const std::vector<double> &energies,
                                   const Observation & observation,
                                   std::vector<double> &exposure,
-                                  bool verbose) {
+                                  bool verbose, bool quiet) {
    (void)(verbose);
    const ScData & scData = observation.scData();
    const RoiCuts & roiCuts = observation.roiCuts();
@@ -400,18 +412,22 @@ void PointSource::computeExposure(const astro::SkyDir & srcDir,
    exposure.clear();
    exposure.resize(energies.size());
 
+// The formatter's streams are shared, so callers running on several
+// threads, e.g., ExposureMap::computeMap, ask for no output.
    st_stream::StreamFormatter formatter("PointSource",
                                         "computeExposure", 4);
-   formatter.warn() << "Computing exposure at (" 
-                    << srcDir.ra() << ", " 
-                    << srcDir.dec() << ")";
+   if (!quiet) {
+      formatter.warn() << "Computing exposure at (" 
+                       << srcDir.ra() << ", " 
+                       << srcDir.dec() << ")";
+   }
    size_t npts(scData.numIntervals() - 1);
    if (roiCuts.maxTime() <= scData.stop(npts)) {
       npts = scData.time_index(roiCuts.maxTime()) + 1;
    }
 
    for (size_t it = 0; it < npts && it < scData.numIntervals(); it++) {
-      if (npts/20 > 0 && ((it % (npts/20)) == 0)) {
+      if (!quiet && npts/20 > 0 && ((it % (npts/20)) == 0)) {
          formatter.warn() << ".";
       }
       double start(scData.start(it));
@@ -441,7 +457,7 @@ void PointSource::computeExposure(const astro::SkyDir & srcDir,
             double time = (start + stop)/2.;
             double effArea = sourceEffArea(srcDir, energies[k], time, 
                                            scData, roiCuts, respFuncs);
-            if (effArea < 0 || fraction < 0 || (stop-start) < 0) {
+            if (!quiet && (effArea < 0 || fraction < 0 || (stop-start) < 0)) {
                formatter.warn() << effArea << std::endl;
             }
             const irfInterface::IEfficiencyFactor * efficiency_factor
@@ -454,7 +470,9 @@ void PointSource::computeExposure(const astro::SkyDir & srcDir,
          }
       }
    }
-   formatter.warn() << "!" << std::endl;
+   if (!quiet) {
+      formatter.warn() << "!" << std::endl;
+   }
 }
 
 void PointSource::makeEnergyVector(int nee) {
@@ -20,9 +20,6 @@
 
 namespace Likelihood {
 
-double PowerLaw2::s_cX = 0;
-double PowerLaw2::s_cLogX = 0;
-
 PowerLaw2::PowerLaw2(double Integral, double Index, 
                      double LowerLimit, double UpperLimit) 
    : optimizers::Function("PowerLaw2", 4, "Integral") {
@@ -96,12 +93,12 @@ derivByParamImp(const optimizers::Arg & xarg, const std::string & paramName) con
       break;
    case Index:
       if (gamma == -1.) {
-	 val = -NN/(2.*x)*(m_cLogXHi+m_cLogXLo-2.*s_cLogX)/
+	 val = -NN/(2.*x)*(m_cLogXHi+m_cLogXLo-2.*m_cLogX)/
 	   (m_cLogXHi-m_cLogXLo);
       } else {
 	 double one_p_gamma = 1.+gamma;
-	 val = NN*(m_cPowXHi*(1.-one_p_gamma*(m_cLogXHi-s_cLogX)) -
-		   m_cPowXLo*(1.-one_p_gamma*(m_cLogXLo-s_cLogX)))/
+	 val = NN*(m_cPowXHi*(1.-one_p_gamma*(m_cLogXHi-m_cLogX)) -
+		   m_cPowXLo*(1.-one_p_gamma*(m_cLogXLo-m_cLogX)))/
 	   std::pow(m_cPowXHi - m_cPowXLo,2)*m_cPowX;
       }
       return val * m_parameter[Index].getScale();
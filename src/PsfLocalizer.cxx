@@ -0,0 +1,321 @@
+/**
+ * @file PsfLocalizer.cxx
+ * @brief Fast localization of a point source in unbinned data using
+ * a cached psf template.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#include <cmath>
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+#include "optimizers/dArg.h"
+
+#include "Likelihood/Event.h"
+#include "Likelihood/MeanPsf.h"
+#include "Likelihood/PsfLocalizer.h"
+#include "Likelihood/Source.h"
+#include "Likelihood/SourceModel.h"
+#include "Likelihood/ThreadPool.h"
+
+namespace {
+   const double s_deg(M_PI/180.);
+
+// Tabulated separations (degrees).
+   const double s_thetaMin(1e-4);
+   const double s_thetaMax(180.);
+   const size_t s_ntheta(400);
+
+// Floor for the tabulated psf values, so that their logs are finite.
+   const double s_psfMin(1e-300);
+
+/// Direction offset from center by (u, v) degrees along the
+/// orthogonal unit vectors e1 and e2 of the tangent plane.
+   CLHEP::Hep3Vector offsetDir(const CLHEP::Hep3Vector & center,
+                               const CLHEP::Hep3Vector & e1,
+                               const CLHEP::Hep3Vector & e2,
+                               double u, double v) {
+      return (center + u*s_deg*e1 + v*s_deg*e2).unit();
+   }
+
+/**
+ * @class StencilTask
+ * @brief Evaluates the log-likelihood at a set of positions.
+ */
+   class StencilTask : public Likelihood::ThreadPool::Task {
+   public:
+      StencilTask(const Likelihood::PsfLocalizer & localizer,
+                  const std::vector<CLHEP::Hep3Vector> & dirs,
+                  std::vector<double> & values)
+         : m_localizer(localizer), m_dirs(dirs), m_values(values) {}
+      virtual void run(size_t item, size_t) {
+         double norm;
+         m_values[item] = m_localizer.logLike(m_dirs[item], norm);
+      }
+   private:
+      const Likelihood::PsfLocalizer & m_localizer;
+      const std::vector<CLHEP::Hep3Vector> & m_dirs;
+      std::vector<double> & m_values;
+   };
+}
+
+namespace Likelihood {
+
+PsfLocalizer::PsfLocalizer(const std::vector<Event> & events,
+                           const MeanPsf & meanPsf,
+                           const CLHEP::Hep3Vector & srcDir,
+                           const std::vector<double> & srcWeights,
+                           const std::vector<double> & srcDensity,
+                           const std::vector<double> & bgDensity,
+                           double npred)
+   : m_logThetaMin(std::log(s_thetaMin)),
+     m_logThetaStep(std::log(s_thetaMax/s_thetaMin)/(s_ntheta - 1)),
+     m_npred(npred), m_logLike0(0), m_errorRadius(-1) {
+   if (srcWeights.size() != events.size() ||
+       srcDensity.size() != events.size() ||
+       bgDensity.size() != events.size()) {
+      throw std::runtime_error("PsfLocalizer: the number of flux densities "
+                               "does not match the number of events.");
+   }
+   const std::vector<double> & energies(meanPsf.energies());
+   if (energies.size() < 2) {
+      throw std::runtime_error("PsfLocalizer: the mean psf needs at least "
+                               "two energies.");
+   }
+   m_logPsfTable.resize(energies.size());
+   for (size_t k(0); k < energies.size(); k++) {
+      m_logPsfTable[k].resize(s_ntheta);
+      for (size_t j(0); j < s_ntheta; j++) {
+         double theta(std::exp(m_logThetaMin + j*m_logThetaStep));
+         m_logPsfTable[k][j] = std::log(std::max(meanPsf(energies[k], theta),
+                                                 s_psfMin));
+      }
+   }
+
+// Keep the events that the source contributes to.
+   double densitySum(0);
+   double templateSum(0);
+   for (size_t i(0); i < events.size(); i++) {
+      double energy(events[i].getEnergy());
+      if (srcDensity[i] <= 0 || srcWeights[i] <= 0 ||
+          energy < energies.front() || energy > energies.back()) {
+         continue;
+      }
+      size_t k(std::upper_bound(energies.begin(), energies.end(), energy)
+               - energies.begin());
+      k = std::min(std::max(k, size_t(1)), energies.size() - 1) - 1;
+      m_dirs.push_back(events[i].getDir().dir());
+      m_bg.push_back(bgDensity[i]);
+      m_scale.push_back(srcWeights[i]);
+      m_energyIndex.push_back(k);
+      m_energyWeight.push_back(std::log(energy/energies[k])
+                               /std::log(energies[k + 1]/energies[k]));
+      densitySum += srcDensity[i];
+      templateSum += srcWeights[i]*psf(m_dirs.size() - 1,
+                                       separation(m_dirs.back(), srcDir));
+   }
+   if (m_dirs.empty() || templateSum <= 0) {
+      throw std::runtime_error("PsfLocalizer: the source does not "
+                               "contribute to any of the events.");
+   }
+
+// Normalize the template so that it matches the full calculation of
+// the source flux densities at the starting position overall.  This
+// is not done event-by-event, since the differences between the mean
+// psf and the response for each event would then depend on the
+// separation from the starting position and bias the fit towards it.
+   double norm(densitySum/templateSum);
+   for (size_t i(0); i < m_scale.size(); i++) {
+      m_scale[i] *= norm;
+   }
+
+// Reference value: the starting position with the starting
+// normalization.
+   for (size_t i(0); i < m_dirs.size(); i++) {
+      m_logLike0 += std::log(m_bg[i] + m_scale[i]
+                             *psf(i, separation(m_dirs[i], srcDir)));
+   }
+   m_logLike0 -= m_npred;
+}
+
+void PsfLocalizer::modelDensities(const std::vector<Event> & events,
+                                  const MeanPsf & meanPsf,
+                                  const SourceModel & model,
+                                  const std::string & srcName,
+                                  std::vector<double> & srcWeights,
+                                  std::vector<double> & srcDensity,
+                                  std::vector<double> & bgDensity) {
+   const std::map<std::string, Source *> & srcMap(model.sources());
+   std::map<std::string, Source *>::const_iterator src(srcMap.find(srcName));
+   if (src == srcMap.end()) {
+      throw std::runtime_error("PsfLocalizer::modelDensities: source "
+                               + srcName + " is not in the model.");
+   }
+   srcWeights.resize(events.size());
+   srcDensity.resize(events.size());
+   bgDensity.assign(events.size(), 0);
+   for (size_t j(0); j < events.size(); j++) {
+      double energy(events[j].getEnergy());
+      optimizers::dArg eArg(energy);
+      srcWeights[j] = src->second->spectrum()(eArg)*meanPsf.exposure(energy);
+      srcDensity[j] = src->second->fluxDensity(events[j])
+         *events[j].efficiency();
+      std::map<std::string, Source *>::const_iterator it(srcMap.begin());
+      for ( ; it != srcMap.end(); ++it) {
+         if (it != src) {
+            bgDensity[j] += it->second->fluxDensity(events[j])
+               *events[j].efficiency();
+         }
+      }
+   }
+}
+
+double PsfLocalizer::logLike(const CLHEP::Hep3Vector & dir,
+                             double & norm) const {
+   size_t nevts(m_dirs.size());
+   std::vector<double> density(nevts);
+   for (size_t i(0); i < nevts; i++) {
+      density[i] = m_scale[i]*psf(i, separation(m_dirs[i], dir));
+   }
+// The log-likelihood is concave in the normalization, so Newton's
+// method converges quickly from the starting value.
+   static const int maxIter(20);
+   static const double tol(1e-8);
+   norm = 1;
+   for (int iter(0); iter < maxIter; iter++) {
+      double deriv(-m_npred);
+      double curvature(0);
+      for (size_t i(0); i < nevts; i++) {
+         double ratio(density[i]/(m_bg[i] + norm*density[i]));
+         deriv += ratio;
+         curvature -= ratio*ratio;
+      }
+      if (curvature >= 0) {
+         break;
+      }
+      double newNorm(norm - deriv/curvature);
+// Don't let the source go negative; halve the distance to zero instead.
+      if (newNorm <= 0) {
+         newNorm = norm/2.;
+      }
+      double change(std::fabs(newNorm - norm));
+      norm = newNorm;
+      if (change < tol*norm) {
+         break;
+      }
+   }
+   double value(-norm*m_npred);
+   for (size_t i(0); i < nevts; i++) {
+      value += std::log(m_bg[i] + norm*density[i]);
+   }
+   return value - m_logLike0;
+}
+
+int PsfLocalizer::localize(CLHEP::Hep3Vector & dir, double step, double tol,
+                           ThreadPool & pool, int maxIter) {
+   CLHEP::Hep3Vector center(dir.unit());
+   double h(step);
+   double hmin(tol/2.);
+   std::vector<CLHEP::Hep3Vector> dirs(9);
+   std::vector<double> values(9);
+   StencilTask task(*this, dirs, values);
+   double g1(0), g2(0), h11(0), h22(0), h12(0);
+   int status(1);
+   for (int iter(0); iter < maxIter; iter++) {
+// Tangent plane at the current position.
+      CLHEP::Hep3Vector e1(center.orthogonal().unit());
+      CLHEP::Hep3Vector e2(center.cross(e1).unit());
+      for (int j(0); j < 3; j++) {
+         for (int i(0); i < 3; i++) {
+            dirs[3*j + i] = offsetDir(center, e1, e2, (i - 1)*h, (j - 1)*h);
+         }
+      }
+      pool.run(task, dirs.size());
+      for (size_t k(0); k < dirs.size(); k++) {
+         m_testDirs.push_back(dirs[k]);
+         m_testValues.push_back(values[k]);
+      }
+
+// Gradient and curvature of the quadratic through the stencil.
+      double f0(values[4]);
+      g1 = (values[5] - values[3])/(2.*h);
+      g2 = (values[7] - values[1])/(2.*h);
+      h11 = (values[5] - 2.*f0 + values[3])/(h*h);
+      h22 = (values[7] - 2.*f0 + values[1])/(h*h);
+      h12 = (values[8] - values[6] - values[2] + values[0])/(4.*h*h);
+      double det(h11*h22 - h12*h12);
+
+      double du, dv;
+      if (h11 < 0 && det > 0) {
+// Newton step to the maximum of the quadratic.
+         du = -(h22*g1 - h12*g2)/det;
+         dv = -(h11*g2 - h12*g1)/det;
+      } else {
+// Not near a maximum yet; go uphill by the stencil spacing.
+         double gnorm(std::sqrt(g1*g1 + g2*g2));
+         if (gnorm == 0) {
+            break;
+         }
+         du = h*g1/gnorm;
+         dv = h*g2/gnorm;
+      }
+// Keep the step within twice the stencil spacing, where the
+// quadratic can be trusted.
+      double length(std::sqrt(du*du + dv*dv));
+      if (length > 2.*h) {
+         du *= 2.*h/length;
+         dv *= 2.*h/length;
+         length = 2.*h;
+      }
+      center = offsetDir(center, e1, e2, du, dv);
+      if (length < tol && h <= hmin) {
+         status = 0;
+         break;
+      }
+      if (length < h) {
+         h = std::max(h/2., hmin);
+      }
+   }
+   dir = center;
+
+// The error radius follows from the curvature, using the geometric
+// mean of the principal curvatures for an elliptical region.
+   double det(h11*h22 - h12*h12);
+   m_errorRadius = -1;
+   if (h11 < 0 && det > 0) {
+      double sigma(1./std::sqrt(std::sqrt(det)));
+      m_errorRadius = 1.51*sigma;
+   }
+   return status;
+}
+
+double PsfLocalizer::psf(size_t ievt, double theta) const {
+   double x((std::log(std::max(theta, s_thetaMin)) - m_logThetaMin)
+            /m_logThetaStep);
+   size_t j(std::min(static_cast<size_t>(x), s_ntheta - 2));
+   double tw(std::min(x - j, 1.));
+   size_t k(m_energyIndex[ievt]);
+   double ew(m_energyWeight[ievt]);
+   const std::vector<double> & lower(m_logPsfTable[k]);
+   const std::vector<double> & upper(m_logPsfTable[k + 1]);
+// Interpolating the log of the psf between energies keeps its shape
+// closer to that at the intermediate energy than interpolating the
+// values themselves.
+   double logLower((1. - tw)*lower[j] + tw*lower[j + 1]);
+   double logUpper((1. - tw)*upper[j] + tw*upper[j + 1]);
+   return std::exp((1. - ew)*logLower + ew*logUpper);
+}
+
+double PsfLocalizer::separation(const CLHEP::Hep3Vector & dir1,
+                                const CLHEP::Hep3Vector & dir2) {
+// This is accurate for small separations, unlike the arc cosine of
+// the dot product.
+   double chord((dir1 - dir2).mag());
+   return 2.*std::asin(std::min(chord/2., 1.))/s_deg;
+}
+
+} // namespace Likelihood
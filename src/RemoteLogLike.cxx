@@ -0,0 +1,396 @@
+/**
+ * @file RemoteLogLike.cxx
+ * @brief LogLike component whose data live in a separate worker
+ * process.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <iostream>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Likelihood/ComponentEvaluator.h"
+#include "Likelihood/RemoteLogLike.h"
+
+namespace {
+   enum Command {QUIT, VALUE, DERIVS, NPRED, COST};
+
+// MSG_NOSIGNAL is not available everywhere, e.g., on macOS, where
+// SO_NOSIGPIPE is set on the sockets instead.
+#ifdef MSG_NOSIGNAL
+   const int s_sendFlags(MSG_NOSIGNAL);
+#else
+   const int s_sendFlags(0);
+#endif
+
+   std::string errorMessage(const std::string & what) {
+      return "RemoteLogLike: " + what + ": " + std::strerror(errno);
+   }
+
+   void writeBytes(int fd, const char * buffer, size_t nbytes) {
+      while (nbytes > 0) {
+// Use send() where possible so that a worker that has gone away
+// gives an error rather than SIGPIPE.
+         ssize_t nwritten(::send(fd, buffer, nbytes, s_sendFlags));
+         if (nwritten < 0 && errno == ENOTSOCK) {
+            nwritten = ::write(fd, buffer, nbytes);
+         }
+         if (nwritten < 0) {
+            if (errno == EINTR) {
+               continue;
+            }
+            throw std::runtime_error(errorMessage("write failed"));
+         }
+         buffer += nwritten;
+         nbytes -= nwritten;
+      }
+   }
+
+/// @return false if the connection was closed before any bytes were
+///         read.
+   bool readBytes(int fd, char * buffer, size_t nbytes) {
+      size_t nread(0);
+      while (nread < nbytes) {
+         ssize_t n(::read(fd, buffer + nread, nbytes - nread));
+         if (n < 0) {
+            if (errno == EINTR) {
+               continue;
+            }
+            if (errno != ECONNRESET) {
+               throw std::runtime_error(errorMessage("read failed"));
+            }
+            n = 0;
+         }
+         if (n == 0) {
+            if (nread == 0) {
+               return false;
+            }
+            throw std::runtime_error("RemoteLogLike: connection closed "
+                                     "in the middle of a message.");
+         }
+         nread += n;
+      }
+      return true;
+   }
+}
+
+namespace Likelihood {
+
+/**
+ * @class RemoteLogLike::Message
+ * @brief A request or reply, sent as its length followed by the
+ * packed values.
+ */
+class RemoteLogLike::Message {
+public:
+   Message() : m_pos(0) {}
+
+   template <typename T>
+   void put(const T & x) {
+      const char * bytes(reinterpret_cast<const char *>(&x));
+      m_data.insert(m_data.end(), bytes, bytes + sizeof(T));
+   }
+
+   template <typename T>
+   T get() {
+      if (m_pos + sizeof(T) > m_data.size()) {
+         throw std::runtime_error("RemoteLogLike: truncated message.");
+      }
+      T x;
+      std::memcpy(&x, &m_data[m_pos], sizeof(T));
+      m_pos += sizeof(T);
+      return x;
+   }
+
+   void putString(const std::string & x) {
+      put<unsigned int>(x.size());
+      m_data.insert(m_data.end(), x.begin(), x.end());
+   }
+
+   std::string getString() {
+      size_t length(get<unsigned int>());
+      if (m_pos + length > m_data.size()) {
+         throw std::runtime_error("RemoteLogLike: truncated message.");
+      }
+      std::string x(m_data.begin() + m_pos, m_data.begin() + m_pos + length);
+      m_pos += length;
+      return x;
+   }
+
+   void send(int fd) const {
+      unsigned int length(m_data.size());
+      std::vector<char> buffer(reinterpret_cast<const char *>(&length),
+                               reinterpret_cast<const char *>(&length)
+                               + sizeof(length));
+      buffer.insert(buffer.end(), m_data.begin(), m_data.end());
+      writeBytes(fd, &buffer[0], buffer.size());
+   }
+
+   /// @return false if the connection was closed.
+   bool receive(int fd) {
+      unsigned int length;
+      if (!readBytes(fd, reinterpret_cast<char *>(&length), sizeof(length))) {
+         return false;
+      }
+      m_data.resize(length);
+      m_pos = 0;
+      if (length > 0 && !readBytes(fd, &m_data[0], length)) {
+         throw std::runtime_error("RemoteLogLike: connection closed "
+                                  "in the middle of a message.");
+      }
+      return true;
+   }
+
+private:
+   std::vector<char> m_data;
+   size_t m_pos;
+};
+
+RemoteLogLike::RemoteLogLike(const Observation & observation,
+                             Factory & factory)
+   : LogLike(observation), m_fdIn(-1), m_fdOut(-1), m_pid(0) {
+   int fds[2];
+   if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      throw std::runtime_error(errorMessage("socketpair failed"));
+   }
+#ifdef SO_NOSIGPIPE
+   int on(1);
+   for (size_t i(0); i < 2; i++) {
+      if (::setsockopt(fds[i], SOL_SOCKET, SO_NOSIGPIPE, 
+                       &on, sizeof(on)) != 0) {
+         ::close(fds[0]);
+         ::close(fds[1]);
+         throw std::runtime_error(errorMessage("setsockopt failed"));
+      }
+   }
+#endif
+// Otherwise output still buffered here would also be written by the
+// worker.
+   std::fflush(0);
+   pid_t pid(::fork());
+   if (pid < 0) {
+      ::close(fds[0]);
+      ::close(fds[1]);
+      throw std::runtime_error(errorMessage("fork failed"));
+   }
+   if (pid == 0) {
+// Worker process.  The coordinator sees a closed connection if
+// anything goes wrong here.
+      ::close(fds[0]);
+      int status(0);
+      LogLike * like(0);
+      try {
+         like = factory.create();
+         serve(*like, fds[1], fds[1]);
+      } catch (std::exception & eObj) {
+         std::cerr << "RemoteLogLike worker: " << eObj.what() << std::endl;
+         status = 1;
+      }
+      delete like;
+      ::close(fds[1]);
+// Skip the coordinator's exit handlers and static destructors.
+      ::_exit(status);
+   }
+   ::close(fds[1]);
+   m_fdIn = fds[0];
+   m_fdOut = fds[0];
+   m_pid = pid;
+}
+
+RemoteLogLike::RemoteLogLike(const Observation & observation,
+                             int fd_in, int fd_out)
+   : LogLike(observation), m_fdIn(fd_in), m_fdOut(fd_out), m_pid(0) {}
+
+RemoteLogLike::~RemoteLogLike() {
+   try {
+      Message request;
+      request.put<int>(QUIT);
+      request.send(m_fdOut);
+   } catch (...) {
+// The worker may already have gone away.
+   }
+   ::close(m_fdIn);
+   if (m_fdOut != m_fdIn) {
+      ::close(m_fdOut);
+   }
+   if (m_pid > 0) {
+      int status;
+      ::waitpid(m_pid, &status, 0);
+   }
+}
+
+double RemoteLogLike::value(const optimizers::Arg &,
+                            bool include_priors) const {
+   Message request;
+   request.put<int>(VALUE);
+   putParams(request);
+   Message reply;
+   call(request, reply);
+   double my_value(reply.get<double>());
+   if (include_priors) {
+      std::vector<optimizers::Parameter>::const_iterator
+         par(m_parameter.begin());
+      for ( ; par != m_parameter.end(); ++par) {
+         my_value += par->log_prior_value();
+      }
+   }
+   m_nevals++;
+   saveBestFit(my_value);
+   if (my_value != my_value) {
+      throw std::runtime_error("RemoteLogLike::value: Nan encountered.");
+   }
+   return my_value;
+}
+
+void RemoteLogLike::getFreeDerivs(const optimizers::Arg &,
+                                  std::vector<double> & derivs,
+                                  bool include_priors) const {
+   Message request;
+   request.put<int>(DERIVS);
+   putParams(request);
+   Message reply;
+   call(request, reply);
+   size_t nderivs(reply.get<unsigned int>());
+   derivs.clear();
+   for (size_t i(0); i < nderivs; i++) {
+      derivs.push_back(reply.get<double>());
+   }
+   if (include_priors) {
+      size_t i(0);
+      std::vector<optimizers::Parameter>::const_iterator
+         par(m_parameter.begin());
+      for ( ; par != m_parameter.end(); ++par) {
+         if (par->isFree()) {
+            derivs.at(i) += par->log_prior_deriv();
+            i++;
+         }
+      }
+   }
+}
+
+double RemoteLogLike::NpredValue(const std::string & srcName,
+                                 bool weighted) const {
+   Message request;
+   request.put<int>(NPRED);
+   putParams(request);
+   request.putString(srcName);
+   request.put<char>(weighted);
+   Message reply;
+   call(request, reply);
+   return reply.get<double>();
+}
+
+double RemoteLogLike::cost() const {
+   Message request;
+   request.put<int>(COST);
+   putParams(request);
+   Message reply;
+   call(request, reply);
+   return reply.get<double>();
+}
+
+LogLike * RemoteLogLike::clone() const {
+   throw std::runtime_error("RemoteLogLike objects cannot be cloned.");
+}
+
+void RemoteLogLike::putParams(Message & request) const {
+   request.put<unsigned int>(m_parameter.size());
+   for (size_t i(0); i < m_parameter.size(); i++) {
+      request.put<double>(m_parameter[i].getValue());
+      request.put<char>(m_parameter[i].isFree());
+   }
+}
+
+void RemoteLogLike::call(const Message & request, Message & reply) const {
+   request.send(m_fdOut);
+   if (!reply.receive(m_fdIn)) {
+      throw std::runtime_error("RemoteLogLike: the worker closed "
+                               "the connection.");
+   }
+   if (reply.get<int>() != 0) {
+      throw std::runtime_error("RemoteLogLike worker: " + reply.getString());
+   }
+}
+
+void RemoteLogLike::serve(LogLike & like, int fd_in, int fd_out) {
+// The parameters last set in like, so that it is only re-synced
+// when they change.
+   std::vector<double> values;
+   std::vector<char> freeFlags;
+   Message request;
+   while (request.receive(fd_in)) {
+      int command(request.get<int>());
+      if (command == QUIT) {
+         return;
+      }
+      Message reply;
+      try {
+         size_t npars(request.get<unsigned int>());
+         std::vector<double> new_values;
+         std::vector<char> new_freeFlags;
+         for (size_t i(0); i < npars; i++) {
+            new_values.push_back(request.get<double>());
+            new_freeFlags.push_back(request.get<char>());
+         }
+         if (new_values != values || new_freeFlags != freeFlags) {
+            std::vector<optimizers::Parameter> pars(like.parameters());
+            if (pars.size() != npars) {
+               throw std::runtime_error("The number of parameters does "
+                                        "not match that of the worker.");
+            }
+            for (size_t i(0); i < npars; i++) {
+               pars[i].setFree(new_freeFlags[i] != 0);
+               pars[i].setValue(new_values[i]);
+            }
+            like.setParams(pars);
+            like.syncParams();
+            values = new_values;
+            freeFlags = new_freeFlags;
+         }
+         optimizers::Arg dummy;
+         if (command == VALUE) {
+            double my_value(like.value(dummy, false));
+            reply.put<int>(0);
+            reply.put<double>(my_value);
+         } else if (command == DERIVS) {
+            std::vector<double> derivs;
+            like.getFreeDerivs(dummy, derivs, false);
+            reply.put<int>(0);
+            reply.put<unsigned int>(derivs.size());
+            for (size_t i(0); i < derivs.size(); i++) {
+               reply.put<double>(derivs[i]);
+            }
+         } else if (command == NPRED) {
+            std::string srcName(request.getString());
+            bool weighted(request.get<char>() != 0);
+            double npred(like.NpredValue(srcName, weighted));
+            reply.put<int>(0);
+            reply.put<double>(npred);
+         } else if (command == COST) {
+            reply.put<int>(0);
+            reply.put<double>(ComponentEvaluator::cost(like));
+         } else {
+            throw std::runtime_error("Unknown request.");
+         }
+      } catch (std::exception & eObj) {
+// Report the error and carry on; the coordinator decides what to do.
+         values.clear();
+         freeFlags.clear();
+         reply = Message();
+         reply.put<int>(1);
+         reply.putString(eObj.what());
+      }
+      reply.send(fd_out);
+   }
+}
+
+} // namespace Likelihood
@@ -31,6 +31,18 @@ ResponseFunctions::~ResponseFunctions() {
    }
 }
 
+ResponseFunctions * ResponseFunctions::clone() const {
+   ResponseFunctions * my_clone(new ResponseFunctions());
+   my_clone->m_useEdisp = m_useEdisp;
+   my_clone->m_respName = m_respName;
+   std::map<unsigned int, irfInterface::Irfs *>::const_iterator 
+      it(m_respPtrs.begin());
+   for ( ; it != m_respPtrs.end(); ++it) {
+      my_clone->m_respPtrs[it->first] = it->second ? it->second->clone() : 0;
+   }
+   return my_clone;
+}
+
 double ResponseFunctions::totalResponse(double energy, double appEnergy,
                                         const astro::SkyDir & zAxis,
                                         const astro::SkyDir & xAxis,
@@ -227,10 +227,37 @@ void RoiCuts::sortCuts(bool strict) {
 }
 
 bool RoiCuts::accept(const Event &event) const {
+   if (event.getEnergy() < m_eMin || event.getEnergy() > m_eMax ||
+       event.getMuZenith() < m_muZenMax) {
+      return false;
+   }
+   double dist = event.getSeparation(m_roiCone.center())*180./M_PI;
+   if (dist > m_roiCone.radius()) {
+      return false;
+   }
+   return acceptTime(event.getArrTime());
+}
+
+bool RoiCuts::accept(double ra, double dec, double energy, double time,
+                     double muZenith) const {
+// The cheap tests go first, since this is applied to every row of
+// the event files.
+   if (energy < m_eMin || energy > m_eMax || muZenith < m_muZenMax) {
+      return false;
+   }
+   double dist = astro::SkyDir(ra, dec).difference(m_roiCone.center())
+      *180./M_PI;
+   if (dist > m_roiCone.radius()) {
+      return false;
+   }
+   return acceptTime(time);
+}
+
+bool RoiCuts::acceptTime(double time) const {
    bool acceptEvent(false);
 
    std::map<std::string, double> thisEvent;
-   thisEvent["TIME"] = event.getArrTime();
+   thisEvent["TIME"] = time;
 
    if (m_gtiCuts.size() == 0) {
       acceptEvent = true;
@@ -246,19 +273,6 @@ bool RoiCuts::accept(const Event &event) const {
       acceptEvent = m_timeRangeCuts.at(i)->accept(thisEvent);
    }
 
-   if (event.getEnergy() < m_eMin || event.getEnergy() > m_eMax) { 
-      acceptEvent = false;
-   }
-
-   double dist = event.getSeparation(m_roiCone.center())*180./M_PI;
-   if (dist > m_roiCone.radius()) {
-      acceptEvent = false;
-   }
-
-   if (event.getMuZenith() < m_muZenMax) {
-      acceptEvent = false;
-   }
-
    return acceptEvent;
 }
 
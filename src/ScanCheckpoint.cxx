@@ -0,0 +1,147 @@
+/**
+ * @file ScanCheckpoint.cxx
+ * @brief Periodic checkpoints of the finished positions of a map scan.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#include <cstdio>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "Likelihood/ScanCheckpoint.h"
+
+namespace {
+   const std::string s_magic("LIKELIHOOD_SCAN_CHECKPOINT 1");
+
+   void writeString(std::ostream & out, const std::string & value) {
+      size_t size(value.size());
+      out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+      out.write(value.data(), size);
+   }
+
+   bool readString(std::istream & in, std::string & value) {
+      size_t size(0);
+      if (!in.read(reinterpret_cast<char *>(&size), sizeof(size))) {
+         return false;
+      }
+      value.resize(size);
+      return size == 0 || in.read(&value[0], size);
+   }
+
+   template <typename T>
+   void writeVector(std::ostream & out, const std::vector<T> & values) {
+      size_t size(values.size());
+      out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+      if (size > 0) {
+         out.write(reinterpret_cast<const char *>(&values[0]),
+                   size*sizeof(T));
+      }
+   }
+
+   template <typename T>
+   bool readVector(std::istream & in, std::vector<T> & values) {
+      size_t size(0);
+      if (!in.read(reinterpret_cast<char *>(&size), sizeof(size))) {
+         return false;
+      }
+      values.resize(size);
+      return size == 0 || in.read(reinterpret_cast<char *>(&values[0]),
+                                  size*sizeof(T));
+   }
+}
+
+namespace Likelihood {
+
+ScanCheckpoint::ScanCheckpoint(const std::string & filename,
+                               const std::string & signature,
+                               size_t npix, double interval)
+   : m_filename(filename), m_signature(signature), m_interval(interval),
+     m_lastWrite(std::time(0)), m_done(npix, 0) {}
+
+bool ScanCheckpoint::read() {
+   std::ifstream in(m_filename.c_str(), std::ios::binary);
+   if (!in) {
+      return false;
+   }
+   std::string magic;
+   std::string signature;
+   if (!readString(in, magic) || magic != s_magic ||
+       !readString(in, signature) || signature != m_signature) {
+      return false;
+   }
+   std::vector<char> done;
+   std::vector<double> params;
+   size_t narrays(0);
+   if (!readVector(in, done) || done.size() != m_done.size() ||
+       !readVector(in, params) ||
+       !in.read(reinterpret_cast<char *>(&narrays), sizeof(narrays))) {
+      return false;
+   }
+   std::map<std::string, std::vector<float> > arrays;
+   for (size_t i(0); i < narrays; i++) {
+      std::string name;
+      if (!readString(in, name) || !readVector(in, arrays[name])) {
+         return false;
+      }
+   }
+   m_done.swap(done);
+   m_params.swap(params);
+   m_arrays.swap(arrays);
+   return true;
+}
+
+void ScanCheckpoint::write() {
+   std::string tmpfile(m_filename + ".tmp");
+   std::ofstream out(tmpfile.c_str(), std::ios::binary | std::ios::trunc);
+   writeString(out, s_magic);
+   writeString(out, m_signature);
+   writeVector(out, m_done);
+   writeVector(out, m_params);
+   size_t narrays(m_arrays.size());
+   out.write(reinterpret_cast<const char *>(&narrays), sizeof(narrays));
+   std::map<std::string, std::vector<float> >::const_iterator it;
+   for (it = m_arrays.begin(); it != m_arrays.end(); ++it) {
+      writeString(out, it->first);
+      writeVector(out, it->second);
+   }
+   out.close();
+   if (!out || std::rename(tmpfile.c_str(), m_filename.c_str()) != 0) {
+      throw std::runtime_error("ScanCheckpoint: failed to write "
+                               + m_filename);
+   }
+   m_lastWrite = std::time(0);
+}
+
+bool ScanCheckpoint::due() const {
+   return std::difftime(std::time(0), m_lastWrite) >= m_interval;
+}
+
+void ScanCheckpoint::remove() const {
+   std::remove(m_filename.c_str());
+}
+
+size_t ScanCheckpoint::nDone() const {
+   return std::count(m_done.begin(), m_done.end(), 1);
+}
+
+void ScanCheckpoint::setArray(const std::string & name,
+                              const std::vector<float> & values) {
+   m_arrays[name] = values;
+}
+
+bool ScanCheckpoint::getArray(const std::string & name,
+                              std::vector<float> & values) const {
+   std::map<std::string, std::vector<float> >::const_iterator it
+      = m_arrays.find(name);
+   if (it == m_arrays.end()) {
+      return false;
+   }
+   values = it->second;
+   return true;
+}
+
+} // namespace Likelihood
@@ -174,6 +174,9 @@ namespace Likelihood {
       logLike_mles.resize(nebins);
       logLikes.resize(nebins);
 
+      // The bins are fit one after another, since they all use the same 
+      // likelihood and optimizer.  FitScanner::sed_binned_newton can fit 
+      // them concurrently, since it works on copies of the cached models
       for ( int ie(0); ie < nebins; ie++ ) {
 	scan_norm_binned(modelWrapper,signal_name,
 			 optimizer,tol,tolType,
@@ -31,16 +31,15 @@ void SummedLikelihood::addComponent(LogLike & component) {
    if (m_masterComponent == 0) {
       m_masterComponent = &component;
    }
+   m_evaluator.reset();
 }
 
 double SummedLikelihood::value() const {
+   std::vector<double> values;
+   m_evaluator.values(m_components, values, true);
    double my_value(0);
-   ComponentConstIterator_t it(m_components.begin());
-   bool include_prior(true);
-   optimizers::Arg dummy;   
-   for ( ; it != m_components.end(); ++it) {
-     my_value += (*it)->value(dummy, include_prior);
-     include_prior = false;
+   for (size_t i(0); i < values.size(); i++) {
+      my_value += values[i];
    }
    return my_value;
 }
@@ -93,12 +92,9 @@ setFreeParamValues(const std::vector<double> & values) {
 }
 
 void SummedLikelihood::syncParams() { 
-   std::vector<optimizers::Parameter> & pars(m_masterComponent->parameters());
-   for (ComponentIterator_t it(m_components.begin()); 
-        it != m_components.end(); ++it) {
-      (*it)->setParams(pars);
-      (*it)->syncParams();
-   }
+// Copy the parameters, since the master component is also updated.
+   std::vector<optimizers::Parameter> pars(m_masterComponent->parameters());
+   m_evaluator.syncParams(m_components, pars);
 }
 
 double SummedLikelihood::NpredValue(const std::string & srcname, bool weighted) const {
@@ -169,18 +165,16 @@ void SummedLikelihood::getFreeDerivs(std::vector<double> & derivs) const {
    // Intialize derivs vector with zeros for each free Minos parameter.
    derivs.resize(free_index.size(), 0);
 
-   // Loop over log-likeihood components, adding derivative contributions.
-   bool include_priors(true);
-   optimizers::Arg dummy;      
-   for (ComponentConstIterator_t it(m_components.begin());
-        it != m_components.end(); ++it) {
-      std::vector<double> freeDerivs;
-      (*it)->getFreeDerivs(dummy, freeDerivs, include_priors);
+   // Evaluate the log-likelihood components, concurrently after the
+   // first call, then add their derivative contributions in order.
+   std::vector< std::vector<double> > componentDerivs;
+   m_evaluator.derivs(m_components, componentDerivs, true);
+   for (size_t i(0); i < m_components.size(); i++) {
+      const std::vector<double> & freeDerivs(componentDerivs[i]);
       for (std::map<int, size_t>::const_iterator index_it(free_index.begin());
            index_it != free_index.end(); ++index_it) {
          derivs.at(index_it->first) += freeDerivs.at(index_it->second);
       }
-      include_priors = false;
    }
 }
 
@@ -0,0 +1,203 @@
+/**
+ * @file ThreadPool.cxx
+ * @brief Implementation of a persistent pool of POSIX threads.
+ * @author agent <agent@local>
+ *
+ * $Header$
+ */
+
+#include <unistd.h>
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "Likelihood/ThreadPool.h"
+
+namespace Likelihood {
+
+ThreadPool::ThreadPool(size_t nthreads)
+   : m_nthreads(nthreads), m_shutdown(false), m_busy(false),
+     m_generation(0), m_task(0), m_nitems(0), m_chunk(1), m_next(0),
+     m_pending(0) {
+   if (m_nthreads == 0) {
+      m_nthreads = defaultThreads();
+   }
+   pthread_cond_init(&m_start, 0);
+   pthread_cond_init(&m_done, 0);
+// The calling thread acts as worker 0, so only nthreads - 1
+// additional threads are needed.
+   m_args.resize(m_nthreads);
+   for (size_t i(1); i < m_nthreads; i++) {
+      m_args[i].pool = this;
+      m_args[i].thread_id = i;
+      pthread_t thread;
+      if (pthread_create(&thread, 0, &ThreadPool::startWorker,
+                         &m_args[i]) != 0) {
+// Run with the threads we managed to create.
+         m_nthreads = i;
+         break;
+      }
+      m_threads.push_back(thread);
+   }
+}
+
+ThreadPool::~ThreadPool() {
+   m_mutex.lock();
+   m_shutdown = true;
+   pthread_cond_broadcast(&m_start);
+   m_mutex.unlock();
+   for (size_t i(0); i < m_threads.size(); i++) {
+      pthread_join(m_threads[i], 0);
+   }
+   pthread_cond_destroy(&m_start);
+   pthread_cond_destroy(&m_done);
+}
+
+void ThreadPool::run(Task & task, size_t nitems, size_t chunk) {
+   if (nitems == 0) {
+      return;
+   }
+   m_mutex.lock();
+// Tasks index per-thread state by thread_id, so a second job cannot
+// share the thread ids of one that is still running.
+   if (m_busy) {
+      m_mutex.unlock();
+      throw std::runtime_error("ThreadPool::run: the pool is already "
+                               "running a task; nested or concurrent "
+                               "calls are not supported.");
+   }
+   m_busy = true;
+   if (m_threads.empty()) {
+      m_mutex.unlock();
+      try {
+         runSerial(task, nitems);
+      } catch (...) {
+         Lock lock(m_mutex);
+         m_busy = false;
+         throw;
+      }
+      Lock lock(m_mutex);
+      m_busy = false;
+      return;
+   }
+   m_task = &task;
+   m_nitems = nitems;
+   m_chunk = std::max(chunk, size_t(1));
+   m_next = 0;
+   m_pending = m_threads.size();
+   m_error.clear();
+   m_generation++;
+   pthread_cond_broadcast(&m_start);
+   m_mutex.unlock();
+
+   processItems(0);
+
+   m_mutex.lock();
+   while (m_pending > 0) {
+      pthread_cond_wait(&m_done, m_mutex.handle());
+   }
+   m_busy = false;
+   m_task = 0;
+   std::string error(m_error);
+   m_mutex.unlock();
+
+   if (!error.empty()) {
+      throw std::runtime_error(error);
+   }
+}
+
+void ThreadPool::runSerial(Task & task, size_t nitems) {
+   for (size_t item(0); item < nitems; item++) {
+      task.run(item, 0);
+   }
+}
+
+void ThreadPool::processItems(size_t thread_id) {
+   while (true) {
+      size_t begin, end;
+      m_mutex.lock();
+      if (!m_error.empty() || m_next >= m_nitems) {
+         m_mutex.unlock();
+         return;
+      }
+      begin = m_next;
+      end = std::min(m_nitems, begin + m_chunk);
+      m_next = end;
+      m_mutex.unlock();
+      try {
+         for (size_t item(begin); item < end; item++) {
+            m_task->run(item, thread_id);
+         }
+      } catch (std::exception & eObj) {
+         Lock lock(m_mutex);
+         if (m_error.empty()) {
+            m_error = eObj.what();
+         }
+         return;
+      } catch (...) {
+         Lock lock(m_mutex);
+         if (m_error.empty()) {
+            m_error = "ThreadPool: unknown exception thrown by task";
+         }
+         return;
+      }
+   }
+}
+
+void ThreadPool::workerLoop(size_t thread_id) {
+   unsigned long seen(0);
+   while (true) {
+      m_mutex.lock();
+      while (!m_shutdown && m_generation == seen) {
+         pthread_cond_wait(&m_start, m_mutex.handle());
+      }
+      if (m_shutdown) {
+         m_mutex.unlock();
+         return;
+      }
+      seen = m_generation;
+      m_mutex.unlock();
+
+      processItems(thread_id);
+
+      m_mutex.lock();
+      m_pending--;
+      if (m_pending == 0) {
+         pthread_cond_signal(&m_done);
+      }
+      m_mutex.unlock();
+   }
+}
+
+void * ThreadPool::startWorker(void * args) {
+   WorkerArgs * my_args(reinterpret_cast<WorkerArgs *>(args));
+   my_args->pool->workerLoop(my_args->thread_id);
+   return 0;
+}
+
+size_t ThreadPool::defaultThreads() {
+   const char * value(std::getenv("LIKELIHOOD_NTHREADS"));
+   if (value == 0) {
+      return 1;
+   }
+   return resolveThreads(std::atoi(value));
+}
+
+size_t ThreadPool::hardwareThreads() {
+   long ncpus(sysconf(_SC_NPROCESSORS_ONLN));
+   if (ncpus < 1) {
+      return 1;
+   }
+   return static_cast<size_t>(ncpus);
+}
+
+size_t ThreadPool::resolveThreads(int nthreads) {
+   if (nthreads <= 0) {
+      return hardwareThreads();
+   }
+   return static_cast<size_t>(nthreads);
+}
+
+} // namespace Likelihood
@@ -231,6 +231,9 @@ void HealCube::computeMap() {
   //m_scanner->set_verbose_bb(3);
   //m_scanner->set_verbose_scan(3);
 
+  int nthreads = m_pars["nthreads"];
+  m_scanner->set_nThreads(nthreads);
+
   int status = m_scanner->run_tscube(doTsMap,doSED,nnorm,normSigma,covScale_bb,covScale,
 				     tol,maxiter,tolType,remakeTestSource,ST_scan_level);
   
@@ -219,9 +219,12 @@ void TsCube::computeMap() {
       tolType = optimizers::RELATIVE;
   }
 
-  // These is always true for this application
+  // This is always true for this application
   static const bool doTsMap(true);
-  static const bool doSED(true);
+
+  // The fast TS map only does the broadband fits
+  bool fastTs = m_pars["fastts"];
+  bool doSED = ! fastTs;
 
   // Hidden parameters for the loop
   int nnorm = m_pars["nnorm"];
@@ -237,6 +240,27 @@ void TsCube::computeMap() {
   //m_scanner->set_verbose_bb(3);
   //m_scanner->set_verbose_scan(3);
 
+  int nthreads = m_pars["nthreads"];
+  m_scanner->set_nThreads(nthreads);
+  m_scanner->set_fastTSMap(fastTs);
+  int nrefine = m_pars["nrefine"];
+  m_scanner->set_nRefine(nrefine);
+  int coarseStep = m_pars["coarsestep"];
+  double refineTs = m_pars["refinets"];
+  double refineGrad = m_pars["refinegrad"];
+  m_scanner->set_adaptiveGrid(coarseStep,refineTs,refineGrad);
+  bool warmStart = m_pars["warmstart"];
+  m_scanner->set_warmStart(warmStart);
+
+  // Checkpoint to a sidecar file next to the output file
+  double checkpoint = m_pars["checkpoint"];
+  bool resume = m_pars["resume"];
+  if ( checkpoint > 0 || resume ) {
+    std::string outfile = m_pars["outfile"];
+    double interval = checkpoint > 0 ? 60.*checkpoint : 600.;
+    m_scanner->set_checkpoint(outfile + ".ckpt",interval,resume);
+  }
+
   int status = m_scanner->run_tscube(doTsMap,doSED,nnorm,normSigma,covScale_bb,covScale,
 				     tol,maxiter,tolType,remakeTestSource,ST_scan_level,
 				     "",initLambda,m_wmap != 0);
@@ -256,5 +280,10 @@ void TsCube::writeFitsFile() {
   int status = m_scanner->writeFitsFile(m_pars["outfile"],
 					"gttscube",
 					template_file);
+  // The checkpoint is no longer needed once the output is written
+  std::string outfile = m_pars["outfile"];
+  if ( status == 0 ) {
+    std::remove((outfile + ".ckpt").c_str());
+  }
   return;
 }
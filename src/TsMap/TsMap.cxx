@@ -12,7 +12,9 @@
 #include <cstdlib>
 #include <cstring>
 
+#include <algorithm>
 #include <sstream>
+#include <stdexcept>
 
 #include "facilities/commonUtilities.h"
 
@@ -36,11 +38,15 @@
 #include "optimizers/OptimizerFactory.h"
 #include "optimizers/Exception.h"
 
+#include "Likelihood/AdaptiveGrid.h"
 #include "Likelihood/AppHelpers.h"
 #include "Likelihood/BinnedLikelihood.h"
 #include "Likelihood/LogLike.h"
+#include "Likelihood/ObservationCopies.h"
+#include "Likelihood/ScanCheckpoint.h"
 #include "Likelihood/SourceMap.h"
 #include "Likelihood/CountsMap.h"
+#include "Likelihood/ThreadPool.h"
 
 using namespace Likelihood;
 
@@ -58,6 +64,8 @@ public:
       try {
          delete m_opt;
          delete m_helper;
+         delete m_grid;
+         delete m_checkpoint;
       } catch (std::exception & eObj) {
          std::cerr << eObj.what() << std::endl;
       } catch (...) {
@@ -75,19 +83,32 @@ private:
    CountsMapBase * m_dataMap;
    std::vector<astro::SkyDir> m_dirs;
    std::vector<float> m_tsMap;
+   AdaptiveGrid * m_grid;
+   ScanCheckpoint * m_checkpoint;
    std::string m_coordSys;
    std::vector<double> m_crpix;
    std::vector<double> m_crval;
    std::vector<double> m_cdelt;
    void promptForParameters();
    void readSrcModel();
+   void readXml(LogLike & logLike);
    void readEventData(const std::vector<std::string> & evfiles);
    void selectOptimizer();
    void setGrid();
    void computeMap();
+   void interpolateMap();
+   void setupCheckpoint(double & logLike0);
+   void finishPosition(long ipix);
+   void saveCheckpoint();
+   void computeMapParallel(size_t nthreads, double logLike0,
+                           int verbosity, double tol,
+                           optimizers::TOLTYPE tolType);
+   LogLike * makeLikelihood(const Observation & observation);
    void writeFitsFile();
    void setPointSourceSpectrum(PointSource &src);
 
+   class PositionTask;
+
    static std::string s_cvs_id;
 };
 
@@ -96,7 +117,7 @@ st_app::StAppFactory<TsMap> myAppFactory("gttsmap");
 TsMap::TsMap() 
    : st_app::StApp(), m_helper(0), 
      m_pars(st_app::StApp::getParGroup("gttsmap")),
-     m_logLike(0), m_opt(0),
+     m_logLike(0), m_opt(0), m_grid(0), m_checkpoint(0),
      m_formatter(new st_stream::StreamFormatter("gttsmap", "", 2)) {
    setVersion(s_cvs_id);
    m_pars.setSwitch("statistic");
@@ -187,31 +208,45 @@ void TsMap::run() {
    selectOptimizer();
    setGrid();
    computeMap();
+   if (m_checkpoint) {
+      saveCheckpoint();
+   }
+   interpolateMap();
    writeFitsFile();
+   if (m_checkpoint) {
+      m_checkpoint->remove();
+   }
 }
 
 void TsMap::readEventData(const std::vector<std::string> & evfiles) {
    std::vector<std::string>::const_iterator evfile(evfiles.begin());
    for ( ; evfile != evfiles.end(); ++evfile) {
       st_facilities::Util::file_ok(*evfile);
-      m_logLike->getEvents(*evfile);
    }
+   m_logLike->getEvents(evfiles);
 }
 
 void TsMap::readSrcModel() {
    std::string srcModelFile = m_pars["srcmdl"];
    if (srcModelFile != "" && srcModelFile != "none") {
       st_facilities::Util::file_ok(srcModelFile);
+      readXml(*m_logLike);
+      if (m_statistic == "UNBINNED") {
+         m_logLike->computeEventResponses();
+      }
+   }
+}
+
+void TsMap::readXml(LogLike & logLike) {
+   std::string srcModelFile = m_pars["srcmdl"];
+   if (srcModelFile != "" && srcModelFile != "none") {
       bool requireExposure = (m_statistic != "BINNED");
 //      bool loadMaps = (m_statistic != "BINNED");
       bool loadMaps;
       bool addPointSources;
-      m_logLike->readXml(srcModelFile, m_helper->funcFactory(),
-                         requireExposure, addPointSources=true,
-                         loadMaps=false);
-      if (m_statistic == "UNBINNED") {
-         m_logLike->computeEventResponses();
-      }
+      logLike.readXml(srcModelFile, m_helper->funcFactory(),
+                      requireExposure, addPointSources=true,
+                      loadMaps=false);
    }
 }
 
@@ -245,20 +280,16 @@ void TsMap::setGrid() {
          m_dirs.push_back(astro::SkyDir(i+1, j+1, proj));
       }
    }
+
+// With coarsestep = 1 every position is fit in the first pass.
+   int coarseStep = m_pars["coarsestep"];
+   double refineTs = m_pars["refinets"];
+   double refineGrad = m_pars["refinegrad"];
+   delete m_grid;
+   m_grid = new AdaptiveGrid(nxpix, nypix, coarseStep, refineTs, refineGrad);
 }
 
 void TsMap::computeMap() {
-   Likelihood::PointSource * testSrc(0);
-   if (m_statistic == "UNBINNED") {
-      testSrc = new Likelihood::PointSource(m_dirs.at(0).ra(), 
-                                            m_dirs.at(0).dec(), 
-                                            m_helper->observation());
-   } else {
-      testSrc = new Likelihood::PointSource();
-   }
-   setPointSourceSpectrum(*testSrc);
-   testSrc->setName("testSource");
-
    int verbosity = m_pars["chatter"];
    verbosity -= 2;
    double tol = m_pars["ftol"];
@@ -274,38 +305,365 @@ void TsMap::computeMap() {
    } catch (...) {
       logLike0 = 0;
    }
+// Each position starts from the null-hypothesis fit, as on the
+// parallel path, so the map does not depend on the number of threads.
+   std::vector<double> nullParams;
+   m_logLike->getParamValues(nullParams);
+   setupCheckpoint(logLike0);
+   int nthreads = m_pars["nthreads"];
+   size_t nthreads_used(ThreadPool::resolveThreads(nthreads));
+   std::string optimizer = m_pars["optimizer"];
+   if (nthreads_used > 1 && optimizer != "NEWMINUIT") {
+      m_formatter->warn() << "Only the NEWMINUIT optimizer can be run "
+                          << "on several threads; "
+                          << "fitting positions serially." << std::endl;
+      nthreads_used = 1;
+   }
+   if (nthreads_used > 1 && m_dirs.size() > 1) {
+      computeMapParallel(nthreads_used, logLike0, verbosity, tol, tolType);
+      return;
+   }
+
+   Likelihood::PointSource * testSrc(0);
+   if (m_statistic == "UNBINNED") {
+      testSrc = new Likelihood::PointSource(m_dirs.at(0).ra(), 
+                                            m_dirs.at(0).dec(), 
+                                            m_helper->observation());
+   } else {
+      testSrc = new Likelihood::PointSource();
+   }
+   setPointSourceSpectrum(*testSrc);
+   testSrc->setName("testSource");
+
    int step(m_dirs.size()/20);
    if (step == 0) {
       step = 2;
    }
    bool computeExposure;
-   for (size_t i(0); i < m_dirs.size(); i++) {
-      if ((i % step) == 0) {
-         m_formatter->warn() << ".";
+   std::vector<long> pixels;
+   while (m_grid->nextPixels(pixels)) {
+      for (size_t k(0); k < pixels.size(); k++) {
+         long i(pixels[k]);
+         if (m_checkpoint && m_checkpoint->done(i)) {
+            m_grid->setValue(i, m_tsMap.at(i));
+            continue;
+         }
+         if ((i % step) == 0) {
+            m_formatter->warn() << ".";
+         }
+         testSrc->setDir(m_dirs.at(i).ra(), m_dirs.at(i).dec(),
+                         computeExposure=(m_statistic=="UNBINNED"), false);
+
+         m_logLike->setParamValues(nullParams);
+         m_logLike->addSource(testSrc);
+         try {
+            m_opt->find_min_only(verbosity, tol, tolType);
+            m_tsMap.at(i) = 2.*(m_logLike->value() - logLike0);
+         } catch (optimizers::Exception & eObj) {
+            m_formatter->err() << eObj.what() << std::endl;
+            // Default null value.
+            m_tsMap.at(i) = 0;
+         }
+         m_formatter->info(3) << m_dirs.at(i).ra() << "  "
+                              << m_dirs.at(i).dec() << "  "
+                              << m_tsMap.at(i) << std::endl;
+         m_logLike->deleteSource(testSrc->getName());
+         if (m_statistic == "BINNED") {
+            dynamic_cast<BinnedLikelihood *>(m_logLike)
+               ->eraseSourceMap(testSrc->getName());
+         }
+         m_grid->setValue(i, m_tsMap.at(i));
+         finishPosition(i);
       }
-      testSrc->setDir(m_dirs.at(i).ra(), m_dirs.at(i).dec(),
-                      computeExposure=(m_statistic=="UNBINNED"), false);
+   }
+   m_formatter->warn() << "!" << std::endl;
+   delete testSrc;
+}
 
-      m_logLike->addSource(testSrc);
+void TsMap::setupCheckpoint(double & logLike0) {
+   m_tsMap.assign(m_dirs.size(), 0);
+   double checkpoint = m_pars["checkpoint"];
+   bool resume = m_pars["resume"];
+   if (checkpoint <= 0 && !resume) {
+      return;
+   }
+   std::string outfile = m_pars["outfile"];
+   std::string filename(outfile + ".ckpt");
+   double interval(checkpoint > 0 ? 60.*checkpoint : 600.);
+   std::string coordsys = m_pars["coordsys"];
+   std::string proj = m_pars["proj"];
+   std::ostringstream signature;
+   signature << "gttsmap " << m_statistic << " "
+             << m_crpix.at(0) << " " << m_crpix.at(1) << " "
+             << m_crval.at(0) << " " << m_crval.at(1) << " "
+             << m_cdelt.at(0) << " " << m_cdelt.at(1) << " "
+             << coordsys << " " << proj;
+   m_checkpoint = new ScanCheckpoint(filename, signature.str(),
+                                     m_dirs.size(), interval);
+   if (resume) {
+// The null fit is taken from the checkpoint, so that all the
+// positions are compared to the same null hypothesis.
+      if (m_checkpoint->read() && m_checkpoint->params().size() == 1
+          && m_checkpoint->getArray("TS", m_tsMap)
+          && m_tsMap.size() == m_dirs.size()) {
+         logLike0 = m_checkpoint->params().at(0);
+         m_formatter->info() << "Resuming from " << filename << " with "
+                             << m_checkpoint->nDone() << " of "
+                             << m_dirs.size() << " positions done."
+                             << std::endl;
+      } else {
+         m_formatter->warn() << "Could not resume from " << filename
+                             << ", starting from the beginning."
+                             << std::endl;
+         delete m_checkpoint;
+         m_checkpoint = new ScanCheckpoint(filename, signature.str(),
+                                           m_dirs.size(), interval);
+         m_tsMap.assign(m_dirs.size(), 0);
+      }
+   }
+   m_checkpoint->setParams(std::vector<double>(1, logLike0));
+}
+
+void TsMap::finishPosition(long ipix) {
+   if (m_checkpoint) {
+      m_checkpoint->setDone(ipix);
+      if (m_checkpoint->due()) {
+         saveCheckpoint();
+      }
+   }
+}
+
+void TsMap::saveCheckpoint() {
+   m_checkpoint->setArray("TS", m_tsMap);
+   m_checkpoint->write();
+}
+
+void TsMap::interpolateMap() {
+   long nfit(m_grid->nEvaluated());
+   if (nfit == static_cast<long>(m_tsMap.size())) {
+      return;
+   }
+   m_formatter->info() << "Fit " << nfit << " of " << m_tsMap.size()
+                       << " positions; the others are interpolated."
+                       << std::endl;
+   std::vector<double> tsMap(m_tsMap.begin(), m_tsMap.end());
+   m_grid->interpolate(tsMap);
+   m_tsMap.assign(tsMap.begin(), tsMap.end());
+}
+
+/**
+ * @class TsMap::PositionTask
+ * @brief Fits the test source at one position on the likelihood and
+ * optimizer belonging to the calling thread.  The model parameters
+ * are reset to the null-hypothesis fit before each position, so the
+ * map does not depend on the order in which the positions are done.
+ * Item k of the task is the position pixels[k].
+ */
+class TsMap::PositionTask : public ThreadPool::Task {
+public:
+   PositionTask(TsMap & app, const std::vector<LogLike *> & logLikes,
+                const std::vector<optimizers::Optimizer *> & opts,
+                const std::vector<PointSource *> & testSrcs,
+                const std::vector<double> & nullParams,
+                const std::vector<long> & pixels, double logLike0,
+                int verbosity, double tol, optimizers::TOLTYPE tolType)
+      : m_app(app), m_logLikes(logLikes), m_opts(opts),
+        m_testSrcs(testSrcs), m_nullParams(nullParams), m_pixels(pixels),
+        m_logLike0(logLike0), m_verbosity(verbosity), m_tol(tol),
+        m_tolType(tolType), m_step(app.m_dirs.size()/20) {
+      if (m_step == 0) {
+         m_step = 2;
+      }
+   }
+
+   virtual void run(size_t item, size_t thread_id) {
+      size_t i(m_pixels.at(item));
+      LogLike & logLike(*m_logLikes.at(thread_id));
+      PointSource & testSrc(*m_testSrcs.at(thread_id));
+      const astro::SkyDir & dir(m_app.m_dirs.at(i));
+      bool computeExposure;
+      logLike.setParamValues(m_nullParams);
+      testSrc.setDir(dir.ra(), dir.dec(),
+                     computeExposure=(m_app.m_statistic=="UNBINNED"), false);
+      logLike.addSource(&testSrc);
+      float ts(0);
+      std::string message;
       try {
-         m_opt->find_min_only(verbosity, tol, tolType);
-         m_tsMap.push_back(2.*(m_logLike->value() - logLike0));
+         m_opts.at(thread_id)->find_min_only(m_verbosity, m_tol, m_tolType);
+         ts = 2.*(logLike.value() - m_logLike0);
       } catch (optimizers::Exception & eObj) {
-         m_formatter->err() << eObj.what() << std::endl;
-         // Default null value.
-         m_tsMap.push_back(0);
+         message = eObj.what();
       }
-      m_formatter->info(3) << m_dirs.at(i).ra() << "  "
-                           << m_dirs.at(i).dec() << "  "
-                           << m_tsMap.back() << std::endl;
-      m_logLike->deleteSource(testSrc->getName());
-      if (m_statistic == "BINNED") {
-         dynamic_cast<BinnedLikelihood *>(m_logLike)
-            ->eraseSourceMap(testSrc->getName());
+      m_app.m_tsMap.at(i) = ts;
+      logLike.deleteSource(testSrc.getName());
+      if (m_app.m_statistic == "BINNED") {
+         dynamic_cast<BinnedLikelihood &>(logLike)
+            .eraseSourceMap(testSrc.getName());
+      }
+      ThreadPool::Lock lock(m_mutex);
+      if (message != "") {
+         m_app.m_formatter->err() << message << std::endl;
+      }
+      if ((i % m_step) == 0) {
+         m_app.m_formatter->warn() << ".";
+      }
+      m_app.m_formatter->info(3) << dir.ra() << "  " << dir.dec() << "  "
+                                 << ts << std::endl;
+   }
+
+private:
+   TsMap & m_app;
+   const std::vector<LogLike *> & m_logLikes;
+   const std::vector<optimizers::Optimizer *> & m_opts;
+   const std::vector<PointSource *> & m_testSrcs;
+   const std::vector<double> & m_nullParams;
+   const std::vector<long> & m_pixels;
+   double m_logLike0;
+   int m_verbosity;
+   double m_tol;
+   optimizers::TOLTYPE m_tolType;
+   size_t m_step;
+   ThreadPool::Mutex m_mutex;
+};
+
+namespace {
+/**
+ * @class EventModelSumsGuard
+ * @brief Turns off the updating of the event model sums of a LogLike
+ * for its lifetime and restores it afterwards.
+ */
+class EventModelSumsGuard {
+public:
+   EventModelSumsGuard(LogLike & logLike, bool active)
+      : m_logLike(logLike), m_active(active) {
+      if (m_active) {
+         m_logLike.setUpdateEventModelSums(false);
+      }
+   }
+   ~EventModelSumsGuard() {
+      if (m_active) {
+         m_logLike.setUpdateEventModelSums(true);
       }
    }
+private:
+   LogLike & m_logLike;
+   bool m_active;
+};
+}
+
+LogLike * TsMap::makeLikelihood(const Observation & observation) {
+   LogLike * logLike(0);
+   if (m_statistic == "UNBINNED") {
+// The events are shared with m_logLike, so leave their model sums alone.
+      logLike = new LogLike(observation);
+      logLike->setUpdateEventModelSums(false);
+   } else {
+      const BinnedLikelihood & master
+         = dynamic_cast<const BinnedLikelihood &>(*m_logLike);
+      BinnedLikelihood * binnedLike 
+         = new BinnedLikelihood(const_cast<CountsMapBase &>(master.countsMap()),
+                                observation, master.config(),
+                                master.srcMapsFile(), master.weightMap_orig());
+      binnedLike->setVerbose(false);
+// Only the free sources get source maps of their own.
+      binnedLike->shareFixedModel(master);
+      logLike = binnedLike;
+   }
+   readXml(*logLike);
+   return logLike;
+}
+
+void TsMap::computeMapParallel(size_t nthreads, double logLike0,
+                               int verbosity, double tol,
+                               optimizers::TOLTYPE tolType) {
+   m_formatter->info() << "Fitting positions with " << nthreads
+                       << " threads." << std::endl;
+   ThreadPool pool(nthreads);
+   ObservationCopies observations(m_helper->observation(), pool.nthreads());
+
+   std::vector<double> nullParams;
+   m_logLike->getParamValues(nullParams);
+   EventModelSumsGuard guard(*m_logLike, m_statistic == "UNBINNED");
+   if (m_statistic != "UNBINNED") {
+// Fill the lazily computed pixel directions of the shared counts map
+// before any thread needs them.
+      dynamic_cast<BinnedLikelihood *>(m_logLike)->countsMap().pixels();
+   }
+
+// Thread 0 uses m_logLike and m_opt.  The others get likelihoods
+// built from the same model and data, each with its own optimizer
+// and test source.  These are created serially so that the source
+// maps and exposures are read before the threads start.
+   std::string optimizer = m_pars["optimizer"];
+   std::vector<LogLike *> logLikes(1, m_logLike);
+   std::vector<optimizers::Optimizer *> opts(1, m_opt);
+   std::vector<PointSource *> testSrcs;
+
+// Number of positions per thread between checks for a checkpoint.
+   static const size_t checkpointBatch(16);
+   std::vector<long> pixels;
+   std::vector<long> batch;
+   PositionTask task(*this, logLikes, opts, testSrcs, nullParams, batch,
+                     logLike0, verbosity, tol, tolType);
+   std::string error;
+   try {
+      for (size_t t(0); t < pool.nthreads(); t++) {
+         if (t > 0) {
+            logLikes.push_back(makeLikelihood(observations[t]));
+            logLikes.back()->setParamValues(nullParams);
+            logLikes.back()->value();
+            opts.push_back(optimizers::OptimizerFactory::instance()
+                           .create(optimizer, *logLikes.back()));
+         }
+         PointSource * testSrc(0);
+         if (m_statistic == "UNBINNED") {
+            testSrc = new PointSource(m_dirs.at(0).ra(), m_dirs.at(0).dec(),
+                                      observations[t]);
+         } else {
+            testSrc = new PointSource();
+         }
+         testSrcs.push_back(testSrc);
+         setPointSourceSpectrum(*testSrc);
+         testSrc->setName("testSource");
+      }
+      while (m_grid->nextPixels(pixels)) {
+         std::vector<long> todo;
+         for (size_t k(0); k < pixels.size(); k++) {
+            if (!m_checkpoint || !m_checkpoint->done(pixels[k])) {
+               todo.push_back(pixels[k]);
+            }
+         }
+         size_t batchSize(m_checkpoint ? checkpointBatch*pool.nthreads()
+                          : todo.size());
+         for (size_t start(0); start < todo.size(); start += batchSize) {
+            size_t stop(std::min(start + batchSize, todo.size()));
+            batch.assign(todo.begin() + start, todo.begin() + stop);
+            pool.run(task, batch.size());
+            for (size_t k(0); k < batch.size(); k++) {
+               finishPosition(batch[k]);
+            }
+         }
+         for (size_t k(0); k < pixels.size(); k++) {
+            m_grid->setValue(pixels[k], m_tsMap.at(pixels[k]));
+         }
+      }
+   } catch (std::exception & eObj) {
+      error = eObj.what();
+   }
    m_formatter->warn() << "!" << std::endl;
-   delete testSrc;
+
+   for (size_t t(0); t < testSrcs.size(); t++) {
+      delete testSrcs[t];
+   }
+   for (size_t t(1); t < opts.size(); t++) {
+      delete opts[t];
+   }
+   for (size_t t(1); t < logLikes.size(); t++) {
+      delete logLikes[t];
+   }
+   if (error != "") {
+      throw std::runtime_error(error);
+   }
 }
 
 void TsMap::setPointSourceSpectrum(PointSource &src) {
@@ -377,4 +735,16 @@ void TsMap::writeFitsFile() {
    double tstop(m_helper->observation().roiCuts().maxTime());
    st_facilities::Util::writeDateKeywords(image, tstart, tstop, false);
    delete image;
+
+// Flag the positions that were interpolated rather than fit.
+   if (m_grid->nEvaluated() < static_cast<long>(m_tsMap.size())) {
+      std::vector<float> interpolated(m_tsMap.size(), 0);
+      for (size_t i(0); i < interpolated.size(); i++) {
+         interpolated[i] = m_grid->evaluated(i) ? 0 : 1;
+      }
+      fileSvc.appendImage(outfile, "INTERPOLATED", naxes);
+      tip::Image * flags(fileSvc.editImage(outfile, "INTERPOLATED"));
+      flags->set(interpolated);
+      delete flags;
+   }
 }
@@ -7,13 +7,20 @@
  */
 
 #include <cmath>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
 #include <algorithm>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <memory>
+#include <sstream>
+
+#include "fitsio.h"
+
+#include "CLHEP/Random/RandFlat.h"
 
 #include "facilities/Util.h"
 
@@ -35,12 +42,17 @@
 #include "dataSubselector/Cuts.h"
 
 #include "Likelihood/AppHelpers.h"
+#include "Likelihood/DiffRespGrid.h"
 #include "Likelihood/DiffRespNames.h"
 #include "Likelihood/DiffuseSource.h"
 #include "Likelihood/Event.h"
+#include "Likelihood/EventColumns.h"
 #include "Likelihood/EventContainer.h"
+#include "Likelihood/ObservationCopies.h"
 #include "Likelihood/ScData.h"
 #include "Likelihood/SourceModel.h"
+#include "Likelihood/SpatialFunction.h"
+#include "Likelihood/ThreadPool.h"
 #include "Likelihood/XmlParser.h"
 
 using XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument;
@@ -63,6 +75,243 @@ namespace {
       Event::toLower(name);
       return name;
    }
+
+   void fitsReportError(int status, const std::string & routine) {
+      if (status == 0) {
+         return;
+      }
+      fits_report_error(stderr, status);
+      throw std::runtime_error(routine + ": cfitsio error.");
+   }
+
+/**
+ * @class DiffRspTask
+ * @brief Computes the diffuse responses of one event of the current
+ * chunk.  Each thread uses its own copies of the response functions
+ * and of the diffuse sources, and the results are written to a
+ * per-chunk [event][component] buffer, so the Events and their
+ * column storage are only modified afterwards on the calling thread.
+ */
+   class DiffRspTask : public ThreadPool::Task {
+   public:
+      DiffRspTask(const std::vector<Event> & events,
+                  const std::vector<size_t> & indices,
+                  const std::vector<bool> & useDummyValue,
+                  const std::vector< std::vector<DiffuseSource *> > & srcs,
+                  const ObservationCopies & observations,
+                  std::vector<double> & values)
+         : m_events(events), m_indices(indices),
+           m_useDummyValue(useDummyValue), m_srcs(srcs),
+           m_observations(observations), m_values(values),
+           m_scratch(observations.size()) {}
+
+      virtual void run(size_t item, size_t thread_id) {
+         size_t ievent(m_indices.at(item));
+         size_t ncomps(m_srcs.at(thread_id).size());
+         std::vector<double>::iterator dest(m_values.begin() + item*ncomps);
+         if (m_useDummyValue.at(ievent)) {
+            std::fill(dest, dest + ncomps, 0);
+            return;
+         }
+         std::vector<double> & respValues(m_scratch.at(thread_id));
+         m_events.at(ievent).diffuseResponsesGQ(m_srcs.at(thread_id),
+                                                m_observations[thread_id]
+                                                .respFuncs(),
+                                                respValues);
+         std::copy(respValues.begin(), respValues.end(), dest);
+      }
+
+   private:
+      const std::vector<Event> & m_events;
+      const std::vector<size_t> & m_indices;
+      const std::vector<bool> & m_useDummyValue;
+      const std::vector< std::vector<DiffuseSource *> > & m_srcs;
+      const ObservationCopies & m_observations;
+      std::vector<double> & m_values;
+      std::vector< std::vector<double> > m_scratch;
+   };
+
+/**
+ * @class GridNodeTask
+ * @brief Computes the diffuse responses at one node of a DiffRespGrid.
+ */
+   class GridNodeTask : public ThreadPool::Task {
+   public:
+      GridNodeTask(const DiffRespGrid & grid, double time,
+                   const std::string & respName,
+                   const std::vector< std::vector<DiffuseSource *> > & srcs,
+                   const ObservationCopies & observations,
+                   std::vector<double> & nodeValues)
+         : m_grid(grid), m_time(time), m_respName(respName), m_srcs(srcs),
+           m_observations(observations), m_nodeValues(nodeValues),
+           m_scratch(observations.size()) {}
+
+      virtual void run(size_t item, size_t thread_id) {
+         Event node(m_grid.nodeEvent(item, m_time, m_respName));
+         std::vector<double> & respValues(m_scratch.at(thread_id));
+         node.diffuseResponsesGQ(m_srcs.at(thread_id),
+                                 m_observations[thread_id].respFuncs(),
+                                 respValues);
+         std::copy(respValues.begin(), respValues.end(),
+                   m_nodeValues.begin() + item*respValues.size());
+      }
+
+   private:
+      const DiffRespGrid & m_grid;
+      double m_time;
+      std::string m_respName;
+      const std::vector< std::vector<DiffuseSource *> > & m_srcs;
+      const ObservationCopies & m_observations;
+      std::vector<double> & m_nodeValues;
+      std::vector< std::vector<double> > m_scratch;
+   };
+
+/**
+ * @class SourceCopies
+ * @brief Per-thread DiffuseSources.  Thread 0 uses the originals and
+ * the other threads own clones.
+ */
+   class SourceCopies {
+   public:
+      SourceCopies(const std::vector<DiffuseSource *> & srcs,
+                   size_t nthreads) : m_srcs(nthreads) {
+         m_srcs[0] = srcs;
+         for (size_t thread(1); thread < nthreads; thread++) {
+            for (size_t k(0); k < srcs.size(); k++) {
+               m_srcs[thread].push_back(
+                  dynamic_cast<DiffuseSource *>(srcs[k]->clone()));
+            }
+         }
+      }
+      ~SourceCopies() {
+         for (size_t thread(1); thread < m_srcs.size(); thread++) {
+            for (size_t k(0); k < m_srcs[thread].size(); k++) {
+               delete m_srcs[thread][k];
+            }
+         }
+      }
+      const std::vector< std::vector<DiffuseSource *> > & srcs() const {
+         return m_srcs;
+      }
+   private:
+      std::vector< std::vector<DiffuseSource *> > m_srcs;
+      SourceCopies(const SourceCopies &);
+      SourceCopies & operator=(const SourceCopies &);
+   };
+
+/**
+ * @class DiffRspCheckpoint
+ * @brief Sidecar file recording the diffuse responses of completed
+ * chunks of events, so that an interrupted run can resume where it
+ * left off.  The file begins with a header that identifies the
+ * events and components being computed, and each chunk is written as
+ *
+ *    CHUNK <number of events>
+ *    <event index> <response 1> ... <response n>
+ *    END
+ *
+ * and flushed.  A chunk without its END line is ignored on reading.
+ */
+   class DiffRspCheckpoint {
+   public:
+      DiffRspCheckpoint(const std::string & filename,
+                        const std::string & header)
+         : m_filename(filename), m_header(header) {}
+
+      /// Read the completed chunks of a previous run, if any, and
+      /// restart the file with their contents.
+      /// @return The number of events restored.
+      size_t restore(size_t ncomps, std::vector<size_t> & indices,
+                     std::vector<double> & values) {
+         indices.clear();
+         values.clear();
+         std::ifstream input(m_filename.c_str());
+         if (input.good() && readHeader(input)) {
+            readChunks(input, ncomps, indices, values);
+         }
+         input.close();
+         m_output.open(m_filename.c_str(), std::ios::out | std::ios::trunc);
+         if (!m_output.good()) {
+            throw std::runtime_error("Cannot write checkpoint file "
+                                     + m_filename);
+         }
+         m_output << m_header << std::flush;
+         if (!indices.empty()) {
+            write(indices, values, ncomps);
+         }
+         return indices.size();
+      }
+
+      void write(const std::vector<size_t> & indices,
+                 const std::vector<double> & values, size_t ncomps) {
+         m_output << "CHUNK " << indices.size() << "\n"
+                  << std::setprecision(17);
+         for (size_t i(0); i < indices.size(); i++) {
+            m_output << indices[i];
+            for (size_t k(0); k < ncomps; k++) {
+               m_output << " " << values[i*ncomps + k];
+            }
+            m_output << "\n";
+         }
+         m_output << "END" << std::endl;
+      }
+
+      void remove() {
+         m_output.close();
+         std::remove(m_filename.c_str());
+      }
+
+   private:
+      std::string m_filename;
+      std::string m_header;
+      std::ofstream m_output;
+
+      bool readHeader(std::istream & input) const {
+         std::istringstream header(m_header);
+         std::string expected, line;
+         while (std::getline(header, expected)) {
+            if (!std::getline(input, line) || line != expected) {
+               return false;
+            }
+         }
+         return true;
+      }
+
+      void readChunks(std::istream & input, size_t ncomps,
+                      std::vector<size_t> & indices,
+                      std::vector<double> & values) const {
+         std::string line;
+         while (std::getline(input, line)) {
+            std::istringstream chunkLine(line);
+            std::string tag;
+            size_t nevents(0);
+            if (!(chunkLine >> tag >> nevents) || tag != "CHUNK") {
+               return;
+            }
+            std::vector<size_t> my_indices(nevents);
+            std::vector<double> my_values(nevents*ncomps);
+            for (size_t i(0); i < nevents; i++) {
+               if (!std::getline(input, line)) {
+                  return;
+               }
+               std::istringstream eventLine(line);
+               eventLine >> my_indices[i];
+               for (size_t k(0); k < ncomps; k++) {
+                  eventLine >> my_values[i*ncomps + k];
+               }
+               if (eventLine.fail()) {
+                  return;
+               }
+            }
+            if (!std::getline(input, line) || line != "END") {
+               return;
+            }
+            indices.insert(indices.end(), my_indices.begin(),
+                           my_indices.end());
+            values.insert(values.end(), my_values.begin(), my_values.end());
+         }
+      }
+   };
 } // anonymous namespace
 
 /**
@@ -129,12 +378,18 @@ private:
    bool haveDiffuseColumns(const std::string & eventFile);
    void buildSourceModel();
    void readEventData(std::string eventFile);
-   void computeEventResponses();
+   void computeEventResponses(const std::string & eventFile);
+   void interpolateResponses(ThreadPool & pool,
+                             const ObservationCopies & observations,
+                             const std::vector<bool> & useDummyValue,
+                             std::vector<DiffuseSource *> & srcs);
    void writeEventResponses(std::string eventFile);
+   void writeResponseColumns(const std::string & eventFile);
    void getDiffuseSources();
    void setGaussianParams(const Event & event, const std::string & name,
                           tip::Table::Vector<double> & params);
    std::string diffuseSrcName(const std::string & srcName) const;
+   std::string checkpointFile(const std::string & eventFile) const;
 
    static std::string s_cvs_id;
 };
@@ -190,8 +445,12 @@ void diffuseResponses::run() {
       if (clobber || !haveDiffuseColumns(*evtfile)) {
          m_formatter->warn() << *evtfile;
          readEventData(*evtfile);
-         computeEventResponses();
+         computeEventResponses(*evtfile);
          writeEventResponses(*evtfile);
+         bool checkpoint = m_pars["checkpoint"];
+         if (checkpoint) {
+            std::remove(checkpointFile(*evtfile).c_str());
+         }
       } else {
          m_formatter->warn() << "Diffuse columns have already been "
                              << "computed for "
@@ -372,13 +631,19 @@ void diffuseResponses::readEventData(std::string eventFile) {
    m_eventCont->getEvents(eventFile, apply_roi_cut=false, event_type_mask);
 }
 
-void diffuseResponses::computeEventResponses() {
+std::string diffuseResponses::
+checkpointFile(const std::string & eventFile) const {
+   std::string filename(eventFile);
+   facilities::Util::expandEnvVar(&filename);
+   return filename + ".diffrsp_ckpt";
+}
+
+void diffuseResponses::computeEventResponses(const std::string & eventFile) {
    std::vector<Event> & events(m_eventCont->events());
 
    bool applyClassFilter(true);
    getDiffuseSources();
-   std::vector<Event>::iterator it = events.begin();
-   unsigned int classLevel_targ;
+   unsigned int classLevel_targ(0);
    if (m_passVer == "NONE") {
       classLevel_targ = m_pars["evclsmin"];
    } else {
@@ -396,34 +661,260 @@ void diffuseResponses::computeEventResponses() {
          applyClassFilter = false;
       }
    }
-   for (int i = 0; it != events.end(); ++it, i++) {
-      int factor(events.size()/20);
-      if (factor == 0) {
-         factor = 1;
-      }
-      if ((i % factor) == 0) {
-         m_formatter->warn() << ".";
-      }
-/// @todo Implement an accurate, faster default calculation; use Gaussian
-/// quadrature version for now.
-//       it->computeResponse(m_srcs, m_helper->observation().respFuncs(), 
-//                           m_srRadius);
-      bool useDummyValue(false);
+   if (events.empty()) {
+      m_formatter->warn() << "!" << std::endl;
+      return;
+   }
+   std::vector<bool> useDummyValue(events.size(), false);
+   for (size_t i(0); i < events.size(); i++) {
       if (m_passVer == "NONE") {
-         useDummyValue = (applyClassFilter && 
-                          (it->classLevel() < classLevel_targ));
+         useDummyValue[i] = (applyClassFilter && 
+                             (events[i].classLevel() < classLevel_targ));
       } else {
          // Apply bit-wise "and" to see if this event is part of the
          // target class.
-         useDummyValue = (applyClassFilter &&
-                          (it->classLevel() & classLevel_targ) == 0);
+         useDummyValue[i] = (applyClassFilter &&
+                             (events[i].classLevel() & classLevel_targ) == 0);
+      }
+   }
+
+// All of the events in a file have responses for the same set of
+// components, so the components to be computed can be found from the
+// first one.
+   std::vector<DiffuseSource *> srcs;
+   events.front().getNewDiffuseSrcs(m_srcs, srcs);
+   if (srcs.empty()) {
+      m_formatter->warn() << "!" << std::endl;
+      return;
+   }
+   int nthreads = m_pars["nthreads"];
+   int chunkSize = m_pars["chunksize"];
+   bool checkpoint = m_pars["checkpoint"];
+   bool approx = m_pars["approx"];
+   if (chunkSize < 1) {
+      throw std::runtime_error("chunksize must be positive.");
+   }
+
+   ThreadPool pool(ThreadPool::resolveThreads(nthreads));
+   if (pool.nthreads() > 1) {
+      m_formatter->info(3) << "Using " << pool.nthreads() << " threads"
+                           << std::endl;
+// The wcslib projections of map-based sources are set up on first
+// use, so compute one event on this thread before the others start.
+      std::vector<double> respValues;
+      events.front().diffuseResponsesGQ(srcs, 
+                                        m_helper->observation().respFuncs(),
+                                        respValues);
+   }
+   ObservationCopies observations(m_helper->observation(), pool.nthreads());
+
+   if (approx) {
+      interpolateResponses(pool, observations, useDummyValue, srcs);
+      if (srcs.empty()) {
+         m_formatter->warn() << "!" << std::endl;
+         return;
+      }
+   }
+
+   size_t ncomps(srcs.size());
+   std::vector<std::string> components;
+   for (size_t k(0); k < ncomps; k++) {
+      components.push_back(events.front().diffuseSrcName(srcs[k]->getName()));
+   }
+
+   std::vector<bool> done(events.size(), false);
+   size_t ndone(0);
+   std::auto_ptr<DiffRspCheckpoint> ckpt(0);
+   if (checkpoint) {
+      std::ostringstream header;
+      header << "gtdiffrsp checkpoint\n"
+             << events.size() << "\n"
+             << m_helper->observation().respFuncs().respName() << "\n"
+             << applyClassFilter << " " << classLevel_targ << "\n";
+      for (size_t k(0); k < ncomps; k++) {
+         header << components[k] << "\n";
+      }
+      ckpt.reset(new DiffRspCheckpoint(checkpointFile(eventFile),
+                                       header.str()));
+      std::vector<size_t> indices;
+      std::vector<double> values;
+      ckpt->restore(ncomps, indices, values);
+      for (size_t i(0); i < indices.size(); i++) {
+         size_t ievent(indices[i]);
+         if (ievent >= events.size() || done[ievent]) {
+            continue;
+         }
+         for (size_t k(0); k < ncomps; k++) {
+            events[ievent].setDiffuseResponse(components[k],
+                                              values[i*ncomps + k]);
+         }
+         done[ievent] = true;
+         ndone++;
+      }
+      if (ndone > 0) {
+         m_formatter->info() << "\nResuming from checkpoint with "
+                             << ndone << " of " << events.size()
+                             << " events done" << std::endl;
+      }
+   }
+
+   SourceCopies threadSrcs(srcs, pool.nthreads());
+
+   int dots(0);
+   std::vector<size_t> indices;
+   std::vector<double> values;
+   for (size_t first(0); first < events.size(); first += chunkSize) {
+      size_t last(std::min(events.size(), first + chunkSize));
+      indices.clear();
+      for (size_t i(first); i < last; i++) {
+         if (!done[i]) {
+            indices.push_back(i);
+         }
+      }
+      if (!indices.empty()) {
+         values.resize(indices.size()*ncomps);
+         DiffRspTask task(events, indices, useDummyValue, threadSrcs.srcs(),
+                          observations, values);
+         pool.run(task, indices.size(), 16);
+         for (size_t i(0); i < indices.size(); i++) {
+            for (size_t k(0); k < ncomps; k++) {
+               events[indices[i]].setDiffuseResponse(components[k],
+                                                     values[i*ncomps + k]);
+            }
+            done[indices[i]] = true;
+         }
+         if (ckpt.get()) {
+            ckpt->write(indices, values, ncomps);
+         }
+      }
+      int ndots(static_cast<int>(20*last/events.size()));
+      for ( ; dots < ndots; dots++) {
+         m_formatter->warn() << ".";
       }
-      it->computeResponseGQ(m_srcs, m_helper->observation().respFuncs(),
-                            useDummyValue);
    }
    m_formatter->warn() << "!" << std::endl;
 }
 
+void diffuseResponses::
+interpolateResponses(ThreadPool & pool,
+                     const ObservationCopies & observations,
+                     const std::vector<bool> & useDummyValue,
+                     std::vector<DiffuseSource *> & srcs) {
+// Interpolate the responses of the components that would be computed
+// with DiffRespIntegrand2 from a grid of exact values, and check them
+// against exact values for a random subset of events.  On return,
+// srcs contains the components that still need to be computed
+// exactly.
+   std::vector<Event> & events(m_eventCont->events());
+   std::vector<DiffuseSource *> gridSrcs;
+   std::vector<DiffuseSource *> exactSrcs;
+   for (size_t k(0); k < srcs.size(); k++) {
+      if (dynamic_cast<const SpatialFunction *>(srcs[k]->spatialDist()) ||
+          srcs[k]->mapBasedIntegral()) {
+         exactSrcs.push_back(srcs[k]);
+      } else {
+         gridSrcs.push_back(srcs[k]);
+      }
+   }
+   std::vector<size_t> selected;
+   for (size_t i(0); i < events.size(); i++) {
+      if (!useDummyValue[i]) {
+         selected.push_back(i);
+      }
+   }
+   if (gridSrcs.empty() || selected.empty()) {
+      return;
+   }
+   size_t ncomps(gridSrcs.size());
+
+   int nside = m_pars["nside"];
+   int ebinsPerDecade = m_pars["ebinsdec"];
+   int ncostheta = m_pars["ncostheta"];
+   double accuracy = m_pars["accuracy"];
+   int nverify = m_pars["nverify"];
+
+   double costhetaMin(1);
+   double costhetaMax(-1);
+   for (size_t i(0); i < selected.size(); i++) {
+      double costheta(DiffRespGrid::costheta(events[selected[i]]));
+      costhetaMin = std::min(costhetaMin, costheta);
+      costhetaMax = std::max(costhetaMax, costheta);
+   }
+   DiffRespGrid grid(nside, ebinsPerDecade, ncostheta, 
+                     costhetaMin, costhetaMax);
+   for (size_t i(0); i < selected.size(); i++) {
+      grid.addEvent(events[selected[i]]);
+   }
+   m_formatter->info() << "\nComputing responses at " << grid.nnodes() 
+                       << " grid nodes" << std::endl;
+
+   SourceCopies threadSrcs(gridSrcs, pool.nthreads());
+   std::vector<double> nodeValues(grid.nnodes()*ncomps);
+   GridNodeTask nodeTask(grid, events[selected.front()].getArrTime(),
+                         m_helper->observation().respFuncs().respName(),
+                         threadSrcs.srcs(), observations, nodeValues);
+   pool.run(nodeTask, grid.nnodes(), 16);
+
+// Exact responses for a random subset of the events.
+   size_t nsubset(std::min(selected.size(), 
+                           static_cast<size_t>(std::max(nverify, 0))));
+   for (size_t i(0); i < nsubset; i++) {
+      size_t j(i + CLHEP::RandFlat::shootInt(long(selected.size() - i)));
+      std::swap(selected[i], selected[j]);
+   }
+   selected.resize(nsubset);
+   std::sort(selected.begin(), selected.end());
+   std::vector<double> exactValues(nsubset*ncomps);
+   DiffRspTask task(events, selected, useDummyValue, threadSrcs.srcs(),
+                    observations, exactValues);
+   pool.run(task, nsubset, 16);
+
+   std::vector<double> approxValues(events.size()*ncomps, 0);
+   std::vector<double> values;
+   for (size_t i(0); i < events.size(); i++) {
+      if (!useDummyValue[i]) {
+         grid.interpolate(events[i], nodeValues, ncomps, values);
+         std::copy(values.begin(), values.end(), 
+                   approxValues.begin() + i*ncomps);
+      }
+   }
+   for (size_t k(0); k < ncomps; k++) {
+      double sum(0);
+      double maxError(0);
+      size_t npts(0);
+      for (size_t i(0); i < nsubset; i++) {
+         double exact(exactValues[i*ncomps + k]);
+         if (exact > 0) {
+            double error((approxValues[selected[i]*ncomps + k] - exact)/exact);
+            sum += error*error;
+            maxError = std::max(maxError, std::fabs(error));
+            npts++;
+         }
+      }
+      double rmsError(npts > 0 ? std::sqrt(sum/npts) : 0);
+      const std::string & component
+         = events.front().diffuseSrcName(gridSrcs[k]->getName());
+      m_formatter->info() << component << ": rms fractional error "
+                          << rmsError << " (maximum " << maxError
+                          << ") for " << npts << " events" << std::endl;
+      if (rmsError > accuracy) {
+         m_formatter->warn() << "\nGrid responses for " << component
+                             << " do not meet the accuracy target of "
+                             << accuracy << "; computing them exactly."
+                             << std::endl;
+         exactSrcs.push_back(gridSrcs[k]);
+         continue;
+      }
+      for (size_t i(0); i < nsubset; i++) {
+         approxValues[selected[i]*ncomps + k] = exactValues[i*ncomps + k];
+      }
+      for (size_t i(0); i < events.size(); i++) {
+         events[i].setDiffuseResponse(component, approxValues[i*ncomps + k]);
+      }
+   }
+   srcs = exactSrcs;
+}
+
 void diffuseResponses::writeEventResponses(std::string eventFile) {
    std::vector<Event> & my_events(m_eventCont->events());
    if (m_srcNames.size() == 0) {
@@ -468,18 +959,15 @@ void diffuseResponses::writeEventResponses(std::string eventFile) {
 //                              << "Using existing column." << std::endl;
       }
    }
-   tip::Table::Iterator it = events->begin();
-   tip::Table::Record & row = *it;
-   for (int j = 0 ; it != events->end(); j++, ++it) {
-      std::vector<std::string>::iterator name = m_srcNames.begin();
-      for ( ; name != m_srcNames.end(); ++name) {
-         std::string fieldName = m_columnNames.key(diffuseSrcName(*name));
-         if (m_useEdisp) {
+   if (m_useEdisp) {
+      tip::Table::Iterator it = events->begin();
+      tip::Table::Record & row = *it;
+      for (int j = 0 ; it != events->end(); j++, ++it) {
+         std::vector<std::string>::iterator name = m_srcNames.begin();
+         for ( ; name != m_srcNames.end(); ++name) {
+            std::string fieldName = m_columnNames.key(diffuseSrcName(*name));
             tip::Table::Vector<double> respParams = row[fieldName];
             setGaussianParams(my_events[j], *name, respParams);
-         } else {
-// Assume infinite energy resolution.
-            row[fieldName].set(my_events[j].diffuseResponse(1., *name));
          }
       }
    }
@@ -511,6 +999,63 @@ void diffuseResponses::writeEventResponses(std::string eventFile) {
       // evtype option not given so do nothing.
    }
    delete events;
+   if (!m_useEdisp) {
+// Assume infinite energy resolution.
+      writeResponseColumns(eventFile);
+   }
+}
+
+void diffuseResponses::writeResponseColumns(const std::string & eventFile) {
+// Write the single-valued responses straight from the column storage
+// in blocks of rows, rather than a cell at a time through tip.
+   const std::vector<Event> & my_events(m_eventCont->events());
+   if (my_events.empty()) {
+      return;
+   }
+   const EventColumns & columns(m_eventCont->columns());
+   std::vector<int> colnums;
+   std::vector<const std::vector<double> *> responses;
+
+   std::string evtable = m_pars["evtable"];
+   int status(0);
+   fitsfile * fptr(0);
+   std::string extfilename(eventFile + "[" + evtable + "]");
+   fits_open_file(&fptr, extfilename.c_str(), READWRITE, &status);
+   fitsReportError(status, "diffuseResponses::writeResponseColumns");
+
+   for (size_t i(0); i < m_srcNames.size(); i++) {
+      const std::string & component 
+         = my_events.front().diffuseSrcName(m_srcNames[i]);
+      int icomp(columns.componentIndex(component));
+      if (icomp < 0 || !columns.haveAllDiffuseResponses(icomp)) {
+         fits_close_file(fptr, &status);
+         throw std::runtime_error("diffuseResponses::writeResponseColumns:\n"
+                                  "Missing diffuse responses for "
+                                  + component);
+      }
+      std::string fieldName(m_columnNames.key(diffuseSrcName(m_srcNames[i])));
+      int colnum(0);
+      fits_get_colnum(fptr, CASEINSEN, const_cast<char *>(fieldName.c_str()),
+                      &colnum, &status);
+      fitsReportError(status, "diffuseResponses::writeResponseColumns");
+      colnums.push_back(colnum);
+      responses.push_back(&columns.diffuseResponses(icomp));
+   }
+
+   int chunkSize = m_pars["chunksize"];
+   LONGLONG nrows(my_events.size());
+   for (LONGLONG first(0); first < nrows; first += chunkSize) {
+      LONGLONG nelements(std::min(nrows - first, LONGLONG(chunkSize)));
+      for (size_t i(0); i < colnums.size(); i++) {
+         double * values(const_cast<double *>(&responses[i]->at(first)));
+         fits_write_col(fptr, TDOUBLE, colnums[i], first + 1, 1, nelements,
+                        values, &status);
+         fitsReportError(status, "diffuseResponses::writeResponseColumns");
+      }
+   }
+
+   fits_close_file(fptr, &status);
+   fitsReportError(status, "diffuseResponses::writeResponseColumns");
 }
 
 void diffuseResponses::setGaussianParams(const Event & event,
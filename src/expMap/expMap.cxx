@@ -182,11 +182,12 @@ void ExpMap::createExposureMap() {
       nlatmin = m_pars["nlatmin"];
       nlatmax = m_pars["nlatmax"];
    }
+   int nthreads = m_pars["nthreads"];
    m_helper->observation().expMap().computeMap(exposureFile, observation,
                                                m_srRadius, nlong, nlat,
                                                nenergies, compute_submap,
                                                nlongmin, nlongmax,
-                                               nlatmin, nlatmax); 
+                                               nlatmin, nlatmax, nthreads); 
    tip::Image * image = 
       tip::IFileSvc::instance().editImage(exposureFile, "");
    // Ensure that irfs version name is written to DSS keywords.
@@ -1,6 +1,7 @@
 /**
  * @file gtfindsrc.cxx
- * @brief Use Nelder-Mead algorithm to fit for a point source location.
+ * @brief Use Nelder-Mead algorithm, or a fast fit with a cached psf
+ * template, to fit for a point source location.
  * @author J. Chiang
  *
  * $Header: /nfs/slac/g/glast/ground/cvs/ScienceTools-scons/Likelihood/src/gtfindsrc/gtfindsrc.cxx,v 1.23 2012/09/30 23:03:09 jchiang Exp $
@@ -32,6 +33,9 @@
 
 #include "Likelihood/AppHelpers.h"
 #include "Likelihood/LogLike.h"
+#include "Likelihood/MeanPsf.h"
+#include "Likelihood/PsfLocalizer.h"
+#include "Likelihood/ThreadPool.h"
 #include "Likelihood/Util.h"
 
 using namespace Likelihood;
@@ -75,6 +79,7 @@ private:
    void identifyTarget();
    void selectOptimizer();
    double fitPosition(double step=0.3);
+   double localizeWithPsf(double step=0.3);
    double errEst(const std::vector< std::vector<double> > & testPoints) const;
    void setTestSource();
 };
@@ -134,12 +139,19 @@ void findSrc::run() {
    m_helper->readExposureMap();
 
    m_logLike = new LogLike(m_helper->observation());
+   int nthreads = m_pars["nthreads"];
+   m_logLike->setNumThreads(nthreads);
    readEventData();
    readSrcModel();
    identifyTarget();
    selectOptimizer();
    m_pars.Save();
-   fitPosition();
+   std::string method = m_pars["method"];
+   if (method == "PSF") {
+      localizeWithPsf();
+   } else {
+      fitPosition();
+   }
    std::string target = m_pars["target"];
    bool clobber = m_pars["clobber"];
    if (clobber && m_logLike->getSource(target)) {
@@ -172,8 +184,8 @@ void findSrc::readEventData() {
    std::vector<std::string>::const_iterator evIt = eventFiles.begin();
    for ( ; evIt != eventFiles.end(); evIt++) {
       Util::file_ok(*evIt);
-      m_logLike->getEvents(*evIt);
    }
+   m_logLike->getEvents(eventFiles);
 }
 
 void findSrc::readSrcModel() {
@@ -406,6 +418,150 @@ double findSrc::fitPosition(double step) {
    return statValue;
 }
 
+double findSrc::localizeWithPsf(double step) {
+   st_stream::StreamFormatter formatter("findSrc", "localizeWithPsf", 2);
+   std::string coordSys = m_pars["coordsys"];
+   bool use_lb(coordSys == "GAL");
+   double tol = m_pars["ftol"];
+   std::string tol_type = m_pars["toltype"];
+   optimizers::TOLTYPE tolType(optimizers::ABSOLUTE);
+   if (tol_type == "REL") {
+      tolType = optimizers::RELATIVE;
+   }
+   bool reopt = m_pars["reopt"];
+   double accuracy = m_pars["posacc"];
+
+// Fit the model once with the source at its starting position.  The
+// flux densities of the source and of the rest of the model at each
+// event are then held fixed while the position is varied.
+   m_logLike->addSource(m_testSrc);
+   if (reopt) {
+      m_opt->find_min_only(0, tol, tolType);
+   }
+   double logLikeStart(m_logLike->value());
+   astro::SkyDir initDir(m_testSrc->getDir());
+
+   const std::vector<Event> & events
+      = m_helper->observation().eventCont().events();
+   if (events.empty()) {
+      throw std::runtime_error("No events to localize the source with.");
+   }
+   double emin(events.front().getEnergy());
+   double emax(emin);
+   for (size_t j(0); j < events.size(); j++) {
+      emin = std::min(emin, events[j].getEnergy());
+      emax = std::max(emax, events[j].getEnergy());
+   }
+// Eight energies per decade, and at least two, for the mean psf.
+   size_t nee(std::max(2, static_cast<int>(8*std::log10(emax/emin)) + 1));
+   std::vector<double> energies;
+   for (size_t k(0); k < nee; k++) {
+      energies.push_back(emin*std::pow(emax/emin, 
+                                       static_cast<double>(k)/(nee - 1)));
+   }
+// Don't let rounding drop the highest energy event off the grid.
+   energies.back() = emax;
+   if (emax == emin) {
+      energies.back() *= 1.01;
+   }
+   MeanPsf meanPsf(initDir, energies, m_helper->observation());
+
+// The model holds its own copy of the test source, which has the
+// fitted parameters.
+   std::vector<double> srcWeights;
+   std::vector<double> srcDensity;
+   std::vector<double> bgDensity;
+   PsfLocalizer::modelDensities(events, meanPsf, *m_logLike, 
+                                m_testSrc->getName(), srcWeights,
+                                srcDensity, bgDensity);
+   PsfLocalizer localizer(events, meanPsf, initDir.dir(), srcWeights,
+                          srcDensity, bgDensity,
+                          m_logLike->NpredValue(m_testSrc->getName()));
+
+   int nthreads = m_pars["nthreads"];
+   ThreadPool pool(ThreadPool::resolveThreads(nthreads));
+   CLHEP::Hep3Vector bestDir(initDir.dir());
+   int status(localizer.localize(bestDir, step, accuracy, pool));
+   if (status != 0) {
+      formatter.warn() << "Position fit did not converge." << std::endl;
+   }
+   astro::SkyDir finalDir(bestDir);
+
+// Convert the test points to the coordinates and the statistic
+// values used by the simplex method.
+   const std::vector<CLHEP::Hep3Vector> & dirs(localizer.testDirs());
+   std::vector< std::vector<double> > testPoints;
+   for (size_t i(0); i < dirs.size(); i++) {
+      astro::SkyDir dir(dirs[i]);
+      std::vector<double> point(3);
+      point[0] = use_lb ? dir.l() : dir.ra();
+      point[1] = use_lb ? dir.b() : dir.dec();
+      point[2] = -(logLikeStart + localizer.testValues()[i]) 
+         - m_logLike0 + 1.;
+      testPoints.push_back(point);
+   }
+   double norm;
+   double statValue(-(logLikeStart + localizer.logLike(bestDir, norm))
+                    - m_logLike0 + 1.);
+   std::vector<double> coords(2);
+   coords[0] = use_lb ? finalDir.l() : finalDir.ra();
+   coords[1] = use_lb ? finalDir.b() : finalDir.dec();
+   double pos_error(localizer.errorRadius());
+   if (pos_error < 0) {
+      formatter.info() << "A reliable positional error estimate cannot "
+                       << "be made.\nPlease inspect the output file"
+                       << std::endl;
+      pos_error = 0;
+   }
+
+   std::string outfile = m_pars["outfile"];
+   if (outfile != "" && outfile != "none") {
+      std::ofstream output(outfile.c_str());
+      output << std::setprecision(10);
+      for (size_t i = 0; i < testPoints.size(); i++) {
+         output << testPoints.at(i).at(0) << "  "
+                << testPoints.at(i).at(1) << "  "
+                << testPoints.at(i).at(2) << "  "
+                << pos_error << std::endl;
+      }
+      output << "initial starting values: "
+             << (use_lb ? initDir.l() : initDir.ra()) << "  "
+             << (use_lb ? initDir.b() : initDir.dec()) << "  "
+             << m_logLike0 << "\n";
+      output << "final values: "
+             << coords[0] << "  "
+             << coords[1] << "  "
+             << statValue + m_logLike0 - 1. << std::endl;
+      output << "angular separation: " 
+             << initDir.difference(finalDir)*180./M_PI 
+             << " degrees" << std::endl;
+      output.close();
+   }
+   formatter.info() << "Best fit position: "
+                    << coords[0] << ",  "
+                    << coords[1] << "\n"
+                    << "Error circle radius: " << pos_error
+                    << std::endl;
+
+// Move the source to the best-fit position, refitting the model there
+// so that it is consistent with the updated source model file.
+   m_logLike->deleteSource(m_testSrc->getName());
+   m_testSrc->setDir(finalDir.ra(), finalDir.dec(), true, false);
+   m_logLike->addSource(m_testSrc);
+   if (reopt) {
+      m_opt->find_min_only(0, tol, tolType);
+   }
+   if (m_testSrc->getName() == "testSource") {
+      m_logLike->deleteSource("testSource");
+   } else {
+      Source * src = m_logLike->getSource(m_testSrc->getName());
+      optimizers::Function * skyDirFunc = src->getSrcFuncs()["Position"];
+      skyDirFunc->setParam("RA", finalDir.ra());
+      skyDirFunc->setParam("DEC", finalDir.dec());
+   }
+   return statValue;
+}
+
 double findSrc::
 errEst(const std::vector< std::vector<double> > & testPoints) const {
    double Sx(0);
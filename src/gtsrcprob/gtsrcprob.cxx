@@ -9,6 +9,7 @@
  * $Header: /nfs/slac/g/glast/ground/cvs/ScienceTools-scons/Likelihood/src/gtsrcprob/gtsrcprob.cxx,v 1.5 2012/09/30 23:03:11 jchiang Exp $
  */
 
+#include <cctype>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
@@ -19,6 +20,9 @@
 #include <map>
 #include <memory>
 #include <sstream>
+#include <stdexcept>
+
+#include "fitsio.h"
 
 #include "facilities/Util.h"
 
@@ -28,24 +32,135 @@
 #include "st_app/StApp.h"
 #include "st_app/StAppFactory.h"
 
-#include "st_facilities/FitsUtil.h"
 #include "st_facilities/Util.h"
 
 #include "xmlBase/Dom.h"
 #include "xmlBase/XmlParser.h"
 
-#include "tip/IFileSvc.h"
-#include "tip/Table.h"
-
 #include "Likelihood/AppHelpers.h"
 #include "Likelihood/DiffRespNames.h"
 #include "Likelihood/DiffuseSource.h"
 #include "Likelihood/Event.h"
+#include "Likelihood/ObservationCopies.h"
 #include "Likelihood/ScData.h"
 #include "Likelihood/SourceModel.h"
+#include "Likelihood/ThreadPool.h"
 
 using namespace Likelihood;
 
+namespace {
+// Number of events per work item within a chunk.
+   const size_t s_eventBlockSize(256);
+
+   void fitsReportError(int status, const std::string & routine) {
+      if (status == 0) {
+         return;
+      }
+      fits_report_error(stderr, status);
+      throw std::runtime_error(routine + ": cfitsio error.");
+   }
+
+   std::string toUpper(std::string name) {
+      for (size_t i(0); i < name.size(); i++) {
+         name[i] = std::toupper(name[i]);
+      }
+      return name;
+   }
+
+/**
+ * @class ModelCopies
+ * @brief Per-thread lists of the model Sources, [thread][source].
+ * Thread 0 uses the original Sources; the other threads own clones
+ * that refer to Observations with their own response functions.
+ */
+   class ModelCopies {
+   public:
+      ModelCopies(const SourceModel & model,
+                  const std::vector<std::string> & srcNames,
+                  const ObservationCopies & observations)
+         : m_srcs(observations.size()) {
+         for (size_t i(0); i < srcNames.size(); i++) {
+            const Source & src(model.source(srcNames[i]));
+            m_srcs[0].push_back(&src);
+            for (size_t t(1); t < m_srcs.size(); t++) {
+               Source * my_src(src.clone());
+               my_src->setObservation(&observations[t]);
+               m_srcs[t].push_back(my_src);
+            }
+         }
+      }
+
+      ~ModelCopies() {
+         for (size_t t(1); t < m_srcs.size(); t++) {
+            for (size_t i(0); i < m_srcs[t].size(); i++) {
+               delete m_srcs[t][i];
+            }
+         }
+      }
+
+      const std::vector<const Source *> & operator[](size_t thread) const {
+         return m_srcs[thread];
+      }
+
+   private:
+      std::vector< std::vector<const Source *> > m_srcs;
+
+      ModelCopies(const ModelCopies &);
+      ModelCopies & operator=(const ModelCopies &);
+   };
+
+/**
+ * @class ProbTask
+ * @brief Computes the source probabilities for one block of events
+ * of the current chunk.  The results go to a [column][row] buffer
+ * that is written to the output file on the calling thread.
+ */
+   class ProbTask : public ThreadPool::Task {
+   public:
+      /// @param columnSrcs Model source index of each output column,
+      ///        or -1 if the source is not in the model
+      /// @param probs Output buffer, probs[icol*nrows + irow]
+      ProbTask(const std::vector<Event> & events, const ModelCopies & srcs,
+               const std::vector<int> & columnSrcs, size_t first,
+               size_t nrows, std::vector<float> & probs)
+         : m_events(events), m_srcs(srcs), m_columnSrcs(columnSrcs),
+           m_first(first), m_nrows(nrows), m_probs(probs) {
+         m_probs.resize(columnSrcs.size()*nrows);
+      }
+
+      size_t nblocks() const {
+         return (m_nrows + s_eventBlockSize - 1)/s_eventBlockSize;
+      }
+
+      virtual void run(size_t block, size_t thread_id) {
+         const std::vector<const Source *> & srcs(m_srcs[thread_id]);
+         std::vector<double> densities(srcs.size());
+         size_t rmax(std::min(m_nrows, (block + 1)*s_eventBlockSize));
+         for (size_t r(block*s_eventBlockSize); r < rmax; r++) {
+            const Event & event(m_events[m_first + r]);
+            double normalization(0);
+            for (size_t i(0); i < srcs.size(); i++) {
+               densities[i] = srcs[i]->fluxDensity(event);
+               normalization += densities[i];
+            }
+            for (size_t k(0); k < m_columnSrcs.size(); k++) {
+               int isrc(m_columnSrcs[k]);
+               m_probs[k*m_nrows + r] = 
+                  isrc < 0 ? 0 : densities[isrc]/normalization;
+            }
+         }
+      }
+
+   private:
+      const std::vector<Event> & m_events;
+      const ModelCopies & m_srcs;
+      const std::vector<int> & m_columnSrcs;
+      size_t m_first;
+      size_t m_nrows;
+      std::vector<float> & m_probs;
+   };
+}
+
 /**
  * @class SourceProbs
  * 
@@ -88,6 +203,7 @@ private:
    void buildSourceModel();
    void readEventData();
    void writeDensities() const;
+   void writeEventTable(fitsfile * infile, fitsfile * outfile) const;
    void getSourceList();
    std::string columnName(std::string srcName) const;
 
@@ -177,64 +293,213 @@ void SourceProbs::getSourceList() {
 }
 
 void SourceProbs::writeDensities() const {
+// Write the output file in a single pass over the input: HDUs other
+// than the event table are copied as they are, and the event table
+// is rebuilt with the probability columns, chunk by chunk.
+   std::string evfile = m_pars["evfile"];
    std::string outfile = m_pars["outfile"];
-
+   std::string evtable = m_pars["evtable"];
+   bool clobber = m_pars["clobber"];
+   facilities::Util::expandEnvVar(&evfile);
    facilities::Util::expandEnvVar(&outfile);
 
-// Open the output file, copying the FT1 file contents first.
-   std::string filter;
-   bool clobber;
-   st_facilities::FitsUtil::fcopy(m_pars["evfile"], outfile, m_pars["evtable"],
-                                  filter="", clobber=m_pars["clobber"]);
-   tip::Table * evtable
-      = tip::IFileSvc::instance().editTable(outfile, m_pars["evtable"]);
-
-   tip::Table::FieldCont columns(evtable->getValidFields());
-// Add the column names for the probabilities to the output file.
-   for (size_t i(0); i < m_srclist.size(); i++) {
-      // Check if desired column name exists, if not, then add it to
-      // the table.
-      std::string fieldName(columnName(m_srclist.at(i)));
-      if (std::count(columns.begin(), columns.end(), fieldName) == 0) {
-         evtable->appendField(m_srclist.at(i), "1E");
-         // Delete TNULL that is added incorrectly by tip for floats.
-         int fieldIndex = evtable->getFieldIndex(m_srclist.at(i)) + 1;
-         std::ostringstream nullkeyword;
-         nullkeyword << "TNULL" << fieldIndex;
-         try {
-            evtable->getHeader().erase(nullkeyword.str());
-         } catch (...) {
-            // do nothing if tip fails us again
+   const std::string routine("SourceProbs::writeDensities");
+   int status(0);
+   fitsfile * infile(0);
+   fits_open_file(&infile, evfile.c_str(), READONLY, &status);
+   fitsReportError(status, routine);
+
+   fitsfile * outptr(0);
+   std::string outname((clobber ? "!" : "") + outfile);
+   fits_create_file(&outptr, outname.c_str(), &status);
+   fitsReportError(status, routine);
+
+   int nhdus(0);
+   fits_get_num_hdus(infile, &nhdus, &status);
+   fitsReportError(status, routine);
+   bool foundTable(false);
+   for (int hdu(1); hdu <= nhdus; hdu++) {
+      int hdutype(0);
+      fits_movabs_hdu(infile, hdu, &hdutype, &status);
+      fitsReportError(status, routine);
+      char extname[FLEN_VALUE] = "";
+      if (hdu > 1) {
+         fits_read_key(infile, TSTRING, "EXTNAME", extname, 0, &status);
+         if (status == KEY_NO_EXIST) {
+            status = 0;
          }
+         fitsReportError(status, routine);
       }
+      if (!foundTable && hdutype == BINARY_TBL
+          && toUpper(extname) == toUpper(evtable)) {
+         writeEventTable(infile, outptr);
+         foundTable = true;
+      } else {
+         fits_copy_hdu(infile, outptr, 0, &status);
+         fitsReportError(status, routine);
+      }
+   }
+   fits_close_file(outptr, &status);
+   fits_close_file(infile, &status);
+   fitsReportError(status, routine);
+   if (!foundTable) {
+      throw std::runtime_error(routine + ": extension " + evtable 
+                               + " not found in " + evfile);
    }
+}
 
-// Grab the names of all of the model components for the normalization 
-// calculation.
-   std::vector<std::string> srcNames;
-   m_sourceModel->getSrcNames(srcNames);
+void SourceProbs::writeEventTable(fitsfile * infile, 
+                                  fitsfile * outfile) const {
+   const std::string routine("SourceProbs::writeEventTable");
+   int status(0);
+
+   long pcount(0);
+   fits_read_key(infile, TLONG, "PCOUNT", &pcount, 0, &status);
+   fitsReportError(status, routine);
+   if (pcount != 0) {
+      throw std::runtime_error(routine + ": event tables with "
+                               + "variable-length columns are not supported.");
+   }
+   long inWidth(0);
+   fits_read_key(infile, TLONG, "NAXIS1", &inWidth, 0, &status);
+   LONGLONG nrows(0);
+   fits_get_num_rowsll(infile, &nrows, &status);
+   int ncols(0);
+   fits_get_num_cols(infile, &ncols, &status);
+   fitsReportError(status, routine);
 
-// Loop over ft1 events and output file rows.
    const std::vector<Event> & 
       events(m_helper->observation().eventCont().events());
+   if (static_cast<size_t>(nrows) != events.size()) {
+      std::ostringstream message;
+      message << routine << ": the event table has " << nrows 
+              << " rows, but " << events.size() << " events were read.";
+      throw std::runtime_error(message.str());
+   }
 
-   tip::Table::Iterator it = evtable->begin();
-   tip::Table::Record & row = *it;
-   for (size_t j(0); it != evtable->end(); j++, ++it) {
-       std::map<std::string, double> densities;
-       double normalization(0);
-       // Loop over all sources in the model to determine the normalization.
-       for (std::vector<std::string>::iterator name(srcNames.begin());
-            name != srcNames.end(); ++name) {
-          const Source & src(m_sourceModel->source(*name));
-          densities[*name] = src.fluxDensity(events.at(j));
-          normalization += densities[*name];
-       }
-       // Loop over items in the desired source list.
-       for (std::vector<std::string>::const_iterator name(m_srclist.begin());
-            name != m_srclist.end(); ++name) {
-          row[*name].set(densities[*name]/normalization);
-       }
-   }
-   delete evtable;
+// Existing columns, followed by a "1E" column for each source in the
+// list that does not already have one.
+   std::vector<std::string> ttype;
+   std::vector<std::string> tform;
+   for (int i(1); i <= ncols; i++) {
+      std::ostringstream typeKey, formKey;
+      typeKey << "TTYPE" << i;
+      formKey << "TFORM" << i;
+      char value[FLEN_VALUE];
+      fits_read_key(infile, TSTRING, typeKey.str().c_str(), value, 0, &status);
+      ttype.push_back(value);
+      fits_read_key(infile, TSTRING, formKey.str().c_str(), value, 0, &status);
+      tform.push_back(value);
+   }
+   fitsReportError(status, routine);
+
+   std::vector<int> colnums;
+   for (size_t k(0); k < m_srclist.size(); k++) {
+      std::string fieldName(columnName(m_srclist[k]));
+      int colnum(0);
+      for (size_t i(0); i < ttype.size(); i++) {
+         if (columnName(ttype[i]) == fieldName) {
+            colnum = i + 1;
+            break;
+         }
+      }
+      if (colnum == 0) {
+         ttype.push_back(m_srclist[k]);
+         tform.push_back("1E");
+         colnum = ttype.size();
+      }
+      colnums.push_back(colnum);
+   }
+
+   char extname[FLEN_VALUE];
+   fits_read_key(infile, TSTRING, "EXTNAME", extname, 0, &status);
+   std::vector<char *> ttypes, tforms;
+   for (size_t i(0); i < ttype.size(); i++) {
+      ttypes.push_back(const_cast<char *>(ttype[i].c_str()));
+      tforms.push_back(const_cast<char *>(tform[i].c_str()));
+   }
+   fits_create_tbl(outfile, BINARY_TBL, 0, ttype.size(), &ttypes[0],
+                   &tforms[0], 0, extname, &status);
+   fitsReportError(status, routine);
+
+// Copy the remaining keywords.  The new columns follow the existing
+// ones, so the column-indexed keywords still apply.  The checksums
+// are recomputed at the end.
+   int nkeys(0);
+   fits_get_hdrspace(infile, &nkeys, 0, &status);
+   bool hasChecksum(false);
+   for (int i(1); i <= nkeys; i++) {
+      char card[FLEN_CARD];
+      fits_read_record(infile, i, card, &status);
+      fitsReportError(status, routine);
+      int keyclass(fits_get_keyclass(card));
+      if (keyclass == TYP_CKSUM_KEY) {
+         hasChecksum = true;
+         continue;
+      }
+      if (keyclass == TYP_STRUC_KEY || std::strncmp(card, "EXTNAME ", 8) == 0) {
+         continue;
+      }
+      fits_write_record(outfile, card, &status);
+   }
+   fits_set_hdustruc(outfile, &status);
+   long outWidth(0);
+   fits_read_key(outfile, TLONG, "NAXIS1", &outWidth, 0, &status);
+   fitsReportError(status, routine);
+
+// Model sources for the normalization, and the index of the source
+// for each output column.
+   std::vector<std::string> srcNames;
+   m_sourceModel->getSrcNames(srcNames);
+   std::vector<int> columnSrcs;
+   for (size_t k(0); k < m_srclist.size(); k++) {
+      std::vector<std::string>::const_iterator name
+         = std::find(srcNames.begin(), srcNames.end(), m_srclist[k]);
+      columnSrcs.push_back(name == srcNames.end() ? -1 
+                           : name - srcNames.begin());
+   }
+
+   int nthreads = m_pars["nthreads"];
+   ThreadPool pool(ThreadPool::resolveThreads(nthreads));
+   if (pool.nthreads() > 1) {
+      m_formatter->info(3) << "Using " << pool.nthreads() << " threads"
+                           << std::endl;
+   }
+   ObservationCopies observations(m_helper->observation(), pool.nthreads());
+   ModelCopies srcs(*m_sourceModel, srcNames, observations);
+
+// Each chunk of rows is copied byte-for-byte into the leading part of
+// the wider output rows, and the probabilities are then written
+// column-wise.
+   int chunkSize = m_pars["chunksize"];
+   std::vector<unsigned char> inbuf;
+   std::vector<unsigned char> outbuf;
+   std::vector<float> probs;
+   for (LONGLONG first(0); first < nrows; first += chunkSize) {
+      LONGLONG nchunk(std::min(nrows - first, LONGLONG(chunkSize)));
+      ProbTask task(events, srcs, columnSrcs, first, nchunk, probs);
+      pool.run(task, task.nblocks());
+
+      inbuf.resize(nchunk*inWidth);
+      fits_read_tblbytes(infile, first + 1, 1, nchunk*inWidth, 
+                         &inbuf[0], &status);
+      fitsReportError(status, routine);
+      outbuf.assign(nchunk*outWidth, 0);
+      for (LONGLONG r(0); r < nchunk; r++) {
+         std::memcpy(&outbuf[r*outWidth], &inbuf[r*inWidth], inWidth);
+      }
+      fits_write_tblbytes(outfile, first + 1, 1, nchunk*outWidth,
+                          &outbuf[0], &status);
+      fitsReportError(status, routine);
+
+      for (size_t k(0); k < colnums.size(); k++) {
+         fits_write_col(outfile, TFLOAT, colnums[k], first + 1, 1, nchunk,
+                        &probs[k*nchunk], &status);
+         fitsReportError(status, routine);
+      }
+   }
+   if (hasChecksum) {
+      fits_write_chksum(outfile, &status);
+      fitsReportError(status, routine);
+   }
 }
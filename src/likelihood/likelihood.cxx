@@ -132,6 +132,9 @@ private:
 
    optimizers::TOLTYPE m_tolType;
 
+   /// Use LogLike's spectral fast path in unbinned fits.
+   bool m_spectralFastPath;
+
    std::vector< std::vector<double> > m_covarianceMatrix;
 
    void promptForParameters();
@@ -144,6 +147,7 @@ private:
    void plotCountsSpectra();
    void printFitResults(const std::vector<double> &errors);
    void printFitQuality() const;
+   void updateModelSums() const;
    bool prompt(const std::string &query);
    void setErrors(const std::vector<double> & errors);
 
@@ -181,7 +185,7 @@ likelihood::likelihood()
      m_logLike(0), m_opt(0), m_dataMap(0), m_wmap(0),
      m_formatter(new st_stream::StreamFormatter("gtlike", "", 2)),
      m_cpuStart(std::clock()), m_tolType(optimizers::RELATIVE),
-     m_tsSrc(0), m_maxdist(20.) {
+     m_spectralFastPath(false), m_tsSrc(0), m_maxdist(20.) {
    setVersion(s_cvs_id);
    m_pars.setSwitch("statistic");
    m_pars.setCase("statistic", "BINNED", "cmap");
@@ -373,7 +377,12 @@ void likelihood::createStatistic() {
       m_dataMap = const_cast<CountsMapBase*>(&binnedLike->countsMap());
       return;
    } else if (m_statistic == "UNBINNED") {
-      m_logLike = new LogLike(m_helper->observation());
+      LogLike * logLike = new LogLike(m_helper->observation());
+      int nthreads = m_pars["nthreads"];
+      logLike->setNumThreads(nthreads);
+      m_spectralFastPath = m_pars["spectral_fast_path"];
+      logLike->setUseSpectralFastPath(m_spectralFastPath);
+      m_logLike = logLike;
    }
    readEventData();
 }
@@ -384,8 +393,9 @@ void likelihood::readEventData() {
       st_facilities::Util::file_ok(*evIt);
       if (m_statistic == "BINNED")
 	m_helper->observation().eventCont().getEvents(*evIt); // Why?
-      else if (m_statistic == "UNBINNED")
-	m_logLike->getEvents(*evIt);
+   }
+   if (m_statistic == "UNBINNED") {
+      m_logLike->getEvents(m_eventFiles);
    }
 }
 
@@ -455,7 +465,16 @@ private:
    const std::vector<Event> & m_events;
 };
 
+void likelihood::updateModelSums() const {
+// Evaluations on the spectral fast path leave Event::modelSum()
+// out of date, and the model counts are computed from those sums.
+   if (m_spectralFastPath) {
+      m_logLike->updateEventModelSums();
+   }
+}
+
 void likelihood::writeCountsSpectra() {
+   updateModelSums();
    CountsSpectra counts(*m_logLike);
 
    if (m_statistic == "UNBINNED") {
@@ -470,6 +489,7 @@ void likelihood::writeCountsSpectra() {
 }
 
 void likelihood::plotCountsSpectra() {
+   updateModelSums();
    CountsSpectra counts(*m_logLike);
 
    if (m_statistic == "UNBINNED") {
@@ -778,6 +798,7 @@ void likelihood::printFitResults(const std::vector<double> &errors) {
 }
 
 void likelihood::printFitQuality() const {
+   updateModelSums();
    CountsSpectra countsSpec(*m_logLike);
 
    if (m_statistic == "UNBINNED") {
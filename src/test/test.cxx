@@ -14,6 +14,7 @@
 #include <cstdio>
 
 #include <fstream>
+#include <memory>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
@@ -25,6 +26,8 @@
 
 #include "CLHEP/Random/RandFlat.h"
 
+#include "astro/SkyProj.h"
+
 #include "facilities/Util.h"
 #include "facilities/commonUtilities.h"
 
@@ -49,30 +52,41 @@
 #include "irfInterface/AcceptanceCone.h"
 #include "irfLoader/Loader.h"
 
+#include "Likelihood/AdaptiveGrid.h"
 #include "Likelihood/BinnedConfig.h"
 #include "Likelihood/BinnedExposure.h"
 #include "Likelihood/BinnedHealpixExposure.h"
 #include "Likelihood/BinnedLikelihood.h"
+#include "Likelihood/ComponentEvaluator.h"
+#include "Likelihood/Composite2.h"
 #include "Likelihood/CompositeSource.h"
+#include "Likelihood/Convolve.h"
 #include "Likelihood/CountsMap.h"
 #include "Likelihood/CountsMapHealpix.h"
+#include "Likelihood/DiffRespGrid.h"
 #include "Likelihood/DiffRespNames.h"
 #include "Likelihood/DiffuseSource.h"
 #include "Likelihood/Drm.h"
 #include "Likelihood/Event.h"
 #include "Likelihood/EventContainer.h"
 #include "Likelihood/ExposureMap.h"
+#include "Likelihood/FitScanner.h"
 #include "Likelihood/FitUtils.h"
 #include "Likelihood/FluxBuilder.h"
+#include "Likelihood/GaussianError.h"
 #include "Likelihood/LikeExposure.h"
+#include "Likelihood/LogLike.h"
 #include "Likelihood/LogNormal.h"
 #include "Likelihood/MeanPsf.h"
 #include "Likelihood/Observation.h"
 #include "Likelihood/PointSource.h"
+#include "Likelihood/PsfLocalizer.h"
 #include "Likelihood/ScaleFactor.h"
 #include "Likelihood/SourceModelBuilder.h"
+#include "Likelihood/RemoteLogLike.h"
 #include "Likelihood/ResponseFunctions.h"
 #include "Likelihood/RoiCuts.h"
+#include "Likelihood/ScanCheckpoint.h"
 #include "Likelihood/ScData.h"
 #include "Likelihood/SkyDirFunction.h"
 #include "Likelihood/Source.h"
@@ -80,6 +94,7 @@
 #include "Likelihood/SourceMap.h"
 #include "Likelihood/SourceModel.h"
 #include "Likelihood/SpatialMap.h"
+#include "Likelihood/SummedLikelihood.h"
 #include "Likelihood/TrapQuad.h"
 #include "Likelihood/WcsMap2.h"
 #include "Likelihood/BandFunction.h"
@@ -97,6 +112,7 @@
 #include "Likelihood/PowerLawSuperExpCutoff.h"
 #include "Likelihood/SmoothBrokenPowerLaw.h"
 #include "Likelihood/SmoothDoubleBrokenPowerLaw.h"
+#include "Likelihood/ThreadPool.h"
 #include "Likelihood/WcsMapLibrary.h"
 
 #include "SourceData.h"
@@ -121,6 +137,7 @@ class LikelihoodTests : public CppUnit::TestFixture {
    CPPUNIT_TEST(test_EblAtten);
    CPPUNIT_TEST(test_EnergyBand);
    CPPUNIT_TEST(test_RoiCuts);
+   CPPUNIT_TEST(test_RoiCuts_accept);
    CPPUNIT_TEST(test_SourceFactory);
    CPPUNIT_TEST(test_XmlBuilders);
    CPPUNIT_TEST(test_LikeExposure);
@@ -148,12 +165,29 @@ class LikelihoodTests : public CppUnit::TestFixture {
    CPPUNIT_TEST(test_PointSourceMap_hpx_region);
    CPPUNIT_TEST(test_rescaling);
    CPPUNIT_TEST(test_DiffRespNames);
+   CPPUNIT_TEST(test_DiffRespGrid);
    CPPUNIT_TEST_EXCEPTION(test_WcsMap2_exception, std::runtime_error);
    CPPUNIT_TEST(test_WcsMap2);
    CPPUNIT_TEST(test_ScaleFactor);
    CPPUNIT_TEST(test_Drm);
    CPPUNIT_TEST(test_Source_Npred);
    CPPUNIT_TEST(test_ExposureCube);
+   CPPUNIT_TEST(test_ThreadPool);
+   CPPUNIT_TEST(test_LogLike_threads);
+   CPPUNIT_TEST(test_EventContainer_getEvents);
+   CPPUNIT_TEST(test_FitUtils_hessian);
+   CPPUNIT_TEST(test_FitUtils_logLikeScan);
+   CPPUNIT_TEST(test_FitUtils_warmStart);
+   CPPUNIT_TEST(test_Convolve_correlate2d);
+   CPPUNIT_TEST(test_FitUtils_shiftedNorms);
+   CPPUNIT_TEST(test_FitScanner_sedThreads);
+   CPPUNIT_TEST(test_AdaptiveGrid);
+   CPPUNIT_TEST(test_ScanCheckpoint);
+   CPPUNIT_TEST(test_RemoteLogLike);
+   CPPUNIT_TEST(test_SummedLikelihood_threads);
+   CPPUNIT_TEST(test_Composite2_ties);
+   CPPUNIT_TEST(test_PsfLocalizer);
+   CPPUNIT_TEST(test_PsfLocalizer_model);
 
    CPPUNIT_TEST_SUITE_END();
 
@@ -174,6 +208,7 @@ public:
    void test_EblAtten();
    void test_EnergyBand();
    void test_RoiCuts();
+   void test_RoiCuts_accept();
    void test_SourceFactory();
    void test_XmlBuilders();
    void test_LikeExposure();
@@ -212,12 +247,29 @@ public:
    void test_PointSourceMap_hpx_region();
    void test_rescaling();
    void test_DiffRespNames();
+   void test_DiffRespGrid();
    void test_WcsMap2_exception();
    void test_WcsMap2();
    void test_ScaleFactor();
    void test_Drm();
    void test_Source_Npred();
    void test_ExposureCube();
+   void test_ThreadPool();
+   void test_LogLike_threads();
+   void test_EventContainer_getEvents();
+   void test_FitUtils_hessian();
+   void test_FitUtils_logLikeScan();
+   void test_FitUtils_warmStart();
+   void test_Convolve_correlate2d();
+   void test_FitUtils_shiftedNorms();
+   void test_FitScanner_sedThreads();
+   void test_AdaptiveGrid();
+   void test_ScanCheckpoint();
+   void test_RemoteLogLike();
+   void test_SummedLikelihood_threads();
+   void test_Composite2_ties();
+   void test_PsfLocalizer();
+   void test_PsfLocalizer_model();
 
 private:
 
@@ -736,6 +788,47 @@ void LikelihoodTests::test_RoiCuts() {
    ASSERT_EQUALS(my_dec, dec);
 }
 
+void LikelihoodTests::test_RoiCuts_accept() {
+   double ra(193.98);
+   double dec(-5.82);
+   double radius(20.);
+   double muZenMax(std::cos(100.*M_PI/180.));
+   m_roiCuts->setCuts(ra, dec, radius, 100., 1e5, 1e3, 5e4, muZenMax, true);
+
+// The cuts applied to the FT1 quantities agree with those applied to
+// the Event, on and off each of the boundaries.
+   astro::SkyDir center(ra, dec);
+   CLHEP::Hep3Vector e1(center.dir().orthogonal().unit());
+   double offsets[] = {0., 10., 19.9, 20.1, 90.};
+   double energies[] = {30., 100.1, 1e3, 9.99e4, 2e5};
+   double times[] = {0., 1e3 + 1., 2e4, 5e4 - 1., 6e4};
+   double mus[] = {-1., muZenMax - 1e-3, muZenMax + 1e-3, 1.};
+   astro::SkyDir zAxis(0., 90.);
+   astro::SkyDir xAxis(0., 0.);
+   size_t naccept(0);
+   for (size_t i(0); i < 5; i++) {
+      double theta(offsets[i]*M_PI/180.);
+      astro::SkyDir dir(std::cos(theta)*center.dir() + std::sin(theta)*e1);
+      for (size_t j(0); j < 5; j++) {
+         for (size_t k(0); k < 5; k++) {
+            for (size_t l(0); l < 4; l++) {
+               Event event(dir.ra(), dir.dec(), energies[j], times[k],
+                           zAxis, xAxis, mus[l], m_respFuncs->useEdisp(),
+                           m_respFuncs->respName(), 0);
+               bool accepted(m_roiCuts->accept(event));
+               CPPUNIT_ASSERT(accepted == m_roiCuts->accept(dir.ra(), dir.dec(),
+                                                            energies[j],
+                                                            times[k], mus[l]));
+               if (accepted) {
+                  naccept++;
+               }
+            }
+         }
+      }
+   }
+   CPPUNIT_ASSERT(naccept == 3*3*3*2);
+}
+
 void LikelihoodTests::test_SourceFactory() {
 
    SourceFactory * srcFactory = srcFactoryInstance();
@@ -1610,6 +1703,26 @@ void LikelihoodTests::test_MeanPsf() {
          CPPUNIT_ASSERT(fabs(my_trap.integral() - 1.) < 0.032);
       }
    }
+
+// The tabulated response path should reproduce ExposureCube::value.
+   int evtType(m_respFuncs->begin()->second->irfID());
+   ExposureCube::LivetimeHandle livetime;
+   std::vector<double> table;
+   for (size_t i(0); i < ra_values.size(); i++) {
+      astro::SkyDir dir(ra_values[i], dec_values[i]);
+      m_expCube->getLivetimeHandle(dir, livetime);
+      for (size_t k(0); k < energies.size(); k++) {
+         ExposureCube::Aeff aeff(energies[k], evtType, *m_observation);
+         double expected(m_expCube->value(dir, aeff, energies[k]));
+         m_expCube->fillResponseTable(aeff, table);
+         double exposure(m_expCube->exposure(livetime, table, energies[k]));
+         if (expected > 0) {
+            CPPUNIT_ASSERT(fabs(exposure/expected - 1.) < 1e-6);
+         } else {
+            CPPUNIT_ASSERT(exposure == 0);
+         }
+      }
+   }
 }
 
 void LikelihoodTests::test_BinnedExposureHealpix() {
@@ -1901,6 +2014,86 @@ void LikelihoodTests::test_DiffRespNames() {
    }
 }
 
+void LikelihoodTests::test_DiffRespGrid() {
+   SourceFactory * srcFactory = srcFactoryInstance();
+   Source * src = srcFactory->create("Extragalactic Diffuse");
+   std::vector<DiffuseSource *> srcs;
+   srcs.push_back(dynamic_cast<DiffuseSource *>(src));
+   CPPUNIT_ASSERT(srcs.front() != 0);
+
+// Events within 5 degrees of the anticenter, at 1-10 GeV and
+// inclinations of 10-50 degrees.
+   astro::SkyDir center(86.4, 28.9);
+   CLHEP::Hep3Vector e1(center.dir().orthogonal().unit());
+   CLHEP::Hep3Vector e2(center.dir().cross(e1).unit());
+   double time(1000.);
+   std::vector<Event> events;
+   for (size_t i(0); i < 40; i++) {
+      double offset(1.25*(i % 5)*M_PI/180.);
+      double phi(0.9*i);
+      CLHEP::Hep3Vector dir((std::cos(offset)*center.dir()
+                             + std::sin(offset)*(std::cos(phi)*e1
+                                                 + std::sin(phi)*e2)).unit());
+      double inclination((10. + 4.*(i % 11))*M_PI/180.);
+      CLHEP::Hep3Vector perp(dir.orthogonal().unit());
+      perp = std::cos(0.7*i)*perp + std::sin(0.7*i)*dir.cross(perp);
+      astro::SkyDir zAxis(std::cos(inclination)*dir 
+                          + std::sin(inclination)*perp);
+      astro::SkyDir xAxis(dir.cross(perp).unit());
+      double energy(1e3*std::pow(10., (i % 9)/8.));
+      astro::SkyDir appDir(dir);
+      events.push_back(Event(appDir.ra(), appDir.dec(), energy, time,
+                             zAxis, xAxis, 1., false,
+                             m_respFuncs->respName(), 0));
+   }
+
+   double costhetaMin(1);
+   double costhetaMax(-1);
+   for (size_t i(0); i < events.size(); i++) {
+      double costheta(DiffRespGrid::costheta(events[i]));
+      costhetaMin = std::min(costhetaMin, costheta);
+      costhetaMax = std::max(costhetaMax, costheta);
+   }
+   DiffRespGrid grid(64, 10, 10, costhetaMin, costhetaMax);
+   for (size_t i(0); i < events.size(); i++) {
+      grid.addEvent(events[i]);
+   }
+   CPPUNIT_ASSERT(grid.nnodes() > 0);
+
+// The exact responses at the nodes, and a function that is linear in
+// log(energy) and cos(inclination), which the interpolation should
+// reproduce.
+   size_t ncomps(2);
+   std::vector<double> nodeValues(grid.nnodes()*ncomps);
+   std::vector<double> values;
+   for (size_t inode(0); inode < grid.nnodes(); inode++) {
+      Event node(grid.nodeEvent(inode, time, m_respFuncs->respName()));
+      node.diffuseResponsesGQ(srcs, *m_respFuncs, values);
+      nodeValues[inode*ncomps] = values.front();
+      nodeValues[inode*ncomps + 1] = 2. + 3.*std::log10(node.getEnergy())
+         - DiffRespGrid::costheta(node);
+   }
+
+// Compare with the responses computed directly for each event.
+   double sum(0);
+   for (size_t i(0); i < events.size(); i++) {
+      std::vector<double> interpolated;
+      grid.interpolate(events[i], nodeValues, ncomps, interpolated);
+      CPPUNIT_ASSERT(interpolated.size() == ncomps);
+      double linear(2. + 3.*std::log10(events[i].getEnergy())
+                    - DiffRespGrid::costheta(events[i]));
+      CPPUNIT_ASSERT(std::fabs(interpolated[1] - linear) < 1e-8);
+
+      events[i].diffuseResponsesGQ(srcs, *m_respFuncs, values);
+      CPPUNIT_ASSERT(values.front() > 0);
+      double error((interpolated[0] - values.front())/values.front());
+      sum += error*error;
+   }
+// The default accuracy of gtdiffrsp
+   CPPUNIT_ASSERT(std::sqrt(sum/events.size()) < 0.01);
+   delete src;
+}
+
 void LikelihoodTests::test_WcsMap2_exception() {
    std::string extension;
    bool interpolate, enforceEnergyRange;
@@ -2081,6 +2274,1100 @@ void LikelihoodTests::test_ExposureCube() {
    }
 }
 
+namespace {
+   class SquareTask : public ThreadPool::Task {
+   public:
+      SquareTask(size_t nitems, size_t nthreads, size_t fail_item)
+         : m_values(nitems, 0), m_calls(nthreads, 0), 
+           m_fail_item(fail_item) {}
+      virtual void run(size_t item, size_t thread_id) {
+         if (item == m_fail_item) {
+            throw std::runtime_error("SquareTask failure");
+         }
+         m_values.at(item) += static_cast<double>(item*item);
+         m_calls.at(thread_id)++;
+      }
+      std::vector<double> m_values;
+      std::vector<size_t> m_calls;
+   private:
+      size_t m_fail_item;
+   };
+
+   class NestedTask : public ThreadPool::Task {
+   public:
+      NestedTask(ThreadPool & pool) : m_pool(pool), m_inner(1, 1, 1) {}
+      virtual void run(size_t, size_t) {
+         m_pool.run(m_inner, 1);
+      }
+   private:
+      ThreadPool & m_pool;
+      SquareTask m_inner;
+   };
+}
+
+void LikelihoodTests::test_ThreadPool() {
+   size_t nitems(1000);
+   size_t nthreads(4);
+   ThreadPool pool(nthreads);
+   CPPUNIT_ASSERT(pool.nthreads() >= 1 && pool.nthreads() <= nthreads);
+
+   SquareTask task(nitems, nthreads, nitems);
+   pool.run(task, nitems, 7);
+// Each item should have been processed exactly once.
+   size_t ncalls(0);
+   for (size_t i(0); i < nthreads; i++) {
+      ncalls += task.m_calls[i];
+   }
+   CPPUNIT_ASSERT(ncalls == nitems);
+   for (size_t i(0); i < nitems; i++) {
+      CPPUNIT_ASSERT(task.m_values[i] == static_cast<double>(i*i));
+   }
+
+// Exceptions thrown by tasks are propagated to the caller, and the
+// pool remains usable afterwards.
+   SquareTask bad_task(nitems, nthreads, nitems/2);
+   bool caught(false);
+   try {
+      pool.run(bad_task, nitems);
+   } catch (std::runtime_error &) {
+      caught = true;
+   }
+   CPPUNIT_ASSERT(caught);
+
+   SquareTask task2(10, nthreads, 10);
+   pool.run(task2, 10);
+   CPPUNIT_ASSERT(task2.m_values[3] == 9.);
+
+// Running a job on a pool that is already busy would hand out thread
+// ids that are in use, so it is refused, with or without worker
+// threads.
+   size_t pool_sizes[] = {1, nthreads};
+   for (size_t ipool(0); ipool < 2; ipool++) {
+      size_t n(pool_sizes[ipool]);
+      ThreadPool my_pool(n);
+      NestedTask nested(my_pool);
+      caught = false;
+      try {
+         my_pool.run(nested, 2);
+      } catch (std::runtime_error &) {
+         caught = true;
+      }
+      CPPUNIT_ASSERT(caught);
+      SquareTask task3(10, n, 10);
+      my_pool.run(task3, 10);
+      CPPUNIT_ASSERT(task3.m_values[3] == 9.);
+   }
+}
+
+void LikelihoodTests::test_EventContainer_getEvents() {
+   std::string eventFile = dataPath("single_src_events_0000.fits");
+
+   tearDown();
+   setUp();
+
+   m_scData->readData(m_scFile, 0, 86400, true);
+   m_roiCuts->setCuts(83.57, 22.01, 10., 100., 2e5, 0, 4.32e4, -1., true);
+
+// The events accepted by reading the file row by row and applying the
+// cuts to each Event.
+   std::vector<Event> expected;
+   tip::Table * eventTable = 
+      tip::IFileSvc::instance().editTable(eventFile, "events");
+   double ra, dec, energy, time, zenith_angle;
+   tip::Table::Iterator it = eventTable->begin();
+   tip::Table::Record & row = *it;
+   size_t nrows(0);
+   for ( ; it != eventTable->end(); ++it, nrows++) {
+      row["ra"].get(ra);
+      row["dec"].get(dec);
+      row["energy"].get(energy);
+      row["time"].get(time);
+      row["zenith_angle"].get(zenith_angle);
+      double muZenith(std::cos(zenith_angle*M_PI/180.));
+      Event event(ra, dec, energy, time, m_scData->zAxis(time),
+                  m_scData->xAxis(time), muZenith, 
+                  m_respFuncs->useEdisp(), m_respFuncs->respName(), 0);
+      bool accepted(m_roiCuts->accept(event));
+      CPPUNIT_ASSERT(accepted == m_roiCuts->accept(ra, dec, energy, time,
+                                                   muZenith));
+      if (accepted) {
+         expected.push_back(event);
+      }
+   }
+   delete eventTable;
+   CPPUNIT_ASSERT(expected.size() > 0 && expected.size() < nrows);
+
+// The chunked reader keeps the same events, in the same order.
+   EventContainer events(*m_respFuncs, *m_roiCuts, *m_scData);
+   events.getEvents(eventFile);
+   CPPUNIT_ASSERT(events.nEvents() == expected.size());
+   for (size_t i(0); i < expected.size(); i++) {
+      const Event & event(events.events()[i]);
+      CPPUNIT_ASSERT(event.getEnergy() == expected[i].getEnergy());
+      CPPUNIT_ASSERT(event.getArrTime() == expected[i].getArrTime());
+      CPPUNIT_ASSERT(event.getMuZenith() == expected[i].getMuZenith());
+      CPPUNIT_ASSERT(event.getDir().difference(expected[i].getDir()) < 1e-10);
+   }
+
+// Without the ROI cuts, all of the rows are kept.
+   EventContainer allEvents(*m_respFuncs, *m_roiCuts, *m_scData);
+   allEvents.getEvents(eventFile, false);
+   CPPUNIT_ASSERT(allEvents.nEvents() == nrows);
+
+// Reading several files, on more than one thread, keeps the order of
+// the files.
+   std::vector<std::string> eventFiles(2, eventFile);
+   EventContainer twoFiles(*m_respFuncs, *m_roiCuts, *m_scData);
+   twoFiles.getEvents(eventFiles, true, 3, 2);
+   CPPUNIT_ASSERT(twoFiles.nEvents() == 2*expected.size());
+   for (size_t i(0); i < expected.size(); i++) {
+      CPPUNIT_ASSERT(twoFiles.events()[i].getArrTime() 
+                     == expected[i].getArrTime());
+      CPPUNIT_ASSERT(twoFiles.events()[i + expected.size()].getArrTime() 
+                     == expected[i].getArrTime());
+   }
+}
+
+void LikelihoodTests::test_LogLike_threads() {
+   std::string eventFile = dataPath("single_src_events_0000.fits");
+
+   tearDown();
+   setUp();
+
+   m_scData->readData(m_scFile, 0, 86400, true);
+   m_roiCuts->setCuts(86.4, 28.9, 25., 30., 2e5, 0, 8.64e4, -1., true);
+
+   LogLike logLike(*m_observation);
+   logLike.getEvents(eventFile);
+
+   SourceFactory * srcFactory = srcFactoryInstance();
+   Source * src = srcFactory->create("Crab Pulsar");
+   dynamic_cast<PointSource *>(src)->setDir(83.57, 22.01, true, false);
+   logLike.addSource(src);
+   delete src;
+
+   std::vector<double> params;
+   logLike.getFreeParamValues(params);
+
+// The first evaluation is always serial and fills the response cache.
+   logLike.setUseSpectralFastPath(false);
+   double serial_value(logLike.value());
+   std::vector<double> serial_derivs;
+   logLike.getFreeDerivs(serial_derivs);
+
+// The threaded sums are combined in a fixed order, so the results
+// should agree to rounding.
+   logLike.setNumThreads(4);
+   logLike.setFreeParamValues(params);
+   double threaded_value(logLike.value());
+   std::vector<double> threaded_derivs;
+   logLike.getFreeDerivs(threaded_derivs);
+
+   ASSERT_EQUALS(threaded_value, serial_value);
+   CPPUNIT_ASSERT(threaded_derivs.size() == serial_derivs.size());
+   for (size_t i(0); i < serial_derivs.size(); i++) {
+      ASSERT_EQUALS(threaded_derivs[i], serial_derivs[i]);
+   }
+
+// The spectral-only fast path should give the same results.
+   logLike.setUseSpectralFastPath(true);
+   double fast_value(logLike.value());
+   std::vector<double> fast_derivs;
+   logLike.getFreeDerivs(fast_derivs);
+
+   ASSERT_EQUALS(fast_value, serial_value);
+   CPPUNIT_ASSERT(fast_derivs.size() == serial_derivs.size());
+   for (size_t i(0); i < serial_derivs.size(); i++) {
+      ASSERT_EQUALS(fast_derivs[i], serial_derivs[i]);
+   }
+
+// Restricting the energy range should give the same results on the
+// serial and fast paths, and unsetting it should recover the
+// full-range value.
+   logLike.set_ebounds(1e3, 1e4);
+   double band_fast_value(logLike.value());
+
+// The band exposure should be the exact one, including after
+// switching to another band and back.
+   logLike.set_ebounds(1e4, 1e5);
+   logLike.set_ebounds(1e3, 1e4);
+   const Source & crab(logLike.source("Crab Pulsar"));
+   Source * check(crab.clone());
+   check->computeExposure(crab.exposureEnergies());
+   CPPUNIT_ASSERT(check->exposure().size() == crab.exposure().size());
+   for (size_t k(0); k < crab.exposure().size(); k++) {
+      ASSERT_EQUALS(crab.exposure()[k], check->exposure()[k]);
+   }
+   delete check;
+   ASSERT_EQUALS(logLike.value(), band_fast_value);
+
+   logLike.setUseSpectralFastPath(false);
+   logLike.setNumThreads(1);
+   double band_serial_value(logLike.value());
+   ASSERT_EQUALS(band_fast_value, band_serial_value);
+   CPPUNIT_ASSERT(band_serial_value != serial_value);
+
+   logLike.unset_ebounds();
+   ASSERT_EQUALS(logLike.value(), serial_value);
+}
+
+namespace {
+   class CrabLogLikeFactory : public RemoteLogLike::Factory {
+   public:
+      CrabLogLikeFactory(const Observation & observation,
+                         const std::string & eventFile, Source * src) 
+         : m_observation(observation), m_eventFile(eventFile), m_src(src) {}
+      virtual LogLike * create() {
+         LogLike * logLike = new LogLike(m_observation);
+         logLike->getEvents(m_eventFile);
+         logLike->addSource(m_src);
+         return logLike;
+      }
+   private:
+      const Observation & m_observation;
+      std::string m_eventFile;
+      Source * m_src;
+   };
+}
+
+void LikelihoodTests::test_RemoteLogLike() {
+   std::string eventFile = dataPath("single_src_events_0000.fits");
+
+   tearDown();
+   setUp();
+
+   m_scData->readData(m_scFile, 0, 86400, true);
+   m_roiCuts->setCuts(86.4, 28.9, 25., 30., 2e5, 0, 8.64e4, -1., true);
+
+   SourceFactory * srcFactory = srcFactoryInstance();
+   Source * src = srcFactory->create("Crab Pulsar");
+   dynamic_cast<PointSource *>(src)->setDir(83.57, 22.01, true, false);
+
+// Start the workers before the events are read here, so that only
+// they hold the data for the remote components.
+   CrabLogLikeFactory factory(*m_observation, eventFile, src);
+   RemoteLogLike remote1(*m_observation, factory);
+   RemoteLogLike remote2(*m_observation, factory);
+   CPPUNIT_ASSERT(remote1.pid() > 0 && remote2.pid() > 0);
+   remote1.addSource(src);
+   remote2.addSource(src);
+
+   LogLike logLike(*m_observation);
+   logLike.getEvents(eventFile);
+   logLike.addSource(src);
+   delete src;
+
+   double local_value(logLike.value());
+   std::vector<double> local_derivs;
+   logLike.getFreeDerivs(local_derivs);
+
+   ASSERT_EQUALS(remote1.value(), local_value);
+   std::vector<double> remote_derivs;
+   remote1.getFreeDerivs(remote_derivs);
+   CPPUNIT_ASSERT(remote_derivs.size() == local_derivs.size());
+   for (size_t i(0); i < local_derivs.size(); i++) {
+      ASSERT_EQUALS(remote_derivs[i], local_derivs[i]);
+   }
+   ASSERT_EQUALS(remote1.NpredValue("Crab Pulsar"),
+                 logLike.NpredValue("Crab Pulsar"));
+
+// The cost used to order the components comes from the worker, which
+// holds the events.
+   ASSERT_EQUALS(ComponentEvaluator::cost(remote1),
+                 ComponentEvaluator::cost(logLike));
+
+// The current parameter values go to the worker with each request.
+   std::vector<double> params;
+   logLike.getFreeParamValues(params);
+   params[0] *= 2.;
+   logLike.setFreeParamValues(params);
+   remote1.setFreeParamValues(params);
+   ASSERT_EQUALS(remote1.value(), logLike.value());
+   CPPUNIT_ASSERT(remote1.value() != local_value);
+
+// Errors in the worker are reported to the coordinator.
+   try {
+      remote1.NpredValue("no such source");
+      CPPUNIT_ASSERT(false);
+   } catch (std::runtime_error &) {
+   }
+
+// A joint fit over two worker processes, the second evaluation of
+// which runs them concurrently.
+   SummedLikelihood summed;
+   summed.addComponent(remote1);
+   summed.addComponent(remote2);
+   summed.setNumThreads(2);
+   summed.syncParams();
+   logLike.getFreeDerivs(local_derivs);
+   for (size_t iter(0); iter < 2; iter++) {
+      ASSERT_EQUALS(summed.value(), 2.*logLike.value());
+      std::vector<double> summed_derivs;
+      summed.getFreeDerivs(summed_derivs);
+      CPPUNIT_ASSERT(summed_derivs.size() == local_derivs.size());
+      for (size_t i(0); i < local_derivs.size(); i++) {
+         ASSERT_EQUALS(summed_derivs[i], 2.*local_derivs[i]);
+      }
+   }
+}
+
+void LikelihoodTests::test_SummedLikelihood_threads() {
+   std::string eventFile = dataPath("single_src_events_0000.fits");
+
+   tearDown();
+   setUp();
+
+   m_scData->readData(m_scFile, 0, 86400, true);
+   m_roiCuts->setCuts(86.4, 28.9, 25., 30., 2e5, 0, 8.64e4, -1., true);
+
+   SourceFactory * srcFactory = srcFactoryInstance();
+   Source * src = srcFactory->create("Crab Pulsar");
+   dynamic_cast<PointSource *>(src)->setDir(83.57, 22.01, true, false);
+
+   LogLike logLike1(*m_observation);
+   logLike1.getEvents(eventFile);
+   logLike1.addSource(src);
+   LogLike logLike2(*m_observation);
+   logLike2.getEvents(eventFile);
+   logLike2.addSource(src);
+   delete src;
+
+// A prior on the first free parameter, which should be counted once.
+   size_t par_index(0);
+   while (!logLike1.parameters().at(par_index).isFree()) {
+      par_index++;
+   }
+   double par_value(logLike1.parameters()[par_index].getValue());
+   GaussianError prior(1., 1.1*par_value, 0.1*par_value, 0.);
+   logLike1.addPrior(par_index, prior);
+
+   SummedLikelihood summed;
+   summed.addComponent(logLike1);
+   summed.addComponent(logLike2);
+   summed.syncParams();
+
+   optimizers::Arg dummy;
+   double expected_value(logLike1.value(dummy, true)
+                         + logLike2.value(dummy, false));
+   CPPUNIT_ASSERT(logLike1.value(dummy, true) 
+                  != logLike1.value(dummy, false));
+   std::vector<double> derivs1, derivs2;
+   logLike1.getFreeDerivs(dummy, derivs1, true);
+   logLike2.getFreeDerivs(dummy, derivs2, false);
+
+// The first evaluations are serial in any case, so compare the
+// second ones.
+   double serial_value(0);
+   std::vector<double> serial_derivs;
+   for (size_t iter(0); iter < 2; iter++) {
+      serial_value = summed.value();
+      summed.getFreeDerivs(serial_derivs);
+   }
+   ASSERT_EQUALS(serial_value, expected_value);
+   CPPUNIT_ASSERT(serial_derivs.size() == derivs1.size());
+   for (size_t i(0); i < derivs1.size(); i++) {
+      ASSERT_EQUALS(serial_derivs[i], derivs1[i] + derivs2[i]);
+   }
+
+   summed.setNumThreads(2);
+   summed.syncParams();
+   for (size_t iter(0); iter < 2; iter++) {
+      CPPUNIT_ASSERT(summed.value() == serial_value);
+      std::vector<double> threaded_derivs;
+      summed.getFreeDerivs(threaded_derivs);
+      CPPUNIT_ASSERT(threaded_derivs == serial_derivs);
+   }
+}
+
+void LikelihoodTests::test_Composite2_ties() {
+   std::string eventFile = dataPath("single_src_events_0000.fits");
+
+   tearDown();
+   setUp();
+
+   m_scData->readData(m_scFile, 0, 86400, true);
+   m_roiCuts->setCuts(86.4, 28.9, 25., 30., 2e5, 0, 8.64e4, -1., true);
+
+   SourceFactory * srcFactory = srcFactoryInstance();
+   Source * src = srcFactory->create("Crab Pulsar");
+   dynamic_cast<PointSource *>(src)->setDir(83.57, 22.01, true, false);
+
+   LogLike like_a(*m_observation);
+   like_a.getEvents(eventFile);
+   like_a.addSource(src);
+   LogLike like_b(*m_observation);
+   like_b.getEvents(eventFile);
+   like_b.addSource(src);
+   delete src;
+
+   std::vector<size_t> free_indices;
+   const std::vector<Parameter> & pars(like_a.parameters());
+   for (size_t i(0); i < pars.size(); i++) {
+      if (pars[i].isFree()) {
+         free_indices.push_back(i);
+      }
+   }
+   CPPUNIT_ASSERT(free_indices.size() > 1);
+   size_t nfree(free_indices.size());
+   size_t tied(free_indices[0]);
+
+   Composite2 composite;
+   composite.addComponent(like_a);
+   composite.addComponent(like_b);
+   TiedParameter::ParVector_t ties;
+   ties.push_back(std::make_pair(&like_a, tied));
+   ties.push_back(std::make_pair(&like_b, tied));
+   composite.tieParameters(ties);
+   composite.syncParams();
+
+// A parameter can only be in one tie.
+   try {
+      composite.tieParameters(ties);
+      CPPUNIT_ASSERT(false);
+   } catch (std::runtime_error &) {
+   }
+
+// The components are ordered by address.  The free, untied
+// parameters of each follow in turn, then the tied parameter.
+   LogLike * first(&like_a < &like_b ? &like_a : &like_b);
+   LogLike * second(first == &like_a ? &like_b : &like_a);
+   CPPUNIT_ASSERT(composite.getNumFreeParams() == 2*nfree - 1);
+   std::vector<Parameter> freePars;
+   composite.getFreeParams(freePars);
+   CPPUNIT_ASSERT(freePars.size() == 2*nfree - 1);
+   for (size_t j(1); j < nfree; j++) {
+      size_t i(free_indices[j]);
+      CPPUNIT_ASSERT(composite.findIndex(*first, i) == int(j - 1));
+      CPPUNIT_ASSERT(composite.findIndex(*second, i) == int(nfree + j - 2));
+      CPPUNIT_ASSERT(freePars[j - 1].getName() == pars[i].getName());
+   }
+   CPPUNIT_ASSERT(composite.findIndex(like_a, tied) == int(2*nfree - 2));
+   CPPUNIT_ASSERT(composite.findIndex(like_b, tied) == int(2*nfree - 2));
+   for (size_t i(0); i < pars.size(); i++) {
+      if (!pars[i].isFree()) {
+         CPPUNIT_ASSERT(composite.findIndex(like_a, i) == -1);
+      }
+   }
+   CPPUNIT_ASSERT(&composite.getTiedParam(like_b, tied) 
+                  == &composite.getTiedParam(like_a, tied));
+
+// The derivative wrt the tied parameter is the sum of those of the
+// components.
+   optimizers::Arg dummy;
+   std::vector<double> derivs_first, derivs_second;
+   first->getFreeDerivs(dummy, derivs_first, true);
+   second->getFreeDerivs(dummy, derivs_second, true);
+   std::vector<double> derivs;
+   composite.getFreeDerivs(derivs);
+   CPPUNIT_ASSERT(derivs.size() == 2*nfree - 1);
+   for (size_t j(1); j < nfree; j++) {
+      ASSERT_EQUALS(derivs[j - 1], derivs_first[j]);
+      ASSERT_EQUALS(derivs[nfree + j - 2], derivs_second[j]);
+   }
+   ASSERT_EQUALS(derivs.back(), derivs_first[0] + derivs_second[0]);
+   ASSERT_EQUALS(composite.value(), like_a.value() + like_b.value());
+}
+
+void LikelihoodTests::test_FitUtils_hessian() {
+// More pixels than fit in one block, so that the partial sums over
+// several blocks are combined.
+   size_t npix(1000);
+   size_t npar(3);
+   std::vector< std::vector<float> > tmpls(npar, std::vector<float>(npix));
+   std::vector<const std::vector<float> *> templates;
+   std::vector<float> data(npix);
+   std::vector<float> fixed(npix, 0.5);
+   std::vector<float> weights(npix);
+   CLHEP::HepVector norms(npar, 1);
+   for (size_t k(0); k < npix; k++) {
+      for (size_t i(0); i < npar; i++) {
+         tmpls[i][k] = 1. + 0.5*std::sin(0.01*(i + 1)*k);
+      }
+      data[k] = k % 7;
+      weights[k] = 0.5 + 0.5*std::cos(0.003*k);
+   }
+   for (size_t i(0); i < npar; i++) {
+      templates.push_back(&tmpls[i]);
+   }
+
+   std::vector<float> model(npix);
+   CLHEP::HepVector gradient(npar);
+   CLHEP::HepSymMatrix hessian(npar);
+   FitUtils::getGradientAndHessian(data, norms, templates, fixed, 0,
+                                   &weights, model, gradient, hessian);
+
+// Compare with direct double-precision sums.
+   for (size_t i(0); i < npar; i++) {
+      double gval(0);
+      for (size_t k(0); k < npix; k++) {
+         double mod(fixed[k] + tmpls[0][k] + tmpls[1][k] + tmpls[2][k]);
+         double fdiff(data[k] > 0 ? 1. - data[k]/mod : 1.);
+         gval += weights[k]*fdiff*tmpls[i][k];
+      }
+      ASSERT_EQUALS(gradient[i], gval);
+      for (size_t j(i); j < npar; j++) {
+         double hval(0);
+         for (size_t k(0); k < npix; k++) {
+            double mod(fixed[k] + tmpls[0][k] + tmpls[1][k] + tmpls[2][k]);
+            hval += weights[k]*data[k]/(mod*mod)*tmpls[i][k]*tmpls[j][k];
+         }
+         ASSERT_EQUALS(hessian[i][j], hval);
+      }
+   }
+}
+
+void LikelihoodTests::test_FitUtils_logLikeScan() {
+   size_t npix(500);
+   size_t firstBin(100);
+   size_t lastBin(400);
+   std::vector<float> data(npix);
+   std::vector<float> fixed(npix);
+   std::vector<float> test(npix);
+   std::vector<float> weights(npix);
+   for (size_t k(0); k < npix; k++) {
+      data[k] = k % 5;
+      fixed[k] = 1. + 0.5*std::sin(0.02*k);
+      test[k] = 0.1*(k % 11);
+      weights[k] = 0.5 + 0.5*std::cos(0.003*k);
+   }
+   std::vector<double> norms;
+   for (size_t j(0); j < 7; j++) {
+      norms.push_back(0.5*j);
+   }
+
+// Compare with building the model and evaluating the log-likelihood
+// at each normalization in turn.
+   std::vector<double> logLikes;
+   std::vector<double> wtdLogLikes;
+   FitUtils::logLikePoissonScan(data, fixed, test, norms, logLikes,
+                                0, firstBin, lastBin);
+   FitUtils::logLikePoissonScan(data, fixed, test, norms, wtdLogLikes,
+                                &weights, firstBin, lastBin);
+   CPPUNIT_ASSERT(logLikes.size() == norms.size());
+   std::vector<float> model(npix);
+   for (size_t j(0); j < norms.size(); j++) {
+      for (size_t k(0); k < npix; k++) {
+         model[k] = fixed[k] + norms[j]*test[k];
+      }
+      double expected
+         = FitUtils::logLikePoisson(data.begin() + firstBin,
+                                    data.begin() + lastBin,
+                                    model.begin() + firstBin,
+                                    model.begin() + lastBin);
+      ASSERT_EQUALS(logLikes[j], expected);
+      double wtdExpected
+         = FitUtils::logLikePoisson(data.begin() + firstBin,
+                                    data.begin() + lastBin,
+                                    model.begin() + firstBin,
+                                    model.begin() + lastBin,
+                                    weights.begin() + firstBin,
+                                    weights.begin() + lastBin);
+      ASSERT_EQUALS(wtdLogLikes[j], wtdExpected);
+   }
+}
+
+void LikelihoodTests::test_Convolve_correlate2d() {
+   size_t nx(5);
+   size_t ny(4);
+   std::vector<double> signal(nx*ny);
+   std::vector<double> kernel(nx*ny);
+   for (size_t k(0); k < nx*ny; k++) {
+      signal[k] = 1. + std::sin(0.7*k);
+      kernel[k] = (k % 3) + 0.25*std::cos(1.3*k);
+   }
+   std::vector<double> output;
+   Convolve::correlate2d(nx, ny, signal, kernel, output);
+   CPPUNIT_ASSERT(output.size() == (2*nx - 1)*(2*ny - 1));
+
+// Compare with the direct sum for every shift.
+   int inx(nx);
+   int iny(ny);
+   for (int dy(1 - iny); dy < iny; dy++) {
+      for (int dx(1 - inx); dx < inx; dx++) {
+         double expected(0);
+         for (int y(0); y < iny; y++) {
+            for (int x(0); x < inx; x++) {
+               if (x - dx < 0 || x - dx >= inx || y - dy < 0 || y - dy >= iny) {
+                  continue;
+               }
+               expected += signal[y*nx + x]*kernel[(y - dy)*nx + x - dx];
+            }
+         }
+         size_t k((dy + iny - 1)*(2*nx - 1) + dx + inx - 1);
+         CPPUNIT_ASSERT(std::fabs(output[k] - expected) < 1e-10);
+      }
+   }
+}
+
+void LikelihoodTests::test_FitUtils_shiftedNorms() {
+   size_t nx(12);
+   size_t ny(10);
+   size_t ne(2);
+   size_t nmap(nx*ny);
+   int inx(nx);
+   int iny(ny);
+// A source at (2, 1) pixels from the reference image, bright enough
+// that the expansion of the log-likelihood fails near it.
+   std::vector<float> ref(nmap*ne);
+   std::vector<float> bkg(nmap*ne);
+   std::vector<float> data(nmap*ne);
+   for (size_t ie(0); ie < ne; ie++) {
+      double amp(ie == 0 ? 10. : 5.);
+      double width(ie == 0 ? 4.5 : 2.);
+      for (int y(0); y < iny; y++) {
+         for (int x(0); x < inx; x++) {
+            size_t i(ie*nmap + y*nx + x);
+            ref[i] = amp*std::exp(-((x - 5.)*(x - 5.) + (y - 4.)*(y - 4.))/width);
+            bkg[i] = 2. + 0.1*x;
+            double src = amp*std::exp(-((x - 7.)*(x - 7.) + (y - 5.)*(y - 5.))/width);
+            data[i] = std::floor(bkg[i] + 3.*src + 0.5);
+         }
+      }
+   }
+   std::vector<double> norms;
+   std::vector<double> deltaLogLikes;
+   std::vector<double> curvatures;
+   std::vector<double> maxRatios;
+   FitUtils::fitShiftedNorms_fft(nx, ny, ne, data, bkg, ref, 0,
+                                 norms, deltaLogLikes, curvatures, maxRatios);
+   CPPUNIT_ASSERT(norms.size() == (2*nx - 1)*(2*ny - 1));
+
+// Compare with the log-likelihood of the shifted image at each shift
+// around the source.
+   std::vector<float> shifted(nmap*ne);
+   size_t nExact(0);
+   for (int dy(-3); dy <= 3; dy++) {
+      for (int dx(-3); dx <= 5; dx++) {
+         size_t k((dy + iny - 1)*(2*nx - 1) + dx + inx - 1);
+         double maxRatio(0);
+         for (size_t ie(0); ie < ne; ie++) {
+            for (int y(0); y < iny; y++) {
+               for (int x(0); x < inx; x++) {
+                  size_t i(ie*nmap + y*nx + x);
+                  shifted[i] = 0;
+                  if (x - dx < 0 || x - dx >= inx || y - dy < 0 || y - dy >= iny) {
+                     continue;
+                  }
+                  shifted[i] = ref[ie*nmap + (y - dy)*nx + x - dx];
+                  if (data[i] > 0) {
+                     maxRatio = std::max(maxRatio, double(shifted[i]/bkg[i]));
+                  }
+               }
+            }
+         }
+         CPPUNIT_ASSERT(maxRatios[k] >= maxRatio*(1. - 1e-6));
+
+// The exact fit is at the maximum of the log-likelihood.
+         double norm(1.);
+         double deltaLogLike(0);
+         double curvature(0);
+         FitUtils::fitShiftedNorm_exact(nx, ny, ne, dx, dy, data, bkg, ref, 0,
+                                        norm, deltaLogLike, curvature);
+         CPPUNIT_ASSERT(norm >= 0);
+         double step(1e-3*std::max(norm, 1.));
+         std::vector<double> scanNorms;
+         scanNorms.push_back(0);
+         scanNorms.push_back(norm);
+         scanNorms.push_back(norm + step);
+         if (norm > step) {
+            scanNorms.push_back(norm - step);
+         }
+         std::vector<double> logLikes;
+         FitUtils::logLikePoissonScan(data, bkg, shifted, scanNorms, logLikes);
+         double expected(logLikes[1] - logLikes[0]);
+         CPPUNIT_ASSERT(std::fabs(deltaLogLike - expected) 
+                        < 1e-6*std::max(1., std::fabs(expected)));
+         for (size_t j(2); j < logLikes.size(); j++) {
+            CPPUNIT_ASSERT(logLikes[j] <= logLikes[1] + 1e-9);
+         }
+
+// Where the expansion holds, the FFT fit agrees with the exact one.
+         if (norms[k]*maxRatios[k] < 0.5) {
+            CPPUNIT_ASSERT(std::fabs(deltaLogLikes[k] - deltaLogLike)
+                           < 0.02*std::max(1., deltaLogLike));
+         } else {
+            nExact++;
+         }
+      }
+   }
+// The shifts onto the source need the exact fit.
+   size_t kSrc((1 + iny - 1)*(2*nx - 1) + 2 + inx - 1);
+   CPPUNIT_ASSERT(norms[kSrc]*maxRatios[kSrc] >= 0.5);
+   CPPUNIT_ASSERT(nExact > 0);
+}
+
+void LikelihoodTests::test_FitScanner_sedThreads() {
+   std::string exposureCubeFile = dataPath("expcube_1_day.fits");
+   if (!st_facilities::Util::fileExists(exposureCubeFile)) {
+      generate_exposureHyperCube();
+   }
+   m_expCube->readExposureCube(exposureCubeFile);
+
+   SourceFactory * srcFactory = srcFactoryInstance();
+   (void)(srcFactory);
+
+   CountsMap dataMap(singleSrcMap(5));
+   BinnedLikeConfig like_config;
+   BinnedLikelihood binnedLogLike(dataMap, *m_observation, like_config);
+   binnedLogLike.readXml(dataPath("anticenter_model_2.xml"), *m_funcFactory);
+
+#ifdef DARWIN_F2C_FAILURE
+   optimizers::NewMinuit my_optimizer(binnedLogLike);
+#else
+   optimizers::Minuit my_optimizer(binnedLogLike);
+#endif
+   std::auto_ptr<astro::SkyProj> 
+      proj(FitScanner::buildSkyProj("CAR", astro::SkyDir(83.57, 22.01),
+                                    0.25, 1));
+   FitScanner scanner(binnedLogLike, my_optimizer, *proj, 1, 1);
+   scanner.set_quiet(true);
+   scanner.set_nThreads(1);
+   scanner.setTestSourceByName("Crab Pulsar");
+
+// The SED at the Crab sets up the fit cache.
+   int nnorm(5);
+   double normSigma(5.);
+   CPPUNIT_ASSERT(scanner.run_tscube(false, true, nnorm, normSigma) == 0);
+
+// Fit the energy bins in turn, then concurrently.
+   std::vector<double> norm_mles[2];
+   std::vector<double> pos_errs[2];
+   std::vector<double> neg_errs[2];
+   std::vector<double> logLike_mles[2];
+   std::vector<double> uls[2];
+   std::vector<int> sed_fit_status[2];
+   std::vector<std::vector<double> > norms[2];
+   std::vector<std::vector<double> > logLikes[2];
+   ThreadPool pool(3);
+   for (size_t i(0); i < 2; i++) {
+      scanner.sed_binned_newton(nnorm, normSigma, -1., norm_mles[i],
+                                pos_errs[i], neg_errs[i], logLike_mles[i],
+                                uls[i], sed_fit_status[i], norms[i],
+                                logLikes[i], i == 0 ? 0 : &pool);
+   }
+
+   size_t nebins(scanner.nEBins());
+   CPPUNIT_ASSERT(nebins > 1);
+   CPPUNIT_ASSERT(norm_mles[1].size() == nebins);
+   double tol(1e-6);
+   for (size_t k(0); k < nebins; k++) {
+      CPPUNIT_ASSERT(sed_fit_status[1][k] == sed_fit_status[0][k]);
+      CPPUNIT_ASSERT(std::fabs(norm_mles[1][k] - norm_mles[0][k])
+                     < tol*std::max(1., std::fabs(norm_mles[0][k])));
+      CPPUNIT_ASSERT(std::fabs(pos_errs[1][k] - pos_errs[0][k])
+                     < tol*std::max(1., std::fabs(pos_errs[0][k])));
+      CPPUNIT_ASSERT(std::fabs(neg_errs[1][k] - neg_errs[0][k])
+                     < tol*std::max(1., std::fabs(neg_errs[0][k])));
+      CPPUNIT_ASSERT(std::fabs(uls[1][k] - uls[0][k])
+                     < tol*std::max(1., std::fabs(uls[0][k])));
+      CPPUNIT_ASSERT(std::fabs(logLike_mles[1][k] - logLike_mles[0][k])
+                     < tol*std::max(1., std::fabs(logLike_mles[0][k])));
+      CPPUNIT_ASSERT(logLikes[1][k].size() == logLikes[0][k].size());
+      for (size_t j(0); j < logLikes[0][k].size(); j++) {
+         CPPUNIT_ASSERT(std::fabs(norms[1][k][j] - norms[0][k][j])
+                        < tol*std::max(1., std::fabs(norms[0][k][j])));
+         CPPUNIT_ASSERT(std::fabs(logLikes[1][k][j] - logLikes[0][k][j])
+                        < tol*std::max(1., std::fabs(logLikes[0][k][j])));
+      }
+   }
+}
+
+void LikelihoodTests::test_AdaptiveGrid() {
+   long nx(37);
+   long ny(21);
+   long npix(nx*ny);
+   std::vector<long> pixels;
+
+// A plane below the thresholds is only evaluated on the coarse grid,
+// and the bilinear interpolation reproduces it.
+   AdaptiveGrid coarse(nx, ny, 8, 100., 100.);
+   std::vector<double> values(npix, 0);
+   while (coarse.nextPixels(pixels)) {
+      for (size_t k(0); k < pixels.size(); k++) {
+         long ipix(pixels[k]);
+         values[ipix] = 10. + 0.5*(ipix % nx) - 0.25*(ipix/nx);
+         coarse.setValue(ipix, values[ipix]);
+      }
+   }
+   CPPUNIT_ASSERT(coarse.nEvaluated() == 6*4);
+   coarse.interpolate(values);
+   for (long ipix(0); ipix < npix; ipix++) {
+      double expected(10. + 0.5*(ipix % nx) - 0.25*(ipix/nx));
+      ASSERT_EQUALS(values[ipix], expected);
+   }
+
+// Cells above the threshold are refined down to every pixel.
+   AdaptiveGrid fine(nx, ny, 8, -1., 100.);
+   while (fine.nextPixels(pixels)) {
+      for (size_t k(0); k < pixels.size(); k++) {
+         fine.setValue(pixels[k], 0);
+      }
+   }
+   CPPUNIT_ASSERT(fine.nEvaluated() == npix);
+}
+
+void LikelihoodTests::test_FitUtils_warmStart() {
+// A background and a test source that is moved across the data, as
+// in a TS map.  The fits at each position are done from the fixed
+// starting values and from the result at the previous position.
+   size_t npix(400);
+   std::vector<float> bkg(npix);
+   std::vector<float> data(npix);
+   std::vector<float> fixed(npix, 0.2);
+   for (size_t k(0); k < npix; k++) {
+      bkg[k] = 2. + std::sin(0.03*k);
+      double src(20.*std::exp(-(k - 200.)*(k - 200.)/200.));
+      data[k] = std::floor(1.3*bkg[k] + 2.*src + fixed[k] + 0.5);
+   }
+   CLHEP::HepVector initNorms(2, 1);
+   CLHEP::HepVector seedNorms(initNorms);
+   std::vector<float> test(npix);
+   for (size_t j(0); j < 10; j++) {
+      double center(190. + 2.*j);
+      for (size_t k(0); k < npix; k++) {
+         test[k] = 20.*std::exp(-(k - center)*(k - center)/200.);
+      }
+      std::vector<const std::vector<float> *> templates;
+      templates.push_back(&bkg);
+      templates.push_back(&test);
+
+      CLHEP::HepVector coldNorms;
+      CLHEP::HepSymMatrix coldCovar;
+      CLHEP::HepVector coldGradient;
+      std::vector<float> coldModel(npix);
+      double coldEdm, coldLogLike;
+      int coldStatus 
+         = FitUtils::fitNorms_newton(data, initNorms, templates, fixed, 0, 0,
+                                     1e-8, 50, 0., coldNorms, coldCovar,
+                                     coldGradient, coldModel, coldEdm,
+                                     coldLogLike);
+      CPPUNIT_ASSERT(coldStatus == 0);
+
+      CLHEP::HepVector warmNorms;
+      CLHEP::HepSymMatrix warmCovar;
+      CLHEP::HepVector warmGradient;
+      std::vector<float> warmModel(npix);
+      double warmEdm, warmLogLike;
+      int warmStatus 
+         = FitUtils::fitNorms_newton(data, seedNorms, templates, fixed, 0, 0,
+                                     1e-8, 50, 0., warmNorms, warmCovar,
+                                     warmGradient, warmModel, warmEdm,
+                                     warmLogLike);
+      CPPUNIT_ASSERT(warmStatus == 0);
+
+      CPPUNIT_ASSERT(std::fabs(warmLogLike - coldLogLike) < 1e-4);
+      for (int i(0); i < 2; i++) {
+         CPPUNIT_ASSERT(std::fabs(warmNorms[i] - coldNorms[i]) 
+                        < 1e-3*std::fabs(coldNorms[i]));
+      }
+      seedNorms = warmNorms;
+   }
+}
+
+void LikelihoodTests::test_ScanCheckpoint() {
+   std::string filename("test_checkpoint.ckpt");
+   std::vector<float> ts(10);
+   for (size_t i(0); i < ts.size(); i++) {
+      ts[i] = 0.5*i;
+   }
+   ScanCheckpoint checkpoint(filename, "scan 10", ts.size(), 60.);
+   checkpoint.setDone(2);
+   checkpoint.setDone(7);
+   checkpoint.setArray("TS", ts);
+   checkpoint.setParams(std::vector<double>(1, -1234.5));
+   checkpoint.write();
+
+   ScanCheckpoint resumed(filename, "scan 10", ts.size(), 60.);
+   CPPUNIT_ASSERT(resumed.read());
+   CPPUNIT_ASSERT(resumed.nDone() == 2);
+   CPPUNIT_ASSERT(resumed.done(2) && resumed.done(7) && !resumed.done(3));
+   std::vector<float> values;
+   CPPUNIT_ASSERT(resumed.getArray("TS", values));
+   CPPUNIT_ASSERT(values == ts);
+   CPPUNIT_ASSERT(resumed.params().size() == 1 &&
+                  resumed.params()[0] == -1234.5);
+
+// A checkpoint of a different scan is not resumed.
+   ScanCheckpoint other(filename, "scan 11", ts.size(), 60.);
+   CPPUNIT_ASSERT(!other.read());
+   CPPUNIT_ASSERT(other.nDone() == 0);
+
+   resumed.remove();
+   CPPUNIT_ASSERT(!resumed.read());
+}
+
+void LikelihoodTests::test_PsfLocalizer() {
+   std::string exposureCubeFile = dataPath("expcube_1_day.fits");
+   if (!st_facilities::Util::fileExists(exposureCubeFile)) {
+      generate_exposureHyperCube();
+   }
+   m_expCube->readExposureCube(exposureCubeFile);
+   m_scData->readData(m_scFile, 0, 86400, true);
+
+   astro::SkyDir srcDir(83.57, 22.01);
+   std::vector<double> energies;
+   for (size_t k(0); k < 5; k++) {
+      energies.push_back(1e3*std::pow(10., k/4.));
+   }
+   MeanPsf meanPsf(srcDir, energies, *m_observation);
+
+// Rings of events about the source at each of the psf energies, so
+// that the best-fit position is the source position.
+   CLHEP::Hep3Vector center(srcDir.dir());
+   CLHEP::Hep3Vector e1(center.orthogonal().unit());
+   CLHEP::Hep3Vector e2(center.cross(e1).unit());
+   double time(1000.);
+   astro::SkyDir zAxis = m_scData->zAxis(time);
+   std::vector<Event> events;
+   for (size_t k(0); k < energies.size(); k++) {
+      double scale(0.8*std::pow(energies[k]/1e3, -0.8)*M_PI/180.);
+      for (size_t ring(1); ring <= 4; ring++) {
+         double theta(0.5*ring*scale);
+         for (size_t j(0); j < 8; j++) {
+            double phi(j*M_PI/4.);
+            astro::SkyDir dir((std::cos(theta)*center 
+                               + std::sin(theta)*(std::cos(phi)*e1
+                                                  + std::sin(phi)*e2)).unit());
+            events.push_back(Event(dir.ra(), dir.dec(), energies[k], time,
+                                   zAxis.ra(), zAxis.dec(), 1.,
+                                   m_respFuncs->useEdisp(),
+                                   m_respFuncs->respName(), 0));
+         }
+      }
+   }
+
+// Start away from the source, with a fixed, uniform background.
+   astro::SkyDir startDir(83.87, 22.21);
+   std::vector<double> srcWeights(events.size(), 1.);
+   std::vector<double> srcDensity(events.size());
+   std::vector<double> bgDensity(events.size(), 10.);
+   for (size_t i(0); i < events.size(); i++) {
+      double sep(events[i].getDir().difference(startDir)*180./M_PI);
+      srcDensity[i] = meanPsf(events[i].getEnergy(), sep);
+   }
+   PsfLocalizer localizer(events, meanPsf, startDir.dir(), srcWeights,
+                          srcDensity, bgDensity, events.size());
+   CPPUNIT_ASSERT(localizer.nevents() == events.size());
+
+   ThreadPool pool(2);
+   CLHEP::Hep3Vector bestDir(startDir.dir());
+   CPPUNIT_ASSERT(localizer.localize(bestDir, 0.1, 1e-3, pool) == 0);
+   double offset(astro::SkyDir(bestDir).difference(srcDir)*180./M_PI);
+   CPPUNIT_ASSERT(offset < 5e-3);
+
+// The log-likelihood should fall by about 1.14, its value for the
+// 68% region of a two-dimensional Gaussian, at the error radius.
+   double radius(localizer.errorRadius());
+   CPPUNIT_ASSERT(radius > 0 && radius < 1.);
+   double norm;
+   double best(localizer.logLike(bestDir, norm));
+   CLHEP::Hep3Vector b1(bestDir.orthogonal().unit());
+   CLHEP::Hep3Vector b2(bestDir.cross(b1).unit());
+   double drop(0);
+   for (int sign(-1); sign <= 1; sign += 2) {
+      drop += best - localizer.logLike((bestDir + sign*radius*M_PI/180.*b1)
+                                       .unit(), norm);
+      drop += best - localizer.logLike((bestDir + sign*radius*M_PI/180.*b2)
+                                       .unit(), norm);
+   }
+   drop /= 4.;
+   CPPUNIT_ASSERT(drop > 1.14/1.5 && drop < 1.14*1.5);
+}
+
+void LikelihoodTests::test_PsfLocalizer_model() {
+   std::string eventFile = dataPath("single_src_events_0000.fits");
+
+   tearDown();
+   setUp();
+
+   std::string exposureCubeFile = dataPath("expcube_1_day.fits");
+   if (!st_facilities::Util::fileExists(exposureCubeFile)) {
+      generate_exposureHyperCube();
+   }
+   m_expCube->readExposureCube(exposureCubeFile);
+   m_scData->readData(m_scFile, 0, 86400, true);
+   m_roiCuts->setCuts(86.4, 28.9, 25., 30., 2e5, 0, 8.64e4, -1., true);
+
+   LogLike logLike(*m_observation);
+   logLike.getEvents(eventFile);
+
+// Start away from the Crab, with another point source in the model
+// as the background.
+   SourceFactory * srcFactory = srcFactoryInstance();
+   Source * src = srcFactory->create("Crab Pulsar");
+   PointSource * testSrc = dynamic_cast<PointSource *>(src);
+   testSrc->setDir(83.87, 22.21, true, false);
+   logLike.addSource(testSrc);
+   Source * bgSrc = srcFactory->create("PKS 0528+134");
+   logLike.addSource(bgSrc);
+   delete bgSrc;
+
+// Stand-in for a fit: the model's copy of the test source has other
+// spectral parameters than the source that was added.
+   Source * fitted = logLike.getSource("Crab Pulsar");
+   optimizers::Function & spectrum(fitted->spectrum());
+   spectrum.setParam("Prefactor", 2.*spectrum.getParamValue("Prefactor"));
+   spectrum.setParam("Index", -2.5);
+
+   const std::vector<Event> & events(m_observation->eventCont().events());
+   CPPUNIT_ASSERT(events.size() > 0);
+   double emin(events.front().getEnergy());
+   double emax(emin);
+   for (size_t j(0); j < events.size(); j++) {
+      emin = std::min(emin, events[j].getEnergy());
+      emax = std::max(emax, events[j].getEnergy());
+   }
+   std::vector<double> energies;
+   size_t nee(10);
+   for (size_t k(0); k < nee; k++) {
+      energies.push_back(emin*std::pow(emax/emin, 
+                                       static_cast<double>(k)/(nee - 1)));
+   }
+   energies.back() = emax*1.01;
+   MeanPsf meanPsf(testSrc->getDir(), energies, *m_observation);
+
+   std::vector<double> srcWeights;
+   std::vector<double> srcDensity;
+   std::vector<double> bgDensity;
+   PsfLocalizer::modelDensities(events, meanPsf, logLike, "Crab Pulsar",
+                                srcWeights, srcDensity, bgDensity);
+   CPPUNIT_ASSERT(srcWeights.size() == events.size());
+   Source * bgFitted = logLike.getSource("PKS 0528+134");
+   for (size_t j(0); j < events.size(); j++) {
+      double energy(events[j].getEnergy());
+      optimizers::dArg eArg(energy);
+      ASSERT_EQUALS(srcWeights[j], 
+                    spectrum(eArg)*meanPsf.exposure(energy));
+      double density(fitted->fluxDensity(events[j])*events[j].efficiency());
+      if (density > 0) {
+         ASSERT_EQUALS(srcDensity[j], density);
+      } else {
+         CPPUNIT_ASSERT(srcDensity[j] == 0);
+      }
+      double bg(bgFitted->fluxDensity(events[j])*events[j].efficiency());
+      CPPUNIT_ASSERT(fabs(bgDensity[j] - bg) <= m_fracTol*bg);
+   }
+
+// The whole localization, as gtfindsrc does it.
+   PsfLocalizer localizer(events, meanPsf, testSrc->getDir().dir(),
+                          srcWeights, srcDensity, bgDensity,
+                          logLike.NpredValue("Crab Pulsar"));
+   ThreadPool pool(2);
+   CLHEP::Hep3Vector bestDir(testSrc->getDir().dir());
+   CPPUNIT_ASSERT(localizer.localize(bestDir, 0.3, 1e-3, pool) == 0);
+   double radius(localizer.errorRadius());
+   CPPUNIT_ASSERT(radius > 0);
+   astro::SkyDir crab(83.57, 22.01);
+   double offset(astro::SkyDir(bestDir).difference(crab)*180./M_PI);
+   CPPUNIT_ASSERT(offset < 3.*radius);
+   double startNorm;
+   double start(localizer.logLike(testSrc->getDir().dir(), startNorm));
+   double norm;
+   CPPUNIT_ASSERT(localizer.logLike(bestDir, norm) >= start);
+   CPPUNIT_ASSERT(norm > 0);
+   delete src;
+}
+
 void LikelihoodTests::readEventData(const std::string &eventFile,
                                     const std::string &scDataFile,
                                     std::vector<Event> &events) {